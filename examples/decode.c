@@ -12,6 +12,9 @@
  * 	TXTFILE         The file where the decoded text will be written
  * 	                Pass /dev/stdout as TXTFILE to conveniently print the
  * 	                decoded contents of COMPRESSEDFILE
+ *
+ * The file is decoded a piece at a time, so COMPRESSEDFILE may also be a pipe,
+ * like /dev/stdin.
  */
 
 #include <stdio.h>
@@ -20,10 +23,17 @@
 #include <stdlib.h>
 #include <cobalt.h>
 
+#define BUFFER_SIZE	(64 * 1024)
+
 int main(int argc, char **argv) {
-	size_t sz;
-	char *sentence;		/* input file buffer */
-	uint16_t *encoded;	/* output file buffer */
+	uint16_t inbuf[BUFFER_SIZE];	/* input file buffer */
+	char outbuf[BUFFER_SIZE];		/* output file buffer */
+	const uint16_t *in;
+	size_t inLength;
+	char *out;
+	size_t capacity;
+	cblt_decoder *dec;
+	bool done = false;
 	FILE *infile, *outfile;
 	
 	if (argc != 3) {
@@ -42,32 +52,36 @@ int main(int argc, char **argv) {
 		fclose(infile);
 		return EXIT_FAILURE;
 	}
-
-	/* read stuff */
-	fseek(infile, 0, SEEK_END);
-	sz = ftell(infile) / sizeof(uint16_t);
-	rewind(infile);
-	encoded = malloc(sizeof(uint16_t) * (sz + 1));	/* +1 for null terminator */
-	if (encoded == NULL) {
+	dec = cblt_createDecoder();
+	if (dec == NULL) {
 		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
 		fclose(infile);
 		fclose(outfile);
-		return (EXIT_FAILURE);
+		return EXIT_FAILURE;
 	}
-	fread(encoded, sz, sizeof(uint16_t), infile);
-	encoded[sz] = 0;
-	fclose(infile);
 
-	/* decode stuff */
-	sentence = cblt_decodeSentence(encoded);
+	/* decode stuff, a piece at a time */
+	while (!done && (inLength = fread(inbuf, sizeof(uint16_t), BUFFER_SIZE,
+			infile)) > 0) {
+		in = inbuf;
+		do {
+			out = outbuf;
+			capacity = BUFFER_SIZE;
+			done = cblt_decoderUpdate(dec, &in, &inLength, &out, &capacity);
+			fwrite(outbuf, sizeof(char), out - outbuf, outfile);
+		} while (!done && inLength > 0);
+	}
+	/* in case the file was cut short */
+	while (!done) {
+		out = outbuf;
+		capacity = BUFFER_SIZE;
+		done = cblt_decoderFinish(dec, &out, &capacity);
+		fwrite(outbuf, sizeof(char), out - outbuf, outfile);
+	}
 
-	/* write stuff */
-	sz = strlen(sentence);
-	fwrite(sentence, sizeof(char), sz, outfile);
+	cblt_freeDecoder(dec);
+	fclose(infile);
 	fclose(outfile);
-
-	free(sentence);
-	free(encoded);
 	
 	return 0;
 }
@@ -5,7 +5,12 @@
  * This file is an example of how to use libcobalt to write a simple text
  * encoding application.
  *
- * Usage:	./encode TXTFILE COMPRESSEDFILE
+ * Usage:	./encode [-j THREADS] TXTFILE COMPRESSEDFILE
+ * 	-j THREADS      Encode on THREADS threads at once; 0 means one thread per
+ * 	                processor. The output is the same either way, but the
+ * 	                whole file is read into memory first. Without -j, the file
+ * 	                is encoded a piece at a time, so TXTFILE may also be a
+ * 	                pipe, like /dev/stdin.
  * 	TXTFILE         A file containing plain text that you would like to encode
  * 	COMPRESSEDFILE  A file where the encoded result will be written
  */
@@ -16,29 +21,87 @@
 #include <stdlib.h>
 #include <cobalt.h>
 
+#define BUFFER_SIZE	(64 * 1024)
+
+/* Encodes INFILE to OUTFILE a piece at a time. Returns 0 on success. */
+static int encodeStream(FILE *infile, FILE *outfile) {
+	char inbuf[BUFFER_SIZE];
+	uint16_t outbuf[BUFFER_SIZE];
+	const char *in;
+	size_t inLength;
+	uint16_t *out;
+	size_t capacity;
+	cblt_encoder *enc;
+	bool done;
+
+	enc = cblt_createEncoder(0);
+	if (enc == NULL)
+		return -1;
+
+	while ((inLength = fread(inbuf, sizeof(char), BUFFER_SIZE, infile)) > 0) {
+		in = inbuf;
+		while (inLength > 0) {
+			out = outbuf;
+			capacity = BUFFER_SIZE;
+			cblt_encoderUpdate(enc, &in, &inLength, &out, &capacity);
+			fwrite(outbuf, sizeof(uint16_t), out - outbuf, outfile);
+		}
+	}
+	do {
+		out = outbuf;
+		capacity = BUFFER_SIZE;
+		done = cblt_encoderFinish(enc, &out, &capacity);
+		fwrite(outbuf, sizeof(uint16_t), out - outbuf, outfile);
+	} while (!done);
+
+	cblt_freeEncoder(enc);
+	return 0;
+}
+
 int main(int argc, char **argv) {
 	size_t sz;
 	char *sentence;		/* input file buffer */
 	uint16_t *encoded;	/* output file buffer */
 	FILE *infile, *outfile;
+	int threads = 1;
+	char **files = argv + 1;
 	
-	if (argc != 3) {
-		fprintf(stderr, "Usage:\t%s TXTFILE COMPRESSEDFILE\n", argv[0]);
+	if (argc == 5 && strcmp(argv[1], "-j") == 0) {
+		threads = strtol(argv[2], NULL, 10);
+		files += 2;
+	} else if (argc != 3) {
+		threads = -1;
+	}
+	if (threads < 0) {
+		fprintf(stderr, "Usage:\t%s [-j THREADS] TXTFILE COMPRESSEDFILE\n",
+			argv[0]);
 		return EXIT_FAILURE;
 	}
 
-	infile = fopen(argv[1], "r");
+	infile = fopen(files[0], "r");
 	if (infile == NULL) {
-		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], files[0]);
 		return EXIT_FAILURE;
 	}
-	outfile = fopen(argv[2], "w");
+	outfile = fopen(files[1], "w");
 	if (outfile == NULL) {
-		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[2]);
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], files[1]);
 		fclose(infile);
 		return EXIT_FAILURE;
 	}
 
+	if (threads == 1) {
+		if (encodeStream(infile, outfile) != 0) {
+			fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+			fclose(infile);
+			fclose(outfile);
+			return EXIT_FAILURE;
+		}
+		fclose(infile);
+		fclose(outfile);
+		return 0;
+	}
+
 	/* read stuff */
 	fseek(infile, 0, SEEK_END);
 	sz = ftell(infile);
@@ -55,7 +118,13 @@ int main(int argc, char **argv) {
 	fclose(infile);
 
 	/* encode stuff */
-	encoded = cblt_encodeSentence(sentence);
+	encoded = cblt_encodeSentenceParallel(sentence, threads);
+	if (encoded == NULL) {
+		fprintf(stderr, "%s: Error encoding %s\n", argv[0], files[0]);
+		fclose(outfile);
+		free(sentence);
+		return EXIT_FAILURE;
+	}
 
 	/* write stuff */
 	sz = cblt_getUint16BlockSize(encoded);
@@ -43,12 +43,17 @@
  * final null byte. I.e., WORDTABLE_STRLEN is the maximum valid index that can
  * be used to access WORDTABLE.
  *
- * NUMBER_OF_WORDS is the number of words in the table.
+ * NUMBER_OF_WORDS is the number of words in the table. The words are followed
+ * by NUMBER_OF_PHRASES phrases: frequent runs of 2 to CBLT_MAX_PHRASE_WORDS
+ * words separated by single spaces, such as "of the" or "one of the". The
+ * encoder treats a phrase just like a word, so a whole phrase costs a single
+ * symbol.
  */
 extern const unsigned char WORDTABLE[];
 extern const size_t WORDTABLE_LEN;
 extern const size_t WORDTABLE_STRLEN;
 extern const uint16_t NUMBER_OF_WORDS;
+extern const uint16_t NUMBER_OF_PHRASES;
 
 /* 
  * WORDMAP is an array of 32-bit unsigned integers that store indexes within
@@ -61,11 +66,40 @@ extern const uint16_t NUMBER_OF_WORDS;
  * terminated string containing the nth word in the table.
  *
  * WORDMAP_LEN is the total number of elements in WORDMAP, including the first
- * 256 reserved elements.
+ * 256 reserved elements and the phrases after the last word.
  */
 extern const uint32_t WORDMAP[];
 extern const size_t WORDMAP_LEN;
 
+/*
+ * WORDLEN is an array of unsigned characters that store the length of every
+ * word in WORDTABLE, not including the null terminator, so that WORDLEN[807] is
+ * the same as strlen(&WORDTABLE[ WORDMAP[807] ]). Just like in WORDMAP, the
+ * first 256 elements are reserved, and are all 0.
+ *
+ * WORDLEN_LEN is the total number of elements in WORDLEN, and is always equal
+ * to WORDMAP_LEN.
+ */
+extern const unsigned char WORDLEN[];
+extern const size_t WORDLEN_LEN;
+
+/*
+ * PHRASESTART is an array of unsigned characters that tells the encoder which
+ * words may begin a phrase. PHRASESTART[807] is the number of words in the
+ * longest phrase that begins with word 807, or 0 if no phrase begins with it,
+ * so the encoder only has to look past the end of a word when that word is
+ * nonzero in PHRASESTART. No value is ever greater than CBLT_MAX_PHRASE_WORDS.
+ *
+ * The first words of every phrase are a phrase of their own, like the path to
+ * a node in a trie, so the encoder makes a phrase longer one word at a time and
+ * stops at the first one that isn't in the table.
+ *
+ * PHRASESTART_LEN is always equal to WORDMAP_LEN.
+ */
+#define CBLT_MAX_PHRASE_WORDS	3
+extern const unsigned char PHRASESTART[];
+extern const size_t PHRASESTART_LEN;
+
 /*
  * GUIDETABLE is an array of 16-bit unsigned integers that store indexes within
  * WORDMAP.
@@ -91,6 +125,35 @@ extern const size_t WORDMAP_LEN;
 extern const uint16_t GUIDETABLE[];
 extern const size_t GUIDETABLE_LEN;
 
+/*
+ * HASHSEEDS and HASHSLOTS form a minimal perfect hash table over every unique
+ * word in WORDTABLE, and are what cblt_findWord() actually uses to find words.
+ * Both are generated at compile time by map/construct_wordhash.c, and the hash
+ * functions that index them are defined in src/wordhash.h.
+ *
+ * A word is hashed once, and the upper bits of the hash select one of the
+ * HASHSEEDS_LEN buckets. The hash is then mixed with the 16-bit seed of its
+ * bucket to select one of the HASHSLOTS_LEN slots. Each slot stores the length
+ * of a word in its upper 16 bits and the ordinal number of the word in its
+ * lower 16 bits. No two words share a slot, so a lookup only has to compare
+ * the word in that one slot with the string being searched for.
+ *
+ * GUIDETABLE is kept for compatibility, but is no longer used by the library.
+ *
+ * PHRASESEEDS and PHRASESLOTS are a second table just like it, over the
+ * phrases that follow the words in WORDTABLE. It is small enough to stay in the
+ * cache, which matters because most of the phrases the encoder looks for are
+ * not there.
+ */
+extern const uint16_t HASHSEEDS[];
+extern const size_t HASHSEEDS_LEN;
+extern const uint32_t HASHSLOTS[];
+extern const size_t HASHSLOTS_LEN;
+extern const uint16_t PHRASESEEDS[];
+extern const size_t PHRASESEEDS_LEN;
+extern const uint32_t PHRASESLOTS[];
+extern const size_t PHRASESLOTS_LEN;
+
 /* 
  * cblt_streq takes two null-terminated strings as arguments and returns true
  * only if the two strings are identical. The two pointers do not need to be
@@ -125,6 +188,11 @@ bool cblt_streq(const char *str1, const char *str2);
  * Return value:
  * This function returns a pointer to the current substring, which is described
  * by the value of *pcurrentStatus.
+ *
+ * cblt_splitstr keeps its position in static variables, so it cannot be used on
+ * two strings at once, nor from more than one thread. The library itself no
+ * longer uses it; internally, strings are split with a reentrant tokenizer that
+ * does not modify its input (see cblt_tokenizer in src/splitstring.h).
  */
 char *cblt_splitstr(char *s, int *pcurrentStatus, int *pnextStatus);
 
@@ -136,17 +204,34 @@ char *cblt_splitstr(char *s, int *pcurrentStatus, int *pnextStatus);
  * The value returned by cblt_findWord can be safely caset to uint16_t without
  * any loss of information, as long as neither of the 2 error codes are
  * returned.
+ *
+ * cblt_findWordN does the same for the first len characters of str, which do
+ * not need to be null-terminated.
  */
 int32_t cblt_findWord(const char *str);
+int32_t cblt_findWordN(const char *str, size_t len);
 
 #define CBLT_WORD_NOT_FOUND	-1
 #define CBLT_EMPTY_WORD_ARG	-2
 
 /*
- * In a uint16_t array, an integer with the value CBLT_BEGIN_STRING indicates
- * that the address of the next integer is the beginning of a null-terminated
- * character array.
- * 
+ * In a uint16_t array, a string literal of n characters, where n is between 1
+ * and CBLT_MAX_LITERAL, starts with the symbol CBLT_LITERAL + n, and its
+ * characters follow 2 to an element, in the order they are in memory. When n
+ * is odd, the last element is padded with a null byte. Since the length comes
+ * first, a literal can be skipped, measured and copied without looking at its
+ * characters. A word longer than CBLT_MAX_LITERAL characters is split into as
+ * many literals as it takes, with a CBLT_NO_SPACE symbol between each.
+ *
+ * Blocks written by earlier versions of the library start a literal with
+ * CBLT_BEGIN_STRING instead, and end it with a null terminator, padded with a
+ * 0xFF byte when it falls at the start of an element. These are still
+ * decoded, but never written. A block passed straight to the decoders is
+ * trusted to end every one of them before its own null terminator, while
+ * cblt_unpackBlock, and the archives that store their records the same way,
+ * check that it does, and the byte format, and the frames built on it, refuse
+ * them.
+ *
  * Since spaces are very common in sentences, they are interpreted as the
  * delimiter character when encoding and decoding. An integer with the value
  * CBLT_NO_SPACE indicates that the space that would normally follow the last
@@ -155,6 +240,100 @@ int32_t cblt_findWord(const char *str);
 #define CBLT_BEGIN_STRING	0xFFFF
 #define CBLT_NO_SPACE       0xFFFE
 
+#define CBLT_LITERAL		0xFB00
+#define CBLT_MAX_LITERAL	0xFF
+#define CBLT_IS_LITERAL(symbol)		(((symbol) & 0xFF00) == CBLT_LITERAL)
+#define CBLT_LITERAL_LENGTH(symbol)	((size_t)((symbol) & 0xFF))
+/* the number of elements taken by the characters of a literal of LENGTH
+   characters, not counting its CBLT_LITERAL symbol */
+#define CBLT_LITERAL_ELEMENTS(length)	(((length) + 1) / 2)
+
+/*
+ * A word made only of digits is written as a number instead of a string
+ * literal, whenever that takes fewer elements. Every string of 1 to 3 decimal
+ * digits, leading zeros and all, is the single symbol CBLT_SMALL_NUMBER + i,
+ * where i counts through "0" to "9", then "00" to "99", then "000" to "999".
+ *
+ * Any other number of n digits, where n is between 1 and CBLT_MAX_DIGITS,
+ * starts with the symbol CBLT_NUMBER + n, plus CBLT_NUMBER_HEX if its digits
+ * are hexadecimal, CBLT_NUMBER_UPPER if their letters are uppercase, and
+ * CBLT_NUMBER_PREFIX if the number starts with a "-" sign, or with "0x" when
+ * it is hexadecimal. Its digits follow, CBLT_NUMBER_CHUNK(symbol) of them to
+ * an element, with the first element taking whatever is left over. Each
+ * element holds the value of its digits plus 1, so that no element is ever 0.
+ * Since the number of digits comes first, leading zeros are kept too.
+ */
+#define CBLT_SMALL_NUMBER	0xF100
+#define CBLT_SMALL_NUMBERS	1110
+#define CBLT_IS_SMALL_NUMBER(symbol) \
+	((symbol) >= CBLT_SMALL_NUMBER \
+		&& (symbol) < CBLT_SMALL_NUMBER + CBLT_SMALL_NUMBERS)
+
+#define CBLT_NUMBER			0xF600
+#define CBLT_MAX_DIGITS		0x1F
+#define CBLT_NUMBER_HEX		0x20
+#define CBLT_NUMBER_UPPER	0x40
+#define CBLT_NUMBER_PREFIX	0x80
+#define CBLT_IS_NUMBER(symbol)		(((symbol) & 0xFF00) == CBLT_NUMBER)
+#define CBLT_NUMBER_DIGITS(symbol)	((size_t)((symbol) & CBLT_MAX_DIGITS))
+/* the number of digits held by each element of the number SYMBOL, and the
+   number of elements they take, not counting the CBLT_NUMBER symbol */
+#define CBLT_NUMBER_CHUNK(symbol)	(((symbol) & CBLT_NUMBER_HEX) ? 3 : 4)
+#define CBLT_NUMBER_ELEMENTS(symbol) \
+	((CBLT_NUMBER_DIGITS(symbol) + CBLT_NUMBER_CHUNK(symbol) - 1) \
+		/ CBLT_NUMBER_CHUNK(symbol))
+
+/*
+ * Spaces, tabs and line breaks are written as runs instead of one element per
+ * character. A run of n of them, where n is between 1 and CBLT_MAX_RUN, is the
+ * single symbol CBLT_RUN_SPACES + n, CBLT_RUN_TABS + n, CBLT_RUN_NEWLINES + n,
+ * or CBLT_RUN_CRLFS + n for n "\r\n" pairs. A longer run takes as many symbols
+ * as it needs. Adding CBLT_RUN_NO_SPACE to a run does the same as a
+ * CBLT_NO_SPACE symbol right after it, so a line that starts with a word
+ * doesn't take an extra element for that.
+ */
+#define CBLT_RUN_SPACES		0xF700
+#define CBLT_RUN_TABS		0xF800
+#define CBLT_RUN_NEWLINES	0xF900
+#define CBLT_RUN_CRLFS		0xFA00
+#define CBLT_MAX_RUN		0x7F
+#define CBLT_RUN_NO_SPACE	0x80
+#define CBLT_IS_RUN(symbol) \
+	((symbol) >= CBLT_RUN_SPACES && (symbol) < CBLT_LITERAL)
+#define CBLT_RUN_LENGTH(symbol)	((size_t)((symbol) & CBLT_MAX_RUN))
+
+/*
+ * A string literal of at most CBLT_MAX_REPEAT characters is kept in one of
+ * CBLT_REPEATS slots, and when the same word comes up again later in the
+ * block, it is written as the single symbol CBLT_REPEAT + n instead, where n
+ * is the slot it is in. The encoder and the decoder fill the slots the same
+ * way, so the slots are never written down: the first CBLT_REPEATS literals
+ * take the slots in order, and after that, every literal that is written out
+ * takes the slot of the one that was written or repeated the longest time ago.
+ * This goes for the last piece of a word that is split into several literals
+ * too, although only a word that fits in a single literal is ever repeated.
+ * Every block starts out with all of the slots empty.
+ */
+#define CBLT_REPEAT			0xFC00
+#define CBLT_REPEATS		0x100
+#define CBLT_MAX_REPEAT		64
+#define CBLT_IS_REPEAT(symbol)		(((symbol) & 0xFF00) == CBLT_REPEAT)
+#define CBLT_REPEAT_SLOT(symbol)	((size_t)((symbol) & 0xFF))
+
+/*
+ * A word that is only in the word table in lowercase, like "The" at the start
+ * of a sentence or "THE" in a heading, is encoded as the lowercase word right
+ * after one of these symbols, instead of as a string literal. CBLT_CAPITALIZE
+ * makes the first letter of the next word uppercase, and CBLT_UPPERCASE makes
+ * all of its letters uppercase. Only the letters A to Z are changed.
+ *
+ * Words get the symbols from 0x100 up to, but not including, CBLT_MAX_SYMBOLS,
+ * so that they never collide with any of the symbols above.
+ */
+#define CBLT_CAPITALIZE	0xFFFD
+#define CBLT_UPPERCASE	0xFFFC
+#define CBLT_MAX_SYMBOLS	CBLT_SMALL_NUMBER
+
 /*
  * cblt_encodeSentence takes a single null-terminated sentence as an argument
  * and returns a pointer to a null-terminated array of 16-bit unsigned integers
@@ -169,6 +348,9 @@ int32_t cblt_findWord(const char *str);
  *
  * If passed an empty string, the function will return a pointer to a 16-bit
  * unsigned integer with the value 0.
+ *
+ * sentence is never modified or copied, and neither function keeps any state
+ * between calls, so both are safe to call from multiple threads at once.
  * 
  * cblt_getEncodedLength takes a sentence to be encoded as its argument, and
  * returns the length in elements of the block of 16-bit unsigned integers
@@ -178,6 +360,70 @@ int32_t cblt_findWord(const char *str);
 uint16_t *cblt_encodeSentence(const char *sentence);
 size_t cblt_getEncodedLength(const char *sentence);
 
+/*
+ * cblt_encodeInto encodes the first `length' characters of sentence, which
+ * does not need to be null-terminated, into the `capacity' elements at out. It
+ * never allocates any memory, so a buffer can be reused across any number of
+ * calls. The result is identical to the output of cblt_encodeSentence,
+ * including the null terminator. A null character in sentence ends it early.
+ *
+ * On success, it returns true and stores the number of elements written,
+ * including the null terminator, in *pwritten. If out is too small, it returns
+ * false and stores the number of elements that out would have needed in
+ * *pwritten instead, so the call can be retried with a big enough buffer. The
+ * contents of out are then unspecified. It also returns false, storing 0, if
+ * sentence or pwritten is NULL.
+ *
+ * cblt_decodeInto does the same for decoding compressed into the `capacity'
+ * characters at out, which are then null-terminated. *pwritten is either the
+ * number of characters written, including the null terminator, or the number
+ * that out would have needed, just like what cblt_getDecodedLength returns.
+ */
+bool cblt_encodeInto(const char *sentence, size_t length, uint16_t *out,
+		size_t capacity, size_t *pwritten);
+bool cblt_decodeInto(const uint16_t *compressed, char *out, size_t capacity,
+		size_t *pwritten);
+
+/*
+ * cblt_encodeBatch encodes the n null-terminated strings at sentences one
+ * after another into a single newly allocated array, so that encoding many
+ * short sentences takes a handful of allocations instead of one for each.
+ * Each of them is encoded just like by cblt_encodeSentence, including its null
+ * terminator. offsets must have room for n + 1 elements: offsets[i] is set to
+ * the index at which sentence i starts, and offsets[n] to the number of
+ * elements in all of them, so that the array plus offsets[i] can be passed to
+ * any function that decodes a block. It returns NULL if sentences, any of
+ * them, or offsets is NULL, or if a memory allocation fails.
+ *
+ * cblt_decodeBatch does the opposite, decoding the n blocks that start at
+ * compressed + offsets[i] into a single newly allocated array of characters,
+ * where each sentence is null-terminated. offsets must have n + 1 elements,
+ * just like the ones written by cblt_encodeBatch, and decodedOffsets must have
+ * room for as many: decodedOffsets[i] is set to the index at which sentence i
+ * starts, and decodedOffsets[n] to the number of characters in all of them,
+ * including their null terminators. It returns NULL if any of its pointers is
+ * NULL, or if a memory allocation fails.
+ */
+uint16_t *cblt_encodeBatch(const char *const *sentences, size_t n,
+		size_t *offsets);
+char *cblt_decodeBatch(const uint16_t *compressed, const size_t *offsets,
+		size_t n, size_t *decodedOffsets);
+
+/*
+ * cblt_encodeSentenceParallel does the same thing as cblt_encodeSentence, but
+ * splits the work across up to `threads' threads. Passing 0 as threads uses one
+ * thread per processor that is online. The output is identical to that of
+ * cblt_encodeSentence, and the same errors cause it to return NULL.
+ *
+ * The sentence is cut into chunks right before words, so that each chunk can
+ * be encoded on its own, and the encoded chunks are stitched back together in
+ * order. Sentences shorter than a few tens of kilobytes are not worth cutting,
+ * and are encoded on the calling thread. If libcobalt was compiled without
+ * pthreads, everything is encoded on the calling thread.
+ */
+uint16_t *cblt_encodeSentenceParallel(const char *sentence,
+		unsigned int threads);
+
 /*
  * cblt_decodeSentence takes a single null-terminated array of 16-bit unsigned
  * integers as an argument and returns a pointer to a null-terminated string of
@@ -194,13 +440,423 @@ size_t cblt_getEncodedLength(const char *sentence);
  * If passed a pointer to a 16-bit unsigned integer with the value 0, the
  * function will return a pointer to an empty string.
  * 
- * cblt_getDecodedLength is used internally to calculate the memory needed to
- * store the string held by a block of compressed data. This function will
- * return 0 on failure.
+ * cblt_decodeSentence counts the elements of the block first, which only looks
+ * for its null terminator, and then decodes it in a single pass. The output
+ * starts out at a generous guess of its size from that count, grows if the
+ * guess was short, and is trimmed to fit at the end.
+ *
+ * cblt_getDecodedLength calculates the memory needed to store the string held
+ * by a block of compressed data, including the null terminator. This function
+ * will return 0 on failure.
  */
 char *cblt_decodeSentence(const uint16_t *compressed);
 size_t cblt_getDecodedLength(const uint16_t *compressed);
 
+/*
+ * A cblt_index is a sparse index into a block of compressed data, which allows
+ * the block to be decoded in pieces, independently of each other. Each entry
+ * marks a point in the block where decoding can start:
+ *
+ * 	token:		the index of the symbol in the compressed block
+ * 	decoded:	the number of characters decoded from all symbols before it
+ * 	noSpace:	whether a word right at that point goes without its implicit
+ * 	        	leading space, i.e. the point is at the start of the sentence or
+ * 	        	right after a CBLT_NO_SPACE symbol
+ *
+ * The first entry is always at the start of the block. decodedLength is the
+ * length of the whole decoded sentence, including the null terminator. Which
+ * string literals can be repeated at each entry isn't kept in the index, since
+ * it can be found by skipping over the symbols before the entry, which is much
+ * quicker than decoding them.
+ * capacity is the number of entries allocated, and is only meaningful to the
+ * library.
+ *
+ * The index is not part of the compressed block; it is up to the programmer to
+ * keep it next to the block it was made for.
+ */
+typedef struct cblt_indexEntry {
+	size_t token;
+	size_t decoded;
+	bool noSpace;
+} cblt_indexEntry;
+
+typedef struct cblt_index {
+	size_t decodedLength;
+	size_t count;
+	size_t capacity;
+	cblt_indexEntry *entries;
+} cblt_index;
+
+#define CBLT_DEFAULT_INDEX_INTERVAL	(64 * 1024)
+
+/*
+ * cblt_encodeSentenceIndexed encodes sentence exactly like cblt_encodeSentence,
+ * and also fills in the index pointed to by index, with an entry roughly every
+ * `interval' characters of the sentence. Passing 0 as interval uses
+ * CBLT_DEFAULT_INDEX_INTERVAL. Returns NULL if sentence or index is NULL, or if
+ * a memory allocation fails, in which case the index is left empty.
+ *
+ * cblt_freeIndex frees the memory held by the entries of an index. It does not
+ * free the cblt_index struct itself.
+ */
+uint16_t *cblt_encodeSentenceIndexed(const char *sentence, size_t interval,
+		cblt_index *index);
+void cblt_freeIndex(cblt_index *index);
+
+/*
+ * cblt_decodeSentenceParallel does the same thing as cblt_decodeSentence, but
+ * splits the work across up to `threads' threads with the help of index, which
+ * must have been made by cblt_encodeSentenceIndexed for this exact block.
+ * Passing 0 as threads uses one thread per processor that is online.
+ *
+ * The output is allocated once, using the length stored in the index, and each
+ * thread decodes its share of the block directly into its own slice of the
+ * output. The block doesn't need to be decoded beforehand to find its decoded
+ * length, and is only skipped over once, to find the string literals that can
+ * be repeated where each thread starts.
+ */
+char *cblt_decodeSentenceParallel(const uint16_t *compressed,
+		const cblt_index *index, unsigned int threads);
+
+/*
+ * A cblt_encoder encodes a sentence that arrives a piece at a time, and a
+ * cblt_decoder decodes one. Neither needs the whole sentence in memory at once,
+ * so they can be used on pipes, sockets and files of any size.
+ *
+ * cblt_createEncoder returns a new encoder that holds at most `window'
+ * characters of input at a time. Passing 0 as window uses CBLT_DEFAULT_WINDOW.
+ * cblt_createDecoder returns a new decoder. Both return NULL if a memory
+ * allocation fails. cblt_freeEncoder and cblt_freeDecoder free them again.
+ *
+ * cblt_encoderUpdate reads characters from *pin, of which there are *pinLength,
+ * and writes encoded symbols to *pout, which has room for *poutCapacity of
+ * them. All 4 are advanced past whatever was read and written. It returns once
+ * either all of the input has been read, or the output is full, so keep calling
+ * it with more room until *pinLength is 0. Null characters in the input can't
+ * be encoded, and are skipped.
+ *
+ * cblt_encoderFinish tells the encoder that there is no more input, and writes
+ * the rest of the encoded sentence, followed by a null terminator, to *pout in
+ * the same way. It returns false if the output filled up before everything
+ * could be written, in which case it must be called again with more room. Once
+ * it returns true, the encoder is ready for a new sentence.
+ *
+ * The encoded symbols are identical to the output of cblt_encodeSentence, with
+ * one exception: a word longer than the window is cut into pieces that are
+ * each encoded as a string literal, joined by CBLT_NO_SPACE symbols. It still
+ * decodes to the same word.
+ *
+ * cblt_decoderUpdate reads symbols from *pin and writes the decoded characters
+ * to *pout in the same way. It returns true once the null terminator of the
+ * compressed block has been read and everything before it has been written,
+ * after which the decoder is ready for a new block and nothing more is read
+ * from *pin. Otherwise it returns false once it needs more input or more room.
+ * No null terminator is written to the output.
+ *
+ * cblt_decoderFinish can be used when the input ends without a null
+ * terminator. It writes whatever the decoder is still holding, returns false if
+ * it didn't all fit, and resets the decoder once it returns true.
+ */
+typedef struct cblt_encoder cblt_encoder;
+typedef struct cblt_decoder cblt_decoder;
+
+#define CBLT_DEFAULT_WINDOW	(64 * 1024)
+
+cblt_encoder *cblt_createEncoder(size_t window);
+void cblt_freeEncoder(cblt_encoder *enc);
+void cblt_encoderUpdate(cblt_encoder *enc, const char **pin,
+		size_t *pinLength, uint16_t **pout, size_t *poutCapacity);
+bool cblt_encoderFinish(cblt_encoder *enc, uint16_t **pout,
+		size_t *poutCapacity);
+
+cblt_decoder *cblt_createDecoder(void);
+void cblt_freeDecoder(cblt_decoder *dec);
+bool cblt_decoderUpdate(cblt_decoder *dec, const uint16_t **pin,
+		size_t *pinLength, char **pout, size_t *poutCapacity);
+bool cblt_decoderFinish(cblt_decoder *dec, char **pout,
+		size_t *poutCapacity);
+
+/*
+ * cblt_packBlock packs a block of compressed data, as returned by
+ * cblt_encodeSentence, into fewer bytes for storage or transmission. Most of a
+ * block is made of the same few words and punctuation marks, so instead of 16
+ * bits for every element, the packed block spends fewer bits on the elements
+ * that appear more often, using an entropy coder. It returns a newly allocated
+ * array of bytes, and stores its size in *psize. It returns NULL if compressed
+ * or psize is NULL, or if a memory allocation fails.
+ *
+ * The packed block starts with a header of its own, which holds everything
+ * needed to unpack it except for the dictionary. It never takes more than a
+ * few bytes more than the block itself, and its format doesn't depend on the
+ * byte order of the machine.
+ *
+ * cblt_unpackBlock turns the `size' bytes at packed back into the exact block
+ * that was packed, in a newly allocated array. It returns NULL if the bytes
+ * aren't a packed block, if they are damaged, if the block was packed with a
+ * dictionary of a different size, or if a memory allocation fails.
+ */
+unsigned char *cblt_packBlock(const uint16_t *compressed, size_t *psize);
+uint16_t *cblt_unpackBlock(const unsigned char *packed, size_t size);
+
+/*
+ * cblt_encodeBytes encodes sentence in the byte format, a lighter alternative
+ * to packing a block. Instead of 2 bytes for every element, every element gets
+ * a code of 1, 2 or 3 bytes: the bytes injected directly, like spaces and
+ * punctuation, and the 128 words that appear most often take 1 byte, the other
+ * words that appear more than once take 2, and the rest take 3. Which is which
+ * is chosen for every block, and listed at its start. String literals are
+ * written as they are, without padding. It returns a newly allocated array of
+ * bytes, and stores its size in *psize. It returns NULL if sentence or psize
+ * is NULL, or if a memory allocation fails.
+ *
+ * The first byte of a block in the byte format is a flag that tells it apart
+ * from other blocks, and its format doesn't depend on the byte order of the
+ * machine. Every code can be decoded with a table lookup, without reading
+ * single bits.
+ *
+ * Text that the dictionary doesn't help with, like source code, logs or base64,
+ * can come out bigger than it went in. When the codes would take more than half
+ * the size of the sentence, it is also compressed with a simple built-in LZ77
+ * coder, and the smaller of the two is kept. If neither is smaller than the
+ * sentence, it is stored as it is, so the block is never more than a few bytes
+ * bigger than the sentence. The first byte tells which one was used, and a
+ * block that was compressed with LZ77 or stored decodes with any dictionary.
+ *
+ * cblt_decodeBytes decodes the `size' bytes at bytes back into the original
+ * sentence, in a newly allocated string. It returns NULL if the bytes aren't
+ * in the byte format, if they are damaged, if they were encoded with a
+ * dictionary of a different size, or if a memory allocation fails.
+ */
+unsigned char *cblt_encodeBytes(const char *sentence, size_t *psize);
+char *cblt_decodeBytes(const unsigned char *bytes, size_t size);
+
+/*
+ * cblt_encodeFrame encodes sentence into a frame: a header that names the
+ * frame, the dictionary it was encoded with, the number of blocks and the
+ * length of the sentence, followed by the sentence cut into blocks in the byte
+ * format of at most about blockSize characters each, each with a header of its
+ * own that gives its size and the number of characters in it. Blocks are cut
+ * between words wherever they can be. Passing 0 as blockSize uses
+ * CBLT_DEFAULT_BLOCK_SIZE, and it can be at most 1 GiB. If flags has
+ * CBLT_FRAME_CRC, every block also gets a CRC-32C checksum, which is computed
+ * with the instructions made for it where the compiler targets them. It
+ * returns a newly allocated array of bytes, and stores its size in *psize. It
+ * returns NULL if sentence or psize is NULL, if blockSize or flags aren't
+ * valid, or if a memory allocation fails. Every number in a frame is written
+ * least significant byte first, so frames can be read on any machine.
+ *
+ * cblt_decodeFrame decodes the `size' bytes at frame back into the original
+ * sentence, in a newly allocated string. It returns NULL if they aren't a
+ * frame, if it was encoded with a different dictionary, if it was cut short
+ * or damaged, if a checksum doesn't match, or if a memory allocation fails.
+ *
+ * cblt_getFrameInfo reads the header of a frame into *info: the ID of the
+ * dictionary it was encoded with (see cblt_getDictId), the number of blocks in
+ * it, the number of characters it decodes to, not counting the null
+ * terminator, and whether its blocks have checksums. cblt_getFrameBlock reads
+ * the header of block number n, counting from 0, into *block: where the block
+ * starts and its size, which can be given to cblt_decodeBytes to decode that
+ * block alone, where its characters start in the sentence and how many there
+ * are, and its checksum, or 0 if it has none. Both only read the headers of
+ * the frame and of its blocks, so they take time proportional to the number of
+ * blocks and not to their size, and both check that the headers add up. They
+ * return false if the bytes aren't a frame, if it was cut short, if n is past
+ * the last block, or if info or block is NULL.
+ *
+ * cblt_verifyFrame checks the headers of a frame and the checksum of every
+ * block, without decoding any of them. It returns false if they aren't a
+ * frame, if it was cut short, or if a checksum doesn't match. A frame without
+ * checksums only has its headers checked.
+ */
+#define CBLT_DEFAULT_BLOCK_SIZE	(64 * 1024)
+#define CBLT_FRAME_CRC			0x01
+
+typedef struct cblt_frameInfo {
+	uint32_t dictId;
+	size_t blocks;
+	size_t decodedLength;
+	bool crc;
+} cblt_frameInfo;
+
+typedef struct cblt_frameBlock {
+	const unsigned char *bytes;
+	size_t size;
+	size_t decodedOffset;
+	size_t decodedLength;
+	uint32_t crc;
+} cblt_frameBlock;
+
+unsigned char *cblt_encodeFrame(const char *sentence, size_t blockSize,
+		unsigned int flags, size_t *psize);
+char *cblt_decodeFrame(const unsigned char *frame, size_t size);
+bool cblt_getFrameInfo(const unsigned char *frame, size_t size,
+		cblt_frameInfo *info);
+bool cblt_getFrameBlock(const unsigned char *frame, size_t size, size_t n,
+		cblt_frameBlock *block);
+bool cblt_verifyFrame(const unsigned char *frame, size_t size);
+
+/*
+ * An archive holds any number of sentences, or records, each encoded on its
+ * own, with an index in front of them, so that any one record, or any range
+ * of the characters of all of them put together, can be decoded without
+ * touching the rest.
+ *
+ * cblt_createArchiveWriter returns a new, empty archive writer, or NULL if a
+ * memory allocation fails. cblt_addRecord encodes record and adds it to the
+ * end of the archive, where it gets the next number, counting from 0. It
+ * returns false if w or record is NULL, or if a memory allocation fails, in
+ * which case the record isn't added. cblt_finishArchive lays out the records
+ * added so far, and their index, in a newly allocated array of bytes, and
+ * stores its size in *psize. It returns NULL if w or psize is NULL, or if a
+ * memory allocation fails. More records can still be added after that.
+ * cblt_saveArchive does the same, but writes the archive to a file at path,
+ * and returns false if the file could not be written. cblt_freeArchiveWriter
+ * releases an archive writer.
+ *
+ * cblt_openArchive opens the archive file at path for reading. Where mmap() is
+ * available, the file is mapped into memory, so opening even a large archive
+ * is cheap, and only the parts of it that are decoded are ever read.
+ * cblt_openArchiveBuffer opens the `size' bytes at archive instead, which must
+ * stay where they are until the archive is closed. Both only check the header
+ * and the size of the index, and return NULL if it isn't an archive, if it was
+ * cut short, if it was written with a different dictionary, or if a memory
+ * allocation fails. cblt_closeArchive releases an archive.
+ *
+ * cblt_getRecordCount returns the number of records in a, and
+ * cblt_getArchiveLength returns the number of characters in all of them put
+ * together, not counting any null terminator.
+ *
+ * cblt_decodeRecord decodes record number n of a into a newly allocated
+ * string, and cblt_decodeRecordInto decodes it into the `capacity' characters
+ * at out, the same way that cblt_decodeInto does, with *pwritten set to the
+ * number of characters written or needed, including the null terminator.
+ * cblt_decodeArchiveRange decodes the `length' characters that start `offset'
+ * characters into all of the records put together into out, which must have
+ * room for length + 1 characters, and null-terminates them. Records are put
+ * together with nothing in between, so a range may start and end anywhere in
+ * them. All of them return NULL or false if there is no such record or range,
+ * if the record is damaged, or if a memory allocation fails. Finding a record
+ * takes a single lookup in the index, and finding a range takes a binary
+ * search, so none of them take time proportional to the size of the archive.
+ * An archive is never modified, so it can be read by any number of threads.
+ */
+typedef struct cblt_archiveWriter cblt_archiveWriter;
+typedef struct cblt_archive cblt_archive;
+
+cblt_archiveWriter *cblt_createArchiveWriter(void);
+void cblt_freeArchiveWriter(cblt_archiveWriter *w);
+bool cblt_addRecord(cblt_archiveWriter *w, const char *record);
+unsigned char *cblt_finishArchive(const cblt_archiveWriter *w, size_t *psize);
+bool cblt_saveArchive(const cblt_archiveWriter *w, const char *path);
+
+cblt_archive *cblt_openArchive(const char *path);
+cblt_archive *cblt_openArchiveBuffer(const unsigned char *archive,
+		size_t size);
+void cblt_closeArchive(cblt_archive *a);
+size_t cblt_getRecordCount(const cblt_archive *a);
+size_t cblt_getArchiveLength(const cblt_archive *a);
+char *cblt_decodeRecord(const cblt_archive *a, size_t n);
+bool cblt_decodeRecordInto(const cblt_archive *a, size_t n, char *out,
+		size_t capacity, size_t *pwritten);
+bool cblt_decodeArchiveRange(const cblt_archive *a, size_t offset,
+		size_t length, char *out);
+
+/*
+ * A cblt_dict is a word list that can be used in place of the one compiled into
+ * the library, so that text can be encoded with a vocabulary suited to it. A
+ * block must be decoded with the same dictionary it was encoded with.
+ *
+ * cblt_openDict loads the dictionary file at path. Where mmap() is available,
+ * the file is mapped into memory and used right where it is, so opening even a
+ * large dictionary is cheap, and processes that open the same file share its
+ * pages. Every offset and length in the file is checked as it is opened. It
+ * returns NULL if the file can't be read, isn't a valid dictionary, or was
+ * written on a machine with a different byte order, or if a memory allocation
+ * fails.
+ *
+ * cblt_createDict builds a dictionary in memory out of the `count' words in
+ * words, which get the symbols 0x100 to 0x100 + count - 1 in order. Words may
+ * be at most 255 characters long, and there may be at most
+ * CBLT_MAX_SYMBOLS - 0x100 of them. When a word appears more than once, only its
+ * first symbol is ever used. It returns NULL if the words don't fit those
+ * limits, or if a memory allocation fails. The words are copied, so they can
+ * be freed as soon as it returns. A word made of 2 to CBLT_MAX_PHRASE_WORDS
+ * words separated by single spaces, such as "of the", is a phrase, which the
+ * encoder uses in place of its words, as long as its first word and the
+ * phrase made of its first words are in the dictionary too.
+ *
+ * cblt_closeDict releases a dictionary returned by cblt_openDict or
+ * cblt_createDict. Nothing that was given the dictionary, such as an encoder
+ * or decoder, may be used after that.
+ *
+ * cblt_saveDict writes dict to a dictionary file at path, and returns false if
+ * the file could not be written. Passing NULL as dict saves the built-in
+ * dictionary.
+ *
+ * cblt_getDictId returns the ID of dict, which is the CRC-32C of its words,
+ * and which frames record so that they are never decoded with a different
+ * dictionary. Passing NULL as dict returns the ID of the built-in dictionary.
+ * A dictionary saved with cblt_saveDict and opened again keeps its ID.
+ *
+ * Every function that encodes or decodes has a variant ending in Dict that
+ * takes a dictionary as its first argument, and otherwise behaves exactly the
+ * same. Passing NULL as the dictionary uses the built-in one, which is what
+ * the functions without the suffix do. A dictionary is never modified, so it
+ * can be shared by any number of threads.
+ */
+typedef struct cblt_dict cblt_dict;
+
+cblt_dict *cblt_openDict(const char *path);
+cblt_dict *cblt_createDict(const char *const *words, size_t count);
+void cblt_closeDict(cblt_dict *dict);
+bool cblt_saveDict(const cblt_dict *dict, const char *path);
+uint32_t cblt_getDictId(const cblt_dict *dict);
+
+int32_t cblt_findWordDict(const cblt_dict *dict, const char *str, size_t len);
+
+uint16_t *cblt_encodeSentenceDict(const cblt_dict *dict, const char *sentence);
+size_t cblt_getEncodedLengthDict(const cblt_dict *dict, const char *sentence);
+bool cblt_encodeIntoDict(const cblt_dict *dict, const char *sentence,
+		size_t length, uint16_t *out, size_t capacity, size_t *pwritten);
+uint16_t *cblt_encodeSentenceParallelDict(const cblt_dict *dict,
+		const char *sentence, unsigned int threads);
+uint16_t *cblt_encodeSentenceIndexedDict(const cblt_dict *dict,
+		const char *sentence, size_t interval, cblt_index *index);
+cblt_encoder *cblt_createEncoderDict(const cblt_dict *dict, size_t window);
+
+char *cblt_decodeSentenceDict(const cblt_dict *dict,
+		const uint16_t *compressed);
+size_t cblt_getDecodedLengthDict(const cblt_dict *dict,
+		const uint16_t *compressed);
+bool cblt_decodeIntoDict(const cblt_dict *dict, const uint16_t *compressed,
+		char *out, size_t capacity, size_t *pwritten);
+uint16_t *cblt_encodeBatchDict(const cblt_dict *dict,
+		const char *const *sentences, size_t n, size_t *offsets);
+char *cblt_decodeBatchDict(const cblt_dict *dict, const uint16_t *compressed,
+		const size_t *offsets, size_t n, size_t *decodedOffsets);
+char *cblt_decodeSentenceParallelDict(const cblt_dict *dict,
+		const uint16_t *compressed, const cblt_index *index,
+		unsigned int threads);
+cblt_decoder *cblt_createDecoderDict(const cblt_dict *dict);
+
+unsigned char *cblt_packBlockDict(const cblt_dict *dict,
+		const uint16_t *compressed, size_t *psize);
+uint16_t *cblt_unpackBlockDict(const cblt_dict *dict,
+		const unsigned char *packed, size_t size);
+unsigned char *cblt_encodeBytesDict(const cblt_dict *dict,
+		const char *sentence, size_t *psize);
+char *cblt_decodeBytesDict(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size);
+unsigned char *cblt_encodeFrameDict(const cblt_dict *dict,
+		const char *sentence, size_t blockSize, unsigned int flags,
+		size_t *psize);
+char *cblt_decodeFrameDict(const cblt_dict *dict, const unsigned char *frame,
+		size_t size);
+cblt_archiveWriter *cblt_createArchiveWriterDict(const cblt_dict *dict);
+cblt_archive *cblt_openArchiveDict(const cblt_dict *dict, const char *path);
+cblt_archive *cblt_openArchiveBufferDict(const cblt_dict *dict,
+		const unsigned char *archive, size_t size);
+
 /*
  * cblt_getUint16BlockSize takes a pointer to a null-terminated array of 16-bit
  * unsigned integers as an argument and returns the size, in elements, of that
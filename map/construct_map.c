@@ -4,38 +4,60 @@
  *
  * This is a helper program to index all the different words in the word table
  * by the index of the word and its offset in the WORDTABLE array.
+ *
+ * It also writes the length of every word to a separate file, so that the
+ * decoder never has to call strlen() on a word from the table, and the number
+ * of words in the longest phrase that begins with each word to another, so
+ * that the encoder knows when it is worth looking for a phrase.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "cobalt.h"
 
 #define MAP_NAME "wordmap.bin"
-#define WORDMAP_LEN NUMBER_OF_WORDS + 256
+#define LEN_NAME "wordlen.bin"
+#define PHRASE_NAME "phrasestart.bin"
+/* both unsigned, like the words that are compared with them */
+#define WORDMAP_LEN (NUMBER_OF_WORDS + NUMBER_OF_PHRASES + 256u)
+#define FIRST_PHRASE (0x100u + NUMBER_OF_WORDS)
 
 int main (int argc, char **argv) {
 	size_t i; /* offset within the WORDTABLE char array */
 	unsigned int word;
 	uint32_t *wordMap;
+	uint8_t *wordLen;
+	uint8_t *phraseStart;
+	unsigned int first;	/* first word of a phrase */
+	unsigned int prefix;	/* the phrase made of its first words */
+	const char *phrase;
+	unsigned int words;	/* number of words in a phrase */
+	size_t length;
 	FILE *out;
 
+	(void)argc;	/* only argv[0] is used, in messages */
+
 	out = fopen(MAP_NAME, "wb");
 	if (out == NULL) {
 		fprintf(stderr, "%s: Error opening file %s.\n", argv[0], MAP_NAME);
 		return EXIT_FAILURE;
 	}
 
-	/* WORDMAP_LEN is defined as 256 + NUMBER_OF_WORDS.
-	   There will be NUMBER_OF_WORDS + 256 elements in wordMap, because the
+	/* WORDMAP_LEN is defined as 256 + NUMBER_OF_WORDS + NUMBER_OF_PHRASES.
+	   There will be NUMBER_OF_WORDS + NUMBER_OF_PHRASES + 256 elements in
+	   wordMap, because the
 	   first 256 addresses are reserved for special characters. This means that
 	   words 0-255 will not point to an actual word in the table. I have made
 	   the executive decision to fill all these elements with the address of the
 	   last character in the wordtable, the null terminator. This way, the first
 	   256 addresses all point to an empty string. */
 	wordMap = malloc(sizeof(uint32_t) * (WORDMAP_LEN));
-	if (wordMap == NULL) {
+	wordLen = malloc(sizeof(uint8_t) * (WORDMAP_LEN));
+	phraseStart = calloc(WORDMAP_LEN, sizeof(uint8_t));
+	if (wordMap == NULL || wordLen == NULL || phraseStart == NULL) {
 		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
 		return EXIT_FAILURE;
 	}
@@ -43,21 +65,94 @@ int main (int argc, char **argv) {
 	/* now we have enough memory, we may proceed */
 	fprintf(stderr, "%s: Writing word map to %s\n", argv[0], MAP_NAME);
 	/* start by filling the first 256 addresses */
-	for (word = 0; word < 0x100; ++word)
+	for (word = 0; word < 0x100; ++word) {
 		wordMap[word] = WORDTABLE_STRLEN;
+		wordLen[word] = 0;
+	}
 
 	for (i = 0; i < WORDTABLE_STRLEN; ) { /* each byte in WORDTABLE */
-		wordMap[word++] = i;
+		wordMap[word] = i;
 		/* advance to the next word */
 		while (WORDTABLE[i++] != '\0') ;
 			/* skip until after the next null character */
+		length = i - 1 - wordMap[word];
+		if (length > UINT8_MAX) {
+			fprintf(stderr, "%s: Word %u is longer than %d characters.\n",
+				argv[0], word, UINT8_MAX);
+			return EXIT_FAILURE;
+		}
+		wordLen[word++] = length;
 	}
 
 	/* now the address block is filled, let's write it to a file */
 	fwrite(wordMap, sizeof(uint32_t), WORDMAP_LEN, out);
 	fclose(out);
+
+	/* mark the first word of every phrase with the length of its longest
+	   phrase, in words */
+	for (word = FIRST_PHRASE; word < WORDMAP_LEN; ++word) {
+		phrase = (const char *)&WORDTABLE[wordMap[word]];
+		length = strcspn(phrase, " ");
+		for (i = length, words = 1; phrase[i] != '\0'; ++i)
+			if (phrase[i] == ' ')
+				++words;
+		if (words < 2 || words > CBLT_MAX_PHRASE_WORDS) {
+			fprintf(stderr, "%s: Phrase \"%s\" does not have 2 to %d words.\n",
+				argv[0], phrase, CBLT_MAX_PHRASE_WORDS);
+			return EXIT_FAILURE;
+		}
+		/* the first occurrence of a word is the one that cblt_findWord()
+		   finds */
+		for (first = 0x100; first < FIRST_PHRASE; ++first)
+			if (wordLen[first] == length
+					&& memcmp(&WORDTABLE[wordMap[first]], phrase, length) == 0)
+				break;
+		if (first == FIRST_PHRASE) {
+			fprintf(stderr, "%s: Phrase \"%s\" does not begin with a word.\n",
+				argv[0], phrase);
+			return EXIT_FAILURE;
+		}
+		/* the encoder makes a phrase longer one word at a time, so the
+		   first words of a phrase must be a phrase of their own */
+		for (i = length + 1; phrase[i] != '\0'; ++i) {
+			if (phrase[i] != ' ')
+				continue;
+			for (prefix = FIRST_PHRASE; prefix < WORDMAP_LEN;
+					++prefix)
+				if (wordLen[prefix] == i
+						&& memcmp(&WORDTABLE[wordMap[prefix]], phrase, i) == 0)
+					break;
+			if (prefix == WORDMAP_LEN) {
+				fprintf(stderr, "%s: Phrase \"%s\" needs \"%.*s\" to be a "
+					"phrase too.\n", argv[0], phrase, (int)i, phrase);
+				return EXIT_FAILURE;
+			}
+		}
+		if (phraseStart[first] < words)
+			phraseStart[first] = words;
+	}
 	free(wordMap);
 
+	out = fopen(LEN_NAME, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: Error opening file %s.\n", argv[0], LEN_NAME);
+		return EXIT_FAILURE;
+	}
+	fprintf(stderr, "%s: Writing word lengths to %s\n", argv[0], LEN_NAME);
+	fwrite(wordLen, sizeof(uint8_t), WORDMAP_LEN, out);
+	fclose(out);
+	free(wordLen);
+
+	out = fopen(PHRASE_NAME, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: Error opening file %s.\n", argv[0], PHRASE_NAME);
+		return EXIT_FAILURE;
+	}
+	fprintf(stderr, "%s: Writing phrase starts to %s\n", argv[0], PHRASE_NAME);
+	fwrite(phraseStart, sizeof(uint8_t), WORDMAP_LEN, out);
+	fclose(out);
+	free(phraseStart);
+
 	fprintf(stderr, "%s: Done.\n", argv[0]);
 	return 0;
 }
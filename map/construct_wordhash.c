@@ -0,0 +1,88 @@
+/*
+ * construct_wordhash.c
+ * by Eliot Baez
+ *
+ * This program builds a minimal perfect hash table over every unique word in
+ * the word table, so that cblt_findWord() can find a word with a single hash,
+ * a single probe and a single memcmp(). The table itself is built by
+ * cblt_buildWordHash(); see src/buildhash.c and src/wordhash.h.
+ *
+ * A second, much smaller table is built the same way over the phrases that
+ * follow the words in the table.
+ *
+ * Four files are written by this program:
+ * 	hashseeds.bin	one 16-bit seed for every bucket
+ * 	hashslots.bin	one 32-bit slot for every unique word, holding the length
+ * 	            	of the word and its ordinal number
+ * 	phraseseeds.bin	the same as hashseeds.bin, for the phrases
+ * 	phraseslots.bin	the same as hashslots.bin, for the phrases
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "buildhash.h"
+
+#define SEEDS_NAME	"hashseeds.bin"
+#define SLOTS_NAME	"hashslots.bin"
+#define PHRASE_SEEDS_NAME	"phraseseeds.bin"
+#define PHRASE_SLOTS_NAME	"phraseslots.bin"
+
+/* Builds the table over the words, or over the phrases if PHRASES is true, and
+   writes it to SEEDSNAME and SLOTSNAME. Returns 0 on success. */
+static int writeHash(const char *name, bool phrases, const char *seedsName,
+		const char *slotsName) {
+	size_t buckets;
+	size_t n;			/* number of unique words */
+	uint16_t *seeds;
+	uint32_t *slots;
+	FILE *out;
+
+	if (cblt_buildWordHash(WORDTABLE, WORDMAP, WORDMAP_LEN, phrases, &seeds,
+			&buckets, &slots, &n) != 0 || n == 0) {
+		fprintf(stderr, "%s: Could not build a perfect hash table.\n", name);
+		return -1;
+	}
+	fprintf(stderr, "%s: Found a perfect hash with %zu buckets for %zu "
+		"unique %s.\n", name, buckets, n, phrases ? "phrases" : "words");
+
+	out = fopen(seedsName, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", name, seedsName);
+		return -1;
+	}
+	fprintf(stderr, "%s: Writing bucket seeds to %s\n", name, seedsName);
+	fwrite(seeds, sizeof(uint16_t), buckets, out);
+	fclose(out);
+
+	out = fopen(slotsName, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", name, slotsName);
+		return -1;
+	}
+	fprintf(stderr, "%s: Writing hash slots to %s\n", name, slotsName);
+	fwrite(slots, sizeof(uint32_t), n, out);
+	fclose(out);
+
+	free(slots);
+	free(seeds);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	(void)argc;	/* only argv[0] is used, in messages */
+
+	fprintf(stderr, "%s: Hashing %u words...\n", argv[0], NUMBER_OF_WORDS);
+	if (writeHash(argv[0], false, SEEDS_NAME, SLOTS_NAME) != 0)
+		return EXIT_FAILURE;
+	fprintf(stderr, "%s: Hashing %u phrases...\n", argv[0],
+		NUMBER_OF_PHRASES);
+	if (writeHash(argv[0], true, PHRASE_SEEDS_NAME, PHRASE_SLOTS_NAME) != 0)
+		return EXIT_FAILURE;
+
+	fprintf(stderr, "%s: Done.\n", argv[0]);
+	return 0;
+}
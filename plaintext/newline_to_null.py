@@ -2,8 +2,9 @@
 # by Eliot Baez
 #
 # This script takes the sorted newline-separated wordlist as an input file, and
-# converts it into a null-separated word table in a single binary file. In
-# addition, it generates a special header file for internal use that defines
+# converts it into a null-separated word table in a single binary file. The
+# phrases in PHRASES_FILE are appended to the table after the words, so that
+# every phrase gets a symbol of its own right after the last word. In addition, it generates a special header file for internal use that defines
 # important sizes used in generating the source files for libcobalt.
 #
 # Two files are generated by this script:
@@ -11,8 +12,8 @@
 #       This file will contain #define directives with all the important lengths
 #       necessary for generating the machine-specific source files. 
 #   ./wordtable.bin
-#       Stores the contents of the INPUT_FILE, with all newlines replaced with
-#       null characters.
+#       Stores the contents of the INPUT_FILE, followed by the phrases of
+#       PHRASES_FILE, with all newlines replaced with null characters.
 
 # TODO:
 # make the in-header value of NUMBER_OF_WORDS depend on the definition of the
@@ -22,6 +23,7 @@ from os import makedirs
 
 NUMBER_OF_WORDS = 50000
 INPUT_FILE = "50k-newline-separated-sorted.txt"
+PHRASES_FILE = "phrases.txt"
 
 if __name__ == "__main__":
     length = 0
@@ -33,6 +35,16 @@ if __name__ == "__main__":
             length += len(line)
             o.write(line)
 
+        phrases = 0
+        with open(PHRASES_FILE, "rb") as p:
+            for line in p:
+                line = line.rstrip(b'\r\n')
+                if len(line) == 0 or line.startswith(b'#'):
+                    continue
+                o.write(line + b'\0')
+                length += len(line) + 1
+                phrases += 1
+
     # Then, based on the size of the wordtable.bin file and the number of words
     # defined in this script, define the relevant information in sizes.c. The
     # only information that goes in sizes.c is information that will not be
@@ -44,5 +56,6 @@ if __name__ == "__main__":
             "#include <stddef.h>\n"
             "#include \"cobalt.h\"\n\n"
             "const uint16_t NUMBER_OF_WORDS = 50000;\n"
+            "const uint16_t NUMBER_OF_PHRASES = %d;\n"
             "const size_t WORDTABLE_STRLEN = %d;"
-            % (length - 1))
+            % (phrases, length - 1))
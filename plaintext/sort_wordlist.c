@@ -5,6 +5,9 @@
  * This program opens the already uncommented wordlist file and sorts its
  * contents into a new file. The sorting is done by way of the magic comparison
  * function described below.
+ *
+ * The word list comes in descending order of frequency, and the sort is stable,
+ * so the words that share their first 2 characters stay in that order.
  * 
  * TODO:
  * It is notable that this program doesn't need to be told how many words are in
@@ -20,6 +23,12 @@
 #define WORDLIST_NAME	"50k-newline-separated.txt"
 #define WORDLIST_SORTED_NAME	"50k-newline-separated-sorted.txt"
 
+/* a word, and its place in the unsorted list, starting from 0 */
+struct word {
+	char *str;
+	unsigned int rank;
+};
+
 /*
  * This is a conceptually dense function, so let me explain.
  *
@@ -35,11 +44,19 @@
  * We can now effectively sort strings by only the first 2 characters. Do not
  * pass pointers to empty strings to this function. Length must be at least 1,
  * excluding the null byte.
+ *
+ * qsort() isn't stable, and some C libraries really do shuffle equal elements
+ * around, so words with the same first 2 characters are put back in their
+ * original order of frequency by their rank. The words are actually struct
+ * words, which start with the string pointer, so the cast still works.
  */
 static int cmpstringp_first2(const void *p1, const void *p2) {
 	uint16_t i1 = **(uint16_t **) p1;
 	uint16_t i2 = **(uint16_t **) p2;
-	return i1 - i2;
+	const struct word *w1 = p1, *w2 = p2;
+	if (i1 != i2)
+		return i1 - i2;
+	return (w1->rank > w2->rank) - (w1->rank < w2->rank);
 }
 
 int main (int argc, char **argv) {
@@ -49,9 +66,11 @@ int main (int argc, char **argv) {
 	size_t size;	/* size of file */
 	char *buf;		/* buffer for storing file */
 	char *sortedBuf;	/* output buffer */
-	char **substrings;	/* array of null terminated words */
+	struct word *substrings;	/* array of null terminated words */
 	FILE *fp;		/* take a guess */
 
+	(void)argc;	/* only argv[0] is used, in messages */
+
 	fp = fopen(WORDLIST_NAME, "rb");
 	if (fp == NULL) {
 		fprintf(stderr, "%s: Error opening file %s.\n", argv[0], WORDLIST_NAME);
@@ -85,7 +104,7 @@ int main (int argc, char **argv) {
 	}
 	
 	/* more memory allocation */
-	substrings = malloc(words * sizeof(char *));
+	substrings = malloc(words * sizeof(struct word));
 	if (substrings == NULL) {
 		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
 		free(buf);
@@ -95,7 +114,9 @@ int main (int argc, char **argv) {
 	/* now build the index of all the words to pass to qsort */
 	word = 0;
 	for (i = 0 ; i < size; ) {
-		substrings[word++] = buf + i;
+		substrings[word].str = buf + i;
+		substrings[word].rank = word;
+		++word;
 		/* advance to the next word */
 		while (buf[i++] != '\0') ;
 			/* skip until after the next null character */
@@ -103,7 +124,7 @@ int main (int argc, char **argv) {
 	
 	/* now we can finally sort! */
 	fprintf(stderr, "%s: Sorting %u words...\n", argv[0], words);
-	qsort(substrings, words, sizeof(char *), cmpstringp_first2);
+	qsort(substrings, words, sizeof(struct word), cmpstringp_first2);
 	fprintf(stderr, "%s: Done sorting.\n", argv[0]);
 
 	/* Sorting is done, now concatenate the strings in order into ANOTHER
@@ -112,8 +133,8 @@ int main (int argc, char **argv) {
 	   buf right now. */
 	word = 0;
 	for (i = 0; i < size; ) {
-		strcpy(sortedBuf + i, substrings[word]);
-		i += strlen(substrings[word++]);
+		strcpy(sortedBuf + i, substrings[word].str);
+		i += strlen(substrings[word++].str);
 		sortedBuf[i++] = '\n';	/* make the null byte a newline */
 	}
 	
@@ -0,0 +1,637 @@
+/*
+ * archive.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for writing many
+ * sentences, or records, into one archive, and for decoding any one of them,
+ * or any range of their characters, without touching the rest.
+ *
+ * Every record is encoded on its own, and its elements are stored the way
+ * CBLT_PACK_STORED stores them, with no null terminator, one record right
+ * after another. A record whose elements would take more bytes than its
+ * characters, like a line of a log, is stored as its characters instead. An
+ * index in front of them gives where each record starts, and where its
+ * characters start in all of the records put together, so that finding a
+ * record takes a single lookup, and finding the record that holds a given
+ * character takes a binary search. An archive is laid out as follows,
+ * where every number is unsigned and least significant byte first:
+ *
+ * 	magic:		the 4 characters "CBLA"
+ * 	version:	1 byte, CBLT_ARCHIVE_VERSION
+ * 	width:		1 byte, the size of every offset in the index, 4 or 8
+ * 	reserved:	2 bytes of zeroes
+ * 	dictionary:	the ID of the dictionary, in 4 bytes
+ * 	records:	the number of records, in 8 bytes
+ * 	offsets:	where each record starts in the records, and then where the
+ * 	        	records end, with the top bit set if the record is stored
+ * 	        	as its characters
+ * 	decoded:	where the characters of each record start, and then the number
+ * 	        	of characters in all of them
+ * 	records:	the records
+ *
+ * Offsets only take 8 bytes each when the records don't fit in 2 GiB, or their
+ * characters don't fit in 4 GiB. Opening an archive only checks the header
+ * and where the index ends, and each record is checked as it is decoded, so
+ * neither takes time proportional to the size of the archive. Where mmap() is
+ * available, an archive file is mapped read-only, so that only the pages that
+ * are read are ever loaded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>	/* malloc, realloc, free, size_t */
+#include <string.h>	/* memcpy, memcmp, memset, strlen */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef CBLT_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "cobalt.h"
+#include "dict.h"
+#include "pack.h"
+#include "archive.h"
+
+#define CBLT_ARCHIVE_VERSION	1
+#define CBLT_ARCHIVE_HEADER		20
+
+/* the top bit of the offset of a record that is stored as its characters,
+   which is moved to the top bit of the offset as it is written */
+#define CBLT_ARCHIVE_TEXT		((uint64_t)1 << 63)
+
+/* records of up to this many elements are unpacked on the stack */
+#define CBLT_ARCHIVE_STACK		256
+
+static const unsigned char CBLT_ARCHIVE_MAGIC[4] = { 'C', 'B', 'L', 'A' };
+
+struct cblt_archiveWriter {
+	unsigned char *data;	/* the records written so far */
+	size_t dataSize;
+	size_t dataCapacity;
+	uint64_t *offsets;		/* where each record starts, and the end */
+	uint64_t *decoded;		/* where its characters start, and the end */
+	size_t records;
+	size_t recordsCapacity;
+	uint16_t *scratch;		/* the elements of the record being added */
+	size_t scratchCapacity;
+	cblt_dict dict;			/* the dictionary to encode with */
+};
+
+struct cblt_archive {
+	const unsigned char *file;
+	size_t fileLength;
+	bool mapped;			/* file is mapped, and must be unmapped */
+	bool owned;				/* file was allocated, and must be freed */
+	unsigned int width;		/* the size of every offset in the index */
+	size_t records;
+	const unsigned char *offsets;
+	const unsigned char *decoded;
+	const unsigned char *data;
+	size_t dataSize;
+	size_t decodedLength;
+	cblt_dict dict;			/* the dictionary to decode with */
+};
+
+/* where a record is, and where its characters go */
+typedef struct cblt_record {
+	const unsigned char *bytes;
+	size_t size;
+	size_t start;
+	size_t length;
+	bool text;				/* it is stored as its characters */
+} cblt_record;
+
+/* Writes the WIDTH bytes of V to P, least significant first. */
+static void cblt_putOffset(unsigned char *p, uint64_t v, unsigned int width) {
+	unsigned int i;
+
+	for (i = 0; i < width; ++i, v >>= 8)
+		p[i] = (unsigned char)v;
+}
+
+/* Returns offset number N of the WIDTH-byte offsets at P. */
+static uint64_t cblt_getOffset(const unsigned char *p, size_t n,
+		unsigned int width) {
+	uint64_t v = 0;
+	unsigned int i;
+
+	p += n * width;
+	for (i = width; i > 0; --i)
+		v = v << 8 | p[i - 1];
+	return v;
+}
+
+cblt_archiveWriter *cblt_createArchiveWriter(void) {
+	return cblt_createArchiveWriterDict(NULL);
+}
+
+cblt_archiveWriter *cblt_createArchiveWriterDict(const cblt_dict *dict) {
+	cblt_archiveWriter *w;
+
+	w = malloc(sizeof(cblt_archiveWriter));
+	if (w == NULL)
+		return NULL;
+	memset(w, 0, sizeof(cblt_archiveWriter));
+	w->recordsCapacity = 64;
+	w->offsets = malloc(sizeof(uint64_t) * (w->recordsCapacity + 1));
+	w->decoded = malloc(sizeof(uint64_t) * (w->recordsCapacity + 1));
+	if (w->offsets == NULL || w->decoded == NULL) {
+		cblt_freeArchiveWriter(w);
+		return NULL;
+	}
+	w->offsets[0] = 0;
+	w->decoded[0] = 0;
+	if (dict != NULL)
+		w->dict = *dict;
+	else
+		cblt_loadBuiltinDict(&w->dict);
+	return w;
+}
+
+void cblt_freeArchiveWriter(cblt_archiveWriter *w) {
+	if (w == NULL)
+		return;
+	free(w->data);
+	free(w->offsets);
+	free(w->decoded);
+	free(w->scratch);
+	free(w);
+}
+
+/* Makes room in *PBLOCK, which has room for *PCAPACITY items of SIZE bytes,
+   for NEEDED items. Returns false if a memory allocation fails. */
+static bool cblt_growArray(void **pblock, size_t *pcapacity, size_t size,
+		size_t needed) {
+	size_t capacity = *pcapacity;
+	void *grown;
+
+	if (needed <= capacity)
+		return true;
+	while (capacity < needed)
+		capacity = 2 * capacity + 64;
+	grown = realloc(*pblock, size * capacity);
+	if (grown == NULL)
+		return false;
+	*pblock = grown;
+	*pcapacity = capacity;
+	return true;
+}
+
+/* Makes room in W for 1 more record. Returns false if a memory allocation
+   fails. */
+static bool cblt_growIndex(cblt_archiveWriter *w) {
+	size_t capacity = 2 * w->recordsCapacity;
+	uint64_t *grown;
+
+	if (w->records < w->recordsCapacity)
+		return true;
+	/* the offsets have room for 1 more than the number of records */
+	grown = realloc(w->offsets, sizeof(uint64_t) * (capacity + 1));
+	if (grown == NULL)
+		return false;
+	w->offsets = grown;
+	grown = realloc(w->decoded, sizeof(uint64_t) * (capacity + 1));
+	if (grown == NULL)
+		return false;
+	w->decoded = grown;
+	w->recordsCapacity = capacity;
+	return true;
+}
+
+bool cblt_addRecord(cblt_archiveWriter *w, const char *record) {
+	size_t length;
+	size_t written;
+	size_t size;
+	bool text;				/* the record is stored as its characters */
+
+	if (w == NULL || record == NULL)
+		return false;
+	length = strlen(record);
+	/* the scratch block is reused, so encoding doesn't allocate anything once
+	   it is big enough */
+	if (!cblt_encodeIntoDict(&w->dict, record, length, w->scratch,
+			w->scratchCapacity, &written)) {
+		if (!cblt_growArray((void **)&w->scratch, &w->scratchCapacity,
+				sizeof(uint16_t), written)
+				|| !cblt_encodeIntoDict(&w->dict, record, length, w->scratch,
+					w->scratchCapacity, &written))
+			return false;
+	}
+
+	/* leave out the null terminator */
+	size = 2 * (written - 1);
+	text = length < size;
+	if (text)
+		size = length;
+	if (!cblt_growArray((void **)&w->data, &w->dataCapacity, 1,
+				w->dataSize + size)
+			|| !cblt_growIndex(w))
+		return false;
+
+	if (text) {
+		memcpy(w->data + w->dataSize, record, length);
+		w->offsets[w->records] |= CBLT_ARCHIVE_TEXT;
+	} else if (size > 0) {
+		cblt_putStored(w->data + w->dataSize, w->scratch, written - 1);
+	}
+	w->dataSize += size;
+	++w->records;
+	w->offsets[w->records] = w->dataSize;
+	w->decoded[w->records] = w->decoded[w->records - 1] + length;
+	return true;
+}
+
+unsigned char *cblt_finishArchive(const cblt_archiveWriter *w, size_t *psize) {
+	unsigned char *archive;
+	unsigned char *p;
+	unsigned int width;
+	uint64_t offset;
+	size_t size;
+	size_t n;
+
+	if (w == NULL || psize == NULL)
+		return NULL;
+	/* the top bit of an offset is the text flag */
+	width = (w->dataSize < ((uint64_t)1 << 31)
+		&& w->decoded[w->records] <= UINT32_MAX) ? 4 : 8;
+	size = CBLT_ARCHIVE_HEADER + 2 * width * (w->records + 1) + w->dataSize;
+	archive = malloc(size);
+	if (archive == NULL)
+		return NULL;
+
+	memcpy(archive, CBLT_ARCHIVE_MAGIC, sizeof(CBLT_ARCHIVE_MAGIC));
+	archive[4] = CBLT_ARCHIVE_VERSION;
+	archive[5] = (unsigned char)width;
+	archive[6] = 0;
+	archive[7] = 0;
+	cblt_putOffset(archive + 8, w->dict.id, 4);
+	cblt_putOffset(archive + 12, w->records, 8);
+	p = archive + CBLT_ARCHIVE_HEADER;
+	for (n = 0; n <= w->records; ++n, p += width) {
+		offset = w->offsets[n] & ~CBLT_ARCHIVE_TEXT;
+		if (w->offsets[n] & CBLT_ARCHIVE_TEXT)
+			offset |= (uint64_t)1 << (8 * width - 1);
+		cblt_putOffset(p, offset, width);
+	}
+	for (n = 0; n <= w->records; ++n, p += width)
+		cblt_putOffset(p, w->decoded[n], width);
+	if (w->dataSize > 0)
+		memcpy(p, w->data, w->dataSize);
+
+	*psize = size;
+	return archive;
+}
+
+bool cblt_saveArchive(const cblt_archiveWriter *w, const char *path) {
+	unsigned char *archive;
+	size_t size;
+	FILE *out;
+	bool ok;
+
+	if (path == NULL)
+		return false;
+	archive = cblt_finishArchive(w, &size);
+	if (archive == NULL)
+		return false;
+	out = fopen(path, "wb");
+	if (out == NULL) {
+		free(archive);
+		return false;
+	}
+
+	ok = fwrite(archive, 1, size, out) == size;
+	if (fclose(out) != 0)
+		ok = false;
+	free(archive);
+	return ok;
+}
+
+/*
+ * Points A at the sections of the archive that is already in memory at
+ * A->FILE, after checking its header and that its index and records add up to
+ * its size. Returns false if it isn't an archive, if it was cut short, or if
+ * it was written with a dictionary other than A->DICT.
+ */
+static bool cblt_readArchive(cblt_archive *a) {
+	const unsigned char *file = a->file;
+	uint64_t records;
+	uint64_t length;
+	size_t index;
+
+	if (a->fileLength < CBLT_ARCHIVE_HEADER
+			|| memcmp(file, CBLT_ARCHIVE_MAGIC, sizeof(CBLT_ARCHIVE_MAGIC)) != 0
+			|| file[4] != CBLT_ARCHIVE_VERSION
+			|| (file[5] != 4 && file[5] != 8)
+			|| file[6] != 0 || file[7] != 0
+			|| cblt_getOffset(file + 8, 0, 4) != a->dict.id)
+		return false;
+	a->width = file[5];
+	records = cblt_getOffset(file + 12, 0, 8);
+	/* the index has 2 offsets for every record, and 2 more */
+	index = (a->fileLength - CBLT_ARCHIVE_HEADER) / (2 * a->width);
+	if (records >= index)
+		return false;
+	a->records = (size_t)records;
+	a->offsets = file + CBLT_ARCHIVE_HEADER;
+	a->decoded = a->offsets + a->width * (a->records + 1);
+	a->data = a->decoded + a->width * (a->records + 1);
+	a->dataSize = a->fileLength - (size_t)(a->data - file);
+
+	length = cblt_getOffset(a->decoded, a->records, a->width);
+	if ((cblt_getOffset(a->offsets, 0, a->width)
+				& ~((uint64_t)1 << (8 * a->width - 1))) != 0
+			|| cblt_getOffset(a->decoded, 0, a->width) != 0
+			|| cblt_getOffset(a->offsets, a->records, a->width)
+				!= a->dataSize
+			|| length >= SIZE_MAX)
+		return false;
+	a->decodedLength = (size_t)length;
+	return true;
+}
+
+cblt_archive *cblt_openArchive(const char *path) {
+	return cblt_openArchiveDict(NULL, path);
+}
+
+cblt_archive *cblt_openArchiveDict(const cblt_dict *dict, const char *path) {
+	cblt_archive *a;
+#ifdef CBLT_HAVE_MMAP
+	int fd;
+	struct stat st;
+	void *file;
+#else
+	FILE *fp;
+	long length;
+	unsigned char *file;
+#endif
+
+	if (path == NULL)
+		return NULL;
+	a = malloc(sizeof(cblt_archive));
+	if (a == NULL)
+		return NULL;
+	memset(a, 0, sizeof(cblt_archive));
+	if (dict != NULL)
+		a->dict = *dict;
+	else
+		cblt_loadBuiltinDict(&a->dict);
+
+#ifdef CBLT_HAVE_MMAP
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		free(a);
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		free(a);
+		return NULL;
+	}
+	file = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	/* the mapping stays valid after the file is closed */
+	close(fd);
+	if (file == MAP_FAILED) {
+		free(a);
+		return NULL;
+	}
+	a->file = file;
+	a->fileLength = st.st_size;
+	a->mapped = true;
+#else
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		free(a);
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	rewind(fp);
+	file = (length > 0) ? malloc(length) : NULL;
+	if (file == NULL || fread(file, 1, length, fp) != (size_t)length) {
+		fclose(fp);
+		free(file);
+		free(a);
+		return NULL;
+	}
+	fclose(fp);
+	a->file = file;
+	a->fileLength = length;
+	a->owned = true;
+#endif
+
+	if (!cblt_readArchive(a)) {
+		cblt_closeArchive(a);
+		return NULL;
+	}
+	return a;
+}
+
+cblt_archive *cblt_openArchiveBuffer(const unsigned char *archive,
+		size_t size) {
+	return cblt_openArchiveBufferDict(NULL, archive, size);
+}
+
+cblt_archive *cblt_openArchiveBufferDict(const cblt_dict *dict,
+		const unsigned char *archive, size_t size) {
+	cblt_archive *a;
+
+	if (archive == NULL)
+		return NULL;
+	a = malloc(sizeof(cblt_archive));
+	if (a == NULL)
+		return NULL;
+	memset(a, 0, sizeof(cblt_archive));
+	if (dict != NULL)
+		a->dict = *dict;
+	else
+		cblt_loadBuiltinDict(&a->dict);
+	a->file = archive;
+	a->fileLength = size;
+
+	if (!cblt_readArchive(a)) {
+		cblt_closeArchive(a);
+		return NULL;
+	}
+	return a;
+}
+
+void cblt_closeArchive(cblt_archive *a) {
+	if (a == NULL)
+		return;
+#ifdef CBLT_HAVE_MMAP
+	if (a->mapped)
+		munmap((void *)a->file, a->fileLength);
+#endif
+	if (a->owned)
+		free((void *)a->file);
+	free(a);
+}
+
+size_t cblt_getRecordCount(const cblt_archive *a) {
+	return (a != NULL) ? a->records : 0;
+}
+
+size_t cblt_getArchiveLength(const cblt_archive *a) {
+	return (a != NULL) ? a->decodedLength : 0;
+}
+
+/*
+ * Finds record number N of A, and stores where it is and where its characters
+ * go in *RECORD. Returns false if there is no such record, or if the index
+ * doesn't make sense there.
+ */
+static bool cblt_findRecord(const cblt_archive *a, size_t n,
+		cblt_record *record) {
+	uint64_t from, to;
+	uint64_t first, last;
+	uint64_t textFlag = (uint64_t)1 << (8 * a->width - 1);
+
+	if (n >= a->records)
+		return false;
+	from = cblt_getOffset(a->offsets, n, a->width);
+	to = cblt_getOffset(a->offsets, n + 1, a->width) & ~textFlag;
+	first = cblt_getOffset(a->decoded, n, a->width);
+	last = cblt_getOffset(a->decoded, n + 1, a->width);
+	record->text = (from & textFlag) != 0;
+	from &= ~textFlag;
+	if (from > to || to > a->dataSize || first > last
+			|| last > a->decodedLength
+			|| (record->text ? to - from != last - first
+				: (to - from) % 2 != 0))
+		return false;
+	record->bytes = a->data + from;
+	record->size = (size_t)(to - from);
+	record->start = (size_t)first;
+	record->length = (size_t)(last - first);
+	return true;
+}
+
+/*
+ * Decodes RECORD, a record of A, into exactly RECORD->LENGTH characters at
+ * OUT, followed by a null terminator. Returns false if it is damaged, if it
+ * doesn't decode to exactly that many characters, or if a memory allocation
+ * fails.
+ */
+static bool cblt_expandRecord(const cblt_archive *a,
+		const cblt_record *record, char *out) {
+	uint16_t stack[CBLT_ARCHIVE_STACK + 1];
+	uint16_t *compressed = stack;
+	size_t count = record->size / 2;
+	size_t written;
+	bool decoded;
+
+	if (record->text) {
+		/* the text of a sentence never has a null character in it */
+		memcpy(out, record->bytes, record->length);
+		out[record->length] = '\0';
+		return memchr(out, '\0', record->length) == NULL;
+	}
+
+	if (count > CBLT_ARCHIVE_STACK) {
+		compressed = malloc(sizeof(uint16_t) * (count + 1));
+		if (compressed == NULL)
+			return false;
+	}
+	decoded = cblt_unpackStored(record->bytes, record->bytes + record->size,
+		count, compressed);
+	if (decoded) {
+		compressed[count] = 0x0000;
+		decoded = cblt_decodeIntoDict(&a->dict, compressed, out,
+				record->length + 1, &written)
+			&& written == record->length + 1;
+	}
+	if (compressed != stack)
+		free(compressed);
+	return decoded;
+}
+
+char *cblt_decodeRecord(const cblt_archive *a, size_t n) {
+	cblt_record record;
+	char *decoded;
+
+	if (a == NULL || !cblt_findRecord(a, n, &record))
+		return NULL;
+	decoded = malloc(record.length + 1);
+	if (decoded == NULL)
+		return NULL;
+	if (!cblt_expandRecord(a, &record, decoded)) {
+		free(decoded);
+		return NULL;
+	}
+	return decoded;
+}
+
+bool cblt_decodeRecordInto(const cblt_archive *a, size_t n, char *out,
+		size_t capacity, size_t *pwritten) {
+	cblt_record record;
+
+	if (pwritten != NULL)
+		*pwritten = 0;
+	if (a == NULL || pwritten == NULL || (out == NULL && capacity > 0)
+			|| !cblt_findRecord(a, n, &record))
+		return false;
+	*pwritten = record.length + 1;
+	if (capacity < record.length + 1)
+		return false;
+	return cblt_expandRecord(a, &record, out);
+}
+
+bool cblt_decodeArchiveRange(const cblt_archive *a, size_t offset,
+		size_t length, char *out) {
+	cblt_record record;
+	size_t lo, hi, mid;
+	size_t done = 0;		/* characters of the range written so far */
+	size_t skip, part, n;
+	char *decoded;
+
+	if (a == NULL || out == NULL || offset > a->decodedLength
+			|| length > a->decodedLength - offset)
+		return false;
+
+	/* the last record whose characters start at or before OFFSET */
+	lo = 0;
+	hi = a->records;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (cblt_getOffset(a->decoded, mid, a->width) <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	for (n = lo; done < length; ++n) {
+		if (!cblt_findRecord(a, n, &record) || record.start > offset + done)
+			return false;
+		skip = offset + done - record.start;
+		if (skip >= record.length)
+			continue;
+		part = record.length - skip;
+		if (part > length - done)
+			part = length - done;
+
+		if (part == record.length) {
+			/* the whole record is in the range, so it goes right where it
+			   belongs, and its null terminator is overwritten by the next */
+			if (!cblt_expandRecord(a, &record, out + done))
+				return false;
+		} else if (record.text) {
+			memcpy(out + done, record.bytes + skip, part);
+			if (memchr(out + done, '\0', part) != NULL)
+				return false;
+		} else {
+			decoded = malloc(record.length + 1);
+			if (decoded == NULL || !cblt_expandRecord(a, &record, decoded)) {
+				free(decoded);
+				return false;
+			}
+			memcpy(out + done, decoded + skip, part);
+			free(decoded);
+		}
+		done += part;
+	}
+	out[length] = '\0';
+	return true;
+}
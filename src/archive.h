@@ -0,0 +1,37 @@
+/*
+ * archive.h
+ *
+ * contains the declarations of functions defined in archive.c
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+cblt_archiveWriter *cblt_createArchiveWriter(void);
+cblt_archiveWriter *cblt_createArchiveWriterDict(const cblt_dict *dict);
+void cblt_freeArchiveWriter(cblt_archiveWriter *w);
+bool cblt_addRecord(cblt_archiveWriter *w, const char *record);
+unsigned char *cblt_finishArchive(const cblt_archiveWriter *w, size_t *psize);
+bool cblt_saveArchive(const cblt_archiveWriter *w, const char *path);
+
+cblt_archive *cblt_openArchive(const char *path);
+cblt_archive *cblt_openArchiveDict(const cblt_dict *dict, const char *path);
+cblt_archive *cblt_openArchiveBuffer(const unsigned char *archive,
+		size_t size);
+cblt_archive *cblt_openArchiveBufferDict(const cblt_dict *dict,
+		const unsigned char *archive, size_t size);
+void cblt_closeArchive(cblt_archive *a);
+size_t cblt_getRecordCount(const cblt_archive *a);
+size_t cblt_getArchiveLength(const cblt_archive *a);
+char *cblt_decodeRecord(const cblt_archive *a, size_t n);
+bool cblt_decodeRecordInto(const cblt_archive *a, size_t n, char *out,
+		size_t capacity, size_t *pwritten);
+bool cblt_decodeArchiveRange(const cblt_archive *a, size_t offset,
+		size_t length, char *out);
+
+#endif  /* ARCHIVE_H */
@@ -0,0 +1,147 @@
+/*
+ * batch.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for encoding and
+ * decoding many sentences at once.
+ *
+ * Encoding a short sentence with cblt_encodeSentence() allocates a block big
+ * enough for the worst case and then trims it, which costs more than the
+ * encoding itself when the sentence is only a few words long, and leaves a
+ * small block on the heap for every sentence. A batch writes every sentence
+ * right after the one before it into a single block, with cblt_encodeInto(),
+ * and only grows the block when a sentence doesn't fit in what is left of it,
+ * so a whole batch takes a handful of allocations, however many sentences are
+ * in it. Decoding a batch works the same way.
+ */
+
+#include <stdlib.h>	/* malloc, realloc, free, size_t */
+#include <string.h>	/* strlen */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+#include "sentence.h"
+#include "batch.h"
+
+/* the number of elements allocated per character when encoding, and the
+   number of characters per element when decoding, to start with */
+#define CBLT_BATCH_ENCODE_RATIO	2
+#define CBLT_BATCH_DECODE_RATIO	4
+
+/* Grows *PBLOCK, which has room for *PCAPACITY items of SIZE bytes, so that
+   it has room for at least NEEDED. Returns false if a memory allocation
+   fails. */
+static bool cblt_growBatch(void **pblock, size_t *pcapacity, size_t size,
+		size_t needed) {
+	size_t capacity = 2 * *pcapacity;
+	void *grown;
+
+	if (capacity < needed)
+		capacity = needed;
+	grown = realloc(*pblock, size * capacity);
+	if (grown == NULL)
+		return false;
+	*pblock = grown;
+	*pcapacity = capacity;
+	return true;
+}
+
+uint16_t *cblt_encodeBatch(const char *const *sentences, size_t n,
+		size_t *offsets) {
+	return cblt_encodeBatchDict(NULL, sentences, n, offsets);
+}
+
+uint16_t *cblt_encodeBatchDict(const cblt_dict *dict,
+		const char *const *sentences, size_t n, size_t *offsets) {
+	uint16_t *compressed;
+	uint16_t *trimmed;
+	size_t capacity;
+	size_t count = 0;		/* number of elements written so far */
+	size_t written;
+	size_t length;
+	size_t i;
+	cblt_dict builtin;
+
+	if (sentences == NULL || offsets == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+
+	/* most sentences take far fewer elements than they have characters */
+	capacity = 64;
+	for (i = 0; i < n; ++i) {
+		if (sentences[i] == NULL)
+			return NULL;
+		capacity += 1 + strlen(sentences[i]) / CBLT_BATCH_ENCODE_RATIO;
+	}
+	compressed = malloc(sizeof(uint16_t) * capacity);
+	if (compressed == NULL)
+		return NULL;
+
+	for (i = 0; i < n; ++i) {
+		offsets[i] = count;
+		length = strlen(sentences[i]);
+		if (!cblt_encodeIntoDict(dict, sentences[i], length,
+				compressed + count, capacity - count, &written)) {
+			/* *pwritten is how much room it needs */
+			if (!cblt_growBatch((void **)&compressed, &capacity,
+					sizeof(uint16_t), count + written)
+					|| !cblt_encodeIntoDict(dict, sentences[i], length,
+						compressed + count, capacity - count, &written)) {
+				free(compressed);
+				return NULL;
+			}
+		}
+		count += written;
+	}
+	offsets[n] = count;
+
+	/* give back the memory we didn't use */
+	trimmed = realloc(compressed, sizeof(uint16_t) * (count > 0 ? count : 1));
+	return (trimmed != NULL) ? trimmed : compressed;
+}
+
+char *cblt_decodeBatch(const uint16_t *compressed, const size_t *offsets,
+		size_t n, size_t *decodedOffsets) {
+	return cblt_decodeBatchDict(NULL, compressed, offsets, n, decodedOffsets);
+}
+
+char *cblt_decodeBatchDict(const cblt_dict *dict, const uint16_t *compressed,
+		const size_t *offsets, size_t n, size_t *decodedOffsets) {
+	char *sentences;
+	char *trimmed;
+	size_t capacity;
+	size_t length = 0;		/* number of characters written so far */
+	size_t written;
+	size_t i;
+	cblt_dict builtin;
+
+	if (compressed == NULL || offsets == NULL || decodedOffsets == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+
+	capacity = 64 + n + (offsets[n] - offsets[0]) * CBLT_BATCH_DECODE_RATIO;
+	sentences = malloc(capacity);
+	if (sentences == NULL)
+		return NULL;
+
+	for (i = 0; i < n; ++i) {
+		decodedOffsets[i] = length;
+		if (!cblt_decodeIntoDict(dict, compressed + offsets[i],
+				sentences + length, capacity - length, &written)) {
+			if (!cblt_growBatch((void **)&sentences, &capacity, 1,
+					length + written)
+					|| !cblt_decodeIntoDict(dict, compressed + offsets[i],
+						sentences + length, capacity - length, &written)) {
+				free(sentences);
+				return NULL;
+			}
+		}
+		length += written;
+	}
+	decodedOffsets[n] = length;
+
+	trimmed = realloc(sentences, length > 0 ? length : 1);
+	return (trimmed != NULL) ? trimmed : sentences;
+}
@@ -0,0 +1,24 @@
+/*
+ * batch.h
+ *
+ * contains the declarations of functions defined in batch.c
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cobalt.h"
+
+#ifndef BATCH_H
+#define BATCH_H
+
+uint16_t *cblt_encodeBatch(const char *const *sentences, size_t n,
+		size_t *offsets);
+uint16_t *cblt_encodeBatchDict(const cblt_dict *dict,
+		const char *const *sentences, size_t n, size_t *offsets);
+char *cblt_decodeBatch(const uint16_t *compressed, const size_t *offsets,
+		size_t n, size_t *decodedOffsets);
+char *cblt_decodeBatchDict(const cblt_dict *dict, const uint16_t *compressed,
+		const size_t *offsets, size_t n, size_t *decodedOffsets);
+
+#endif  /* BATCH_H */
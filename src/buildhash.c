@@ -0,0 +1,249 @@
+/*
+ * buildhash.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for building a minimal
+ * perfect hash table over every unique word in a word table, so that
+ * cblt_findWord() can find a word with a single hash, a single probe and a
+ * single memcmp(). See wordhash.h for the hash functions themselves.
+ *
+ * The words are spread over buckets by their hash, and every bucket gets a
+ * seed that sends all of its words to slots that no other word has taken yet.
+ * The biggest buckets are placed first, while there are still plenty of free
+ * slots to choose from.
+ *
+ * Phrases get a small table of their own, built the same way, so that looking
+ * for a phrase that isn't there only touches memory that stays in the cache.
+ *
+ * This is used both by map/construct_wordhash.c, to build the table compiled
+ * into the library, and by cblt_createDict(), to build the table of a
+ * dictionary at runtime.
+ */
+
+#include <stdlib.h>	/* malloc, calloc, qsort, free */
+#include <string.h>	/* memchr, memcmp, memset, strlen */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buildhash.h"
+#include "wordhash.h"
+
+struct cblt_hashKey {
+	uint64_t hash;
+	uint16_t word;
+	uint16_t length;
+	uint32_t bucket;
+};
+
+/* sort keys by bucket, so that each bucket is a contiguous run of keys */
+static int cblt_cmpKeyBucket(const void *p1, const void *p2) {
+	const struct cblt_hashKey *k1 = p1, *k2 = p2;
+	if (k1->bucket != k2->bucket)
+		return (k1->bucket > k2->bucket) - (k1->bucket < k2->bucket);
+	return (k1->word > k2->word) - (k1->word < k2->word);
+}
+
+/* Collects every unique word in the table into KEYS, or every unique phrase if
+   PHRASES is true. A phrase is told apart from a word by the spaces in it.
+   When a word occurs more than once in the table, only its first occurrence
+   is kept, since that is the occurrence that the old linear search would have
+   found. Returns the number of unique words, or SIZE_MAX if a memory
+   allocation fails. */
+static size_t cblt_collectKeys(const unsigned char *wordtable,
+		const uint32_t *wordmap, size_t symbols, bool phrases,
+		struct cblt_hashKey *keys) {
+	size_t n = 0;
+	size_t i;
+	size_t mask;
+	uint32_t *seen;		/* open addressing table of indexes into KEYS */
+	uint32_t word;
+	const char *str;
+	size_t length;
+	uint64_t h;
+
+	for (mask = 1; mask < 2 * symbols; mask <<= 1) ;
+	seen = malloc(sizeof(uint32_t) * mask);
+	if (seen == NULL)
+		return SIZE_MAX;
+	memset(seen, 0xFF, sizeof(uint32_t) * mask);
+	--mask;
+
+	for (word = 0x100; word < symbols; ++word) {
+		str = (const char *)wordtable + wordmap[word];
+		length = strlen(str);
+		if (length == 0 || (memchr(str, ' ', length) != NULL) != phrases)
+			continue;
+		h = cblt_hashWord(str, length);
+
+		for (i = h & mask; seen[i] != UINT32_MAX; i = (i + 1) & mask) {
+			if (keys[seen[i]].hash == h
+					&& keys[seen[i]].length == length
+					&& memcmp(str, wordtable + wordmap[keys[seen[i]].word],
+						length) == 0)
+				break;
+		}
+		if (seen[i] != UINT32_MAX)
+			/* duplicate word */
+			continue;
+
+		seen[i] = n;
+		keys[n].hash = h;
+		keys[n].word = word;
+		keys[n].length = length;
+		++n;
+	}
+
+	free(seen);
+	return n;
+}
+
+/* Tries to find a seed for every bucket. Returns 0 on success and -1 if some
+   bucket could not be placed with any seed. */
+static int cblt_placeBuckets(struct cblt_hashKey *keys, size_t n,
+		size_t buckets, uint16_t *seeds, uint32_t *slots) {
+	size_t *start;		/* index of the first key of each bucket */
+	uint32_t *order;	/* buckets, largest first */
+	uint8_t *taken;		/* whether a slot has been filled */
+	uint32_t *trial;	/* slots picked by the current seed */
+	size_t i, j, k, b, size, maxSize;
+	size_t first;
+	uint32_t seed;
+	int ret = 0;
+
+	start = calloc(buckets + 1, sizeof(size_t));
+	order = malloc(sizeof(uint32_t) * buckets);
+	taken = calloc(n, 1);
+	if (start == NULL || order == NULL || taken == NULL) {
+		ret = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < n; ++i)
+		keys[i].bucket = cblt_hashBucket(keys[i].hash, buckets);
+	qsort(keys, n, sizeof(struct cblt_hashKey), cblt_cmpKeyBucket);
+
+	maxSize = 0;
+	for (i = 0, b = 0; b < buckets; ++b) {
+		start[b] = i;
+		while (i < n && keys[i].bucket == b)
+			++i;
+		if (i - start[b] > maxSize)
+			maxSize = i - start[b];
+	}
+	start[buckets] = n;
+
+	/* counting sort of the buckets by descending size */
+	j = 0;
+	for (size = maxSize; size > 0; --size)
+		for (b = 0; b < buckets; ++b)
+			if (start[b + 1] - start[b] == size)
+				order[j++] = b;
+	/* empty buckets keep a seed of 0 */
+	memset(seeds, 0, sizeof(uint16_t) * buckets);
+
+	trial = malloc(sizeof(uint32_t) * (maxSize + 1));
+	if (trial == NULL) {
+		ret = -1;
+		goto cleanup;
+	}
+
+	for (b = 0; b < j; ++b) {
+		first = start[order[b]];
+		size = start[order[b] + 1] - first;
+
+		for (seed = 0; seed <= UINT16_MAX; ++seed) {
+			for (i = 0; i < size; ++i) {
+				trial[i] = cblt_hashSlot(keys[first + i].hash, seed, n);
+				if (taken[trial[i]])
+					break;
+				/* two words of the same bucket may also collide */
+				for (k = 0; k < i && trial[k] != trial[i]; ++k) ;
+				if (k < i)
+					break;
+			}
+			if (i == size)
+				break;
+		}
+		if (seed > UINT16_MAX) {
+			ret = -1;
+			break;
+		}
+
+		seeds[order[b]] = seed;
+		for (i = 0; i < size; ++i) {
+			taken[trial[i]] = 1;
+			slots[trial[i]] = CBLT_MAKE_SLOT(keys[first + i].word,
+				keys[first + i].length);
+		}
+	}
+
+	free(trial);
+cleanup:
+	free(start);
+	free(order);
+	free(taken);
+	return ret;
+}
+
+/*
+ * Builds a minimal perfect hash table over the unique, non-empty words among
+ * words 0x100 to SYMBOLS - 1 of WORDTABLE, where WORDMAP holds the offset of
+ * each word. If PHRASES is true, the table is built over the phrases instead:
+ * the words that have spaces in them. On success, *PSEEDS and *PSLOTS point to
+ * newly allocated arrays of *PNSEEDS bucket seeds and *PNSLOTS slots, to be
+ * freed by the caller, and 0 is returned. Both counts are 0 if there are no
+ * words to build a table over. Returns -1 if a memory allocation fails, or if
+ * no perfect hash could be found.
+ */
+int cblt_buildWordHash(const unsigned char *wordtable,
+		const uint32_t *wordmap, size_t symbols, bool phrases,
+		uint16_t **pseeds, size_t *pnseeds, uint32_t **pslots,
+		size_t *pnslots) {
+	struct cblt_hashKey *keys;
+	size_t n;			/* number of unique words */
+	size_t buckets;
+	uint16_t *seeds;
+	uint32_t *slots;
+	int attempt;
+
+	keys = malloc(sizeof(struct cblt_hashKey) * symbols);
+	slots = malloc(sizeof(uint32_t) * symbols);
+	/* there will never be more buckets than this */
+	seeds = malloc(sizeof(uint16_t) * (symbols / CBLT_BUCKET_SIZE
+		+ CBLT_MAX_HASH_ATTEMPTS + 1));
+	if (keys == NULL || slots == NULL || seeds == NULL)
+		goto fail;
+
+	n = cblt_collectKeys(wordtable, wordmap, symbols, phrases, keys);
+	if (n == SIZE_MAX)
+		goto fail;
+	if (n == 0) {
+		buckets = 0;
+		goto done;
+	}
+
+	/* Every bucket count gives a completely different distribution of words
+	   into buckets, so if we get stuck, we can just try again with one more
+	   bucket. */
+	for (attempt = 0; attempt < CBLT_MAX_HASH_ATTEMPTS; ++attempt) {
+		buckets = n / CBLT_BUCKET_SIZE + 1 + attempt;
+		if (cblt_placeBuckets(keys, n, buckets, seeds, slots) == 0)
+			break;
+	}
+	if (attempt == CBLT_MAX_HASH_ATTEMPTS)
+		goto fail;
+
+done:
+	free(keys);
+	*pseeds = seeds;
+	*pnseeds = buckets;
+	*pslots = slots;
+	*pnslots = n;
+	return 0;
+
+fail:
+	free(keys);
+	free(slots);
+	free(seeds);
+	return -1;
+}
@@ -0,0 +1,25 @@
+/*
+ * buildhash.h
+ *
+ * contains the declarations of functions defined in buildhash.c
+ */
+
+#ifndef BUILDHASH_H
+#define BUILDHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* average number of words per bucket */
+#define CBLT_BUCKET_SIZE	4
+/* number of times we will retry with a different number of buckets before
+   giving up entirely */
+#define CBLT_MAX_HASH_ATTEMPTS	64
+
+int cblt_buildWordHash(const unsigned char *wordtable,
+		const uint32_t *wordmap, size_t symbols, bool phrases,
+		uint16_t **pseeds, size_t *pnseeds, uint32_t **pslots,
+		size_t *pnslots);
+
+#endif /* BUILDHASH_H */
@@ -0,0 +1,713 @@
+/*
+ * bytes.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for encoding sentences
+ * in the byte format, and decoding them again.
+ *
+ * A block of compressed data spends 2 bytes on every element, even on a
+ * single space or comma, and on "the". The byte format writes the same
+ * elements with a code of 1, 2 or 3 bytes each instead, picked so that the
+ * elements that appear most often in the block take the fewest bytes. Every
+ * code is a whole number of bytes, and its first byte alone tells what kind of
+ * code it is, so decoding one takes nothing more than a table lookup or two.
+ * The first byte of a code is one of:
+ *
+ * 	0x00:		the end of the block
+ * 	0x01:		a string literal, followed by its length in 1 byte, and then
+ * 	     		its characters
+ * 	0x02 to 0x04:	CBLT_NO_SPACE, CBLT_CAPITALIZE and CBLT_UPPERCASE
+ * 	0x05:		any other element, followed by its 16 bits, least
+ * 	     		significant first
+ * 	0x06:		a CBLT_NUMBER symbol, followed by its low byte, and then the
+ * 	     		value of the digits of each of its elements as a varint
+ * 	the next B:	the bytes injected directly that are listed in the header
+ * 	the next H:	the words that appear most often in the block
+ * 	the rest:	the first byte of a 2-byte code, whose second byte picks one of
+ * 	         	256 of the words that appear more than once, in the order
+ * 	         	they are listed in the header
+ *
+ * Those B bytes, H words and the rest of the words that get a 2-byte code are
+ * chosen for every block by counting its elements, and are listed in its
+ * header, so that the block can be decoded with nothing but the dictionary.
+ * A word that only appears once takes 3 bytes, which is 1 more than in a block
+ * of compressed data, but that is still less than listing it in the header.
+ * Runs of spaces, tabs and line breaks, then the small numbers, and then the
+ * CBLT_REPEAT symbols, are counted and listed just like words, as if they came
+ * right after the last word of the dictionary.
+ *
+ * A block in the byte format is laid out as follows, where every number is a
+ * varint, like in a packed block:
+ *
+ * 	format:		CBLT_BYTES_FORMAT, 1 byte
+ * 	symbols:	the number of symbols in the dictionary used
+ * 	B:		1 byte, then the B bytes, in increasing order
+ * 	H:		then the H words, in increasing order, each as the difference
+ * 	  		from the one before it, minus 1, and the first one minus 0x100
+ * 	T:		then the T words with a 2-byte code, the same way
+ * 	the codes:	up to and including the end of the block
+ *
+ * Decoding turns the codes back into a block of compressed data, which is then
+ * decoded as usual.
+ *
+ * Text that the dictionary doesn't help with, such as source code, logs, base64
+ * or text in another language, can come out bigger than it went in. When the
+ * codes take up more than half as many bytes as the text itself, the text is
+ * also compressed with the LZ77 coder in lz.c, and whichever is smaller is
+ * kept. If neither is smaller than the text, it is stored as it is, so that a
+ * block is never more than a few bytes bigger than its text. Such a block
+ * starts with a different first byte, followed by the length of the text as a
+ * varint, so that a block that was cut short is still refused, and then:
+ *
+ * 	CBLT_BYTES_STORED:	the text, up to the end of the block
+ * 	CBLT_BYTES_LZ:		the text as compressed by cblt_lzCompress(), up to
+ * 	              		the end of the block
+ *
+ * Neither of them depends on the dictionary.
+ */
+
+#include <stdlib.h>	/* malloc, calloc, realloc, free, qsort, size_t */
+#include <string.h>	/* memcpy, memchr */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+#include "bytes.h"
+#include "lz.h"
+#include "pack.h"
+#include "sentence.h"
+
+/* the first byte of every block in the byte format, which tells it apart from
+   other kinds of blocks, and would change along with the format */
+#define CBLT_BYTES_FORMAT	0xB5
+/* the first byte of a block that stores its text as it is, and of one that
+   compresses it with LZ77 */
+#define CBLT_BYTES_STORED	0xA0
+#define CBLT_BYTES_LZ		0xA1
+
+/* Before a text of at least 4 times CBLT_LZ_SAMPLE characters is compressed
+   with LZ77, only its first CBLT_LZ_SAMPLE characters are. */
+#define CBLT_LZ_SAMPLE		(16 * 1024)
+
+/* the codes that are the same in every block */
+#define CBLT_CODE_END			0x00
+#define CBLT_CODE_LITERAL		0x01
+#define CBLT_CODE_NO_SPACE		0x02
+#define CBLT_CODE_CAPITALIZE	0x03
+#define CBLT_CODE_UPPERCASE		0x04
+#define CBLT_CODE_ESCAPE		0x05
+#define CBLT_CODE_NUMBER		0x06
+#define CBLT_CODE_LISTED		0x07
+
+/* At most CBLT_MAX_BYTES bytes and CBLT_MAX_HOT words get a 1-byte code, so
+   that at least 2 first bytes are always left for the 2-byte codes. A word
+   must appear at least CBLT_MIN_LISTED times to be listed in the header. */
+#define CBLT_MAX_BYTES		119
+#define CBLT_MAX_HOT		128
+#define CBLT_MIN_LISTED		2
+
+/* the number of runs, which are numbered after the words, then the small
+   numbers, which are numbered after the runs, and then the CBLT_REPEAT
+   symbols, which are numbered after the small numbers */
+#define CBLT_RUN_SLOTS		(CBLT_LITERAL - CBLT_RUN_SPACES)
+#define CBLT_REPEAT_SLOTS	(CBLT_RUN_SLOTS + CBLT_SMALL_NUMBERS)
+#define CBLT_EXTRA_SLOTS	(CBLT_REPEAT_SLOTS + CBLT_REPEATS)
+
+/* Tells whether E is counted and listed like a word. */
+static inline bool cblt_isListable(size_t symbols, uint16_t e) {
+	return e < symbols || CBLT_IS_RUN(e) || CBLT_IS_SMALL_NUMBER(e)
+		|| CBLT_IS_REPEAT(e);
+}
+
+/* Returns the number that the word, run, small number or CBLT_REPEAT symbol
+   E is counted and listed under, for a dictionary of SYMBOLS symbols. */
+static inline size_t cblt_slotOf(size_t symbols, uint16_t e) {
+	if (e < symbols)
+		return e;
+	if (CBLT_IS_RUN(e))
+		return symbols + (e - CBLT_RUN_SPACES);
+	if (CBLT_IS_SMALL_NUMBER(e))
+		return symbols + CBLT_RUN_SLOTS + (e - CBLT_SMALL_NUMBER);
+	return symbols + CBLT_REPEAT_SLOTS + (e - CBLT_REPEAT);
+}
+
+/* Turns the number SLOT back into the element it is listed under, for a
+   dictionary of SYMBOLS symbols. */
+static inline uint16_t cblt_slotElement(size_t symbols, uint64_t slot) {
+	if (slot < symbols)
+		return (uint16_t)slot;
+	if (slot < symbols + CBLT_RUN_SLOTS)
+		return (uint16_t)(CBLT_RUN_SPACES + (slot - symbols));
+	if (slot < symbols + CBLT_REPEAT_SLOTS)
+		return (uint16_t)(CBLT_SMALL_NUMBER
+			+ (slot - symbols - CBLT_RUN_SLOTS));
+	return (uint16_t)(CBLT_REPEAT + (slot - symbols - CBLT_REPEAT_SLOTS));
+}
+
+/* orders packed counts and elements from largest to smallest */
+static int cblt_compareDescending(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x < y) - (x > y);
+}
+
+/* orders elements from smallest to largest */
+static int cblt_compareAscending(const void *a, const void *b) {
+	uint16_t x = *(const uint16_t *)a;
+	uint16_t y = *(const uint16_t *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Takes up to LIMIT elements off the front of the N elements at CANDIDATES,
+ * which are packed along with their counts and sorted from the largest count
+ * to the smallest, and stores them at OUT in increasing order. Returns the
+ * number of elements taken.
+ */
+static size_t cblt_pickLargest(uint64_t *candidates, size_t n, size_t limit,
+		uint16_t *out) {
+	size_t i;
+
+	if (n > limit)
+		n = limit;
+	for (i = 0; i < n; ++i)
+		out[i] = (uint16_t)(candidates[i] & 0xFFFF);
+	qsort(out, n, sizeof(uint16_t), cblt_compareAscending);
+	return n;
+}
+
+/* Writes the N words at WORDS to P as differences, and returns the byte after
+   them. */
+static unsigned char *cblt_putWords(unsigned char *p, const uint16_t *words,
+		size_t n) {
+	uint32_t next = 0x100;		/* the smallest the next word can be */
+	size_t i;
+
+	p = cblt_putVarint(p, n);
+	for (i = 0; i < n; ++i) {
+		p = cblt_putVarint(p, words[i] - next);
+		next = words[i] + 1;
+	}
+	return p;
+}
+
+/* Reads the N words written by cblt_putWords() after their number from *PP,
+   which must not go past END, into WORDS, turning the numbers of runs, small
+   numbers and CBLT_REPEAT symbols back into symbols. Returns false if any of
+   them isn't a word of a dictionary of SYMBOLS symbols or one of those, or
+   they aren't in increasing order. */
+static bool cblt_getWords(const unsigned char **pp, const unsigned char *end,
+		size_t symbols, uint16_t *words, size_t n) {
+	uint64_t delta;
+	uint64_t next = 0x100;		/* the smallest the next word can be */
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		if (!cblt_getVarint(pp, end, &delta)
+				|| delta >= symbols + CBLT_EXTRA_SLOTS - next)
+			return false;
+		next += delta;
+		words[i] = cblt_slotElement(symbols, next);
+		++next;
+	}
+	return true;
+}
+
+/*
+ * Writes the COUNT elements of COMPRESSED, which were encoded with DICT, in
+ * the byte format, into a newly allocated array of bytes, and stores its size
+ * in *PSIZE. Returns NULL if a string literal or a number in the block is
+ * empty or doesn't end before the block does, if a number holds more than its
+ * digits can, or if a memory allocation fails.
+ */
+unsigned char *cblt_toBytes(const cblt_dict *dict, const uint16_t *compressed,
+		size_t count, size_t *psize) {
+	uint32_t *codes;		/* the count, and then the code, of each element */
+	size_t slots;			/* the number of bytes, words, runs, small
+							   numbers and CBLT_REPEAT symbols */
+	uint64_t *candidates;	/* count in the upper bits, element in the lower */
+	uint16_t listed[256];	/* the bytes and words with a 1-byte code */
+	uint16_t *twoByte;		/* the words with a 2-byte code */
+	size_t nbytes, nhot, ntwo;
+	size_t n;
+	unsigned int first;		/* the first byte of the first 2-byte code */
+	unsigned char *bytes, *p;
+	unsigned char *shrunk;
+	size_t length;			/* characters in a string literal */
+	uint32_t code;
+	uint16_t e;
+	size_t i;
+
+	slots = dict->symbols + CBLT_EXTRA_SLOTS;
+	codes = calloc(slots, sizeof(uint32_t));
+	candidates = malloc(sizeof(uint64_t) * slots);
+	twoByte = malloc(sizeof(uint16_t) * slots);
+	bytes = malloc(64 + 3 * 256 + 3 * slots + 3 * count);
+	if (codes == NULL || candidates == NULL || twoByte == NULL
+			|| bytes == NULL)
+		goto fail;
+
+	for (i = 0; i < count; ++i) {
+		e = compressed[i];
+		if (CBLT_IS_LITERAL(e)) {
+			length = CBLT_LITERAL_LENGTH(e);
+			if (length == 0 || CBLT_LITERAL_ELEMENTS(length) >= count - i)
+				goto fail;
+			i += CBLT_LITERAL_ELEMENTS(length);
+		} else if (CBLT_IS_NUMBER(e)) {
+			if (!cblt_checkNumber(compressed, i, count))
+				goto fail;
+			i += CBLT_NUMBER_ELEMENTS(e);
+		} else if (cblt_isListable(dict->symbols, e)) {
+			++codes[cblt_slotOf(dict->symbols, e)];
+		}
+	}
+
+	/* every byte that appears gets a 1-byte code, as long as there is room */
+	n = 0;
+	for (e = 1; e < 0x100; ++e)
+		if (codes[e] != 0)
+			candidates[n++] = (uint64_t)codes[e] << 16 | e;
+	qsort(candidates, n, sizeof(uint64_t), cblt_compareDescending);
+	nbytes = cblt_pickLargest(candidates, n, CBLT_MAX_BYTES, listed);
+
+	/* and then the words, runs, small numbers and CBLT_REPEAT symbols, from
+	   the one that appears most often */
+	n = 0;
+	for (i = 0x100; i < slots; ++i)
+		if (codes[i] >= CBLT_MIN_LISTED)
+			candidates[n++] = (uint64_t)codes[i] << 16 | i;
+	qsort(candidates, n, sizeof(uint64_t), cblt_compareDescending);
+	nhot = cblt_pickLargest(candidates, n, CBLT_MAX_HOT, listed + nbytes);
+	first = CBLT_CODE_LISTED + nbytes + nhot;
+	ntwo = cblt_pickLargest(candidates + nhot, n - nhot,
+		(size_t)(0x100 - first) << 8, twoByte);
+
+	/* From here on, codes holds the code of every element, and 0 for those
+	   that are written out with CBLT_CODE_ESCAPE. A 2-byte code is kept in
+	   the order it is written, first byte first. */
+	memset(codes, 0, sizeof(uint32_t) * slots);
+	for (i = 0; i < nbytes + nhot; ++i)
+		codes[listed[i]] = CBLT_CODE_LISTED + i;
+	for (i = 0; i < ntwo; ++i)
+		codes[twoByte[i]] = (first + (i >> 8)) << 8 | (i & 0xFF);
+
+	p = bytes;
+	*p++ = CBLT_BYTES_FORMAT;
+	p = cblt_putVarint(p, dict->symbols);
+	*p++ = (unsigned char)nbytes;
+	for (i = 0; i < nbytes; ++i)
+		*p++ = (unsigned char)listed[i];
+	p = cblt_putWords(p, listed + nbytes, nhot);
+	p = cblt_putWords(p, twoByte, ntwo);
+
+	for (i = 0; i < count; ++i) {
+		e = compressed[i];
+		if (cblt_isListable(dict->symbols, e)
+				&& codes[cblt_slotOf(dict->symbols, e)] != 0) {
+			code = codes[cblt_slotOf(dict->symbols, e)];
+			if (code > 0xFF)
+				*p++ = (unsigned char)(code >> 8);
+			*p++ = (unsigned char)code;
+			continue;
+		}
+		if (CBLT_IS_LITERAL(e)) {
+			length = CBLT_LITERAL_LENGTH(e);
+			*p++ = CBLT_CODE_LITERAL;
+			*p++ = (unsigned char)length;
+			memcpy(p, compressed + i + 1, length);
+			p += length;
+			i += CBLT_LITERAL_ELEMENTS(length);
+			continue;
+		}
+		if (CBLT_IS_NUMBER(e)) {
+			*p++ = CBLT_CODE_NUMBER;
+			*p++ = (unsigned char)(e & 0xFF);
+			for (n = 0; n < CBLT_NUMBER_ELEMENTS(e); ++n)
+				p = cblt_putVarint(p, compressed[++i] - 1);
+			continue;
+		}
+		switch (e) {
+		case CBLT_NO_SPACE:
+			*p++ = CBLT_CODE_NO_SPACE;
+			break;
+		case CBLT_CAPITALIZE:
+			*p++ = CBLT_CODE_CAPITALIZE;
+			break;
+		case CBLT_UPPERCASE:
+			*p++ = CBLT_CODE_UPPERCASE;
+			break;
+		default:
+			*p++ = CBLT_CODE_ESCAPE;
+			*p++ = (unsigned char)(e & 0xFF);
+			*p++ = (unsigned char)(e >> 8);
+			break;
+		}
+	}
+	*p++ = CBLT_CODE_END;
+
+	free(codes);
+	free(candidates);
+	free(twoByte);
+	*psize = p - bytes;
+	shrunk = realloc(bytes, *psize);
+	return (shrunk != NULL) ? shrunk : bytes;
+
+fail:
+	free(codes);
+	free(candidates);
+	free(twoByte);
+	free(bytes);
+	return NULL;
+}
+
+/*
+ * Turns the SIZE bytes at BYTES, in the byte format, back into a newly
+ * allocated block of compressed data for DICT. Returns NULL if the bytes are
+ * damaged, if they were written for a dictionary of a different size, or if a
+ * memory allocation fails.
+ */
+uint16_t *cblt_fromBytes(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size) {
+	const unsigned char *p = bytes;
+	const unsigned char *end = bytes + size;
+	/* the element of every 1-byte code, or 0 for the first byte of a longer
+	   one */
+	uint16_t direct[256] = { 0 };
+	uint16_t *twoByte = NULL;
+	uint16_t *compressed = NULL;
+	uint64_t symbols, nhot, ntwo;
+	unsigned int nbytes;
+	unsigned int first;		/* the first byte of the first 2-byte code */
+	size_t code;			/* the index of a 2-byte code */
+	size_t length;			/* characters in a string literal */
+	uint64_t value;			/* the digits of an element of a number */
+	uint16_t number;		/* the CBLT_NUMBER symbol of a number */
+	size_t i, j = 0;
+
+	if (size < 1 || *p++ != CBLT_BYTES_FORMAT
+			|| !cblt_getVarint(&p, end, &symbols) || symbols != dict->symbols
+			|| p == end)
+		return NULL;
+
+	direct[CBLT_CODE_NO_SPACE] = CBLT_NO_SPACE;
+	direct[CBLT_CODE_CAPITALIZE] = CBLT_CAPITALIZE;
+	direct[CBLT_CODE_UPPERCASE] = CBLT_UPPERCASE;
+	nbytes = *p++;
+	if (nbytes > 0x100 - CBLT_CODE_LISTED || (size_t)(end - p) < nbytes)
+		return NULL;
+	for (i = 0; i < nbytes; ++i) {
+		/* in increasing order, so none of them is 0 but the first */
+		if (p[i] == 0 || (i > 0 && p[i] <= p[i - 1]))
+			return NULL;
+		direct[CBLT_CODE_LISTED + i] = p[i];
+	}
+	p += nbytes;
+
+	if (!cblt_getVarint(&p, end, &nhot)
+			|| nhot > 0x100 - CBLT_CODE_LISTED - nbytes
+			|| !cblt_getWords(&p, end, dict->symbols,
+				direct + CBLT_CODE_LISTED + nbytes, nhot))
+		return NULL;
+	first = CBLT_CODE_LISTED + nbytes + nhot;
+	if (!cblt_getVarint(&p, end, &ntwo)
+			|| ntwo > (uint64_t)(0x100 - first) << 8)
+		return NULL;
+	twoByte = malloc(sizeof(uint16_t) * ntwo + 1);
+	/* every code takes at least 1 byte, and gives at most 1 element per
+	   byte */
+	compressed = malloc(sizeof(uint16_t) * (end - p + 1));
+	if (twoByte == NULL || compressed == NULL
+			|| !cblt_getWords(&p, end, dict->symbols, twoByte, ntwo))
+		goto fail;
+
+	while (p < end) {
+		if (direct[*p] != 0) {
+			compressed[j++] = direct[*p++];
+		} else if (*p >= first) {
+			if (end - p < 2)
+				goto fail;
+			code = (size_t)(p[0] - first) << 8 | p[1];
+			if (code >= ntwo)
+				goto fail;
+			compressed[j++] = twoByte[code];
+			p += 2;
+		} else if (*p == CBLT_CODE_LITERAL) {
+			if (end - p < 2 || p[1] == 0 || (size_t)(end - p - 2) < p[1]
+					|| memchr(p + 2, '\0', p[1]) != NULL)
+				goto fail;
+			length = p[1];
+			p += 2;
+			compressed[j++] = (uint16_t)(CBLT_LITERAL + length);
+			/* an odd number of characters is padded with a null byte */
+			compressed[j + CBLT_LITERAL_ELEMENTS(length) - 1] = 0x0000;
+			memcpy(compressed + j, p, length);
+			j += CBLT_LITERAL_ELEMENTS(length);
+			p += length;
+		} else if (*p == CBLT_CODE_NUMBER) {
+			if (end - p < 2 || CBLT_NUMBER_DIGITS(p[1]) == 0)
+				goto fail;
+			number = (uint16_t)(CBLT_NUMBER + p[1]);
+			p += 2;
+			compressed[j++] = number;
+			for (i = 0; i < CBLT_NUMBER_ELEMENTS(number); ++i) {
+				if (!cblt_getVarint(&p, end, &value) || value
+						>= cblt_getChunkLimit(number,
+							cblt_getChunkDigits(number, i)))
+					goto fail;
+				compressed[j++] = (uint16_t)(value + 1);
+			}
+		} else if (*p == CBLT_CODE_ESCAPE) {
+			if (end - p < 3)
+				goto fail;
+			compressed[j] = p[1] | (uint16_t)p[2] << 8;
+			/* a string literal or a number always has a code of its
+			   own, and the literals of older blocks are never written in
+			   this format */
+			if (compressed[j] == 0 || CBLT_IS_LITERAL(compressed[j])
+					|| CBLT_IS_NUMBER(compressed[j])
+					|| compressed[j] == CBLT_BEGIN_STRING)
+				goto fail;
+			++j;
+			p += 3;
+		} else {
+			/* CBLT_CODE_END, or the code of a byte that isn't listed */
+			break;
+		}
+	}
+	/* the end of the block must be the last byte */
+	if (p == end || *p != CBLT_CODE_END || p + 1 != end)
+		goto fail;
+
+	compressed[j] = 0x0000;
+	free(twoByte);
+	return compressed;
+
+fail:
+	free(twoByte);
+	free(compressed);
+	return NULL;
+}
+
+/*
+ * Writes the LENGTH characters at SENTENCE to a newly allocated block with
+ * CBLT_BYTES_LZ, or with CBLT_BYTES_STORED if that is smaller, and stores its
+ * size in *PSIZE. Returns NULL if neither would take fewer than LIMIT bytes,
+ * or if a memory allocation fails.
+ */
+static unsigned char *cblt_encodeFallback(const char *sentence, size_t length,
+		size_t limit, size_t *psize) {
+	unsigned char *bytes, *p;
+	size_t header;
+	size_t capacity;		/* the most the LZ77 codes can take */
+	size_t sample;			/* the characters that are tried first */
+	size_t lz = 0;
+
+	/* the first byte and a varint of up to 64 bits */
+	bytes = malloc(1 + 10 + length);
+	if (bytes == NULL)
+		return NULL;
+	p = cblt_putVarint(bytes + 1, length);
+	header = (size_t)(p - bytes);
+
+	/* only worth it if it ends up smaller than both the stored text and the
+	   limit, and the positions in the text fit in 32 bits */
+	capacity = (limit <= header) ? 0
+		: (limit - header < length) ? limit - header : length;
+	if (capacity > 1 && length < UINT32_MAX) {
+		/* A long text is only compressed if the start of it comes out
+		   at least an eighth smaller than its share of the limit, so
+		   that the whole text isn't compressed for nothing when LZ77
+		   does about as well as the dictionary. */
+		sample = CBLT_LZ_SAMPLE;
+		if (length / 4 < sample
+				|| cblt_lzCompress(sentence, sample, p,
+					capacity / (length / sample) / 8 * 7) > 0)
+			lz = cblt_lzCompress(sentence, length, p, capacity - 1);
+	}
+
+	if (lz > 0) {
+		bytes[0] = CBLT_BYTES_LZ;
+		*psize = header + lz;
+	} else if (header + length < limit) {
+		bytes[0] = CBLT_BYTES_STORED;
+		memcpy(p, sentence, length);
+		*psize = header + length;
+	} else {
+		free(bytes);
+		return NULL;
+	}
+	return bytes;
+}
+
+
+/*
+ * Reads the length of the text of the SIZE bytes at BYTES, which start with
+ * CBLT_BYTES_STORED or CBLT_BYTES_LZ, into *PLENGTH. Returns where the rest of
+ * the block starts, or NULL if the length doesn't fit the block.
+ */
+static const unsigned char *cblt_getFallbackLength(const unsigned char *bytes,
+		size_t size, size_t *plength) {
+	const unsigned char *p = bytes + 1;
+	const unsigned char *end = bytes + size;
+	uint64_t length;
+
+	if (!cblt_getVarint(&p, end, &length)
+			|| (bytes[0] == CBLT_BYTES_STORED && length != (size_t)(end - p))
+			/* no match takes less than 1 byte per 255 characters */
+			|| length / 256 > size)
+		return NULL;
+	*plength = (size_t)length;
+	return p;
+}
+
+/*
+ * Writes the LENGTH characters of text that start at P, in the SIZE bytes at
+ * BYTES, which start with CBLT_BYTES_STORED or CBLT_BYTES_LZ, to OUT. Returns
+ * false if they are damaged.
+ */
+static bool cblt_expandFallback(const unsigned char *bytes, size_t size,
+		const unsigned char *p, char *out, size_t length) {
+	if (bytes[0] == CBLT_BYTES_STORED)
+		memcpy(out, p, length);
+	else if (!cblt_lzExpand(p, (size_t)(bytes + size - p), out, length))
+		return false;
+	/* the text of a sentence never has a null character in it */
+	return memchr(out, '\0', length) == NULL;
+}
+
+/*
+ * Decodes the SIZE bytes at BYTES, which start with CBLT_BYTES_STORED or
+ * CBLT_BYTES_LZ, into a newly allocated string. Returns NULL if they are
+ * damaged, or if a memory allocation fails.
+ */
+static char *cblt_decodeFallback(const unsigned char *bytes, size_t size) {
+	const unsigned char *p;
+	size_t length;
+	char *sentence;
+
+	p = cblt_getFallbackLength(bytes, size, &length);
+	if (p == NULL)
+		return NULL;
+	sentence = malloc(length + 1);
+	if (sentence == NULL)
+		return NULL;
+	if (!cblt_expandFallback(bytes, size, p, sentence, length)) {
+		free(sentence);
+		return NULL;
+	}
+	sentence[length] = '\0';
+	return sentence;
+}
+
+/*
+ * Encodes the LENGTH characters at S with DICT, which must not be NULL, in the
+ * byte format, into a newly allocated array of bytes, and stores its size in
+ * *PSIZE. Returns NULL if a memory allocation fails.
+ */
+unsigned char *cblt_encodeBytesRange(const cblt_dict *dict, const char *s,
+		size_t length, size_t *psize) {
+	uint16_t *compressed;
+	unsigned char *bytes;
+	unsigned char *fallback;
+	size_t fallbackSize;
+	size_t count;
+
+	compressed = cblt_encodeRange(dict, s, length, &count, NULL, 0, true);
+	if (compressed == NULL)
+		return NULL;
+	bytes = cblt_toBytes(dict, compressed, count, psize);
+	free(compressed);
+	if (bytes != NULL && *psize > length / 2) {
+		/* the dictionary didn't pay off much, so see if LZ77 or
+		   storing the text does better */
+		fallback = cblt_encodeFallback(s, length, *psize, &fallbackSize);
+		if (fallback != NULL) {
+			free(bytes);
+			bytes = fallback;
+			*psize = fallbackSize;
+		}
+	}
+	return bytes;
+}
+
+/*
+ * Decodes the SIZE bytes at BYTES, in the byte format, with DICT, which must
+ * not be NULL, into exactly LENGTH characters at OUT, followed by a null
+ * terminator. Returns false if the bytes are damaged, if they don't decode to
+ * exactly LENGTH characters, or if a memory allocation fails.
+ */
+bool cblt_decodeBytesInto(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size, char *out, size_t length) {
+	const unsigned char *p;
+	uint16_t *compressed;
+	size_t written;
+	bool decoded;
+
+	if (size > 0 && (bytes[0] == CBLT_BYTES_STORED
+			|| bytes[0] == CBLT_BYTES_LZ)) {
+		p = cblt_getFallbackLength(bytes, size, &written);
+		if (p == NULL || written != length
+				|| !cblt_expandFallback(bytes, size, p, out, length))
+			return false;
+		out[length] = '\0';
+		return true;
+	}
+
+	compressed = cblt_fromBytes(dict, bytes, size);
+	if (compressed == NULL)
+		return false;
+	decoded = cblt_decodeIntoDict(dict, compressed, out, length + 1, &written)
+		&& written == length + 1;
+	free(compressed);
+	return decoded;
+}
+
+
+/*
+ * Encodes SENTENCE with DICT in the byte format, into a newly allocated array
+ * of bytes, and stores its size in *PSIZE. See cobalt.h.
+ */
+unsigned char *cblt_encodeBytesDict(const cblt_dict *dict,
+		const char *sentence, size_t *psize) {
+	cblt_dict builtin;
+
+	if (sentence == NULL || psize == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+	return cblt_encodeBytesRange(dict, sentence, strlen(sentence), psize);
+}
+
+unsigned char *cblt_encodeBytes(const char *sentence, size_t *psize) {
+	return cblt_encodeBytesDict(NULL, sentence, psize);
+}
+
+/*
+ * Decodes the SIZE bytes at BYTES, in the byte format, with DICT, into a newly
+ * allocated string. See cobalt.h.
+ */
+char *cblt_decodeBytesDict(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size) {
+	uint16_t *compressed;
+	char *sentence;
+	cblt_dict builtin;
+
+	if (bytes == NULL)
+		return NULL;
+	if (size > 0 && (bytes[0] == CBLT_BYTES_STORED
+			|| bytes[0] == CBLT_BYTES_LZ))
+		return cblt_decodeFallback(bytes, size);
+	dict = cblt_useDict(dict, &builtin);
+
+	compressed = cblt_fromBytes(dict, bytes, size);
+	if (compressed == NULL)
+		return NULL;
+	sentence = cblt_decodeSentenceDict(dict, compressed);
+	free(compressed);
+	return sentence;
+}
+
+char *cblt_decodeBytes(const unsigned char *bytes, size_t size) {
+	return cblt_decodeBytesDict(NULL, bytes, size);
+}
@@ -0,0 +1,33 @@
+/*
+ * bytes.h
+ *
+ * contains the declarations of functions defined in bytes.c
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+
+#ifndef BYTES_H
+#define BYTES_H
+
+unsigned char *cblt_toBytes(const cblt_dict *dict, const uint16_t *compressed,
+		size_t count, size_t *psize);
+uint16_t *cblt_fromBytes(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size);
+unsigned char *cblt_encodeBytesRange(const cblt_dict *dict, const char *s,
+		size_t length, size_t *psize);
+bool cblt_decodeBytesInto(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size, char *out, size_t length);
+
+unsigned char *cblt_encodeBytes(const char *sentence, size_t *psize);
+unsigned char *cblt_encodeBytesDict(const cblt_dict *dict,
+		const char *sentence, size_t *psize);
+char *cblt_decodeBytes(const unsigned char *bytes, size_t size);
+char *cblt_decodeBytesDict(const cblt_dict *dict, const unsigned char *bytes,
+		size_t size);
+
+#endif  /* BYTES_H */
@@ -0,0 +1,15 @@
+/*
+ * crc.h
+ *
+ * contains the declaration of the function defined in crc.c
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef CRC_H
+#define CRC_H
+
+uint32_t cblt_crc32c(uint32_t crc, const void *data, size_t length);
+
+#endif  /* CRC_H */
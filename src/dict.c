@@ -0,0 +1,513 @@
+/*
+ * dict.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for building, loading
+ * and saving dictionaries. See dict.h for the format of a dictionary file.
+ *
+ * Where mmap() is available, a dictionary file is mapped read-only and used
+ * right where it is, so opening one costs next to nothing, and every process
+ * that opens the same file shares the same pages of memory. Anywhere else, the
+ * file is read into memory instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>	/* malloc, calloc, free, size_t */
+#include <string.h>	/* memcmp, memcpy, memset, strlen, strcspn */
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef CBLT_HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#ifdef CBLT_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "cobalt.h"
+#include "dict.h"
+#include "wordhash.h"
+#include "buildhash.h"
+#include "crc.h"
+
+/* The ID of the built-in dictionary is only worked out once, the first time
+   it is needed. */
+static uint32_t cblt_builtinId;
+#ifdef CBLT_HAVE_PTHREADS
+static pthread_once_t cblt_builtinIdOnce = PTHREAD_ONCE_INIT;
+#else
+static bool cblt_builtinIdKnown = false;
+#endif
+
+static void cblt_findBuiltinId(void) {
+	cblt_builtinId = cblt_crc32c(0, WORDTABLE, WORDTABLE_LEN);
+}
+
+void cblt_loadBuiltinDict(cblt_dict *builtin) {
+	builtin->wordtable = WORDTABLE;
+	builtin->wordtableLength = WORDTABLE_LEN;
+	builtin->wordmap = WORDMAP;
+	builtin->wordlen = WORDLEN;
+	builtin->phrasestart = PHRASESTART;
+	builtin->symbols = WORDMAP_LEN;
+	builtin->seeds = HASHSEEDS;
+	builtin->nseeds = HASHSEEDS_LEN;
+	builtin->slots = HASHSLOTS;
+	builtin->nslots = HASHSLOTS_LEN;
+	builtin->phraseseeds = PHRASESEEDS;
+	builtin->nphraseseeds = PHRASESEEDS_LEN;
+	builtin->phraseslots = PHRASESLOTS;
+	builtin->nphraseslots = PHRASESLOTS_LEN;
+	builtin->file = NULL;
+	builtin->fileLength = 0;
+	builtin->mapped = false;
+
+#ifdef CBLT_HAVE_PTHREADS
+	pthread_once(&cblt_builtinIdOnce, cblt_findBuiltinId);
+#else
+	if (!cblt_builtinIdKnown) {
+		cblt_findBuiltinId();
+		cblt_builtinIdKnown = true;
+	}
+#endif
+	builtin->id = cblt_builtinId;
+}
+
+/* Returns true if the section of N elements of SIZE bytes each at OFFSET lies
+   entirely within a file of LENGTH bytes, and is properly aligned. */
+static bool cblt_checkSection(uint64_t offset, uint64_t n, size_t size,
+		size_t length) {
+	if (offset % 8 != 0 || offset > length)
+		return false;
+	return n <= (length - offset) / size;
+}
+
+/* Returns true if every one of the NSLOTS slots of a perfect hash table holds
+   a real word of DICT, which the hash leads back to. */
+static bool cblt_checkSlots(const cblt_dict *dict, const uint16_t *seeds,
+		size_t nseeds, const uint32_t *slots, size_t nslots) {
+	size_t w;
+	uint32_t slot;
+	uint16_t w2;		/* the word stored in a slot */
+	uint64_t h;
+
+	for (w = 0; w < nslots; ++w) {
+		slot = slots[w];
+		w2 = CBLT_SLOT_WORD(slot);
+		if (w2 < 0x100 || w2 >= dict->symbols
+				|| CBLT_SLOT_LENGTH(slot) != dict->wordlen[w2])
+			return false;
+		h = cblt_hashWord((const char *)dict->wordtable + dict->wordmap[w2],
+			dict->wordlen[w2]);
+		if (cblt_hashSlot(h, seeds[cblt_hashBucket(h, nseeds)], nslots) != w)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Points DICT at the sections of the dictionary file that is already in
+ * memory at DICT->FILE, after checking that the file is well-formed. Every
+ * offset and length in the file is checked, so that a damaged or malicious
+ * file can never make the encoder or decoder read outside of it. Returns false
+ * if the file is not a valid dictionary.
+ */
+static bool cblt_readDictFile(cblt_dict *dict) {
+	const struct cblt_dictHeader *header = dict->file;
+	const unsigned char *base = dict->file;
+	size_t w;
+
+	if (dict->fileLength < sizeof(struct cblt_dictHeader)
+			|| memcmp(header->magic, CBLT_DICT_MAGIC, 8) != 0
+			|| header->version != CBLT_DICT_VERSION
+			|| header->byteOrder != CBLT_DICT_BYTE_ORDER)
+		return false;
+
+	/* Every word must have a symbol of its own, which doesn't collide with any
+	   of the special symbols. */
+	if (header->symbols < 0x100 || header->symbols > CBLT_MAX_SYMBOLS
+			|| header->wordtableLength == 0
+			|| header->nseeds == 0 || header->nslots == 0
+			|| !cblt_checkSection(header->wordmapOffset, header->symbols,
+				sizeof(uint32_t), dict->fileLength)
+			|| !cblt_checkSection(header->wordlenOffset, header->symbols,
+				sizeof(unsigned char), dict->fileLength)
+			|| !cblt_checkSection(header->phrasestartOffset, header->symbols,
+				sizeof(unsigned char), dict->fileLength)
+			|| !cblt_checkSection(header->wordtableOffset,
+				header->wordtableLength, sizeof(unsigned char),
+				dict->fileLength)
+			|| !cblt_checkSection(header->seedsOffset, header->nseeds,
+				sizeof(uint16_t), dict->fileLength)
+			|| !cblt_checkSection(header->slotsOffset, header->nslots,
+				sizeof(uint32_t), dict->fileLength)
+			|| (header->nphraseslots > 0 && header->nphraseseeds == 0)
+			|| !cblt_checkSection(header->phraseseedsOffset,
+				header->nphraseseeds, sizeof(uint16_t), dict->fileLength)
+			|| !cblt_checkSection(header->phraseslotsOffset,
+				header->nphraseslots, sizeof(uint32_t), dict->fileLength))
+		return false;
+
+	dict->wordtable = base + header->wordtableOffset;
+	dict->wordtableLength = header->wordtableLength;
+	dict->wordmap = (const uint32_t *)(base + header->wordmapOffset);
+	dict->wordlen = base + header->wordlenOffset;
+	dict->phrasestart = base + header->phrasestartOffset;
+	dict->symbols = header->symbols;
+	dict->seeds = (const uint16_t *)(base + header->seedsOffset);
+	dict->nseeds = header->nseeds;
+	dict->slots = (const uint32_t *)(base + header->slotsOffset);
+	dict->nslots = header->nslots;
+	dict->phraseseeds = (const uint16_t *)(base + header->phraseseedsOffset);
+	dict->nphraseseeds = header->nphraseseeds;
+	dict->phraseslots = (const uint32_t *)(base + header->phraseslotsOffset);
+	dict->nphraseslots = header->nphraseslots;
+
+	/* every word must lie within the word table, and have the length that
+	   WORDLEN says it has */
+	if (dict->wordtable[dict->wordtableLength - 1] != '\0')
+		return false;
+	for (w = 0; w < dict->symbols; ++w) {
+		if ((size_t)dict->wordmap[w] + dict->wordlen[w]
+					>= dict->wordtableLength
+				|| dict->wordtable[dict->wordmap[w] + dict->wordlen[w]]
+					!= '\0'
+				|| dict->phrasestart[w] > CBLT_MAX_PHRASE_WORDS
+				|| (dict->phrasestart[w] > 0 && dict->nphraseslots == 0))
+			return false;
+	}
+
+	dict->id = cblt_crc32c(0, dict->wordtable, dict->wordtableLength);
+	return cblt_checkSlots(dict, dict->seeds, dict->nseeds, dict->slots,
+			dict->nslots)
+		&& cblt_checkSlots(dict, dict->phraseseeds, dict->nphraseseeds,
+			dict->phraseslots, dict->nphraseslots);
+}
+
+cblt_dict *cblt_openDict(const char *path) {
+	cblt_dict *dict;
+#ifdef CBLT_HAVE_MMAP
+	int fd;
+	struct stat st;
+	void *file;
+#else
+	FILE *fp;
+	long length;
+#endif
+
+	if (path == NULL)
+		return NULL;
+	dict = malloc(sizeof(cblt_dict));
+	if (dict == NULL)
+		return NULL;
+	memset(dict, 0, sizeof(cblt_dict));
+
+#ifdef CBLT_HAVE_MMAP
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		free(dict);
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		free(dict);
+		return NULL;
+	}
+	file = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	/* the mapping stays valid after the file is closed */
+	close(fd);
+	if (file == MAP_FAILED) {
+		free(dict);
+		return NULL;
+	}
+	dict->file = file;
+	dict->fileLength = st.st_size;
+	dict->mapped = true;
+#else
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		free(dict);
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	rewind(fp);
+	/* malloc() returns memory that is aligned well enough for any section */
+	dict->file = (length > 0) ? malloc(length) : NULL;
+	if (dict->file == NULL
+			|| fread(dict->file, 1, length, fp) != (size_t)length) {
+		fclose(fp);
+		free(dict->file);
+		free(dict);
+		return NULL;
+	}
+	fclose(fp);
+	dict->fileLength = length;
+#endif
+
+	if (!cblt_readDictFile(dict)) {
+		cblt_closeDict(dict);
+		return NULL;
+	}
+	return dict;
+}
+
+void cblt_closeDict(cblt_dict *dict) {
+	if (dict == NULL)
+		return;
+#ifdef CBLT_HAVE_MMAP
+	if (dict->mapped)
+		munmap(dict->file, dict->fileLength);
+	else
+#endif
+		free(dict->file);
+	free(dict);
+}
+
+/* Returns OFFSET rounded up to the next multiple of 8. */
+static uint64_t cblt_alignSection(uint64_t offset) {
+	return (offset + 7) & ~(uint64_t)7;
+}
+
+/* Lays DICT out in the format of a dictionary file, in a newly allocated block
+   of memory whose length is stored in *PLENGTH. Returns NULL if a memory
+   allocation fails. */
+static void *cblt_packDict(const cblt_dict *dict, size_t *plength) {
+	struct cblt_dictHeader header;
+	unsigned char *file;
+	uint64_t length;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CBLT_DICT_MAGIC, 8);
+	header.version = CBLT_DICT_VERSION;
+	header.byteOrder = CBLT_DICT_BYTE_ORDER;
+	header.symbols = dict->symbols;
+	header.wordtableLength = dict->wordtableLength;
+	header.nseeds = dict->nseeds;
+	header.nslots = dict->nslots;
+	header.nphraseseeds = dict->nphraseseeds;
+	header.nphraseslots = dict->nphraseslots;
+
+	/* the sections go in order of decreasing alignment */
+	length = cblt_alignSection(sizeof(header));
+	header.wordmapOffset = length;
+	length = cblt_alignSection(length + sizeof(uint32_t) * dict->symbols);
+	header.slotsOffset = length;
+	length = cblt_alignSection(length + sizeof(uint32_t) * dict->nslots);
+	header.phraseslotsOffset = length;
+	length = cblt_alignSection(length + sizeof(uint32_t) * dict->nphraseslots);
+	header.seedsOffset = length;
+	length = cblt_alignSection(length + sizeof(uint16_t) * dict->nseeds);
+	header.phraseseedsOffset = length;
+	length = cblt_alignSection(length + sizeof(uint16_t) * dict->nphraseseeds);
+	header.wordlenOffset = length;
+	length = cblt_alignSection(length + dict->symbols);
+	header.phrasestartOffset = length;
+	length = cblt_alignSection(length + dict->symbols);
+	header.wordtableOffset = length;
+	length += dict->wordtableLength;
+
+	/* calloc() takes care of the padding between the sections */
+	file = calloc(length, 1);
+	if (file == NULL)
+		return NULL;
+	memcpy(file, &header, sizeof(header));
+	memcpy(file + header.wordmapOffset, dict->wordmap,
+		sizeof(uint32_t) * dict->symbols);
+	memcpy(file + header.slotsOffset, dict->slots,
+		sizeof(uint32_t) * dict->nslots);
+	memcpy(file + header.seedsOffset, dict->seeds,
+		sizeof(uint16_t) * dict->nseeds);
+	memcpy(file + header.phraseslotsOffset, dict->phraseslots,
+		sizeof(uint32_t) * dict->nphraseslots);
+	memcpy(file + header.phraseseedsOffset, dict->phraseseeds,
+		sizeof(uint16_t) * dict->nphraseseeds);
+	memcpy(file + header.wordlenOffset, dict->wordlen, dict->symbols);
+	memcpy(file + header.phrasestartOffset, dict->phrasestart,
+		dict->symbols);
+	memcpy(file + header.wordtableOffset, dict->wordtable,
+		dict->wordtableLength);
+
+	*plength = length;
+	return file;
+}
+
+bool cblt_saveDict(const cblt_dict *dict, const char *path) {
+	cblt_dict builtin;
+	void *file;
+	size_t length;
+	FILE *out;
+	bool ok;
+
+	if (path == NULL)
+		return false;
+	dict = cblt_useDict(dict, &builtin);
+
+	file = cblt_packDict(dict, &length);
+	if (file == NULL)
+		return false;
+	out = fopen(path, "wb");
+	if (out == NULL) {
+		free(file);
+		return false;
+	}
+
+	ok = fwrite(file, 1, length, out) == length;
+	if (fclose(out) != 0)
+		ok = false;
+	free(file);
+	return ok;
+}
+
+uint32_t cblt_getDictId(const cblt_dict *dict) {
+	cblt_dict builtin;
+
+	dict = cblt_useDict(dict, &builtin);
+	return dict->id;
+}
+
+/* Marks the first word of every phrase in TABLES with the number of words in
+   the longest phrase that begins with it, the same way construct_map.c does for
+   the built-in word list. A phrase is any entry made of 2 to
+   CBLT_MAX_PHRASE_WORDS words separated by single spaces, whose first words
+   are a phrase of their own. Any other entry with spaces in it is left alone,
+   since the encoder would never find it. */
+static void cblt_markPhrases(const cblt_dict *tables,
+		unsigned char *phrasestart) {
+	const char *str;
+	size_t w, i;
+	size_t first;		/* length of the first word of a phrase */
+	unsigned int words;
+	int32_t word;
+
+	memset(phrasestart, 0, tables->symbols);
+	for (w = 0x100; w < tables->symbols; ++w) {
+		str = (const char *)tables->wordtable + tables->wordmap[w];
+		first = strcspn(str, " ");
+		if (first == 0 || first == tables->wordlen[w])
+			continue;
+		for (i = first, words = 1; i < tables->wordlen[w]; ++i) {
+			if (str[i] != ' ')
+				continue;
+			/* an empty word means a space too many */
+			if (str[i + 1] == ' ' || str[i + 1] == '\0')
+				break;
+			if (words > 1 && cblt_findPhraseDict(tables, str, i) < 0)
+				break;
+			++words;
+		}
+		if (i < tables->wordlen[w] || words > CBLT_MAX_PHRASE_WORDS)
+			continue;
+		word = cblt_findWordDict(tables, str, first);
+		if (word != CBLT_WORD_NOT_FOUND && phrasestart[word] < words)
+			phrasestart[word] = words;
+	}
+}
+
+/*
+ * Lays out the COUNT words in WORDS the same way construct_map.c lays out the
+ * built-in word list, builds a perfect hash table over them, and packs it all
+ * into a dictionary that lives in memory. The word in WORDS[i] gets the symbol
+ * 0x100 + i.
+ */
+cblt_dict *cblt_createDict(const char *const *words, size_t count) {
+	cblt_dict tables;		/* the tables, before they are packed */
+	cblt_dict *dict;
+	unsigned char *wordtable = NULL;
+	uint32_t *wordmap = NULL;
+	unsigned char *wordlen = NULL;
+	unsigned char *phrasestart = NULL;
+	uint16_t *seeds = NULL;
+	uint32_t *slots = NULL;
+	uint16_t *phraseseeds = NULL;
+	uint32_t *phraseslots = NULL;
+	size_t length;
+	size_t i, j;
+
+	/* every word needs a symbol below the special symbols */
+	if (words == NULL || count == 0 || count > CBLT_MAX_SYMBOLS - 0x100)
+		return NULL;
+	dict = malloc(sizeof(cblt_dict));
+	if (dict == NULL)
+		return NULL;
+	memset(dict, 0, sizeof(cblt_dict));
+	memset(&tables, 0, sizeof(tables));
+	tables.symbols = count + 0x100;
+
+	/* the table ends with an extra null byte for the first 256 symbols to
+	   point to */
+	length = 1;
+	for (i = 0; i < count; ++i) {
+		if (words[i] == NULL || strlen(words[i]) > UINT8_MAX)
+			goto fail;
+		length += strlen(words[i]) + 1;
+	}
+	if (length > UINT32_MAX)
+		goto fail;
+	tables.wordtableLength = length;
+
+	wordtable = malloc(length);
+	wordmap = malloc(sizeof(uint32_t) * tables.symbols);
+	wordlen = malloc(tables.symbols);
+	phrasestart = malloc(tables.symbols);
+	if (wordtable == NULL || wordmap == NULL || wordlen == NULL
+			|| phrasestart == NULL)
+		goto fail;
+
+	for (i = 0; i < 0x100; ++i) {
+		wordmap[i] = length - 1;
+		wordlen[i] = 0;
+	}
+	for (i = 0, j = 0; i < count; ++i) {
+		wordmap[i + 0x100] = j;
+		wordlen[i + 0x100] = strlen(words[i]);
+		memcpy(wordtable + j, words[i], wordlen[i + 0x100] + 1);
+		j += wordlen[i + 0x100] + 1;
+	}
+	wordtable[j] = '\0';
+
+	if (cblt_buildWordHash(wordtable, wordmap, tables.symbols, false, &seeds,
+			&tables.nseeds, &slots, &tables.nslots) != 0
+			|| cblt_buildWordHash(wordtable, wordmap, tables.symbols, true,
+				&phraseseeds, &tables.nphraseseeds, &phraseslots,
+				&tables.nphraseslots) != 0)
+		goto fail;
+	tables.wordtable = wordtable;
+	tables.wordmap = wordmap;
+	tables.wordlen = wordlen;
+	tables.seeds = seeds;
+	tables.slots = slots;
+	tables.phraseseeds = phraseseeds;
+	tables.phraseslots = phraseslots;
+	cblt_markPhrases(&tables, phrasestart);
+	tables.phrasestart = phrasestart;
+
+	dict->file = cblt_packDict(&tables, &dict->fileLength);
+	if (dict->file == NULL || !cblt_readDictFile(dict))
+		goto fail;
+
+	free(wordtable);
+	free(wordmap);
+	free(wordlen);
+	free(phrasestart);
+	free(seeds);
+	free(slots);
+	free(phraseseeds);
+	free(phraseslots);
+	return dict;
+
+fail:
+	free(wordtable);
+	free(wordmap);
+	free(wordlen);
+	free(phrasestart);
+	free(seeds);
+	free(slots);
+	free(phraseseeds);
+	free(phraseslots);
+	cblt_closeDict(dict);
+	return NULL;
+}
@@ -0,0 +1,103 @@
+/*
+ * dict.h
+ *
+ * Contains the definition of a dictionary, and the declarations of the
+ * functions defined in dict.c.
+ *
+ * A dictionary is everything the encoder and decoder need to know about the
+ * word list: the words themselves, where each one starts and how long it is,
+ * which words begin a phrase, and the perfect hash table used to find them.
+ * The tables that are compiled into the library make up the built-in
+ * dictionary. Other dictionaries are loaded from files at runtime, in the
+ * format described below.
+ */
+
+#ifndef DICT_H
+#define DICT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+
+struct cblt_dict {
+	const unsigned char *wordtable;	/* null-separated words */
+	size_t wordtableLength;			/* including the final null byte */
+	const uint32_t *wordmap;		/* offset of each word in wordtable */
+	const unsigned char *wordlen;	/* length of each word */
+	const unsigned char *phrasestart;	/* see PHRASESTART */
+	size_t symbols;					/* elements in wordmap and wordlen */
+	const uint16_t *seeds;			/* HASHSEEDS */
+	size_t nseeds;
+	const uint32_t *slots;			/* HASHSLOTS */
+	size_t nslots;
+	const uint16_t *phraseseeds;	/* PHRASESEEDS */
+	size_t nphraseseeds;
+	const uint32_t *phraseslots;	/* PHRASESLOTS */
+	size_t nphraseslots;
+	uint32_t id;		/* the CRC-32C of wordtable, see cblt_getDictId() */
+
+	void *file;			/* contents of the dictionary file, if any */
+	size_t fileLength;
+	bool mapped;		/* whether file was mapped, or read into memory */
+};
+
+/*
+ * A dictionary file starts with this header, followed by the sections it
+ * points to. All numbers are stored in the byte order of the machine that
+ * wrote the file, just like the built-in tables, and a file written on a
+ * machine of the other byte order is rejected. Every section starts at a
+ * multiple of 8 bytes from the start of the file, so that the file can be used
+ * straight from memory once it is mapped.
+ *
+ * 	magic:		CBLT_DICT_MAGIC, not null-terminated
+ * 	version:	CBLT_DICT_VERSION
+ * 	byteOrder:	CBLT_DICT_BYTE_ORDER
+ * 	symbols:	number of elements in WORDMAP, WORDLEN and PHRASESTART,
+ * 	        	including the first 256 reserved elements
+ * 	the rest:	the length in elements and the offset in bytes of each section
+ */
+#define CBLT_DICT_MAGIC			"CBLTDICT"
+#define CBLT_DICT_VERSION		2
+#define CBLT_DICT_BYTE_ORDER	0x01020304
+
+struct cblt_dictHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t symbols;
+	uint64_t wordtableLength;
+	uint64_t nseeds;
+	uint64_t nslots;
+	uint64_t wordmapOffset;
+	uint64_t wordlenOffset;
+	uint64_t wordtableOffset;
+	uint64_t seedsOffset;
+	uint64_t slotsOffset;
+	uint64_t nphraseseeds;
+	uint64_t nphraseslots;
+	uint64_t phrasestartOffset;
+	uint64_t phraseseedsOffset;
+	uint64_t phraseslotsOffset;
+};
+
+/* Fills in BUILTIN with the tables compiled into the library. */
+void cblt_loadBuiltinDict(cblt_dict *builtin);
+
+/* Returns DICT, or BUILTIN filled in with the built-in dictionary if DICT is
+   NULL. This is how every function that takes a dictionary treats NULL. */
+static inline const cblt_dict *cblt_useDict(const cblt_dict *dict,
+		cblt_dict *builtin) {
+	if (dict != NULL)
+		return dict;
+	cblt_loadBuiltinDict(builtin);
+	return builtin;
+}
+
+/* Looks for the phrase of LEN characters at STR in DICT, and returns its
+   symbol or CBLT_WORD_NOT_FOUND. Defined in findword.c. */
+int32_t cblt_findPhraseDict(const cblt_dict *dict, const char *str,
+		size_t len);
+
+#endif /* DICT_H */
@@ -9,14 +9,11 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "cobalt.h"
-
-/*
- * TODO:
- * Instead of unfound first-2-character-pairs leading to the end of the
- * word list, have them point to the previous word. maybe?
- */
+#include "dict.h"
+#include "wordhash.h"
 
 /* This function is different from strcmp() in that it will ONLY tell us whether
    str1 and str2 point to identical strings. This gives us the power to simply
@@ -41,34 +38,58 @@ bool cblt_streq(const char *str1, const char *str2) {
    it's there just in case. Will return -1 if the string is not found. Returns
    which number word is the first match in the wordlist otherwise. */
 int32_t cblt_findWord(const char *str) {
-	uint16_t buf;
-	uint16_t word;
+	return cblt_findWordN(str, strlen(str));
+}
+
+/* Same as cblt_findWord(), but STR is LEN characters long and doesn't need to
+   be null-terminated. */
+int32_t cblt_findWordN(const char *str, size_t len) {
+	return cblt_findWordDict(NULL, str, len);
+}
+
+/* Looks for the word of LEN characters at STR in the perfect hash table made
+   of SEEDS and SLOTS. The word is hashed once, which leads us straight to the
+   only slot in the table where it could possibly be. All that's left to do is
+   check whether the word in that slot is actually the same word. */
+static inline int32_t cblt_findInHash(const cblt_dict *dict,
+		const uint16_t *seeds, size_t nseeds, const uint32_t *slots,
+		size_t nslots, const char *str, size_t len) {
+	uint64_t h;
+	uint32_t slot;
+
+	h = cblt_hashWord(str, len);
+	slot = slots[cblt_hashSlot(h, seeds[cblt_hashBucket(h, nseeds)], nslots)];
+
+	if (CBLT_SLOT_LENGTH(slot) == len
+			&& memcmp(str,
+				dict->wordtable + dict->wordmap[CBLT_SLOT_WORD(slot)],
+				len) == 0)
+		return CBLT_SLOT_WORD(slot);
+
+	return CBLT_WORD_NOT_FOUND;
+}
+
+/* Same as cblt_findWordN(), but looks in DICT. */
+int32_t cblt_findWordDict(const cblt_dict *dict, const char *str, size_t len) {
+	cblt_dict builtin;
 
 	/* Empty strings would break this function. */
-	if (str[0] == '\0') {
+	if (len == 0) {
 		/* Except they don't. */
 		return CBLT_EMPTY_WORD_ARG;
 	}
-	
-	/* word is initialized to the starting point of our search */
-	buf = *( (uint16_t *)str );
-	word = GUIDETABLE[buf];
-
-	/* Then set buf to the first word with the next set of first 2 characters.
-	   This way we don't seach all the way to the end of the word list if we
-	   don't have to. */
-	if (buf == 0xFFFF) {
-		/* We do this so that buf doesn't overflow from being incremented. */
-		/* Search until end of wordlist */
-		buf = WORDMAP_LEN;
-	} else {
-		buf = GUIDETABLE[buf + 1];
-	}
+	dict = cblt_useDict(dict, &builtin);
 
-	for ( ; word < buf; ++word) {
-		if (cblt_streq(str, WORDTABLE + WORDMAP[word]))
-			return word;
-	}
+	return cblt_findInHash(dict, dict->seeds, dict->nseeds, dict->slots,
+		dict->nslots, str, len);
+}
 
-	return CBLT_WORD_NOT_FOUND;
+/* Looks for a phrase in the table of phrases of DICT, which must not be NULL.
+   A dictionary without any phrases has an empty table. */
+int32_t cblt_findPhraseDict(const cblt_dict *dict, const char *str,
+		size_t len) {
+	if (dict->nphraseslots == 0)
+		return CBLT_WORD_NOT_FOUND;
+	return cblt_findInHash(dict, dict->phraseseeds, dict->nphraseseeds,
+		dict->phraseslots, dict->nphraseslots, str, len);
 }
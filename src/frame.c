@@ -0,0 +1,302 @@
+/*
+ * frame.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for encoding long text
+ * into frames, and for reading them back.
+ *
+ * A block of compressed data or in the byte format says nothing about itself:
+ * not which dictionary it needs, nor how long it is, nor how much text it
+ * holds. A frame cuts the text into blocks in the byte format, and puts a
+ * header in front of all of them, and in front of each one, so that a reader
+ * can tell what it is, skip to any block, allocate room for all of the text,
+ * and check every block, only by reading the headers. A frame is laid out as
+ * follows, where every number is unsigned and least significant byte first:
+ *
+ * 	magic:		the 4 characters "CBLF"
+ * 	version:	1 byte, CBLT_FRAME_VERSION
+ * 	flags:		1 byte, CBLT_FRAME_CRC if the blocks have checksums
+ * 	dictionary:	the ID of the dictionary, in 4 bytes
+ * 	blocks:		the number of blocks, in 4 bytes
+ * 	length:		the number of characters in all of the text, in 8 bytes
+ *
+ * and then, for every block:
+ *
+ * 	size:		the size of the block, in 4 bytes
+ * 	length:		the number of characters in the block, in 4 bytes
+ * 	checksum:	the CRC-32C of the block, in 4 bytes, only if the frame has
+ * 	         	checksums
+ * 	block:		the block, in the byte format
+ *
+ * Blocks are cut right after a space or line break, so that no word is split
+ * between 2 of them, as long as there is one at most 1/8 of the block size
+ * past where the cut should be.
+ */
+
+#include <stdlib.h>	/* malloc, realloc, free, size_t */
+#include <string.h>	/* memcpy, memcmp, strlen */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+#include "bytes.h"
+#include "crc.h"
+#include "frame.h"
+
+#define CBLT_FRAME_VERSION	1
+
+/* the sizes of the header of a frame, and of the header of each block with and
+   without a checksum */
+#define CBLT_FRAME_HEADER	22
+#define CBLT_BLOCK_HEADER	8
+#define CBLT_BLOCK_CRC		4
+
+/* the largest block size, which leaves room for the 1/8 a block may run over
+   and for the bytes the byte format adds, in a 4-byte size */
+#define CBLT_MAX_BLOCK_SIZE	((size_t)1 << 30)
+
+static const unsigned char CBLT_FRAME_MAGIC[4] = { 'C', 'B', 'L', 'F' };
+
+static void cblt_putUint32(unsigned char *p, uint32_t v) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t cblt_getUint32(const unsigned char *p) {
+	return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+		| (uint32_t)p[3] << 24;
+}
+
+/* Returns the number of characters from START, at most LENGTH, that go in the
+   block that starts there, for blocks of BLOCKSIZE characters. */
+static size_t cblt_cutBlock(const char *start, size_t length,
+		size_t blockSize) {
+	size_t limit;
+	size_t i;
+
+	if (length <= blockSize)
+		return length;
+	limit = blockSize + blockSize / 8;
+	if (limit > length)
+		limit = length;
+	for (i = blockSize; i < limit; ++i) {
+		if ((start[i - 1] == ' ' || start[i - 1] == '\n')
+				&& start[i] != ' ' && start[i] != '\n')
+			return i;
+	}
+	return blockSize;
+}
+
+unsigned char *cblt_encodeFrame(const char *sentence, size_t blockSize,
+		unsigned int flags, size_t *psize) {
+	return cblt_encodeFrameDict(NULL, sentence, blockSize, flags, psize);
+}
+
+unsigned char *cblt_encodeFrameDict(const cblt_dict *dict,
+		const char *sentence, size_t blockSize, unsigned int flags,
+		size_t *psize) {
+	cblt_dict builtin;
+	unsigned char *frame;
+	unsigned char *grown;
+	unsigned char *bytes = NULL;
+	size_t capacity;
+	size_t size;		/* bytes of the frame written so far */
+	size_t header;		/* size of the header of each block */
+	size_t length;
+	size_t start, n;
+	size_t blockBytes;
+	uint32_t blocks = 0;
+
+	if (sentence == NULL || psize == NULL || blockSize > CBLT_MAX_BLOCK_SIZE
+			|| (flags & ~(unsigned int)CBLT_FRAME_CRC) != 0)
+		return NULL;
+	if (blockSize == 0)
+		blockSize = CBLT_DEFAULT_BLOCK_SIZE;
+	dict = cblt_useDict(dict, &builtin);
+	header = CBLT_BLOCK_HEADER + ((flags & CBLT_FRAME_CRC) ? CBLT_BLOCK_CRC
+		: 0);
+	length = strlen(sentence);
+	/* blocks that make the text smaller, and their headers, mostly fit in
+	   this much */
+	capacity = CBLT_FRAME_HEADER + length / 2 + header + 64;
+	frame = malloc(capacity);
+	if (frame == NULL)
+		return NULL;
+
+	size = CBLT_FRAME_HEADER;
+	for (start = 0; start < length; start += n) {
+		n = cblt_cutBlock(sentence + start, length - start, blockSize);
+		bytes = cblt_encodeBytesRange(dict, sentence + start, n, &blockBytes);
+		if (bytes == NULL || blocks == UINT32_MAX)
+			goto fail;
+		if (capacity - size < header + blockBytes) {
+			capacity = 2 * capacity + header + blockBytes;
+			grown = realloc(frame, capacity);
+			if (grown == NULL)
+				goto fail;
+			frame = grown;
+		}
+		cblt_putUint32(frame + size, (uint32_t)blockBytes);
+		cblt_putUint32(frame + size + 4, (uint32_t)n);
+		if (flags & CBLT_FRAME_CRC)
+			cblt_putUint32(frame + size + CBLT_BLOCK_HEADER,
+				cblt_crc32c(0, bytes, blockBytes));
+		memcpy(frame + size + header, bytes, blockBytes);
+		free(bytes);
+		size += header + blockBytes;
+		++blocks;
+	}
+
+	memcpy(frame, CBLT_FRAME_MAGIC, sizeof(CBLT_FRAME_MAGIC));
+	frame[4] = CBLT_FRAME_VERSION;
+	frame[5] = (unsigned char)flags;
+	cblt_putUint32(frame + 6, dict->id);
+	cblt_putUint32(frame + 10, blocks);
+	cblt_putUint32(frame + 14, (uint32_t)length);
+	cblt_putUint32(frame + 18, (uint32_t)((uint64_t)length >> 32));
+	*psize = size;
+	return frame;
+
+fail:
+	free(bytes);
+	free(frame);
+	return NULL;
+}
+
+/*
+ * Reads the header of the SIZE bytes at FRAME into *INFO, and checks that the
+ * headers of all of its blocks add up to it, without reading the blocks. If
+ * PBLOCK isn't NULL, stores block number N in *PBLOCK along the way. Returns
+ * false if FRAME isn't a frame, or if it was cut short or damaged.
+ */
+static bool cblt_readFrame(const unsigned char *frame, size_t size,
+		cblt_frameInfo *info, size_t n, cblt_frameBlock *pblock) {
+	const unsigned char *p;
+	const unsigned char *end;
+	size_t header;
+	size_t blocks;
+	uint64_t length;
+	uint64_t total = 0;
+	cblt_frameBlock block;
+
+	if (frame == NULL || size < CBLT_FRAME_HEADER
+			|| memcmp(frame, CBLT_FRAME_MAGIC, sizeof(CBLT_FRAME_MAGIC)) != 0
+			|| frame[4] != CBLT_FRAME_VERSION
+			|| (frame[5] & ~CBLT_FRAME_CRC) != 0)
+		return false;
+	info->crc = (frame[5] & CBLT_FRAME_CRC) != 0;
+	info->dictId = cblt_getUint32(frame + 6);
+	info->blocks = cblt_getUint32(frame + 10);
+	length = cblt_getUint32(frame + 14)
+		| (uint64_t)cblt_getUint32(frame + 18) << 32;
+	if (length > SIZE_MAX - 1)
+		return false;
+	info->decodedLength = (size_t)length;
+	if (pblock != NULL && n >= info->blocks)
+		return false;
+
+	header = CBLT_BLOCK_HEADER + (info->crc ? CBLT_BLOCK_CRC : 0);
+	p = frame + CBLT_FRAME_HEADER;
+	end = frame + size;
+	for (blocks = 0; blocks < info->blocks; ++blocks) {
+		if ((size_t)(end - p) < header)
+			return false;
+		block.size = cblt_getUint32(p);
+		block.decodedOffset = (size_t)total;
+		block.decodedLength = cblt_getUint32(p + 4);
+		block.crc = info->crc ? cblt_getUint32(p + CBLT_BLOCK_HEADER) : 0;
+		block.bytes = p + header;
+		/* every block has at least 1 byte and 1 character */
+		if (block.size == 0 || block.size > (size_t)(end - block.bytes)
+				|| block.decodedLength == 0)
+			return false;
+		total += block.decodedLength;
+		if (total > length)
+			return false;
+		if (pblock != NULL && blocks == n)
+			*pblock = block;
+		p = block.bytes + block.size;
+	}
+	return p == end && total == length;
+}
+
+bool cblt_getFrameInfo(const unsigned char *frame, size_t size,
+		cblt_frameInfo *info) {
+	if (info == NULL)
+		return false;
+	return cblt_readFrame(frame, size, info, 0, NULL);
+}
+
+bool cblt_getFrameBlock(const unsigned char *frame, size_t size, size_t n,
+		cblt_frameBlock *block) {
+	cblt_frameInfo info;
+
+	if (block == NULL)
+		return false;
+	return cblt_readFrame(frame, size, &info, n, block);
+}
+
+bool cblt_verifyFrame(const unsigned char *frame, size_t size) {
+	cblt_frameInfo info;
+	const unsigned char *p;
+	size_t blockBytes, n;
+
+	if (!cblt_readFrame(frame, size, &info, 0, NULL))
+		return false;
+	if (!info.crc)
+		return true;
+	p = frame + CBLT_FRAME_HEADER;
+	for (n = 0; n < info.blocks; ++n) {
+		blockBytes = cblt_getUint32(p);
+		if (cblt_crc32c(0, p + CBLT_BLOCK_HEADER + CBLT_BLOCK_CRC,
+				blockBytes) != cblt_getUint32(p + CBLT_BLOCK_HEADER))
+			return false;
+		p += CBLT_BLOCK_HEADER + CBLT_BLOCK_CRC + blockBytes;
+	}
+	return true;
+}
+
+char *cblt_decodeFrame(const unsigned char *frame, size_t size) {
+	return cblt_decodeFrameDict(NULL, frame, size);
+}
+
+char *cblt_decodeFrameDict(const cblt_dict *dict, const unsigned char *frame,
+		size_t size) {
+	cblt_dict builtin;
+	cblt_frameInfo info;
+	const unsigned char *p;
+	size_t header;
+	size_t blockBytes, n;
+	size_t decoded = 0;
+	uint32_t crc;
+	char *sentence;
+
+	dict = cblt_useDict(dict, &builtin);
+	if (!cblt_readFrame(frame, size, &info, 0, NULL)
+			|| info.dictId != dict->id)
+		return NULL;
+	sentence = malloc(info.decodedLength + 1);
+	if (sentence == NULL)
+		return NULL;
+
+	/* the headers were all checked, so they can be trusted from here on */
+	header = CBLT_BLOCK_HEADER + (info.crc ? CBLT_BLOCK_CRC : 0);
+	p = frame + CBLT_FRAME_HEADER;
+	for (n = 0; n < info.blocks; ++n) {
+		blockBytes = cblt_getUint32(p);
+		crc = info.crc ? cblt_getUint32(p + CBLT_BLOCK_HEADER) : 0;
+		if ((info.crc && cblt_crc32c(0, p + header, blockBytes) != crc)
+				|| !cblt_decodeBytesInto(dict, p + header, blockBytes,
+					sentence + decoded, cblt_getUint32(p + 4))) {
+			free(sentence);
+			return NULL;
+		}
+		decoded += cblt_getUint32(p + 4);
+		p += header + blockBytes;
+	}
+	sentence[decoded] = '\0';
+	return sentence;
+}
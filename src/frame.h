@@ -0,0 +1,29 @@
+/*
+ * frame.h
+ *
+ * contains the declarations of functions defined in frame.c
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+
+#ifndef FRAME_H
+#define FRAME_H
+
+unsigned char *cblt_encodeFrame(const char *sentence, size_t blockSize,
+		unsigned int flags, size_t *psize);
+unsigned char *cblt_encodeFrameDict(const cblt_dict *dict,
+		const char *sentence, size_t blockSize, unsigned int flags,
+		size_t *psize);
+char *cblt_decodeFrame(const unsigned char *frame, size_t size);
+char *cblt_decodeFrameDict(const cblt_dict *dict, const unsigned char *frame,
+		size_t size);
+bool cblt_getFrameInfo(const unsigned char *frame, size_t size,
+		cblt_frameInfo *info);
+bool cblt_getFrameBlock(const unsigned char *frame, size_t size, size_t n,
+		cblt_frameBlock *block);
+bool cblt_verifyFrame(const unsigned char *frame, size_t size);
+
+#endif  /* FRAME_H */
@@ -0,0 +1,210 @@
+/*
+ * lz.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for compressing text
+ * that the dictionary doesn't help with, such as source code, logs or text in
+ * another language, with a simple LZ77 coder.
+ *
+ * The text is written as a series of sequences, each of which is some
+ * characters copied as they are, followed by a match: a copy of characters
+ * that came up earlier, at most CBLT_LZ_WINDOW characters back. A sequence is
+ * laid out as follows:
+ *
+ * 	token:		1 byte, whose upper 4 bits are the number of characters copied
+ * 	      		as they are, and whose lower 4 bits are the length of the
+ * 	      		match minus CBLT_LZ_MIN_MATCH. If either one is 15, the rest
+ * 	      		of it follows in bytes that are added to it, up to and
+ * 	      		including the first byte that isn't 255.
+ * 	characters:	the characters copied as they are
+ * 	offset:		how far back the match starts, in 2 bytes, least
+ * 	       		significant first
+ * 	length:		the rest of the length of the match, if there is any
+ *
+ * The last sequence has no match, and ends right after its characters. The
+ * encoder finds matches with a hash table of the last position at which each
+ * group of CBLT_LZ_MIN_MATCH characters came up, and skips ahead faster the
+ * longer it goes without finding one, so that text with nothing to find is
+ * given up on quickly.
+ */
+
+#include <stdlib.h>	/* calloc, free, size_t */
+#include <string.h>	/* memcpy, memcmp */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lz.h"
+
+/* A match is at least CBLT_LZ_MIN_MATCH characters long, and starts at most
+   CBLT_LZ_WINDOW characters back. */
+#define CBLT_LZ_MIN_MATCH	4
+#define CBLT_LZ_WINDOW		0xFFFF
+
+/* the hash table has 2^CBLT_LZ_HASH_BITS entries */
+#define CBLT_LZ_HASH_BITS	14
+
+/* Returns the hash of the CBLT_LZ_MIN_MATCH characters at P. */
+static inline uint32_t cblt_lzHash(const char *p) {
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return (v * 2654435761u) >> (32 - CBLT_LZ_HASH_BITS);
+}
+
+/* Writes the part of a length of N that didn't fit in its token to P, and
+   returns the end of what was written. */
+static unsigned char *cblt_lzPutLength(unsigned char *p, size_t n) {
+	while (n >= 255) {
+		*p++ = 255;
+		n -= 255;
+	}
+	*p++ = (unsigned char)n;
+	return p;
+}
+
+/* Reads the part of a length that didn't fit in its token from *PP, up to
+   END, and adds it to *PN. Returns false if the input ends first. */
+static bool cblt_lzGetLength(const unsigned char **pp,
+		const unsigned char *end, size_t *pn) {
+	const unsigned char *p = *pp;
+
+	do {
+		if (p == end)
+			return false;
+		*pn += *p;
+	} while (*p++ == 255);
+	*pp = p;
+	return true;
+}
+
+/*
+ * Writes the sequence of the LITERALS characters at FROM, followed by a match
+ * of LENGTH characters OFFSET back if LENGTH isn't 0, to *PP, which must not
+ * go past END. Returns false if it doesn't fit.
+ */
+static bool cblt_lzPutSequence(unsigned char **pp, unsigned char *end,
+		const char *from, size_t literals, size_t offset, size_t length) {
+	unsigned char *p = *pp;
+	unsigned char *token;
+	size_t extra = (length > 0) ? length - CBLT_LZ_MIN_MATCH : 0;
+
+	/* the most that the token, lengths and offset could take */
+	if ((size_t)(end - p) < 1 + literals + literals / 255 + 1 + 2
+			+ extra / 255 + 1)
+		return false;
+
+	token = p++;
+	*token = (unsigned char)((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15)
+		p = cblt_lzPutLength(p, literals - 15);
+	memcpy(p, from, literals);
+	p += literals;
+
+	if (length > 0) {
+		*token |= (unsigned char)(extra < 15 ? extra : 15);
+		*p++ = (unsigned char)(offset & 0xFF);
+		*p++ = (unsigned char)(offset >> 8);
+		if (extra >= 15)
+			p = cblt_lzPutLength(p, extra - 15);
+	}
+	*pp = p;
+	return true;
+}
+
+/*
+ * Compresses the LENGTH characters at IN into OUT, which has room for
+ * CAPACITY bytes. Returns the number of bytes written, or 0 if they didn't
+ * fit, or if a memory allocation fails.
+ */
+size_t cblt_lzCompress(const char *in, size_t length, unsigned char *out,
+		size_t capacity) {
+	uint32_t *table;		/* 1 more than the last position of each hash */
+	const char *end = in + length;
+	const char *anchor = in;	/* the first character not yet written */
+	const char *p = in;
+	const char *candidate;
+	unsigned char *o = out;
+	unsigned char *oend = out + capacity;
+	size_t misses = 0;		/* positions tried since the last match */
+	size_t matched;
+	uint32_t h;
+
+	table = calloc((size_t)1 << CBLT_LZ_HASH_BITS, sizeof(uint32_t));
+	if (table == NULL)
+		return 0;
+
+	while (end - p >= CBLT_LZ_MIN_MATCH) {
+		h = cblt_lzHash(p);
+		candidate = (table[h] != 0) ? in + table[h] - 1 : NULL;
+		table[h] = (uint32_t)(p - in) + 1;
+		if (candidate == NULL || p - candidate > CBLT_LZ_WINDOW
+				|| memcmp(candidate, p, CBLT_LZ_MIN_MATCH) != 0) {
+			p += 1 + (misses++ >> 5);
+			continue;
+		}
+
+		matched = CBLT_LZ_MIN_MATCH;
+		while (p + matched < end && candidate[matched] == p[matched])
+			++matched;
+		if (!cblt_lzPutSequence(&o, oend, anchor, (size_t)(p - anchor),
+				(size_t)(p - candidate), matched)) {
+			free(table);
+			return 0;
+		}
+		p += matched;
+		anchor = p;
+		misses = 0;
+	}
+
+	free(table);
+	if (!cblt_lzPutSequence(&o, oend, anchor, (size_t)(end - anchor), 0, 0))
+		return 0;
+	return (size_t)(o - out);
+}
+
+/*
+ * Expands the SIZE bytes at IN, which were written by cblt_lzCompress(), into
+ * exactly LENGTH characters at OUT. Returns false if they are damaged, or
+ * don't come out to exactly LENGTH characters.
+ */
+bool cblt_lzExpand(const unsigned char *in, size_t size, char *out,
+		size_t length) {
+	const unsigned char *p = in;
+	const unsigned char *end = in + size;
+	char *o = out;
+	char *oend = out + length;
+	size_t literals, matched, offset;
+	const char *from;
+
+	while (p < end) {
+		literals = *p >> 4;
+		matched = *p & 0x0F;
+		++p;
+		if (literals == 15 && !cblt_lzGetLength(&p, end, &literals))
+			return false;
+		if ((size_t)(end - p) < literals || (size_t)(oend - o) < literals)
+			return false;
+		memcpy(o, p, literals);
+		o += literals;
+		p += literals;
+		if (p == end)
+			/* the last sequence, which has no match */
+			return o == oend;
+
+		if (end - p < 2)
+			return false;
+		offset = p[0] | (size_t)p[1] << 8;
+		p += 2;
+		if (matched == 15 && !cblt_lzGetLength(&p, end, &matched))
+			return false;
+		matched += CBLT_LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t)(o - out)
+				|| (size_t)(oend - o) < matched)
+			return false;
+		/* one at a time, since the match may overlap what it writes */
+		for (from = o - offset; matched > 0; --matched)
+			*o++ = *from++;
+	}
+	/* the last sequence is missing */
+	return false;
+}
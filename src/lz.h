@@ -0,0 +1,18 @@
+/*
+ * lz.h
+ *
+ * contains the declarations of functions defined in lz.c
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#ifndef LZ_H
+#define LZ_H
+
+size_t cblt_lzCompress(const char *in, size_t length, unsigned char *out,
+		size_t capacity);
+bool cblt_lzExpand(const unsigned char *in, size_t size, char *out,
+		size_t length);
+
+#endif  /* LZ_H */
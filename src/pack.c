@@ -0,0 +1,1059 @@
+/*
+ * pack.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for packing a block of
+ * compressed data into fewer bytes with an entropy coder, and unpacking it
+ * again.
+ *
+ * Every element of a compressed block takes 16 bits, even though a handful of
+ * words, spaces and punctuation marks make up most of any text. A packed block
+ * sorts the elements into a few hundred classes, and codes the classes with
+ * rANS (range asymmetric numeral systems), so that the most frequent ones only
+ * take a few bits. The classes are:
+ *
+ * 	1 to 255:	a byte injected directly, one class each
+ * 	the next 5:	CBLT_LITERAL, CBLT_NO_SPACE, CBLT_CAPITALIZE,
+ * 	           	CBLT_UPPERCASE, and any other special symbol, which is followed
+ * 	           	by its 16 bits as they are
+ * 	the next 1024:	the runs of spaces, tabs and line breaks, one class each
+ * 	the next 3:	the small numbers of 1, 2 and 3 digits, followed by the
+ * 	           	number as raw bits
+ * 	the next 256:	the CBLT_NUMBER symbols, one class each, followed by the
+ * 	             	value of each element of digits as raw bits
+ * 	the next 256:	the CBLT_REPEAT symbols, one class each
+ * 	the next K:	the K words that appear most often in the block, one class each
+ * 	the rest:	every other word, in buckets by its rank in the dictionary,
+ * 	         	followed by its place in the bucket as raw bits
+ *
+ * A trained dictionary numbers its words from most to least frequent, so the
+ * buckets get wider further down the dictionary: ranks 0 to 15 get a bucket
+ * each, and after that, every power of 2 is split into 4 buckets. The words of
+ * the built-in dictionary are sorted by their first 2 characters instead, so
+ * most of them land in the last few buckets, and it is the words with a class
+ * of their own that do most of the work. Every class is followed by
+ * its raw bits, even when it has none, so that the decoder never has to
+ * branch on it. The characters of a string literal are coded one at a time
+ * with a model of their own, followed by a null character that tells where
+ * the literal ends, which is cheaper than coding its length.
+ *
+ * The frequencies of both models are counted over the whole block, scaled so
+ * that they add up to CBLT_RANS_TOTAL, and stored in the header of the packed
+ * block, so unpacking needs nothing but the block and the dictionary. 4 rANS
+ * states take turns coding the classes, the raw bits and the characters, which
+ * lets the decoder work on 4 of them at once.
+ *
+ * A packed block is laid out as follows, where every number is a varint of 7
+ * bits per byte, least significant first:
+ *
+ * 	magic:		CBLT_PACK_MAGIC, not null-terminated
+ * 	version:	CBLT_PACK_VERSION, 1 byte
+ * 	method:		CBLT_PACK_STORED or CBLT_PACK_RANS, 1 byte
+ * 	elements:	the number of elements, NOT including the null terminator
+ * 	symbols:	the number of symbols in the dictionary used
+ *
+ * With CBLT_PACK_STORED, every element follows in 2 bytes, least significant
+ * first, except for the characters of a string literal, which are stored as
+ * they are in memory. With CBLT_PACK_RANS, what follows is:
+ *
+ * 	K, then the K words that have a class of their own, in increasing order,
+ * 	each as the difference from the one before it, minus 1
+ * 	the frequencies of the element classes, then of the characters
+ * 	the 4 final rANS states, 4 bytes each, least significant first
+ * 	the rANS stream, up to the end of the block
+ *
+ * Every frequency is a varint, except that a frequency of 0 is followed by the
+ * number of classes right after it whose frequency is also 0. Either way, the
+ * packed block doesn't depend on the byte order of the machine.
+ *
+ * A block is only packed with CBLT_PACK_RANS if it comes out smaller that way,
+ * and if every string literal in it is written just like the encoder writes
+ * it, with no null characters and a null byte as padding. The CBLT_BEGIN_STRING
+ * literals of older blocks are packed element by element, like anything else
+ * the packer doesn't know about.
+ */
+
+#include <stdlib.h>	/* malloc, calloc, free, qsort, size_t */
+#include <string.h>	/* memcpy, memcmp, memchr */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+#include "pack.h"
+#include "sentence.h"
+
+#define CBLT_PACK_MAGIC		"CBLP"
+#define CBLT_PACK_VERSION	5
+#define CBLT_PACK_STORED	0
+#define CBLT_PACK_RANS		1
+
+/* The frequencies of a model add up to CBLT_RANS_TOTAL. A rANS state is kept
+   between CBLT_RANS_LOW and 256 times that, and is written out a byte at a
+   time to stay there. */
+#define CBLT_RANS_BITS		12
+#define CBLT_RANS_TOTAL		(1u << CBLT_RANS_BITS)
+#define CBLT_RANS_LOW		(1u << 23)
+#define CBLT_RANS_STATES	4
+
+/* the classes of elements that aren't bytes */
+#define CBLT_CLASS_LITERAL		0x100
+#define CBLT_CLASS_NO_SPACE		0x101
+#define CBLT_CLASS_CAPITALIZE	0x102
+#define CBLT_CLASS_UPPERCASE	0x103
+#define CBLT_CLASS_OTHER		0x104
+#define CBLT_CLASS_RUNS			0x105
+#define CBLT_RUN_CLASSES		(CBLT_LITERAL - CBLT_RUN_SPACES)
+#define CBLT_CLASS_SMALL		(CBLT_CLASS_RUNS + CBLT_RUN_CLASSES)
+#define CBLT_CLASS_NUMBERS		(CBLT_CLASS_SMALL + 3)
+#define CBLT_CLASS_REPEATS		(CBLT_CLASS_NUMBERS + 0x100)
+#define CBLT_CLASS_WORDS		(CBLT_CLASS_REPEATS + CBLT_REPEATS)
+
+/* the first small number of 1, 2 and 3 digits, and the raw bits that tell
+   the numbers of each apart */
+static const uint16_t CBLT_SMALL_BASE[] = { 0, 10, 110 };
+static const uint8_t CBLT_SMALL_BITS[] = { 4, 7, 10 };
+static const uint16_t CBLT_SMALL_COUNT[] = { 10, 100, 1000 };
+
+/* A word that appears at least CBLT_MIN_DIRECT times gets a class of its own,
+   up to CBLT_MAX_DIRECT words. Ranks up to 0xFFFF fit in CBLT_MAX_BUCKETS
+   buckets. */
+#define CBLT_MIN_DIRECT		4
+#define CBLT_MAX_DIRECT		256
+#define CBLT_MAX_BUCKETS	(16 + 12 * 4)
+#define CBLT_MAX_CLASSES	(CBLT_CLASS_WORDS + CBLT_MAX_DIRECT \
+	+ CBLT_MAX_BUCKETS)
+
+/* the most bytes the header of a packed block can take */
+#define CBLT_MAX_HEADER	(32 + 3 * CBLT_MAX_DIRECT + 3 * CBLT_MAX_CLASSES \
+	+ 3 * 256)
+
+/* the scaled frequencies of the classes of a model, and where each starts */
+typedef struct cblt_model {
+	size_t n;			/* number of classes */
+	uint32_t total;		/* either 0 or CBLT_RANS_TOTAL */
+	uint16_t freq[CBLT_MAX_CLASSES];
+	uint16_t start[CBLT_MAX_CLASSES];
+} cblt_model;
+
+/* a class, some raw bits or a character, ready to be coded */
+typedef struct cblt_event {
+	uint16_t start;
+	uint16_t freq;
+	uint8_t bits;		/* the frequencies add up to 2^bits */
+} cblt_event;
+
+/* what follows the element of a class, which the decoder has to read or
+   check before the next class */
+#define CBLT_FOLLOW_NOTHING	0
+#define CBLT_FOLLOW_OTHER	1	/* nothing, but the element must be checked */
+#define CBLT_FOLLOW_NUMBER	2	/* the digits of a number */
+#define CBLT_FOLLOW_LITERAL	3	/* the characters of a string literal */
+
+/* Everything the decoder needs to know about a slot of the class model, so
+   that one lookup takes it from the state to the element. */
+typedef struct cblt_slot {
+	/* the frequency of the class in the upper 16 bits, and the distance of
+	   the slot from the start of the class in the lower 16 bits */
+	uint32_t step;
+	uint16_t base;		/* the first element of the class */
+	uint16_t last;		/* the last element of the class, minus 1 */
+	uint8_t bits;		/* raw bits after the class */
+	uint8_t follow;		/* one of CBLT_FOLLOW_* */
+} cblt_slot;
+
+/* everything the decoder needs to turn a class back into an element */
+typedef struct cblt_unpacker {
+	cblt_model classes;
+	cblt_model chars;
+	cblt_slot classSlot[CBLT_RANS_TOTAL];
+	/* For every slot of the character model, the character it belongs to,
+	   and the same step as in a cblt_slot. */
+	unsigned char charSlot[CBLT_RANS_TOTAL];
+	uint32_t charStep[CBLT_RANS_TOTAL];
+	uint16_t base[CBLT_MAX_CLASSES];	/* the first element of a class */
+	uint8_t bits[CBLT_MAX_CLASSES];		/* raw bits after a class */
+	uint32_t limit[CBLT_MAX_CLASSES];	/* 1 more than the last element */
+} cblt_unpacker;
+
+/* Returns the bucket of the word of rank RANK, and stores the number of raw
+   bits that tell the words in it apart in *PBITS. */
+static unsigned int cblt_rankBucket(uint32_t rank, unsigned int *pbits) {
+	unsigned int e = 4;		/* rank is between 2^e and 2^(e + 1) */
+
+	if (rank < 16) {
+		*pbits = 0;
+		return rank;
+	}
+	while (rank >> (e + 1) != 0)
+		++e;
+	*pbits = e - 2;
+	return 16 + (e - 4) * 4 + ((rank >> (e - 2)) & 3);
+}
+
+/* Returns the first rank in BUCKET, and stores the number of raw bits after
+   it in *PBITS. */
+static uint32_t cblt_bucketBase(unsigned int bucket, unsigned int *pbits) {
+	unsigned int e;
+
+	if (bucket < 16) {
+		*pbits = 0;
+		return bucket;
+	}
+	e = 4 + (bucket - 16) / 4;
+	*pbits = e - 2;
+	return (uint32_t)(4 + (bucket - 16) % 4) << (e - 2);
+}
+
+/* Returns the number of buckets needed for the words of a dictionary with
+   SYMBOLS symbols. */
+static unsigned int cblt_countBuckets(size_t symbols) {
+	unsigned int bits;
+
+	if (symbols <= 0x100)
+		return 0;
+	return cblt_rankBucket(symbols - 0x100 - 1, &bits) + 1;
+}
+
+/* Returns the class of the special symbol SYMBOL, other than a string
+   literal. */
+static unsigned int cblt_specialClass(uint16_t symbol) {
+	switch (symbol) {
+	case CBLT_NO_SPACE:
+		return CBLT_CLASS_NO_SPACE;
+	case CBLT_CAPITALIZE:
+		return CBLT_CLASS_CAPITALIZE;
+	case CBLT_UPPERCASE:
+		return CBLT_CLASS_UPPERCASE;
+	}
+	if (CBLT_IS_RUN(symbol))
+		return CBLT_CLASS_RUNS + (symbol - CBLT_RUN_SPACES);
+	if (CBLT_IS_SMALL_NUMBER(symbol))
+		return CBLT_CLASS_SMALL + (symbol >= CBLT_SMALL_NUMBER + 10)
+			+ (symbol >= CBLT_SMALL_NUMBER + 110);
+	if (CBLT_IS_NUMBER(symbol))
+		return CBLT_CLASS_NUMBERS + (symbol & 0xFF);
+	if (CBLT_IS_REPEAT(symbol))
+		return CBLT_CLASS_REPEATS + CBLT_REPEAT_SLOT(symbol);
+	return CBLT_CLASS_OTHER;
+}
+
+/* Returns the number of raw bits that element K of the number SYMBOL is
+   coded with, and stores 1 more than the largest value it can hold in
+   *PLIMIT. */
+static unsigned int cblt_chunkBits(uint16_t symbol, size_t k,
+		uint32_t *plimit) {
+	unsigned int bits = 0;
+
+	*plimit = cblt_getChunkLimit(symbol, cblt_getChunkDigits(symbol, k));
+	while ((1u << bits) < *plimit)
+		++bits;
+	return bits;
+}
+
+/*
+ * Checks the string literal of LENGTH characters that start at element I of
+ * the COUNT elements of COMPRESSED. Returns false if it is empty, if it
+ * doesn't end before element COUNT, or if it has a null character in it or
+ * isn't padded the way the encoder pads it.
+ */
+static bool cblt_checkLiteral(const uint16_t *compressed, size_t i,
+		size_t count, size_t length) {
+	const unsigned char *chars = (const unsigned char *)(compressed + i);
+
+	if (length == 0 || CBLT_LITERAL_ELEMENTS(length) > count - i
+			|| memchr(chars, '\0', length) != NULL)
+		return false;
+	return length % 2 == 0 || chars[length] == '\0';
+}
+
+/*
+ * Scales the N counts at COUNTS so that they add up to CBLT_RANS_TOTAL, and
+ * stores them in MODEL. Every class that was counted at least once keeps a
+ * frequency of at least 1. If nothing was counted, every frequency is 0.
+ */
+static void cblt_scaleCounts(const uint32_t *counts, size_t n,
+		cblt_model *model) {
+	uint64_t total = 0;
+	uint32_t sum = 0;
+	uint32_t excess;
+	size_t i, largest = 0;
+
+	model->n = n;
+	for (i = 0; i < n; ++i)
+		total += counts[i];
+	for (i = 0; i < n; ++i) {
+		model->freq[i] = 0;
+		if (counts[i] == 0)
+			continue;
+		model->freq[i] = (uint16_t)(counts[i] * (uint64_t)CBLT_RANS_TOTAL
+			/ total);
+		if (model->freq[i] == 0)
+			model->freq[i] = 1;
+		sum += model->freq[i];
+		if (model->freq[i] > model->freq[largest])
+			largest = i;
+	}
+	model->total = (total == 0) ? 0 : CBLT_RANS_TOTAL;
+	if (total == 0)
+		return;
+
+	/* Rounding down leaves some of the total over, which goes to the most
+	   frequent class. Rounding rare classes up to 1 can overshoot instead,
+	   which is taken back from the most frequent classes. */
+	if (sum <= CBLT_RANS_TOTAL) {
+		model->freq[largest] += CBLT_RANS_TOTAL - sum;
+	} else {
+		excess = sum - CBLT_RANS_TOTAL;
+		while (excess > 0) {
+			largest = 0;
+			for (i = 1; i < n; ++i)
+				if (model->freq[i] > model->freq[largest])
+					largest = i;
+			i = model->freq[largest] / 2;
+			if (i > excess)
+				i = excess;
+			model->freq[largest] -= i;
+			excess -= i;
+		}
+	}
+
+	sum = 0;
+	for (i = 0; i < n; ++i) {
+		model->start[i] = sum;
+		sum += model->freq[i];
+	}
+}
+
+/* Writes V to P as a varint, and returns the byte after it. */
+unsigned char *cblt_putVarint(unsigned char *p, uint64_t v) {
+	while (v >= 0x80) {
+		*p++ = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+/* Reads a varint from *PP, which must not go past END, into *PV. Returns
+   false if it doesn't fit. */
+bool cblt_getVarint(const unsigned char **pp, const unsigned char *end,
+		uint64_t *pv) {
+	const unsigned char *p = *pp;
+	uint64_t v = 0;
+	unsigned int shift;
+
+	for (shift = 0; shift < 64; shift += 7) {
+		if (p == end)
+			return false;
+		v |= (uint64_t)(*p & 0x7F) << shift;
+		if ((*p++ & 0x80) == 0) {
+			*pp = p;
+			*pv = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+static unsigned char *cblt_putFreqs(unsigned char *p,
+		const cblt_model *model) {
+	size_t i, run;
+
+	for (i = 0; i < model->n; ++i) {
+		p = cblt_putVarint(p, model->freq[i]);
+		if (model->freq[i] != 0)
+			continue;
+		for (run = 0; i + 1 < model->n && model->freq[i + 1] == 0; ++i)
+			++run;
+		p = cblt_putVarint(p, run);
+	}
+	return p;
+}
+
+/* Reads the frequencies of the N classes of MODEL from *PP, which must not go
+   past END. Returns false if they don't add up. */
+static bool cblt_getFreqs(const unsigned char **pp, const unsigned char *end,
+		cblt_model *model, size_t n) {
+	uint64_t freq, run;
+	uint32_t sum = 0;
+	size_t i;
+
+	model->n = n;
+	for (i = 0; i < n; ++i) {
+		if (!cblt_getVarint(pp, end, &freq) || freq > CBLT_RANS_TOTAL - sum)
+			return false;
+		model->start[i] = sum;
+		model->freq[i] = (uint16_t)freq;
+		sum += freq;
+		if (freq != 0)
+			continue;
+		if (!cblt_getVarint(pp, end, &run) || run >= n - i)
+			return false;
+		for ( ; run > 0; --run) {
+			++i;
+			model->start[i] = sum;
+			model->freq[i] = 0;
+		}
+	}
+
+	model->total = sum;
+	return sum == 0 || sum == CBLT_RANS_TOTAL;
+}
+
+static unsigned char *cblt_putHeader(unsigned char *p, int method,
+		size_t count, size_t symbols) {
+	memcpy(p, CBLT_PACK_MAGIC, 4);
+	p += 4;
+	*p++ = CBLT_PACK_VERSION;
+	*p++ = (unsigned char)method;
+	p = cblt_putVarint(p, count);
+	return cblt_putVarint(p, symbols);
+}
+
+/* Codes EV into the rANS state *X, writing bytes backwards from *PP. */
+static inline void cblt_ransPut(uint32_t *x, unsigned char **pp,
+		const cblt_event *ev) {
+	uint32_t max = ((CBLT_RANS_LOW >> ev->bits) << 8) * ev->freq;
+
+	while (*x >= max) {
+		*--*pp = (unsigned char)*x;
+		*x >>= 8;
+	}
+	*x = ((*x / ev->freq) << ev->bits) + (*x % ev->freq) + ev->start;
+}
+
+/*
+ * Brings the rANS state *X back up to CBLT_RANS_LOW with bytes from *PP, which
+ * must not go past END. Returns false if the stream ends too early.
+ *
+ * No event is coded with more than 16 bits, so a state never needs more than 2
+ * bytes to get back up. As long as 2 bytes are left, they are read without a
+ * loop or a branch, and only as many of them as needed are used.
+ */
+static inline bool cblt_ransRenorm(uint32_t *x, const unsigned char **pp,
+		const unsigned char *end) {
+	const unsigned char *p = *pp;
+	unsigned int n;		/* the number of bytes needed */
+
+	if (end - p >= 2) {
+		n = (*x < CBLT_RANS_LOW) + (*x < (CBLT_RANS_LOW >> 8));
+		*x = (*x << (8 * n)) | ((uint32_t)(p[0] << 8 | p[1]) >> (16 - 8 * n));
+		*pp = p + n;
+		return true;
+	}
+	while (*x < CBLT_RANS_LOW) {
+		if (*pp == end)
+			return false;
+		*x = (*x << 8) | *(*pp)++;
+	}
+	return true;
+}
+
+/* Passes the turn to the next rANS state, so that X0 is always the one whose
+   turn it is. Unlike indexing an array of states, this keeps them all in
+   registers. */
+#define CBLT_RANS_ROTATE(x0, x1, x2, x3)	do { \
+		uint32_t rotated = x0; \
+		x0 = x1; \
+		x1 = x2; \
+		x2 = x3; \
+		x3 = rotated; \
+	} while (0)
+
+/* Writes the COUNT elements of COMPRESSED to P in 2 bytes each, the way
+   CBLT_PACK_STORED stores them, and returns the end of what was written. */
+unsigned char *cblt_putStored(unsigned char *p, const uint16_t *compressed,
+		size_t count) {
+	size_t literal = 0;		/* elements left in the current string literal */
+	size_t i;
+
+	for (i = 0; i < count; ++i) {
+		if (literal > 0) {
+			memcpy(p, &compressed[i], 2);
+			--literal;
+		} else {
+			p[0] = (unsigned char)compressed[i];
+			p[1] = (unsigned char)(compressed[i] >> 8);
+			if (CBLT_IS_LITERAL(compressed[i]))
+				literal = CBLT_LITERAL_ELEMENTS(
+					CBLT_LITERAL_LENGTH(compressed[i]));
+		}
+		p += 2;
+	}
+	return p;
+}
+
+/* Packs the COUNT elements of COMPRESSED with CBLT_PACK_STORED. */
+static unsigned char *cblt_packStored(const uint16_t *compressed,
+		size_t count, size_t symbols, size_t *psize) {
+	unsigned char *packed;
+	unsigned char *p;
+
+	packed = malloc(32 + 2 * count);
+	if (packed == NULL)
+		return NULL;
+
+	p = cblt_putHeader(packed, CBLT_PACK_STORED, count, symbols);
+	p = cblt_putStored(p, compressed, count);
+	*psize = p - packed;
+	return packed;
+}
+
+/* orders packed counts and words from largest to smallest */
+static int cblt_compareDescending(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x < y) - (x > y);
+}
+
+/*
+ * Picks the words of DICT that get a class of their own, out of the counts at
+ * WORDCOUNTS, and stores them at DIRECT in increasing order. Returns the
+ * number of words picked, or SIZE_MAX if a memory allocation fails.
+ */
+static size_t cblt_pickDirect(const cblt_dict *dict,
+		const uint32_t *wordCounts, uint16_t *direct) {
+	uint64_t *candidates;	/* count in the upper bits, word in the lower */
+	size_t n = 0, picked;
+	size_t w, i;
+
+	candidates = malloc(sizeof(uint64_t) * dict->symbols);
+	if (candidates == NULL)
+		return SIZE_MAX;
+	for (w = 0x100; w < dict->symbols; ++w)
+		if (wordCounts[w] >= CBLT_MIN_DIRECT)
+			candidates[n++] = (uint64_t)wordCounts[w] << 16 | w;
+	qsort(candidates, n, sizeof(uint64_t), cblt_compareDescending);
+
+	picked = (n < CBLT_MAX_DIRECT) ? n : CBLT_MAX_DIRECT;
+	for (i = 0; i < picked; ++i)
+		candidates[i] &= 0xFFFF;
+	qsort(candidates, picked, sizeof(uint64_t), cblt_compareDescending);
+	/* the words are wanted in increasing order */
+	for (i = 0; i < picked; ++i)
+		direct[i] = (uint16_t)candidates[picked - 1 - i];
+
+	free(candidates);
+	return picked;
+}
+
+/*
+ * Packs the COUNT elements of COMPRESSED with CBLT_PACK_RANS. Returns NULL if
+ * the packed block wouldn't be smaller than LIMIT bytes, if the block can't be
+ * packed this way, or if a memory allocation fails.
+ */
+static unsigned char *cblt_packRans(const cblt_dict *dict,
+		const uint16_t *compressed, size_t count, size_t limit,
+		size_t *psize) {
+	uint32_t classCounts[CBLT_MAX_CLASSES] = { 0 };
+	uint32_t charCounts[256] = { 0 };
+	uint32_t *wordCounts = NULL;	/* how often each word appears */
+	uint16_t *classOf = NULL;		/* the class of each word */
+	uint16_t direct[CBLT_MAX_DIRECT];
+	size_t ndirect = 0;
+	unsigned int buckets;
+	cblt_model *models = NULL;		/* the classes, then the characters */
+	cblt_event *events = NULL;
+	size_t nevents = 0;
+	unsigned char header[CBLT_MAX_HEADER];
+	unsigned char *stream = NULL;	/* the rANS stream, written backwards */
+	size_t streamSize;
+	unsigned char *packed = NULL;
+	unsigned char *p;
+	uint32_t states[CBLT_RANS_STATES];
+	const unsigned char *chars;
+	unsigned char ch;
+	size_t length;
+	size_t i, j, w;
+	unsigned int c, bits;
+	uint32_t chunkLimit;	/* the values an element of a number can hold */
+	uint16_t e;
+
+	buckets = cblt_countBuckets(dict->symbols);
+	wordCounts = calloc(dict->symbols, sizeof(uint32_t));
+	classOf = malloc(sizeof(uint16_t) * dict->symbols);
+	models = malloc(sizeof(cblt_model) * 2);
+	/* every element is a class and its raw bits, and a literal is never
+	   more than 2 characters per element, plus the null character at its
+	   end */
+	events = malloc(sizeof(cblt_event) * (3 * count + 1));
+	if (wordCounts == NULL || classOf == NULL || models == NULL
+			|| events == NULL)
+		goto done;
+
+	/* count every class */
+	for (i = 0; i < count; ) {
+		e = compressed[i++];
+		if (e < 0x100) {
+			++classCounts[e];
+		} else if (e < dict->symbols) {
+			++wordCounts[e];
+		} else if (CBLT_IS_LITERAL(e)) {
+			++classCounts[CBLT_CLASS_LITERAL];
+			length = CBLT_LITERAL_LENGTH(e);
+			if (!cblt_checkLiteral(compressed, i, count, length))
+				goto done;
+			chars = (const unsigned char *)(compressed + i);
+			for (j = 0; j < length; ++j)
+				++charCounts[chars[j]];
+			++charCounts[0];
+			i += CBLT_LITERAL_ELEMENTS(length);
+		} else if (CBLT_IS_NUMBER(e)) {
+			if (!cblt_checkNumber(compressed, i - 1, count))
+				goto done;
+			++classCounts[cblt_specialClass(e)];
+			i += CBLT_NUMBER_ELEMENTS(e);
+		} else {
+			++classCounts[cblt_specialClass(e)];
+		}
+	}
+
+	ndirect = cblt_pickDirect(dict, wordCounts, direct);
+	if (ndirect == SIZE_MAX)
+		goto done;
+	for (w = 0x100; w < dict->symbols; ++w) {
+		if (wordCounts[w] == 0)
+			continue;
+		classOf[w] = CBLT_CLASS_WORDS + ndirect
+			+ cblt_rankBucket(w - 0x100, &bits);
+	}
+	for (i = 0; i < ndirect; ++i)
+		classOf[direct[i]] = CBLT_CLASS_WORDS + i;
+	for (w = 0x100; w < dict->symbols; ++w)
+		if (wordCounts[w] != 0)
+			classCounts[classOf[w]] += wordCounts[w];
+	cblt_scaleCounts(classCounts, CBLT_CLASS_WORDS + ndirect + buckets,
+		&models[0]);
+	cblt_scaleCounts(charCounts, 256, &models[1]);
+
+	/* then turn every element into events */
+	for (i = 0; i < count; ) {
+		e = compressed[i++];
+		if (e < 0x100)
+			c = e;
+		else if (e < dict->symbols)
+			c = classOf[e];
+		else if (CBLT_IS_LITERAL(e))
+			c = CBLT_CLASS_LITERAL;
+		else
+			c = cblt_specialClass(e);
+		events[nevents].start = models[0].start[c];
+		events[nevents].freq = models[0].freq[c];
+		events[nevents++].bits = CBLT_RANS_BITS;
+
+		/* Every class is followed by its raw bits, even if there are
+		   none, so that the decoder doesn't have to tell them apart. */
+		events[nevents].start = 0;
+		events[nevents].freq = 1;
+		events[nevents].bits = 0;
+		if (c >= CBLT_CLASS_WORDS + ndirect) {
+			/* the place of the word in its bucket */
+			cblt_rankBucket(e - 0x100, &bits);
+			events[nevents].start = (e - 0x100) & ((1u << bits) - 1);
+			events[nevents].bits = bits;
+		} else if (c == CBLT_CLASS_OTHER) {
+			events[nevents].start = e;
+			events[nevents].bits = 16;
+		} else if (c >= CBLT_CLASS_SMALL && c < CBLT_CLASS_NUMBERS) {
+			/* the place of the number among those of as many digits */
+			events[nevents].start = e - CBLT_SMALL_NUMBER
+				- CBLT_SMALL_BASE[c - CBLT_CLASS_SMALL];
+			events[nevents].bits = CBLT_SMALL_BITS[c - CBLT_CLASS_SMALL];
+		}
+		++nevents;
+
+		if (c >= CBLT_CLASS_NUMBERS && c < CBLT_CLASS_REPEATS) {
+			/* the digits of a number, an element at a time */
+			for (j = 0; j < CBLT_NUMBER_ELEMENTS(e); ++j) {
+				events[nevents].start = compressed[i + j] - 1;
+				events[nevents].freq = 1;
+				events[nevents++].bits = cblt_chunkBits(e, j,
+					&chunkLimit);
+			}
+			i += CBLT_NUMBER_ELEMENTS(e);
+		}
+
+		if (c == CBLT_CLASS_LITERAL) {
+			length = CBLT_LITERAL_LENGTH(e);
+			chars = (const unsigned char *)(compressed + i);
+			for (j = 0; j <= length; ++j) {
+				/* and the null character that ends it */
+				ch = (j < length) ? chars[j] : '\0';
+				events[nevents].start = models[1].start[ch];
+				events[nevents].freq = models[1].freq[ch];
+				events[nevents++].bits = CBLT_RANS_BITS;
+			}
+			i += CBLT_LITERAL_ELEMENTS(length);
+		}
+	}
+
+	/* No event takes more than 16 bits, and the states take 4 bytes each
+	   at the end. */
+	streamSize = 2 * nevents + 4 * CBLT_RANS_STATES + 8;
+	stream = malloc(streamSize);
+	if (stream == NULL)
+		goto done;
+	p = stream + streamSize;
+	for (j = 0; j < CBLT_RANS_STATES; ++j)
+		states[j] = CBLT_RANS_LOW;
+	/* rANS codes backwards, so that it decodes forwards */
+	for (j = nevents; j-- > 0; )
+		if (events[j].bits != 0)
+			cblt_ransPut(&states[j % CBLT_RANS_STATES], &p, &events[j]);
+	for (j = CBLT_RANS_STATES; j-- > 0; ) {
+		p -= 4;
+		p[0] = (unsigned char)states[j];
+		p[1] = (unsigned char)(states[j] >> 8);
+		p[2] = (unsigned char)(states[j] >> 16);
+		p[3] = (unsigned char)(states[j] >> 24);
+	}
+	streamSize = stream + streamSize - p;
+
+	/* the header, with everything needed to decode the stream */
+	length = cblt_putHeader(header, CBLT_PACK_RANS, count, dict->symbols)
+		- header;
+	length = cblt_putVarint(header + length, ndirect) - header;
+	for (i = 0; i < ndirect; ++i)
+		length = cblt_putVarint(header + length,
+			direct[i] - (i == 0 ? 0x100 : direct[i - 1] + 1)) - header;
+	length = cblt_putFreqs(header + length, &models[0]) - header;
+	length = cblt_putFreqs(header + length, &models[1]) - header;
+
+	if (length + streamSize >= limit)
+		goto done;
+	packed = malloc(length + streamSize);
+	if (packed == NULL)
+		goto done;
+	memcpy(packed, header, length);
+	memcpy(packed + length, p, streamSize);
+	*psize = length + streamSize;
+
+done:
+	free(stream);
+	free(events);
+	free(models);
+	free(classOf);
+	free(wordCounts);
+	return packed;
+}
+
+/*
+ * Packs the block COMPRESSED, which was encoded with DICT, into a newly
+ * allocated array of bytes, and stores its size in *PSIZE. See cobalt.h.
+ */
+unsigned char *cblt_packBlockDict(const cblt_dict *dict,
+		const uint16_t *compressed, size_t *psize) {
+	unsigned char *packed;
+	unsigned char header[CBLT_MAX_HEADER];
+	size_t count;		/* number of elements, without the terminator */
+	size_t stored;		/* the size of the block with CBLT_PACK_STORED */
+	cblt_dict builtin;
+
+	if (compressed == NULL || psize == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+
+	count = cblt_getUint16BlockSize(compressed) - 1;
+	stored = cblt_putHeader(header, CBLT_PACK_STORED, count, dict->symbols)
+		- header + 2 * count;
+	packed = cblt_packRans(dict, compressed, count, stored, psize);
+	if (packed != NULL)
+		return packed;
+	return cblt_packStored(compressed, count, dict->symbols, psize);
+}
+
+unsigned char *cblt_packBlock(const uint16_t *compressed, size_t *psize) {
+	return cblt_packBlockDict(NULL, compressed, psize);
+}
+
+/* Unpacks the COUNT elements stored at P, up to END, into OUT. Returns false
+   if there aren't exactly that many, or if a string literal, including one of
+   an older block, or a number doesn't end with them. */
+bool cblt_unpackStored(const unsigned char *p, const unsigned char *end,
+		size_t count, uint16_t *out) {
+	size_t literal = 0;		/* elements left in the current string literal */
+	size_t i;
+
+	if ((size_t)(end - p) / 2 != count || (end - p) % 2 != 0)
+		return false;
+	for (i = 0; i < count; ++i, p += 2) {
+		if (literal > 0) {
+			memcpy(&out[i], p, 2);
+			--literal;
+		} else {
+			out[i] = p[0] | (uint16_t)p[1] << 8;
+			if (CBLT_IS_LITERAL(out[i]))
+				literal = CBLT_LITERAL_ELEMENTS(CBLT_LITERAL_LENGTH(out[i]));
+		}
+		if (out[i] == 0)
+			return false;
+	}
+	/* the last literal must end with the block, and so must every number
+	   and every literal of an older block, which the decoder reads all of
+	   at once */
+	return literal == 0 && cblt_checkElements(out, count);
+}
+
+/*
+ * Reads the words with classes of their own and the frequencies of both
+ * models from *PP, which must not go past END, and fills in the tables of U
+ * for a dictionary of SYMBOLS symbols. Returns false if they don't make sense.
+ */
+static bool cblt_readModels(const unsigned char **pp, const unsigned char *end,
+		size_t symbols, cblt_unpacker *u) {
+	uint64_t ndirect, delta;
+	uint32_t next = 0x100;	/* the smallest the next direct word can be */
+	unsigned int buckets = cblt_countBuckets(symbols);
+	unsigned int c, bits, follow;
+	cblt_slot *slot;
+	size_t i;
+
+	if (!cblt_getVarint(pp, end, &ndirect) || ndirect > CBLT_MAX_DIRECT)
+		return false;
+	for (c = 0; c < 0x100; ++c) {
+		u->base[c] = c;
+		u->bits[c] = 0;
+	}
+	u->base[CBLT_CLASS_LITERAL] = CBLT_LITERAL;
+	u->base[CBLT_CLASS_NO_SPACE] = CBLT_NO_SPACE;
+	u->base[CBLT_CLASS_CAPITALIZE] = CBLT_CAPITALIZE;
+	u->base[CBLT_CLASS_UPPERCASE] = CBLT_UPPERCASE;
+	u->base[CBLT_CLASS_OTHER] = 0;
+	for (c = CBLT_CLASS_LITERAL; c < CBLT_CLASS_OTHER; ++c)
+		u->bits[c] = 0;
+	u->bits[CBLT_CLASS_OTHER] = 16;
+	for (c = CBLT_CLASS_RUNS; c < CBLT_CLASS_SMALL; ++c) {
+		u->base[c] = (uint16_t)(CBLT_RUN_SPACES + (c - CBLT_CLASS_RUNS));
+		u->bits[c] = 0;
+	}
+	for (c = CBLT_CLASS_SMALL; c < CBLT_CLASS_NUMBERS; ++c) {
+		u->base[c] = (uint16_t)(CBLT_SMALL_NUMBER
+			+ CBLT_SMALL_BASE[c - CBLT_CLASS_SMALL]);
+		u->bits[c] = CBLT_SMALL_BITS[c - CBLT_CLASS_SMALL];
+	}
+	for (c = CBLT_CLASS_NUMBERS; c < CBLT_CLASS_REPEATS; ++c) {
+		u->base[c] = (uint16_t)(CBLT_NUMBER + (c - CBLT_CLASS_NUMBERS));
+		u->bits[c] = 0;
+	}
+	for (c = CBLT_CLASS_REPEATS; c < CBLT_CLASS_WORDS; ++c) {
+		u->base[c] = (uint16_t)(CBLT_REPEAT + (c - CBLT_CLASS_REPEATS));
+		u->bits[c] = 0;
+	}
+
+	c = CBLT_CLASS_WORDS;
+	for (i = 0; i < ndirect; ++i, ++c) {
+		if (!cblt_getVarint(pp, end, &delta) || delta >= symbols - next)
+			return false;
+		u->base[c] = (uint16_t)(next + delta);
+		u->bits[c] = 0;
+		next = u->base[c] + 1;
+	}
+	for (i = 0; i < buckets; ++i, ++c) {
+		u->base[c] = (uint16_t)(0x100 + cblt_bucketBase(i, &bits));
+		u->bits[c] = bits;
+	}
+	/* Only the words in buckets and the small numbers can go past the end of
+	   their range, and only CBLT_CLASS_OTHER can make a null element. */
+	for (i = 0; i < c; ++i)
+		u->limit[i] = (i >= CBLT_CLASS_WORDS) ? symbols : 0x10000;
+	for (i = CBLT_CLASS_SMALL; i < CBLT_CLASS_NUMBERS; ++i)
+		u->limit[i] = u->base[i] + CBLT_SMALL_COUNT[i - CBLT_CLASS_SMALL];
+
+	if (!cblt_getFreqs(pp, end, &u->classes, c)
+			|| !cblt_getFreqs(pp, end, &u->chars, 256))
+		return false;
+	/* a literal can't be decoded without any characters */
+	if (u->classes.freq[CBLT_CLASS_LITERAL] != 0 && u->chars.total == 0)
+		return false;
+
+	for (c = 0; c < u->classes.n; ++c) {
+		if (c == CBLT_CLASS_OTHER)
+			follow = CBLT_FOLLOW_OTHER;
+		else if (c >= CBLT_CLASS_NUMBERS && c < CBLT_CLASS_REPEATS)
+			follow = CBLT_FOLLOW_NUMBER;
+		else if (c == CBLT_CLASS_LITERAL)
+			follow = CBLT_FOLLOW_LITERAL;
+		else
+			follow = CBLT_FOLLOW_NOTHING;
+		for (i = 0; i < u->classes.freq[c]; ++i) {
+			slot = &u->classSlot[u->classes.start[c] + i];
+			slot->step = (uint32_t)u->classes.freq[c] << 16 | i;
+			slot->base = u->base[c];
+			slot->last = (uint16_t)(u->limit[c] - 1);
+			slot->bits = u->bits[c];
+			slot->follow = (uint8_t)follow;
+		}
+	}
+	for (c = 0; c < u->chars.n; ++c) {
+		for (i = 0; i < u->chars.freq[c]; ++i) {
+			u->charSlot[u->chars.start[c] + i] = c;
+			u->charStep[u->chars.start[c] + i]
+				= (uint32_t)u->chars.freq[c] << 16 | i;
+		}
+	}
+	return true;
+}
+
+/*
+ * Unpacks the COUNT elements coded with rANS at P, up to END, into OUT, for a
+ * dictionary of SYMBOLS symbols. Returns false if the stream is damaged.
+ */
+static bool cblt_unpackRans(const unsigned char *p, const unsigned char *end,
+		size_t count, size_t symbols, uint16_t *out) {
+	cblt_unpacker *u;
+	uint32_t x0, x1, x2, x3;	/* the rANS states, in turn */
+	cblt_slot slot;
+	uint32_t step;
+	uint32_t e;			/* the element being decoded */
+	uint32_t value, limit;	/* the digits of an element of a number */
+	unsigned int bits;
+	unsigned char *chars;
+	unsigned char ch;
+	size_t i, j, n;
+	bool legacy = false;	/* whether there is a literal of an older block */
+	bool ok = false;
+
+	u = malloc(sizeof(cblt_unpacker));
+	if (u == NULL)
+		return false;
+	if (!cblt_readModels(&p, end, symbols, u)
+			|| (count > 0 && u->classes.total == 0)
+			|| (size_t)(end - p) < 4 * CBLT_RANS_STATES)
+		goto done;
+	x0 = p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+		| (uint32_t)p[3] << 24;
+	x1 = p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16
+		| (uint32_t)p[7] << 24;
+	x2 = p[8] | (uint32_t)p[9] << 8 | (uint32_t)p[10] << 16
+		| (uint32_t)p[11] << 24;
+	x3 = p[12] | (uint32_t)p[13] << 8 | (uint32_t)p[14] << 16
+		| (uint32_t)p[15] << 24;
+	p += 4 * CBLT_RANS_STATES;
+
+	for (i = 0; i < count; ) {
+		/* the class, with everything about it in the slot */
+		slot = u->classSlot[x0 & (CBLT_RANS_TOTAL - 1)];
+		x0 = (slot.step >> 16) * (x0 >> CBLT_RANS_BITS)
+			+ (slot.step & 0xFFFF);
+		if (!cblt_ransRenorm(&x0, &p, end))
+			goto done;
+		CBLT_RANS_ROTATE(x0, x1, x2, x3);
+
+		/* and its raw bits, of which a class with none takes 0 */
+		e = slot.base + (x0 & ((1u << slot.bits) - 1));
+		x0 >>= slot.bits;
+		if (!cblt_ransRenorm(&x0, &p, end))
+			goto done;
+		CBLT_RANS_ROTATE(x0, x1, x2, x3);
+		if (e - 1 >= slot.last)
+			goto done;
+		out[i++] = (uint16_t)e;
+
+		if (slot.follow == CBLT_FOLLOW_NOTHING) {
+			continue;
+		} else if (slot.follow == CBLT_FOLLOW_OTHER) {
+			/* a literal, a run, a number or a repeated literal always
+			   has a class of its own */
+			if (CBLT_IS_LITERAL(e) || CBLT_IS_RUN(e)
+					|| CBLT_IS_SMALL_NUMBER(e) || CBLT_IS_NUMBER(e)
+					|| CBLT_IS_REPEAT(e))
+				goto done;
+			legacy |= (e == CBLT_BEGIN_STRING);
+		} else if (slot.follow == CBLT_FOLLOW_NUMBER) {
+			/* the digits of the number, an element at a time */
+			n = CBLT_NUMBER_ELEMENTS(e);
+			if (CBLT_NUMBER_DIGITS(e) == 0 || n > count - i)
+				goto done;
+			for (j = 0; j < n; ++j) {
+				bits = cblt_chunkBits((uint16_t)e, j, &limit);
+				value = x0 & ((1u << bits) - 1);
+				x0 >>= bits;
+				if (!cblt_ransRenorm(&x0, &p, end) || value >= limit)
+					goto done;
+				CBLT_RANS_ROTATE(x0, x1, x2, x3);
+				out[i++] = (uint16_t)(value + 1);
+			}
+		} else {
+			/* the characters of the literal, in memory order, up to the
+			   null character that ends it, which is the padding when the
+			   length is odd */
+			chars = (unsigned char *)(out + i);
+			n = 0;
+			do {
+				if (n > CBLT_MAX_LITERAL || i + n / 2 > count)
+					goto done;
+				ch = u->charSlot[x0 & (CBLT_RANS_TOTAL - 1)];
+				step = u->charStep[x0 & (CBLT_RANS_TOTAL - 1)];
+				x0 = (step >> 16) * (x0 >> CBLT_RANS_BITS) + (step & 0xFFFF);
+				if (!cblt_ransRenorm(&x0, &p, end))
+					goto done;
+				CBLT_RANS_ROTATE(x0, x1, x2, x3);
+				chars[n++] = ch;
+			} while (ch != '\0');
+			/* not counting the null character */
+			if (--n == 0 || i + CBLT_LITERAL_ELEMENTS(n) > count)
+				goto done;
+			out[i - 1] = (uint16_t)(CBLT_LITERAL + n);
+			i += CBLT_LITERAL_ELEMENTS(n);
+		}
+	}
+
+	/* every state is back where the encoder started it, and the literals
+	   of an older block, which were unpacked element by element, end with
+	   the block; everything else was checked as it was unpacked */
+	ok = (p == end && x0 == CBLT_RANS_LOW && x1 == CBLT_RANS_LOW
+		&& x2 == CBLT_RANS_LOW && x3 == CBLT_RANS_LOW
+		&& (!legacy || cblt_checkElements(out, count)));
+
+done:
+	free(u);
+	return ok;
+}
+
+/*
+ * Unpacks the SIZE bytes at PACKED, which were packed with DICT, into a newly
+ * allocated block of compressed data. See cobalt.h.
+ */
+uint16_t *cblt_unpackBlockDict(const cblt_dict *dict,
+		const unsigned char *packed, size_t size) {
+	const unsigned char *p = packed;
+	const unsigned char *end = packed + size;
+	uint64_t count, symbols;
+	uint16_t *compressed;
+	int method;
+	bool ok;
+	cblt_dict builtin;
+
+	if (packed == NULL || size < 6 || memcmp(p, CBLT_PACK_MAGIC, 4) != 0
+			|| p[4] != CBLT_PACK_VERSION)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+	method = p[5];
+	p += 6;
+	if (!cblt_getVarint(&p, end, &count) || !cblt_getVarint(&p, end, &symbols)
+			|| symbols != dict->symbols
+			|| count >= SIZE_MAX / sizeof(uint16_t))
+		return NULL;
+
+	compressed = malloc(sizeof(uint16_t) * (count + 1));
+	if (compressed == NULL)
+		return NULL;
+	if (method == CBLT_PACK_STORED)
+		ok = cblt_unpackStored(p, end, count, compressed);
+	else if (method == CBLT_PACK_RANS)
+		ok = cblt_unpackRans(p, end, count, dict->symbols, compressed);
+	else
+		ok = false;
+	if (!ok) {
+		free(compressed);
+		return NULL;
+	}
+
+	compressed[count] = 0x0000;
+	return compressed;
+}
+
+uint16_t *cblt_unpackBlock(const unsigned char *packed, size_t size) {
+	return cblt_unpackBlockDict(NULL, packed, size);
+}
@@ -0,0 +1,37 @@
+/*
+ * pack.h
+ *
+ * contains the declarations of functions defined in pack.c
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+
+#ifndef PACK_H
+#define PACK_H
+
+unsigned char *cblt_packBlock(const uint16_t *compressed, size_t *psize);
+unsigned char *cblt_packBlockDict(const cblt_dict *dict,
+		const uint16_t *compressed, size_t *psize);
+uint16_t *cblt_unpackBlock(const unsigned char *packed, size_t size);
+uint16_t *cblt_unpackBlockDict(const cblt_dict *dict,
+		const unsigned char *packed, size_t size);
+
+/* elements in 2 bytes each, least significant first, except for the
+   characters of string literals, as in CBLT_PACK_STORED blocks and archives */
+unsigned char *cblt_putStored(unsigned char *p, const uint16_t *compressed,
+		size_t count);
+bool cblt_unpackStored(const unsigned char *p, const unsigned char *end,
+		size_t count, uint16_t *out);
+
+/* numbers of 7 bits per byte, least significant first, as used in the
+   headers of packed blocks */
+unsigned char *cblt_putVarint(unsigned char *p, uint64_t v);
+bool cblt_getVarint(const unsigned char **pp, const unsigned char *end,
+		uint64_t *pv);
+
+#endif  /* PACK_H */
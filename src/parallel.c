@@ -0,0 +1,415 @@
+/*
+ * parallel.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for encoding and
+ * decoding large sentences on more than one thread at once.
+ *
+ * When encoding, the sentence is cut into chunks, each chunk is encoded on its
+ * own by a pool of worker threads, and the encoded chunks are stitched back
+ * together in order. Chunks are only ever cut right before a word, so that the
+ * only thing that changes at the cut is how the space before that word is
+ * encoded, and that is easy to fix up while stitching. A chunk can't know
+ * which string literals came up in the chunks before it, so the literals are
+ * all written out, and are only turned into CBLT_REPEAT symbols once the
+ * chunks are stitched. The result is identical to what cblt_encodeSentence()
+ * would have produced.
+ *
+ * When decoding, a cblt_index tells us where in the compressed block each
+ * worker can start, where its output goes, and what state the decoder would
+ * have been in at that point, so every worker can decode straight into its own
+ * slice of the output. The string literals that can be repeated at each of
+ * those points are found beforehand, in a single pass over the block that
+ * skips everything else.
+ */
+
+#include <stdlib.h>	/* malloc, free, size_t */
+#include <string.h>	/* strlen, memcpy */
+#include <stdint.h>	/* uint16_t */
+#include <stdbool.h>
+
+#ifdef CBLT_HAVE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>	/* sysconf */
+#endif
+
+#include "cobalt.h"
+#include "sentence.h"
+#include "splitstring.h"
+
+/* Chunks smaller than this aren't worth handing to another thread. */
+#define CBLT_MIN_CHUNK		(64 * 1024)
+/* Each worker gets this many chunks on average, so that a worker that gets
+   stuck with a slow chunk doesn't hold everyone else up at the end. */
+#define CBLT_CHUNKS_PER_THREAD	4
+
+/*
+ * A single chunk of the sentence.
+ *
+ * start, length:	the characters to be encoded
+ * noSpace:			whether a space omission signal has to be placed before the
+ * 					encoded chunk when stitching
+ * block, count:	the encoded chunk, filled in by the worker
+ * dict:			the dictionary to encode with
+ */
+struct cblt_chunk {
+	const char *start;
+	size_t length;
+	bool noSpace;
+	uint16_t *block;
+	size_t count;
+	const cblt_dict *dict;
+};
+
+/* State shared by all the workers; the index of the next job to be done is
+   handed out under the lock. */
+struct cblt_pool {
+	void (*job)(void *arg, size_t n);
+	void *arg;
+	size_t njobs;
+	size_t next;
+#ifdef CBLT_HAVE_PTHREADS
+	pthread_mutex_t lock;
+#endif
+};
+
+/* Does jobs until there are no more jobs left to do. */
+static void *cblt_poolWorker(void *arg) {
+	struct cblt_pool *pool = arg;
+	size_t n;
+
+	while (1) {
+#ifdef CBLT_HAVE_PTHREADS
+		pthread_mutex_lock(&pool->lock);
+#endif
+		n = pool->next;
+		if (n < pool->njobs)
+			++pool->next;
+#ifdef CBLT_HAVE_PTHREADS
+		pthread_mutex_unlock(&pool->lock);
+#endif
+		if (n >= pool->njobs)
+			return NULL;
+
+		pool->job(pool->arg, n);
+	}
+}
+
+/* Returns the number of threads to actually use when asked for THREADS. */
+static unsigned int cblt_countThreads(unsigned int threads) {
+#ifdef CBLT_HAVE_PTHREADS
+	long online;
+
+	if (threads == 0) {
+		online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (online > 0) ? (unsigned int)online : 1;
+	}
+	return threads;
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Calls JOB(ARG, n) for every n from 0 to NJOBS - 1, on up to THREADS threads
+ * at once, and returns once every job is done. The calling thread is one of
+ * the workers. If a thread can't be started, the others just do more jobs.
+ */
+static void cblt_runPool(void (*job)(void *, size_t), void *arg,
+		size_t njobs, unsigned int threads) {
+	struct cblt_pool pool;
+#ifdef CBLT_HAVE_PTHREADS
+	pthread_t *workers;
+	unsigned int started = 0;	/* number of workers actually running */
+	unsigned int i;
+#endif
+
+	pool.job = job;
+	pool.arg = arg;
+	pool.njobs = njobs;
+	pool.next = 0;
+
+#ifdef CBLT_HAVE_PTHREADS
+	if (threads > njobs)
+		threads = njobs;
+	workers = (threads > 1) ? malloc(sizeof(pthread_t) * (threads - 1)) : NULL;
+	pthread_mutex_init(&pool.lock, NULL);
+	if (workers != NULL)
+		for ( ; started < threads - 1; ++started)
+			if (pthread_create(&workers[started], NULL,
+					cblt_poolWorker, &pool) != 0)
+				break;
+	cblt_poolWorker(&pool);
+	for (i = 0; i < started; ++i)
+		pthread_join(workers[i], NULL);
+	pthread_mutex_destroy(&pool.lock);
+	free(workers);
+#else
+	(void)threads;
+	cblt_poolWorker(&pool);
+#endif
+}
+
+/*
+ * Returns true if no phrase in DICT can take in the word at S + P along with
+ * the words before it. A phrase is made of words separated by single spaces,
+ * so only the few words right before S + P could begin one, and only if DICT
+ * has a phrase long enough that begins with one of them.
+ */
+static bool cblt_outsidePhrase(const cblt_dict *dict, const char *s,
+		size_t p) {
+	size_t start;		/* first character of an earlier word */
+	unsigned int k;		/* how many words back that word is */
+	int32_t word;
+
+	for (k = 1; k < CBLT_MAX_PHRASE_WORDS; ++k) {
+		if (p < 2 || s[p - 1] != ' '
+				|| CHARSTATUS[(unsigned char)s[p - 2]] != Word)
+			return true;
+		for (start = p - 2;
+				start > 0 && CHARSTATUS[(unsigned char)s[start - 1]] == Word;
+				--start) ;
+		word = cblt_findWordDict(dict, s + start, p - 1 - start);
+		if (word >= 0 && dict->phrasestart[word] > k)
+			return false;
+		p = start;
+	}
+	return true;
+}
+
+/*
+ * Finds a place at or after S + TARGET, but before S + LENGTH, where it is safe
+ * to end a chunk: the first character of a word that is not the first group
+ * of S, and that can't be part of a phrase that starts before it. Returns
+ * LENGTH if there is no such place.
+ */
+static size_t cblt_findCut(const cblt_dict *dict, const char *s,
+		size_t target, size_t length) {
+	size_t p;
+
+	for (p = target; p < length; ++p) {
+		if (CHARSTATUS[(unsigned char)s[p]] == Word
+				&& CHARSTATUS[(unsigned char)s[p - 1]] != Word
+				&& cblt_outsidePhrase(dict, s, p))
+			return p;
+	}
+	return length;
+}
+
+/*
+ * Cuts the LENGTH characters of S into chunks of roughly CHUNKSIZE characters.
+ * CHUNKS must have room for at least length / chunkSize + 1 elements. Returns
+ * the number of chunks.
+ *
+ * Every chunk but the first starts with a word. If the character before that
+ * word is a space, it is left out of both chunks, since the decoder puts an
+ * implicit space before the word anyway. Otherwise it is punctuation, which
+ * would have been followed by a space omission signal if the sentence hadn't
+ * been cut there, so that is recorded for the stitching.
+ */
+static size_t cblt_cutChunks(const cblt_dict *dict, const char *s,
+		size_t length, size_t chunkSize, struct cblt_chunk *chunks) {
+	size_t n = 0;
+	size_t start = 0;	/* first character of the current chunk */
+	size_t cut;			/* first character of the next chunk */
+	bool noSpace = false;
+
+	while (start < length) {
+		if (length - start <= chunkSize)
+			cut = length;
+		else
+			cut = cblt_findCut(dict, s, start + chunkSize, length);
+
+		chunks[n].start = s + start;
+		chunks[n].length = cut - start;
+		chunks[n].noSpace = noSpace;
+		chunks[n].block = NULL;
+		chunks[n].dict = dict;
+
+		if (cut < length) {
+			if (s[cut - 1] == ' ') {
+				--chunks[n].length;
+				noSpace = false;
+			} else {
+				noSpace = true;
+			}
+		}
+		++n;
+		start = cut;
+	}
+
+	return n;
+}
+
+/* Encodes chunk N of the array of chunks ARG. */
+static void cblt_encodeJob(void *arg, size_t n) {
+	struct cblt_chunk *chunk = (struct cblt_chunk *)arg + n;
+
+	/* a NULL block tells the caller that this chunk failed */
+	chunk->block = cblt_encodeRange(chunk->dict, chunk->start, chunk->length,
+		&chunk->count, NULL, 0, false);
+}
+
+/*
+ * Encodes SENTENCE like cblt_encodeSentence(), using up to THREADS threads at
+ * once. If THREADS is 0, one thread is used for every processor that is
+ * online. The output is identical to that of cblt_encodeSentence().
+ */
+uint16_t *cblt_encodeSentenceParallel(const char *sentence,
+		unsigned int threads) {
+	return cblt_encodeSentenceParallelDict(NULL, sentence, threads);
+}
+
+uint16_t *cblt_encodeSentenceParallelDict(const cblt_dict *dict,
+		const char *sentence, unsigned int threads) {
+	cblt_dict builtin;
+	size_t length;				/* length of sentence */
+	size_t chunkSize;
+	struct cblt_chunk *chunks;
+	size_t nchunks;
+	uint16_t *compressed;		/* the stitched output */
+	size_t count;				/* number of elements in compressed */
+	size_t i;
+
+	if (sentence == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+
+	threads = cblt_countThreads(threads);
+	length = strlen(sentence);
+	chunkSize = length / ((size_t)threads * CBLT_CHUNKS_PER_THREAD) + 1;
+	if (chunkSize < CBLT_MIN_CHUNK)
+		chunkSize = CBLT_MIN_CHUNK;
+	if (threads == 1 || length <= chunkSize)
+		return cblt_encodeSentenceDict(dict, sentence);
+
+	chunks = malloc(sizeof(struct cblt_chunk) * (length / chunkSize + 1));
+	if (chunks == NULL)
+		return NULL;
+	nchunks = cblt_cutChunks(dict, sentence, length, chunkSize, chunks);
+
+	cblt_runPool(cblt_encodeJob, chunks, nchunks, threads);
+
+	/* stitch the chunks together */
+	count = 1;
+	for (i = 0; i < nchunks; ++i) {
+		if (chunks[i].block == NULL)
+			break;
+		count += chunks[i].count + chunks[i].noSpace;
+	}
+	compressed = (i == nchunks) ? malloc(sizeof(uint16_t) * count) : NULL;
+
+	count = 0;
+	for (i = 0; i < nchunks; ++i) {
+		if (compressed != NULL) {
+			/* a chunk that ends in a run carries the space omission
+			   signal in the run, just like it would have uncut */
+			if (chunks[i].noSpace && count > 0
+					&& CBLT_IS_RUN(compressed[count - 1]))
+				compressed[count - 1] |= CBLT_RUN_NO_SPACE;
+			else if (chunks[i].noSpace)
+				compressed[count++] = CBLT_NO_SPACE;
+			memcpy(compressed + count, chunks[i].block,
+				sizeof(uint16_t) * chunks[i].count);
+			count += chunks[i].count;
+		}
+		free(chunks[i].block);
+	}
+	if (compressed != NULL) {
+		count = cblt_repeatLiterals(compressed, count);
+		compressed[count] = 0x0000;
+	}
+
+	free(chunks);
+	return compressed;
+}
+
+/*
+ * Everything the workers need to decode a block. Job n decodes the symbols
+ * from index entry n * per up to, but not including, index entry (n + 1) * per.
+ * The last job goes all the way to the end of the block, and starts out with
+ * the string literals in repeats[n].
+ */
+struct cblt_decodeJob {
+	const cblt_dict *dict;
+	const uint16_t *compressed;
+	const cblt_index *index;
+	char *sentence;
+	size_t per;		/* number of index entries per job */
+	cblt_repeats *repeats;
+};
+
+/* Decodes the Nth range of index entries described by ARG. */
+static void cblt_decodeJob(void *arg, size_t n) {
+	struct cblt_decodeJob *job = arg;
+	const cblt_indexEntry *first;
+	size_t last;
+	size_t to;
+
+	first = &job->index->entries[n * job->per];
+	last = (n + 1) * job->per;
+	to = (last < job->index->count)
+		? job->index->entries[last].token
+		: SIZE_MAX;
+
+	cblt_decodeRange(job->dict, job->compressed, first->token, to,
+		job->sentence + first->decoded, first->noSpace, &job->repeats[n]);
+}
+
+/*
+ * Decodes COMPRESSED like cblt_decodeSentence(), using INDEX to split the work
+ * across up to THREADS threads at once. If THREADS is 0, one thread is used for
+ * every processor that is online.
+ */
+char *cblt_decodeSentenceParallel(const uint16_t *compressed,
+		const cblt_index *index, unsigned int threads) {
+	return cblt_decodeSentenceParallelDict(NULL, compressed, index, threads);
+}
+
+char *cblt_decodeSentenceParallelDict(const cblt_dict *dict,
+		const uint16_t *compressed, const cblt_index *index,
+		unsigned int threads) {
+	cblt_dict builtin;
+	struct cblt_decodeJob job;
+	size_t njobs;
+	size_t n;
+
+	if (compressed == NULL || index == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+	if (index->count == 0 || index->decodedLength == 0)
+		return cblt_decodeSentenceDict(dict, compressed);
+
+	job.sentence = malloc(sizeof(char) * index->decodedLength);
+	if (job.sentence == NULL)
+		return NULL;
+	job.dict = dict;
+	job.compressed = compressed;
+	job.index = index;
+
+	threads = cblt_countThreads(threads);
+	njobs = (size_t)threads * CBLT_CHUNKS_PER_THREAD;
+	if (njobs > index->count)
+		njobs = index->count;
+	/* ceiling division, so that there are never more than njobs jobs */
+	job.per = index->count / njobs + (index->count % njobs != 0);
+	njobs = index->count / job.per + (index->count % job.per != 0);
+
+	job.repeats = malloc(sizeof(cblt_repeats) * njobs);
+	if (job.repeats == NULL) {
+		free(job.sentence);
+		return NULL;
+	}
+	cblt_initRepeats(&job.repeats[0], NULL, false);
+	for (n = 1; n < njobs; ++n) {
+		job.repeats[n] = job.repeats[n - 1];
+		cblt_followRepeats(compressed, index->entries[(n - 1) * job.per].token,
+			index->entries[n * job.per].token, &job.repeats[n]);
+	}
+
+	cblt_runPool(cblt_decodeJob, &job, njobs, threads);
+	job.sentence[index->decodedLength - 1] = '\0';
+
+	free(job.repeats);
+	return job.sentence;
+}
@@ -0,0 +1,148 @@
+/*
+ * repeats.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for keeping track of
+ * the string literals of a block, so that a word that isn't in the dictionary
+ * only has to be written out the first time it comes up.
+ *
+ * The encoder and the decoder both keep a cblt_repeats table, and update it
+ * the same way at the same symbols, so the decoder always knows which literal
+ * a CBLT_REPEAT symbol stands for without being told. The table never grows:
+ * it has room for CBLT_REPEATS literals, and once it is full, a new literal
+ * takes the slot that was used the longest time ago. Moving a slot to the
+ * front of the circle and taking the oldest one are a few stores each, so
+ * updating the table takes no more time than copying the literal, and never
+ * allocates any memory.
+ */
+
+#include <stdlib.h>	/* size_t */
+#include <string.h>	/* memcpy, memcmp, memset */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "repeats.h"
+#include "wordhash.h"
+
+/*
+ * Empties REPEATS. If STORE is not NULL, it must have room for CBLT_REPEATS
+ * literals, and every literal is copied into it as it is added; otherwise, the
+ * characters given to cblt_addRepeat() must stay where they are. LOOKUP tells
+ * whether cblt_seeRepeat() will be used.
+ */
+void cblt_initRepeats(cblt_repeats *repeats, char (*store)[CBLT_MAX_REPEAT],
+		bool lookup) {
+	repeats->count = 0;
+	repeats->newest = 0;
+	repeats->older[0] = 0;
+	repeats->newer[0] = 0;
+	repeats->store = store;
+	repeats->lookup = lookup;
+	if (lookup)
+		memset(repeats->first, 0, sizeof(repeats->first));
+}
+
+/* Returns the hash of the LENGTH characters at TEXT. */
+static inline uint32_t cblt_hashRepeat(const char *text, size_t length) {
+	return (uint32_t)cblt_hashWord(text, length);
+}
+
+/* Takes SLOT out of the bucket it is in. */
+static void cblt_unlinkRepeat(cblt_repeats *repeats, size_t slot) {
+	uint16_t *link = &repeats->first[repeats->hash[slot]
+		% CBLT_REPEAT_BUCKETS];
+
+	while (*link != slot + 1)
+		link = &repeats->next[*link - 1];
+	*link = repeats->next[slot];
+}
+
+/* Adds the LENGTH characters at TEXT, whose hash is HASH if REPEATS is looked
+   up, to REPEATS as the newest literal. */
+static void cblt_addHashedRepeat(cblt_repeats *repeats, const char *text,
+		size_t length, uint32_t hash) {
+	size_t slot;
+	uint8_t oldest = repeats->newer[repeats->newest];
+
+	if (repeats->count < CBLT_REPEATS) {
+		/* a slot that hasn't been used yet, between the newest and the
+		   oldest */
+		slot = repeats->count++;
+		repeats->older[slot] = repeats->newest;
+		repeats->newer[slot] = oldest;
+		repeats->newer[repeats->newest] = (uint8_t)slot;
+		repeats->older[oldest] = (uint8_t)slot;
+	} else {
+		/* The oldest slot is already right after the newest one, so it
+		   only has to be called the newest. */
+		slot = oldest;
+		if (repeats->lookup)
+			cblt_unlinkRepeat(repeats, slot);
+	}
+	repeats->newest = (uint8_t)slot;
+
+	if (repeats->store != NULL) {
+		memcpy(repeats->store[slot], text, length);
+		text = repeats->store[slot];
+	}
+	repeats->text[slot] = text;
+	repeats->length[slot] = (uint8_t)length;
+	if (repeats->lookup) {
+		repeats->hash[slot] = hash;
+		repeats->next[slot] = repeats->first[hash % CBLT_REPEAT_BUCKETS];
+		repeats->first[hash % CBLT_REPEAT_BUCKETS] = (uint16_t)(slot + 1);
+	}
+}
+
+/* Adds the LENGTH characters at TEXT, which must be between 1 and
+   CBLT_MAX_REPEAT, to REPEATS as the newest literal. */
+void cblt_addRepeat(cblt_repeats *repeats, const char *text, size_t length) {
+	cblt_addHashedRepeat(repeats, text, length,
+		repeats->lookup ? cblt_hashRepeat(text, length) : 0);
+}
+
+/* Makes SLOT, which must be filled, the newest literal of REPEATS. */
+void cblt_useRepeat(cblt_repeats *repeats, size_t slot) {
+	uint8_t newest = repeats->newest;
+	uint8_t oldest = repeats->newer[newest];
+
+	if (slot == newest)
+		return;
+	if (slot != oldest) {
+		/* take it out of the circle... */
+		repeats->newer[repeats->older[slot]] = repeats->newer[slot];
+		repeats->older[repeats->newer[slot]] = repeats->older[slot];
+		/* ...and put it back between the newest and the oldest */
+		repeats->older[slot] = newest;
+		repeats->newer[slot] = oldest;
+		repeats->newer[newest] = (uint8_t)slot;
+		repeats->older[oldest] = (uint8_t)slot;
+	}
+	repeats->newest = (uint8_t)slot;
+}
+
+/*
+ * Looks up the LENGTH characters at TEXT, which must be between 1 and
+ * CBLT_MAX_REPEAT, in REPEATS, which must have been set up for lookups. If
+ * they are there, their slot is made the newest and returned. Otherwise, they
+ * are added as the newest literal, and -1 is returned.
+ */
+int cblt_seeRepeat(cblt_repeats *repeats, const char *text, size_t length) {
+	uint32_t hash = cblt_hashRepeat(text, length);
+	size_t slot;
+	uint16_t link;
+
+	for (link = repeats->first[hash % CBLT_REPEAT_BUCKETS]; link != 0;
+			link = repeats->next[slot]) {
+		slot = link - 1;
+		if (repeats->hash[slot] == hash && repeats->length[slot] == length
+				&& memcmp(repeats->text[slot], text, length) == 0) {
+			cblt_useRepeat(repeats, slot);
+			return (int)slot;
+		}
+	}
+
+	cblt_addHashedRepeat(repeats, text, length, hash);
+	return -1;
+}
@@ -0,0 +1,59 @@
+/*
+ * repeats.h
+ *
+ * contains the declarations of functions defined in repeats.c, and the table
+ * of string literals that they keep
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+
+#ifndef REPEATS_H
+#define REPEATS_H
+
+/* the number of hash buckets that the encoder looks literals up in */
+#define CBLT_REPEAT_BUCKETS	1024
+
+/*
+ * The string literals of a block that can be repeated, one per slot. The slots
+ * are kept in a circle from the one used longest ago to the one used most
+ * recently, so that the slot after the newest one is always the oldest.
+ *
+ * text, length:	the characters of the literal in each slot, which either
+ * 					point into the text or block being worked on, or into store
+ * older, newer:	the slots used right before and right after each slot
+ * count:			the number of slots filled so far
+ * newest:			the slot used most recently
+ * store:			room for a copy of the literal in each slot, or NULL if the
+ * 					characters stay where they are for as long as they are needed
+ * lookup:			whether the slots can be looked up by their characters, which
+ * 					only the encoder needs; the rest is only for that
+ * hash:			the hash of the literal in each slot
+ * first:			1 more than the first slot in each bucket, or 0
+ * next:			1 more than the next slot in the same bucket, or 0
+ */
+typedef struct cblt_repeats {
+	const char *text[CBLT_REPEATS];
+	uint8_t length[CBLT_REPEATS];
+	uint8_t older[CBLT_REPEATS];
+	uint8_t newer[CBLT_REPEATS];
+	size_t count;
+	uint8_t newest;
+	char (*store)[CBLT_MAX_REPEAT];
+
+	bool lookup;
+	uint32_t hash[CBLT_REPEATS];
+	uint16_t first[CBLT_REPEAT_BUCKETS];
+	uint16_t next[CBLT_REPEATS];
+} cblt_repeats;
+
+void cblt_initRepeats(cblt_repeats *repeats, char (*store)[CBLT_MAX_REPEAT],
+		bool lookup);
+void cblt_addRepeat(cblt_repeats *repeats, const char *text, size_t length);
+void cblt_useRepeat(cblt_repeats *repeats, size_t slot);
+int cblt_seeRepeat(cblt_repeats *repeats, const char *text, size_t length);
+
+#endif  /* REPEATS_H */
@@ -6,13 +6,16 @@
  * decoding whole sentences.
  */
 
-#include <stdlib.h>	/* malloc, size_t */
-#include <string.h>	/* strtok, strlen, memcpy, strchr */
+#include <stdlib.h>	/* malloc, realloc, size_t */
+#include <string.h>	/* strtok, strlen, memcpy, memmove, strchr */
 #include <stdint.h>	/* uint16_t, int32_t */
+#include <stdbool.h>
 #include <ctype.h>	/* isalnum, isalpha */
 #include <stdio.h>
 
 #include "cobalt.h"
+#include "dict.h"
+#include "repeats.h"
 #include "sentence.h"
 #include "splitstring.h"
 
@@ -36,15 +39,653 @@
  * In this implementation, the ceiling devision calculation is easier to express
  * and more understandable when length is the length of a string PLUS 1, as
  * opposed to just the length as returned from strlen().
+ *
+ * This only applies to the CBLT_BEGIN_STRING literals of older blocks, which
+ * are still decoded. A literal that is written today carries its length in
+ * its CBLT_LITERAL symbol, and has no null terminator, so its elements are
+ * counted with CBLT_LITERAL_ELEMENTS() instead.
+ */
+
+
+/* No word in the table and no string literal is longer than 255 characters,
+   and no run is longer than 254, so this is enough room to decode any of them
+   along with its leading space. */
+#define CBLT_MAX_WORD_ROOM	(UINT8_MAX + 1)
+/* the number of characters allocated per symbol when decoding, to start with */
+#define CBLT_DECODE_RATIO	4
+
+/* Copies a word of LENGTH characters from the word table to DEST. Almost every
+   word is 16 characters or shorter, and those are copied with two overlapping
+   fixed-size copies, which compilers turn into plain loads and stores. Given a
+   variable length, memcpy() may be inlined as a string instruction that is
+   slow to start up for copies this short. */
+static inline void cblt_copyWord(char *dest, const unsigned char *word,
+		size_t length) {
+	if (length >= 8 && length <= 16) {
+		memcpy(dest, word, 8);
+		memcpy(dest + length - 8, word + length - 8, 8);
+	} else if (length >= 4 && length < 8) {
+		memcpy(dest, word, 4);
+		memcpy(dest + length - 4, word + length - 4, 4);
+	} else if (length > 16) {
+		memcpy(dest, word, length);
+	} else if (length > 0) {
+		/* 1 to 3 characters, some of them copied twice */
+		dest[0] = word[0];
+		dest[length / 2] = word[length / 2];
+		dest[length - 1] = word[length - 1];
+	}
+}
+
+/* Tells whether C is one of the letters A to Z, or a to z. Unlike isupper()
+   and islower(), these don't depend on the locale, which the decoder doesn't
+   know about. */
+static inline bool cblt_isUpper(char c) {
+	return c >= 'A' && c <= 'Z';
+}
+
+static inline bool cblt_isLower(char c) {
+	return c >= 'a' && c <= 'z';
+}
+
+/* Makes the first letter of the LENGTH characters at WORD uppercase if ESCAPE
+   is CBLT_CAPITALIZE, or all of its letters if it is CBLT_UPPERCASE. */
+void cblt_applyCase(char *word, size_t length, uint16_t escape) {
+	size_t i;
+
+	if (escape == CBLT_CAPITALIZE)
+		length = (length > 0);
+	for (i = 0; i < length; ++i) {
+		if (cblt_isLower(word[i]))
+			word[i] -= 'a' - 'A';
+	}
+}
+
+/* the characters of the longest run of each kind, to copy runs from */
+#define CBLT_REPEAT2(s)		s s
+#define CBLT_REPEAT8(s)		CBLT_REPEAT2(CBLT_REPEAT2(CBLT_REPEAT2(s)))
+#define CBLT_REPEAT128(s)	CBLT_REPEAT8(CBLT_REPEAT8(CBLT_REPEAT2(s)))
+static const char *const CBLT_RUN_CHARS[] = {
+	CBLT_REPEAT128(" "),
+	CBLT_REPEAT128("\t"),
+	CBLT_REPEAT128("\n"),
+	CBLT_REPEAT128("\r\n")
+};
+
+/* Returns the characters of the run SYMBOL, and stores how many there are in
+   *PLENGTH, which is never more than 2 * CBLT_MAX_RUN. */
+const char *cblt_getRun(uint16_t symbol, size_t *plength) {
+	*plength = CBLT_RUN_LENGTH(symbol) << (symbol >= CBLT_RUN_CRLFS);
+	return CBLT_RUN_CHARS[(symbol - CBLT_RUN_SPACES) >> 8];
+}
+
+/* the digits of numbers, with lowercase letters and then uppercase ones */
+static const char CBLT_DIGITS[] = "0123456789abcdef0123456789ABCDEF";
+/* the first CBLT_SMALL_NUMBER symbol of 1, 2 and 3 digits */
+static const uint16_t CBLT_SMALL_START[] = { 0, 0, 10, 110 };
+
+/* Returns the number of digits of the small number SYMBOL. */
+static inline size_t cblt_getSmallDigits(uint16_t symbol) {
+	return 1 + (symbol >= CBLT_SMALL_NUMBER + 10)
+		+ (symbol >= CBLT_SMALL_NUMBER + 110);
+}
+
+/* Writes the last DIGITS digits of VALUE in BASE to DEST, most significant
+   first, with the digit characters at CHARS. */
+static void cblt_putDigits(char *dest, uint32_t value, size_t digits,
+		unsigned int base, const char *chars) {
+	while (digits-- > 0) {
+		dest[digits] = chars[value % base];
+		value /= base;
+	}
+}
+
+/* Writes the digits of the small number SYMBOL to DEST, and returns how many
+   there are. */
+size_t cblt_formatSmallNumber(uint16_t symbol, char *dest) {
+	size_t digits = cblt_getSmallDigits(symbol);
+
+	cblt_putDigits(dest, symbol - CBLT_SMALL_NUMBER - CBLT_SMALL_START[digits],
+		digits, 10, CBLT_DIGITS);
+	return digits;
+}
+
+/* Returns the characters that come before the digits of the number SYMBOL,
+   and stores how many there are in *PLENGTH. */
+const char *cblt_getNumberPrefix(uint16_t symbol, size_t *plength) {
+	*plength = 0;
+	if ((symbol & CBLT_NUMBER_PREFIX) == 0)
+		return "";
+	*plength = (symbol & CBLT_NUMBER_HEX) ? 2 : 1;
+	return (symbol & CBLT_NUMBER_HEX) ? "0x" : "-";
+}
+
+/* Returns the number of digits held by element K, counting from 0, of the
+   elements after the number SYMBOL. */
+size_t cblt_getChunkDigits(uint16_t symbol, size_t k) {
+	size_t chunk = CBLT_NUMBER_CHUNK(symbol);
+
+	if (k > 0)
+		return chunk;
+	return CBLT_NUMBER_DIGITS(symbol)
+		- chunk * (CBLT_NUMBER_ELEMENTS(symbol) - 1);
+}
+
+/* Returns 1 more than the largest value that DIGITS digits of the number
+   SYMBOL can hold. */
+uint32_t cblt_getChunkLimit(uint16_t symbol, size_t digits) {
+	uint32_t limit = 1;
+
+	while (digits-- > 0)
+		limit *= (symbol & CBLT_NUMBER_HEX) ? 16 : 10;
+	return limit;
+}
+
+/* Writes the DIGITS digits held by ELEMENT, one of the elements after the
+   number SYMBOL, to DEST. */
+void cblt_formatChunk(uint16_t symbol, uint16_t element, size_t digits,
+		char *dest) {
+	cblt_putDigits(dest, element - 1u, digits,
+		(symbol & CBLT_NUMBER_HEX) ? 16 : 10,
+		CBLT_DIGITS + ((symbol & CBLT_NUMBER_UPPER) ? 16 : 0));
+}
+
+/* Returns the number of characters that the number SYMBOL decodes to. */
+static inline size_t cblt_getNumberLength(uint16_t symbol) {
+	size_t length;
+
+	cblt_getNumberPrefix(symbol, &length);
+	return length + CBLT_NUMBER_DIGITS(symbol);
+}
+
+/* Writes the number that starts with the CBLT_NUMBER symbol at NUMBER to
+   DEST, and returns the number of characters written. */
+static size_t cblt_formatNumber(const uint16_t *number, char *dest) {
+	const char *prefix;
+	size_t length;			/* characters written so far */
+	size_t digits;
+	size_t k;
+
+	prefix = cblt_getNumberPrefix(number[0], &length);
+	memcpy(dest, prefix, length);
+	for (k = 0; k < CBLT_NUMBER_ELEMENTS(number[0]); ++k) {
+		digits = cblt_getChunkDigits(number[0], k);
+		cblt_formatChunk(number[0], number[1 + k], digits, dest + length);
+		length += digits;
+	}
+	return length;
+}
+
+/*
+ * Checks the number that starts with the CBLT_NUMBER symbol at element I of
+ * the COUNT elements of COMPRESSED. Returns false if it has no digits, if it
+ * doesn't end before element COUNT, or if any of its elements holds more than
+ * its digits can.
+ */
+bool cblt_checkNumber(const uint16_t *compressed, size_t i, size_t count) {
+	uint16_t symbol = compressed[i];
+	size_t k;
+
+	if (CBLT_NUMBER_DIGITS(symbol) == 0
+			|| CBLT_NUMBER_ELEMENTS(symbol) >= count - i)
+		return false;
+	for (k = 0; k < CBLT_NUMBER_ELEMENTS(symbol); ++k)
+		if (compressed[i + 1 + k] == 0 || compressed[i + 1 + k]
+				> cblt_getChunkLimit(symbol, cblt_getChunkDigits(symbol, k)))
+			return false;
+	return true;
+}
+
+/*
+ * Checks the string literal of an older block that starts with the
+ * CBLT_BEGIN_STRING symbol at element I of the COUNT elements of COMPRESSED.
+ * Returns the number of elements that its characters take, null terminator
+ * included, or 0 if the null terminator doesn't come before element COUNT.
+ */
+size_t cblt_checkBeginString(const uint16_t *compressed, size_t i,
+		size_t count) {
+	const char *chars = (const char *)(compressed + i + 1);
+	const char *end;
+
+	if (count - i < 2)
+		return 0;
+	end = memchr(chars, '\0', 2 * (count - i - 1));
+	if (end == NULL)
+		return 0;
+	/* the same integer ceiling division that the decoders do */
+	return (size_t)(end - chars) / 2 + 1;
+}
+
+/*
+ * Checks that every string literal and number among the COUNT elements of
+ * COMPRESSED ends before element COUNT, stepping over them the same way the
+ * decoders do, so that none of them read past the end of the block. Returns
+ * false otherwise.
+ */
+bool cblt_checkElements(const uint16_t *compressed, size_t count) {
+	size_t i;
+	size_t n;
+
+	for (i = 0; i < count; ++i) {
+		if (compressed[i] == 0) {
+			return false;
+		} else if (CBLT_IS_LITERAL(compressed[i])) {
+			n = CBLT_LITERAL_ELEMENTS(CBLT_LITERAL_LENGTH(compressed[i]));
+			if (n >= count - i)
+				return false;
+			i += n;
+		} else if (CBLT_IS_NUMBER(compressed[i])) {
+			if (!cblt_checkNumber(compressed, i, count))
+				return false;
+			i += CBLT_NUMBER_ELEMENTS(compressed[i]);
+		} else if (compressed[i] == CBLT_BEGIN_STRING) {
+			n = cblt_checkBeginString(compressed, i, count);
+			if (n == 0)
+				return false;
+			i += n;
+		}
+	}
+	return true;
+}
+
+/*
+ * Finds the element that the LENGTH spaces or punctuation marks at CHARS start
+ * with: a run of spaces, tabs, newlines or "\r\n" pairs, or otherwise the first
+ * character by itself. Stores the element in *PSYMBOL, and returns the number
+ * of characters it stands for.
+ */
+static size_t cblt_nextChars(const char *chars, size_t length,
+		uint16_t *psymbol) {
+	uint16_t run;
+	size_t n = 1;			/* characters or pairs in the run */
+
+	switch (chars[0]) {
+	case ' ':
+		run = CBLT_RUN_SPACES;
+		break;
+	case '\t':
+		run = CBLT_RUN_TABS;
+		break;
+	case '\n':
+		run = CBLT_RUN_NEWLINES;
+		break;
+	case '\r':
+		if (length >= 2 && chars[1] == '\n') {
+			while (n < CBLT_MAX_RUN && 2 * n + 1 < length
+					&& chars[2 * n] == '\r' && chars[2 * n + 1] == '\n')
+				++n;
+			*psymbol = CBLT_RUN_CRLFS + n;
+			return 2 * n;
+		}
+		*psymbol = '\r';
+		return 1;
+	default:
+		/* direct byte injection */
+		*psymbol = (unsigned char)chars[0];
+		return 1;
+	}
+
+	while (n < CBLT_MAX_RUN && n < length && chars[n] == chars[0])
+		++n;
+	*psymbol = run + n;
+	return n;
+}
+
+/*
+ * Writes the LENGTH spaces or punctuation marks at CHARS to OUT, and returns
+ * the number of elements written. If NOSPACE is true, they are followed by a
+ * space omission signal, which is folded into the last element if it is a
+ * run. If OUT is NULL, the elements are only counted.
+ */
+static size_t cblt_encodeChars(const char *chars, size_t length, bool noSpace,
+		uint16_t *out) {
+	size_t i = 0;			/* index for out */
+	size_t n;				/* characters in an element */
+	uint16_t symbol = 0;
+
+	while (length > 0) {
+		n = cblt_nextChars(chars, length, &symbol);
+		if (out != NULL)
+			out[i] = symbol;
+		++i;
+		chars += n;
+		length -= n;
+	}
+	if (noSpace && CBLT_IS_RUN(symbol)) {
+		if (out != NULL)
+			out[i - 1] |= CBLT_RUN_NO_SPACE;
+	} else if (noSpace) {
+		if (out != NULL)
+			out[i] = CBLT_NO_SPACE;
+		++i;
+	}
+	return i;
+}
+
+/*
+ * Returns how many of the LENGTH spaces or punctuation marks at CHARS come
+ * before the last element they are written as. That element may stand for
+ * more characters once the ones after CHARS are known, but the ones before it
+ * are always written the same way.
+ */
+size_t cblt_cutChars(const char *chars, size_t length) {
+	size_t done = 0;		/* characters before the current element */
+	size_t n;
+	uint16_t symbol;
+
+	while (done < length) {
+		n = cblt_nextChars(chars + done, length - done, &symbol);
+		if (done + n == length)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+/* Tells whether SYMBOL, the last element of a group of spaces or punctuation,
+   makes the decoder leave out the space before the next word. */
+static inline bool cblt_omitsSpace(uint16_t symbol) {
+	return symbol == CBLT_NO_SPACE
+		|| (CBLT_IS_RUN(symbol) && (symbol & CBLT_RUN_NO_SPACE));
+}
+
+/*
+ * Returns the number of elements taken by a string literal of LENGTH
+ * characters, which must not be 0. A literal longer than CBLT_MAX_LITERAL
+ * characters is split into pieces, with a CBLT_NO_SPACE symbol between each.
+ */
+static size_t cblt_getLiteralLength(size_t length) {
+	size_t pieces = length / CBLT_MAX_LITERAL;	/* full pieces */
+	size_t rest = length % CBLT_MAX_LITERAL;
+	size_t n;
+
+	n = pieces * (1 + CBLT_LITERAL_ELEMENTS(CBLT_MAX_LITERAL) + 1);
+	if (rest > 0)
+		return n + 1 + CBLT_LITERAL_ELEMENTS(rest);
+	/* no CBLT_NO_SPACE symbol after the last piece */
+	return n - 1;
+}
+
+/* Returns the value of the digit C, in any base up to 16. */
+static inline unsigned int cblt_digitValue(char c) {
+	return (c <= '9') ? (unsigned int)(c - '0')
+		: (unsigned int)((c | ('a' - 'A')) - 'a' + 10);
+}
+
+/*
+ * Writes the word of LENGTH characters at GROUP to OUT as a number, if it is
+ * one and that takes fewer elements than a string literal. A number is made
+ * of decimal digits, with an optional "-" sign before them, or of hexadecimal
+ * digits whose letters are all in the same case, with an optional "0x" before
+ * them. Returns the number of elements written, or 0 if the word isn't
+ * written as a number. If OUT is NULL, the elements are only counted.
+ */
+static size_t cblt_encodeNumber(const char *group, size_t length,
+		uint16_t *out) {
+	uint16_t symbol = CBLT_NUMBER;
+	const char *digits = group;
+	size_t n = length;		/* number of digits */
+	size_t elements;
+	size_t digitsLeft;		/* digits left in the current element */
+	size_t j, k;
+	uint32_t value;
+	bool lower = false;		/* a lowercase hexadecimal digit anywhere */
+	bool upper = false;		/* an uppercase one */
+
+	if (length >= 2 && group[0] == '-') {
+		symbol |= CBLT_NUMBER_PREFIX;
+		++digits;
+		--n;
+	} else if (length >= 3 && group[0] == '0' && group[1] == 'x') {
+		symbol |= CBLT_NUMBER_PREFIX | CBLT_NUMBER_HEX;
+		digits += 2;
+		n -= 2;
+	}
+	if (n > CBLT_MAX_DIGITS)
+		return 0;
+	for (j = 0; j < n; ++j) {
+		if (digits[j] >= 'a' && digits[j] <= 'f')
+			lower = true;
+		else if (digits[j] >= 'A' && digits[j] <= 'F')
+			upper = true;
+		else if (digits[j] < '0' || digits[j] > '9')
+			return 0;
+	}
+	if (lower && upper)
+		return 0;
+	if (lower || upper) {
+		/* a "-" sign only goes before decimal digits */
+		if ((symbol & CBLT_NUMBER_PREFIX) && !(symbol & CBLT_NUMBER_HEX))
+			return 0;
+		symbol |= CBLT_NUMBER_HEX | (upper ? CBLT_NUMBER_UPPER : 0);
+	}
+	symbol |= n;
+
+	if (symbol == CBLT_NUMBER + n && n <= 3) {
+		/* 1 to 3 decimal digits fit in a symbol of their own */
+		if (out != NULL) {
+			value = 0;
+			for (j = 0; j < n; ++j)
+				value = 10 * value + cblt_digitValue(digits[j]);
+			out[0] = CBLT_SMALL_NUMBER + CBLT_SMALL_START[n] + value;
+		}
+		return 1;
+	}
+
+	elements = 1 + CBLT_NUMBER_ELEMENTS(symbol);
+	if (elements >= cblt_getLiteralLength(length))
+		return 0;
+	if (out == NULL)
+		return elements;
+
+	out[0] = symbol;
+	for (k = 1; k < elements; ++k) {
+		value = 0;
+		for (digitsLeft = cblt_getChunkDigits(symbol, k - 1);
+				digitsLeft > 0; --digitsLeft)
+			value = value * ((symbol & CBLT_NUMBER_HEX) ? 16 : 10)
+				+ cblt_digitValue(*digits++);
+		out[k] = (uint16_t)(value + 1);
+	}
+	return elements;
+}
+
+/*
+ * Looks up the word of LENGTH characters at GROUP in REPEATS, for a word that
+ * isn't in the dictionary. If the word is going to be written as a string
+ * literal that came up before, returns the CBLT_REPEAT symbol to write in its
+ * place. Otherwise, returns CBLT_WORD_NOT_FOUND, after adding the literal, or
+ * the last piece of it, to REPEATS if it is short enough. Does nothing if
+ * REPEATS is NULL.
  */
+int32_t cblt_findLiteral(cblt_repeats *repeats, const char *group,
+		size_t length) {
+	size_t rest;			/* characters in the last piece of the literal */
+	int slot;
 
+	if (repeats == NULL || length == 0
+			|| cblt_encodeNumber(group, length, NULL) > 0)
+		return CBLT_WORD_NOT_FOUND;
+	if (length > CBLT_MAX_LITERAL) {
+		/* only a whole word is repeated, but the decoder can't tell the
+		   last piece of a longer one apart */
+		rest = length % CBLT_MAX_LITERAL;
+		if (rest > 0 && rest <= CBLT_MAX_REPEAT)
+			cblt_addRepeat(repeats, group + length - rest, rest);
+		return CBLT_WORD_NOT_FOUND;
+	}
+	if (length > CBLT_MAX_REPEAT)
+		return CBLT_WORD_NOT_FOUND;
+
+	slot = cblt_seeRepeat(repeats, group, length);
+	return (slot < 0) ? CBLT_WORD_NOT_FOUND : CBLT_REPEAT + slot;
+}
+
+/*
+ * Returns the number of elements that cblt_encodeGroup() would write for the
+ * same arguments, without writing anything.
+ */
+static size_t cblt_getGroupLength(const char *group, size_t length,
+		int32_t word, int status, int nextStatus, bool first) {
+	size_t n;
 
-/* copies NC characters from S to DEST, casting from char to uint16_t for each
-   character; 1 char in S translates to 1 uint16_t in DEST */
-static void cblt_copyCharToUint16(const char *s, uint16_t *dest, size_t nc) {
+	switch (status) {
+	case Word:
+		if (word >= 0)
+			/* with the case symbol, if needed */
+			return 1 + ((word & (CBLT_WORD_CAPITALIZED
+				| CBLT_WORD_UPPERCASE)) != 0);
+		/* a number, or else string literal injection */
+		n = cblt_encodeNumber(group, length, NULL);
+		return (n > 0) ? n : cblt_getLiteralLength(length);
+	case Space:
+		/* 1 space before words are implicit, even before the first word
+		   of the sentence if it has leading spaces, unless the only
+		   leading space is a single one. All extra spaces are encoded as
+		   runs. */
+		if (nextStatus == Word) {
+			if (first && length == 1)
+				/* explicit space with the space omission signal */
+				return 1;
+			--length;
+		}
+		return cblt_encodeChars(group, length, false, NULL);
+	case Punctuation:
+		/* with the space omission signal, if needed */
+		return cblt_encodeChars(group, length, nextStatus == Word, NULL);
+	}
+	return 0;
+}
+
+/*
+ * Looks up the word of LENGTH characters at GROUP in DICT with some of its
+ * letters made lowercase, for a word that isn't in DICT as it is. A word with
+ * only its first letter in uppercase, like "The", is looked up with that letter
+ * made lowercase, and a word with no lowercase letters at all, like "THE", is
+ * looked up with all of its letters made lowercase. Returns the symbol of the
+ * word along with CBLT_WORD_CAPITALIZED or CBLT_WORD_UPPERCASE, or
+ * CBLT_WORD_NOT_FOUND.
+ */
+static int32_t cblt_findFolded(const cblt_dict *dict, const char *group,
+		size_t length) {
+	char folded[UINT8_MAX];	/* the word with its letters made lowercase */
+	bool upper = false;		/* an uppercase letter after the first letter */
+	bool lower = false;		/* a lowercase letter anywhere */
+	int32_t word;
 	size_t i;
-	for (i = 0; i < nc; ++i)
-		dest[i] = (uint16_t)s[i];
+
+	if (length == 0 || length > UINT8_MAX)
+		return CBLT_WORD_NOT_FOUND;
+	for (i = 0; i < length; ++i) {
+		upper |= (i > 0 && cblt_isUpper(group[i]));
+		lower |= cblt_isLower(group[i]);
+	}
+
+	if (cblt_isUpper(group[0]) && !upper) {
+		memcpy(folded, group, length);
+		folded[0] += 'a' - 'A';
+		word = cblt_findWordDict(dict, folded, length);
+		return (word < 0) ? word : (word | CBLT_WORD_CAPITALIZED);
+	}
+	if (!lower && upper) {
+		for (i = 0; i < length; ++i)
+			folded[i] = cblt_isUpper(group[i]) ? group[i] + ('a' - 'A')
+				: group[i];
+		word = cblt_findWordDict(dict, folded, length);
+		return (word < 0) ? word : (word | CBLT_WORD_UPPERCASE);
+	}
+	return CBLT_WORD_NOT_FOUND;
+}
+
+/*
+ * Looks up the word of *PLENGTH characters at GROUP in DICT, where GROUP is the
+ * group that TOK has just found. If a phrase in DICT may begin with that word,
+ * TOK is used to look at the groups that follow it, and the longest phrase that
+ * begins at GROUP is taken instead: *PLENGTH is set to the length of the whole
+ * phrase, and TOK is moved past it. The words of a phrase are separated by
+ * single spaces, and the first words of a phrase are always a phrase of their
+ * own, so the phrase is made longer one word at a time until it isn't found.
+ *
+ * A word that is only in DICT in lowercase is found with cblt_findFolded(), but
+ * never begins a phrase.
+ *
+ * Returns the symbol of the word or phrase, or CBLT_WORD_NOT_FOUND if not even
+ * the word is in DICT. If FINAL is false, the text may go on past the end of
+ * TOK, so CBLT_PHRASE_NEEDS_MORE is returned if the end comes too early to tell
+ * which phrase GROUP begins. No phrase is longer than 255 characters, so this
+ * never happens when the end is further away than that.
+ */
+int32_t cblt_findPhrase(const cblt_dict *dict, cblt_tokenizer *tok,
+		const char *group, size_t *plength, bool final) {
+	cblt_tokenizer ahead;	/* looks at the groups after the word */
+	cblt_tokenizer best;	/* TOK after the longest phrase so far */
+	const char *next;		/* a group after the word */
+	size_t length;
+	unsigned int words;		/* number of words in the longest phrase */
+	unsigned int n;			/* number of words found so far */
+	int32_t word, phrase;
+
+	word = cblt_findWordDict(dict, group, *plength);
+	if (word < 0)
+		return cblt_findFolded(dict, group, *plength);
+	if (dict->phrasestart[word] < 2)
+		return word;
+	words = dict->phrasestart[word];
+
+	ahead = *tok;
+	best = *tok;
+	for (n = 1; n < words; ++n) {
+		/* exactly 1 space... */
+		if (cblt_nextToken(&ahead, &next, &length) != Space || length != 1) {
+			if (length == 0 && !final)
+				/* the end of the text, for now */
+				return CBLT_PHRASE_NEEDS_MORE;
+			break;
+		}
+		if (ahead.nextStatus != Word) {
+			if (ahead.nextStatus == EndOfString && !final)
+				return CBLT_PHRASE_NEEDS_MORE;
+			break;
+		}
+		/* ...then the next word */
+		cblt_nextToken(&ahead, &next, &length);
+		if ((size_t)(next + length - group) > UINT8_MAX)
+			/* too long to be in the dictionary */
+			break;
+		if (ahead.nextStatus == EndOfString && !final)
+			return CBLT_PHRASE_NEEDS_MORE;
+
+		phrase = cblt_findPhraseDict(dict, group, next + length - group);
+		if (phrase < 0)
+			break;
+		word = phrase;
+		best = ahead;
+	}
+
+	*plength = best.next - group;
+	*tok = best;
+	return word;
+}
+
+/*
+ * Finds the next character group in the string being split by TOK, just like
+ * cblt_nextToken(), except that a word that begins a phrase in DICT takes the
+ * rest of the phrase along with it. The symbol of the word or phrase is stored
+ * in *PWORD, or else the symbol that repeats it, as found by
+ * cblt_findLiteral() in REPEATS, or CBLT_WORD_NOT_FOUND.
+ */
+static int cblt_nextPhraseToken(const cblt_dict *dict, cblt_tokenizer *tok,
+		cblt_repeats *repeats, const char **pgroup, size_t *plength,
+		int32_t *pword) {
+	int status = cblt_nextToken(tok, pgroup, plength);
+
+	*pword = CBLT_WORD_NOT_FOUND;
+	if (status == Word) {
+		*pword = cblt_findPhrase(dict, tok, *pgroup, plength, true);
+		if (*pword < 0)
+			*pword = cblt_findLiteral(repeats, *pgroup, *plength);
+	}
+	return status;
 }
 
 /* 
@@ -53,92 +694,247 @@ static void cblt_copyCharToUint16(const char *s, uint16_t *dest, size_t nc) {
  * 
  * Returns a nonzero number on success.
  */
-size_t cblt_getEncodedLength(const char *sentence) {
+size_t cblt_getEncodedLengthDict(const cblt_dict *dict, const char *sentence) {
 	size_t length;			/* length of strings */
 	size_t encodedLength;	/* length of encoded integer block */
-	char *mSentence;		/* mutable copy of sentence */
-	char *group;			/* points to a group of characters */
-	int 
-		currentStatus,		/* the type of characters stored in group */
-		nextStatus;			/* the type of characters following group */
+	cblt_tokenizer tok;		/* splits sentence into character groups */
+	const char *group;		/* points to a group of characters */
+	int currentStatus;		/* the type of characters stored in group */
+	int32_t word;			/* the symbol of group, if it is a word */
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	cblt_dict builtin;
 
 	if (sentence == NULL)
 		return 0;
-
-	/* We make a mutable copy of sentence because cblt_splitstr() overwrites
-	   modifies in its first argument. */
-	length = strlen(sentence);
-	mSentence = malloc(sizeof(char) * (length + 1));
-	if (mSentence == NULL)
-		return 0;
-	strcpy(mSentence, sentence);
+	dict = cblt_useDict(dict, &builtin);
 
 	/* use an approach similar to the decoding process to calculate how much
 	   memory will be needed to store the compressed data */
 	encodedLength = 1;
 
-	group = cblt_splitstr(mSentence, &currentStatus, &nextStatus);
-	switch (currentStatus) {
+	cblt_initRepeats(&repeats, NULL, true);
+	cblt_initTokenizer(&tok, sentence, strlen(sentence));
+	while ((currentStatus = cblt_nextPhraseToken(dict, &tok, &repeats, &group,
+			&length, &word)) != EndOfString)
+		encodedLength += cblt_getGroupLength(group, length, word,
+			currentStatus, tok.nextStatus, group == sentence);
+
+	return encodedLength;
+}
+
+size_t cblt_getEncodedLength(const char *sentence) {
+	return cblt_getEncodedLengthDict(NULL, sentence);
+}
+
+/*
+ * Makes sure that the block pointed to by *PBLOCK, which currently holds USED
+ * elements out of *PCAPACITY, has room for at least N more elements. The block
+ * grows by doubling, so that encoding a sentence of any length only takes a
+ * handful of reallocations. Returns false if the memory allocation fails, in
+ * which case the original block is left untouched.
+ */
+static bool cblt_reserve(uint16_t **pblock, size_t *pcapacity, size_t used,
+		size_t n) {
+	size_t capacity = *pcapacity;
+	uint16_t *block;
+
+	if (used + n <= capacity)
+		return true;
+
+	while (capacity < used + n)
+		capacity *= 2;
+	block = realloc(*pblock, sizeof(uint16_t) * capacity);
+	if (block == NULL)
+		return false;
+
+	*pblock = block;
+	*pcapacity = capacity;
+	return true;
+}
+
+/*
+ * Adds an entry to INDEX for a character group whose first symbol will be
+ * written at index TOKEN, and whose first character will be decoded at offset
+ * DECODED. NOSPACE tells whether the decoder will leave out the implicit space
+ * before a word or string literal at that point. Returns false if a memory
+ * allocation fails.
+ */
+static bool cblt_addIndexEntry(cblt_index *index, size_t token, size_t decoded,
+		bool noSpace) {
+	cblt_indexEntry *entries;
+	cblt_indexEntry *entry;
+
+	if (index->count == index->capacity) {
+		entries = realloc(index->entries,
+			sizeof(cblt_indexEntry) * (index->capacity * 2 + 16));
+		if (entries == NULL)
+			return false;
+		index->entries = entries;
+		index->capacity = index->capacity * 2 + 16;
+	}
+
+	entry = &index->entries[index->count++];
+	entry->token = token;
+	entry->decoded = decoded;
+	entry->noSpace = noSpace;
+	return true;
+}
+
+/*
+ * Encodes the character group of LENGTH characters at GROUP into OUT, which
+ * must have room for at least LENGTH + 2 elements: a word literal of length 1
+ * takes 2, and a punctuation group takes length + 1 with the space omission
+ * signal. WORD is the symbol of a word or phrase, as found by
+ * cblt_findPhrase(), along with the case of its letters, or the CBLT_REPEAT
+ * symbol found by cblt_findLiteral(), and is negative if the group has to be
+ * written as a number or a string literal. STATUS is the
+ * status of the group and NEXTSTATUS is the status of the group after it.
+ * FIRST tells whether the group is at the very start of the sentence. Returns
+ * the number of elements written, which may be 0.
+ */
+size_t cblt_encodeGroup(const char *group, size_t length, int32_t word,
+		int status, int nextStatus, bool first, uint16_t *out) {
+	size_t i = 0;			/* index for out */
+	size_t n;				/* elements of a number, or characters in a
+							   piece of a literal */
+
+	switch (status) {
 	case Word:
-		if (cblt_findWord(group) != CBLT_WORD_NOT_FOUND) {
-			++encodedLength;
+		if (word >= 0) {
+			if (word & CBLT_WORD_CAPITALIZED)
+				out[i++] = CBLT_CAPITALIZE;
+			else if (word & CBLT_WORD_UPPERCASE)
+				out[i++] = CBLT_UPPERCASE;
+			out[i++] = CBLT_WORD_SYMBOL(word);
+		} else if ((n = cblt_encodeNumber(group, length, out)) > 0) {
+			i += n;
 		} else {
-			/* string literal injection */
-			/* integer ceiling division */
-			length = strlen(group) + 1;
-			encodedLength += (length / 2 + (length % 2 != 0)) + 1;
+			/* string literal injection, in pieces of at most
+			   CBLT_MAX_LITERAL characters */
+			while (1) {
+				n = (length < CBLT_MAX_LITERAL) ? length : CBLT_MAX_LITERAL;
+				out[i++] = CBLT_LITERAL + n;
+				/* An odd number of characters leaves a null byte in the last
+				   element. No character is ever null, so the element never
+				   is either. */
+				out[i + CBLT_LITERAL_ELEMENTS(n) - 1] = 0x0000;
+				memcpy(&out[i], group, n);
+				i += CBLT_LITERAL_ELEMENTS(n);
+				group += n;
+				length -= n;
+				if (length == 0)
+					break;
+				out[i++] = CBLT_NO_SPACE;
+			}
 		}
 		break;
 	case Space:
-		encodedLength += strlen(group);
+		/* 1 space before words are implicit, since the decoder puts a
+		   space before every word that isn't at the very start of the
+		   sentence. All extra spaces are encoded as runs. All spaces
+		   before punctuation symbols, and all trailing spaces before the
+		   end of the string, must be explicit. A single leading space
+		   can't be left out, because nothing comes before it to make the
+		   decoder write it, so it is written explicitly along with a
+		   space omission signal instead. */
+		if (nextStatus == Word) {
+			if (first && length == 1) {
+				out[i++] = CBLT_RUN_SPACES + 1 + CBLT_RUN_NO_SPACE;
+				break;
+			}
+			--length;
+		}
+		i += cblt_encodeChars(group, length, false, out + i);
 		break;
 	case Punctuation:
-		encodedLength += strlen(group);
-		if (nextStatus == Word)
-			/* space omission signal */
-			++encodedLength;
+		/* with the space omission signal, if needed */
+		i += cblt_encodeChars(group, length, nextStatus == Word, out + i);
 		break;
-	/* EndOfString is handled in the while loop below */
-	}
-
-	while (currentStatus != EndOfString) {
-		group = cblt_splitstr(NULL, &currentStatus, &nextStatus);
-		switch (currentStatus) {
-		case Word:
-			if (cblt_findWord(group) != CBLT_WORD_NOT_FOUND) {
-				++encodedLength;
-			} else {
-				/* string literal injection */
-				/* integer ceiling division */
-				length = strlen(group) + 1;
-				encodedLength += (length / 2 + (length % 2 != 0)) + 1;
-			}
-			break;
-		case Space:
-			/* TODO:
-			   possibly consider optimizing this case? */
-			if (nextStatus == Word) {
-				/* 1 space before words (except the first word) are implicit.
-				   All extra spaces are encoded by direct ASCII injection. */
-				encodedLength += strlen(group) - 1;
-			} else {
-				/* Punctuation and End of String */
-				/* All spaces before punctuation symbols, and all trailing
-				   spaces before the end of the string, must be explicit */
-				encodedLength += strlen(group);
+	}
+
+	return i;
+}
+
+/*
+ * Encodes the first LENGTH characters of S, which do not need to be null-
+ * terminated, into a newly allocated block of uint16_t's. The block is null-
+ * terminated, but it is not trimmed, so it may be larger than it needs to be.
+ * The number of elements written, NOT including the null terminator, is stored
+ * in *PCOUNT.
+ *
+ * Every character group is split and looked up exactly once, directly from S,
+ * which is never modified or copied. The output is written into a block that
+ * starts out with one element per character of S, which is almost always
+ * enough, and grows if it isn't.
+ *
+ * If INDEX is not NULL, an entry is added to it at the first character group
+ * that starts at least INTERVAL characters after the previous entry. INDEX must
+ * be empty or zeroed beforehand.
+ *
+ * If REPEAT is false, a string literal is written out every time, even if it
+ * came up before, and it is left to cblt_repeatLiterals() to repeat them.
+ *
+ * Returns NULL if a memory allocation fails.
+ */
+uint16_t *cblt_encodeRange(const cblt_dict *dict, const char *s,
+		size_t length, size_t *pcount, cblt_index *index, size_t interval,
+		bool repeat) {
+	cblt_tokenizer tok;		/* splits s into character groups */
+	const char *group;		/* points to a group of characters */
+	int currentStatus;		/* the type of characters stored in group */
+	int32_t word;			/* the symbol of group, if it is a word */
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	size_t nextEntry = 0;	/* offset where the next index entry is due */
+	/* The state the decoder will be in at the start of the current group:
+	   whether the previous group left out the space before it, and whether
+	   the decoder will omit the space before a word. */
+	bool spaceOmitted = false;
+	bool noSpace = true;
+
+	uint16_t *compressed;	/* the compressed sentence */
+	size_t capacity;		/* number of elements allocated for compressed */
+	size_t i = 0;			/* index for compressed */
+	size_t n;				/* number of elements written for a group */
+
+	capacity = length + 1;
+	compressed = malloc(sizeof(uint16_t) * capacity);
+	if (compressed == NULL)
+		return NULL;
+
+	cblt_initRepeats(&repeats, NULL, true);
+	cblt_initTokenizer(&tok, s, length);
+	while ((currentStatus = cblt_nextPhraseToken(dict, &tok,
+			repeat ? &repeats : NULL, &group, &length, &word))
+			!= EndOfString) {
+		if (index != NULL && (size_t)(group - s) >= nextEntry) {
+			if (!cblt_addIndexEntry(index, i, group - s - spaceOmitted,
+					noSpace)) {
+				free(compressed);
+				return NULL;
 			}
-			break;
-		case Punctuation:
-			encodedLength += strlen(group);
-			if (nextStatus == Word)
-				/* space omission signal */
-				++encodedLength;
-			break;
+			nextEntry = group - s + interval;
+		}
+		/* keep 1 extra element for the terminator */
+		if (!cblt_reserve(&compressed, &capacity, i, length + 3)) {
+			free(compressed);
+			return NULL;
 		}
+
+		n = cblt_encodeGroup(group, length, word, currentStatus,
+			tok.nextStatus, group == s, compressed + i);
+		i += n;
+		/* A group ends in a space omission signal exactly when the decoder
+		   will omit the space before the next word. A space that was left
+		   out before a word hasn't been decoded yet at the next group. */
+		noSpace = (currentStatus != Word && n > 0
+			&& cblt_omitsSpace(compressed[i - 1]));
+		spaceOmitted = (currentStatus == Space && tok.nextStatus == Word
+			&& !noSpace);
 	}
 
-	free(mSentence);
-	return encodedLength;
+	compressed[i] = 0x0000;
+	*pcount = i;
+	return compressed;
 }
 
 /*
@@ -151,264 +947,616 @@ size_t cblt_getEncodedLength(const char *sentence) {
  * If the word is not found, then the string that contains the word is copied
  * directly into the array, including the null terminating character.
  *
+ * SENTENCE is never modified or copied, and this function keeps no state
+ * between calls, so it is safe to call from multiple threads at once. The
+ * output block is trimmed to its actual size before it is returned.
+ *
  * It is the job of the programmer to free() the returned pointer after doing
  * something meaningful with the output of this function.
  */
+uint16_t *cblt_encodeSentenceDict(const cblt_dict *dict, const char *sentence) {
+	uint16_t *compressed;	/* the compressed sentence */
+	uint16_t *trimmed;		/* the compressed sentence, after trimming */
+	size_t count;			/* number of elements in compressed */
+	cblt_dict builtin;
+
+	if (sentence == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+
+	compressed = cblt_encodeRange(dict, sentence, strlen(sentence), &count,
+		NULL, 0, true);
+	if (compressed == NULL)
+		return NULL;
+
+	/* give back the memory we didn't use */
+	trimmed = realloc(compressed, sizeof(uint16_t) * (count + 1));
+	return (trimmed != NULL) ? trimmed : compressed;
+}
+
 uint16_t *cblt_encodeSentence(const char *sentence) {
-	size_t length;			/* stores the length of block of memory */
+	return cblt_encodeSentenceDict(NULL, sentence);
+}
 
-	char *mSentence;		/* points to a mutable copy of sentence */
-	char *group;			/* points to a group of characters */
-	int 
-		currentStatus,		/* the type of characters stored in group */
-		nextStatus;			/* the type of characters following group */
+/*
+ * Encodes the first LENGTH characters of SENTENCE into the CAPACITY elements at
+ * OUT, without allocating any memory. See cobalt.h.
+ */
+bool cblt_encodeIntoDict(const cblt_dict *dict, const char *sentence,
+		size_t length, uint16_t *out, size_t capacity, size_t *pwritten) {
+	cblt_tokenizer tok;		/* splits sentence into character groups */
+	const char *group;		/* points to a group of characters */
+	int currentStatus;		/* the type of characters stored in group */
+	int32_t word;			/* the symbol of group, if it is a word */
+	size_t i = 0;			/* index for out, or the length needed */
+	size_t n;				/* number of elements for a group */
+	bool fits = true;		/* whether everything so far has fit in out */
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	cblt_dict builtin;
 
+	if (pwritten != NULL)
+		*pwritten = 0;
+	if (sentence == NULL || pwritten == NULL || (out == NULL && capacity > 0))
+		return false;
+	dict = cblt_useDict(dict, &builtin);
+
+	cblt_initRepeats(&repeats, NULL, true);
+	cblt_initTokenizer(&tok, sentence, length);
+	while ((currentStatus = cblt_nextPhraseToken(dict, &tok, &repeats, &group,
+			&length, &word)) != EndOfString) {
+		/* keep 1 element for the terminator */
+		if (fits && capacity - i > length + 2) {
+			/* room for any group of this length */
+			i += cblt_encodeGroup(group, length, word, currentStatus,
+				tok.nextStatus, group == sentence, out + i);
+			continue;
+		}
+
+		n = cblt_getGroupLength(group, length, word, currentStatus,
+			tok.nextStatus, group == sentence);
+		if (fits && capacity - i > n) {
+			cblt_encodeGroup(group, length, word, currentStatus,
+				tok.nextStatus, group == sentence, out + i);
+		} else {
+			/* from here on, we only count */
+			fits = false;
+		}
+		i += n;
+	}
+
+	/* the null terminator */
+	++i;
+	*pwritten = i;
+	if (!fits || i > capacity)
+		return false;
+	out[i - 1] = 0x0000;
+	return true;
+}
+
+bool cblt_encodeInto(const char *sentence, size_t length, uint16_t *out,
+		size_t capacity, size_t *pwritten) {
+	return cblt_encodeIntoDict(NULL, sentence, length, out, capacity,
+		pwritten);
+}
+
+/*
+ * Encodes SENTENCE exactly like cblt_encodeSentence(), and fills in INDEX with
+ * an entry roughly every INTERVAL characters of SENTENCE. See cobalt.h.
+ */
+uint16_t *cblt_encodeSentenceIndexedDict(const cblt_dict *dict,
+		const char *sentence, size_t interval, cblt_index *index) {
 	uint16_t *compressed;	/* the compressed sentence */
-	size_t i = 0;			/* index for compressed */
-	int32_t wordNum;		/* stores result of cblt_findWord() */
+	uint16_t *trimmed;		/* the compressed sentence, after trimming */
+	size_t count;			/* number of elements in compressed */
+	size_t length;			/* length of sentence */
+	cblt_dict builtin;
 
-	if (sentence == NULL)
+	if (sentence == NULL || index == NULL)
 		return NULL;
-	
-	/* We make a mutable copy of sentence because cblt_splitstr() modifies
-	   characters in its first argument. */
+	dict = cblt_useDict(dict, &builtin);
+
+	index->count = 0;
+	index->capacity = 0;
+	index->entries = NULL;
+	if (interval == 0)
+		interval = CBLT_DEFAULT_INDEX_INTERVAL;
+
 	length = strlen(sentence);
-	mSentence = malloc(sizeof(char) * (length + 1));
-	if (mSentence == NULL)
-		return NULL;
-	strcpy(mSentence, sentence);
-	
-	length = cblt_getEncodedLength(sentence);
-	compressed = malloc(sizeof(uint16_t) * (length));
+	compressed = cblt_encodeRange(dict, sentence, length, &count, index,
+		interval, true);
 	if (compressed == NULL) {
-		free(mSentence);
+		cblt_freeIndex(index);
 		return NULL;
 	}
+	index->decodedLength = length + 1;
 
-	/* special treatment for first character group */
-	group = cblt_splitstr(mSentence, &currentStatus, &nextStatus);
-	switch (currentStatus) {
-	case Word:
-		wordNum = cblt_findWord(group);
-		if (wordNum != CBLT_WORD_NOT_FOUND) {
-			compressed[i++] = (uint16_t)wordNum;
-		} else {
-			/* string literal injection */
-			compressed[i++] = CBLT_BEGIN_STRING;
-			length = strlen(group);
-			/* We fill this integer with all 1s, to avoid having an element be
-			   all zero from the string's null terminator. This would cause a
-			   premature termination of the integer block. */
-			compressed[i + length / 2] = 0xffff;
-			/* memcpy and integer ceiling division require ++length */
-			++length;
-			memcpy(&compressed[i], group, length);
-			i += (length / 2 + (length % 2 != 0));
-		}
-		break;
-	case Space:
-		length = strlen(group);
-		cblt_copyCharToUint16(group, compressed + i, length);
-		i += length;
-		break;
-	case Punctuation:
-		length = strlen(group);
-		cblt_copyCharToUint16(group, compressed + i, length);
-		i += length;
-		if (nextStatus == Word)
-			/* space omission signal */
-			compressed[i++] = CBLT_NO_SPACE;
-		break;
-	/* EndOfString is handled by the while loop below */
-	}
-
-	while (currentStatus != EndOfString) {
-		group = cblt_splitstr(NULL, &currentStatus, &nextStatus);
-		switch (currentStatus) {
-		case Word:
-			wordNum = cblt_findWord(group);
-			if (wordNum != CBLT_WORD_NOT_FOUND) {
-				compressed[i++] = (uint16_t)wordNum;
-			} else {
-				/* string literal injection */
-				compressed[i++] = CBLT_BEGIN_STRING;
-				length = strlen(group);
-				compressed[i + length / 2] = 0xffff;
-				++length;
-				memcpy(&compressed[i], group, length);
-				i += (length / 2 + (length % 2 != 0));
-			}
-			break;
-		case Space:
-			if (nextStatus == Word) {
-				/* 1 space before words (except the first word) are implicit.
-				   All extra spaces are encoded by direct ASCII injection. */
-				length = strlen(group) - 1;
-				if (length != 0)	/* save a few push and pop instructions */
-					cblt_copyCharToUint16(group, compressed + i, length);
-				i += length;
-			} else {
-				/* Punctuation and End of String */
-				/* All spaces before punctuation symbols, and all trailing
-				   spaces before the end of the string, must be explicit */
-				length = strlen(group);
-				cblt_copyCharToUint16(group, compressed + i, length);
-				i += length;
-			}
-			break;
-		case Punctuation:
-			length = strlen(group);
-			cblt_copyCharToUint16(group, compressed + i, length);
-			i += length;
-			if (nextStatus == Word)
-				/* space omission signal */
-				compressed[i++] = CBLT_NO_SPACE;
-			break;
-		}
-	}
+	trimmed = realloc(compressed, sizeof(uint16_t) * (count + 1));
+	return (trimmed != NULL) ? trimmed : compressed;
+}
 
-	compressed[i] = 0x0000;
-	free(mSentence);
-	return compressed;
+uint16_t *cblt_encodeSentenceIndexed(const char *sentence, size_t interval,
+		cblt_index *index) {
+	return cblt_encodeSentenceIndexedDict(NULL, sentence, interval, index);
+}
+
+/* Frees the entries of INDEX, leaving it empty. */
+void cblt_freeIndex(cblt_index *index) {
+	if (index == NULL)
+		return;
+	free(index->entries);
+	index->entries = NULL;
+	index->count = 0;
+	index->capacity = 0;
 }
 
 /*
- * Returns the length of the decoded sentence contained by COMPRESSED, including
- * the null terminator at the end of the string.
- * 
- * This function expects the input array to be perfectly formatted, with no
- * invalid sequences of numbers.
+ * Returns the number of characters that the elements of COMPRESSED starting at
+ * index I decode to, NOT including the null terminator. NOSPACE and REPEATS are
+ * the state of the decoder at index I, like in cblt_decodeRange(), and REPEATS
+ * is left in the state at the end.
  */
-size_t cblt_getDecodedLength(const uint16_t *compressed) {
+static size_t cblt_countDecoded(const cblt_dict *dict,
+		const uint16_t *compressed, size_t i, bool noSpace,
+		cblt_repeats *repeats) {
 	size_t length;			/* length of a word */
-	size_t decodedLength;	/* length of the output string */
-	unsigned words = 0;		/* number of actual words counted */
-	size_t i;				/* index for compressed */
-	
-	if (compressed == NULL)
-		return 0;
+	size_t decodedLength = 0;	/* length of the output string */
+	size_t slot;			/* the slot of a repeated literal */
 
-	/* initialize to 1 to account for null terminator */
-	decodedLength = 1;
-	for (i = 0; compressed[i] != 0; ) {
+	while (compressed[i] != 0) {
 		if (compressed[i] < 0x100) {
 			/* direct byte injection */
 			++decodedLength;
 			++i;
-		} else if (compressed[i] < WORDMAP_LEN) {
-			/* valid words */
-			decodedLength += strlen( WORDTABLE + WORDMAP[compressed[i]] );
+			noSpace = false;
+		} else if (compressed[i] < dict->symbols) {
+			/* valid words, with their implicit leading space */
+			decodedLength += !noSpace;
+			decodedLength += dict->wordlen[compressed[i]];
 			++i;
-			++words;
+			noSpace = false;
+		} else if (CBLT_IS_RUN(compressed[i])) {
+			/* a run of spaces, tabs or line breaks */
+			cblt_getRun(compressed[i], &length);
+			decodedLength += length;
+			noSpace = (compressed[i] & CBLT_RUN_NO_SPACE) != 0;
+			++i;
+		} else if (CBLT_IS_LITERAL(compressed[i])) {
+			/* string literal, with its implicit leading space */
+			length = CBLT_LITERAL_LENGTH(compressed[i]);
+			decodedLength += !noSpace + length;
+			if (length <= CBLT_MAX_REPEAT)
+				cblt_addRepeat(repeats, (const char *)(compressed + i + 1),
+					length);
+			i += 1 + CBLT_LITERAL_ELEMENTS(length);
+			noSpace = false;
+		} else if (CBLT_IS_REPEAT(compressed[i])
+				&& CBLT_REPEAT_SLOT(compressed[i]) < repeats->count) {
+			/* a string literal that came up before */
+			slot = CBLT_REPEAT_SLOT(compressed[i]);
+			decodedLength += !noSpace + repeats->length[slot];
+			cblt_useRepeat(repeats, slot);
+			++i;
+			noSpace = false;
+		} else if (CBLT_IS_SMALL_NUMBER(compressed[i])) {
+			/* a number of 1 to 3 digits, with its implicit leading space */
+			decodedLength += !noSpace + cblt_getSmallDigits(compressed[i]);
+			++i;
+			noSpace = false;
+		} else if (CBLT_IS_NUMBER(compressed[i])) {
+			/* any other number, with its implicit leading space */
+			decodedLength += !noSpace + cblt_getNumberLength(compressed[i]);
+			i += 1 + CBLT_NUMBER_ELEMENTS(compressed[i]);
+			noSpace = false;
 		} else if (compressed[i] == CBLT_BEGIN_STRING) {
-			/* string literal */
+			/* string literal from an older block */
 			++i;	/* skip past the CBLT_BEGIN_STRING symbol */
+			decodedLength += !noSpace;
 			length = strlen( (char *)(compressed + i) );
 			decodedLength += length;
 			/* then integer ceiling division */
 			++length;
 			i += (length / 2 + (length % 2 != 0));
-			++words;
+			noSpace = false;
 		} else if (compressed[i] == CBLT_NO_SPACE) {
-			--decodedLength;
+			noSpace = true;
 			++i;
 		} else {
-			/* any other codes are invalid, so move on */
+			/* The case of a word doesn't change its length, and any other
+			   codes are invalid, so move on. */
 			++i;
 		}
 	}
 
-	/* If there is a punctuation character followed by a word character at the
-	   beginning of the string, then there is an implicit space before the word
-	   character. Skip past all leading spaces and check if the first non-space
-	   symbol is a punctuation character. If it is, increment WORDS since a
-	   leading punctuation marker counts as a pseudo-word. */
-	i = 0;
-	while (compressed[i] == ' ')
-		/* this syntax is easier to understand than an empty for loop. */
-		++i;
-	/* Using cblt_getCharStatus() only makes sense for values up to 255. */
-	if ( (compressed[i] < 0x100)
-		&& (cblt_getCharStatus(compressed[i]) == Punctuation) )
-		++words;
-
-	/* There is an implicit space between every word, except for where
-	   CBLT_NO_SPACE compensated by decrementing the encodedLength. If there are
-	   less than 2 words, there are no implicit spaces. */
-	if (words > 1)
-		decodedLength += words - 1;
-
 	return decodedLength;
 }
 
 /*
- * This function takes a single null-terminated array of 16-bit unsigned
- * integers as an argument and returns a pointer to a null-terminated string of
- * characters containing the original sentence. The block of memory pointed to
- * by the return value is dynamically allocated, so it is the job of the
- * programmer to free() the pointer after doing something meaningful with the
- * data.
+ * Returns the length of the decoded sentence contained by COMPRESSED, including
+ * the null terminator at the end of the string.
+ * 
+ * This function expects the input array to be perfectly formatted, with no
+ * invalid sequences of numbers.
  */
+size_t cblt_getDecodedLengthDict(const cblt_dict *dict,
+		const uint16_t *compressed) {
+	cblt_repeats repeats;
+	cblt_dict builtin;
+	if (compressed == NULL)
+		return 0;
+	dict = cblt_useDict(dict, &builtin);
 
-char *cblt_decodeSentence(const uint16_t *compressed) {
-	size_t i;		/* index for compressed */
-	char *sentence;	/* decoded data */
-	size_t j;		/* index for sentence */
-	size_t length;	/* length of a word */
+	/* add 1 to account for null terminator */
+	/* By my specification, the first word will not have a leading space
+	   unless explicitly specified by a literal ASCII space. */
+	cblt_initRepeats(&repeats, NULL, false);
+	return cblt_countDecoded(dict, compressed, 0, true, &repeats) + 1;
+}
 
-	if (compressed == NULL)
-		return NULL;
+size_t cblt_getDecodedLength(const uint16_t *compressed) {
+	return cblt_getDecodedLengthDict(NULL, compressed);
+}
 
-	/* We use calloc in this case because we will make a special assumption
-	   during decoding: that untouched bytes in SENTENCE are zero. A non-zero
-	   byte indicates that a CBLT_NO_SPACE symbol was present in the last
-	   element in COMPRESSED. */
-	length = cblt_getDecodedLength(compressed);
-	sentence = calloc(length, sizeof(char));
-	if (sentence == NULL)
-		return NULL;
+/*
+ * Decodes the elements of COMPRESSED starting at index *PI, up to but not
+ * including index TO or the null terminator, whichever comes first, into the
+ * CAPACITY characters at SENTENCE. Decoding stops early, right before a symbol
+ * that might not fit. *PI is left at the first symbol that wasn't decoded, and
+ * *PNOSPACE and REPEATS hold the state of the decoder before and after.
+ *
+ * Returns the number of characters written.
+ */
+static size_t cblt_decodeSome(const cblt_dict *dict,
+		const uint16_t *compressed, size_t *pi,
+		size_t to, char *sentence, size_t capacity, bool *pnoSpace,
+		cblt_repeats *repeats) {
+	size_t i = *pi;			/* index for compressed */
+	size_t j = 0;			/* index for sentence */
+	size_t length;			/* length of a word */
+	size_t slot;			/* the slot of a repeated literal */
+	const char *run;		/* the characters of a run */
+	bool noSpace = *pnoSpace;
 
-	/* By my specification, the first word will not have a leading space unless
-	   explicitly specified by a literal ASCII space. */
-	sentence[0] = 1;
+	for ( ; i < to && compressed[i] != 0; ) {
+		/* a word and its leading space always fit in this much room */
+		if (capacity - j < CBLT_MAX_WORD_ROOM)
+			break;
 
-	for (i = 0; compressed[i] != 0; ) {
 		if (compressed[i] < 0x100) {
 			/* direct byte injection */
 			sentence[j++] = (char)compressed[i++];
-		} else if (compressed[i] < WORDMAP_LEN) {
+			noSpace = false;
+		} else if (compressed[i] < dict->symbols) {
 			/* valid words */
 			/* insert leading space if applicable */
-			if (sentence[j] == 0)
+			if (!noSpace)
 				sentence[j++] = ' ';
 			
-			length = strlen( WORDTABLE + WORDMAP[compressed[i]] );
-			memcpy(sentence + j, WORDTABLE + WORDMAP[compressed[i]], length);
+			length = dict->wordlen[compressed[i]];
+			cblt_copyWord(sentence + j,
+				dict->wordtable + dict->wordmap[compressed[i]], length);
+			j += length;
+			++i;
+			noSpace = false;
+		} else if (CBLT_IS_RUN(compressed[i])) {
+			/* a run of spaces, tabs or line breaks, which also fits */
+			run = cblt_getRun(compressed[i], &length);
+			cblt_copyWord(sentence + j, (const unsigned char *)run, length);
+			j += length;
+			noSpace = (compressed[i] & CBLT_RUN_NO_SPACE) != 0;
+			++i;
+		} else if (CBLT_IS_LITERAL(compressed[i])) {
+			/* string literal, which fits in the same room as a word */
+			if (!noSpace)
+				sentence[j++] = ' ';
+
+			length = CBLT_LITERAL_LENGTH(compressed[i]);
+			cblt_copyWord(sentence + j,
+				(const unsigned char *)(compressed + i + 1), length);
+			if (length <= CBLT_MAX_REPEAT)
+				cblt_addRepeat(repeats, (const char *)(compressed + i + 1),
+					length);
+			j += length;
+			i += 1 + CBLT_LITERAL_ELEMENTS(length);
+			noSpace = false;
+		} else if (CBLT_IS_REPEAT(compressed[i])
+				&& CBLT_REPEAT_SLOT(compressed[i]) < repeats->count) {
+			/* a string literal that came up before */
+			if (!noSpace)
+				sentence[j++] = ' ';
+
+			slot = CBLT_REPEAT_SLOT(compressed[i]);
+			length = repeats->length[slot];
+			cblt_copyWord(sentence + j,
+				(const unsigned char *)repeats->text[slot], length);
+			cblt_useRepeat(repeats, slot);
 			j += length;
 			++i;
+			noSpace = false;
+		} else if (CBLT_IS_SMALL_NUMBER(compressed[i])) {
+			/* a number of 1 to 3 digits */
+			if (!noSpace)
+				sentence[j++] = ' ';
+			j += cblt_formatSmallNumber(compressed[i], sentence + j);
+			++i;
+			noSpace = false;
+		} else if (CBLT_IS_NUMBER(compressed[i])) {
+			/* any other number, which is never longer than a word */
+			if (!noSpace)
+				sentence[j++] = ' ';
+			j += cblt_formatNumber(compressed + i, sentence + j);
+			i += 1 + CBLT_NUMBER_ELEMENTS(compressed[i]);
+			noSpace = false;
 		} else if (compressed[i] == CBLT_BEGIN_STRING) {
-			/* string literal */
+			/* string literal from an older block */
+			length = strlen( (char *)(compressed + i + 1) );
+			if (capacity - j < length + 1)
+				break;
 			++i;	/* skip past the CBLT_BEGIN_STRING symbol */
 			/* insert leading space if applicable */
-			if (sentence[j] == 0)
+			if (!noSpace)
 				sentence[j++] = ' ';
 			
-			length = strlen( (char *)(compressed + i) );
 			memcpy(sentence + j, compressed + i, length);
 			j += length;
 			/* then integer ceiling division */
 			++length;
 			i += (length / 2 + (length % 2 != 0));
+			noSpace = false;
 		} else if (compressed[i] == CBLT_NO_SPACE) {
 			/* The next word will not have a leading space */
-			sentence[j] = 1;
+			noSpace = true;
 			++i;
+		} else if ((compressed[i] == CBLT_CAPITALIZE
+				|| compressed[i] == CBLT_UPPERCASE)
+				&& compressed[i + 1] >= 0x100
+				&& compressed[i + 1] < dict->symbols) {
+			/* a word with some of its letters made uppercase, decoded
+			   together with its case symbol */
+			if (!noSpace)
+				sentence[j++] = ' ';
+
+			length = dict->wordlen[compressed[i + 1]];
+			cblt_copyWord(sentence + j,
+				dict->wordtable + dict->wordmap[compressed[i + 1]], length);
+			cblt_applyCase(sentence + j, length, compressed[i]);
+			j += length;
+			i += 2;
+			noSpace = false;
 		} else {
 			/* any other codes are invalid, so move on */
 			++i;
 		}
 	}
-	sentence[j] = '\0';
 
-	return sentence;
+	*pi = i;
+	*pnoSpace = noSpace;
+	return j;
+}
+
+/*
+ * Decodes the elements of COMPRESSED starting at index FROM, up to but not
+ * including index TO or the null terminator, whichever comes first. FROM and TO
+ * must both be the index of the start of a symbol, and not somewhere in the
+ * middle of a string literal or a number, or right after a case symbol. The
+ * decoded characters are written to SENTENCE, which must be large enough to
+ * hold them, and are NOT null-terminated.
+ *
+ * NOSPACE is whether a word at the very start of the range should go without
+ * its leading space; this is true at the start of a sentence, and right after
+ * a CBLT_NO_SPACE symbol. REPEATS holds the string literals that can be
+ * repeated at that point, as cblt_followRepeats() finds them, and is left as
+ * they are at the end of the range. Since this is all the state the decoder
+ * carries from one symbol to the next, any range of symbols can be decoded
+ * independently of the others, as long as its starting state is known.
+ *
+ * Returns the number of characters written.
+ */
+size_t cblt_decodeRange(const cblt_dict *dict, const uint16_t *compressed,
+		size_t from, size_t to, char *sentence, bool noSpace,
+		cblt_repeats *repeats) {
+	return cblt_decodeSome(dict, compressed, &from, to, sentence, SIZE_MAX,
+		&noSpace, repeats);
+}
+
+/*
+ * Brings REPEATS from the state it is in at index FROM of COMPRESSED to the
+ * state it is in at index TO, or at the null terminator, whichever comes
+ * first, without decoding anything. FROM and TO must both be the index of the
+ * start of a symbol. This only has to look at every symbol, which is a lot
+ * faster than decoding them.
+ */
+void cblt_followRepeats(const uint16_t *compressed, size_t from, size_t to,
+		cblt_repeats *repeats) {
+	size_t i = from;		/* index for compressed */
+	size_t length;			/* length of a literal */
+
+	while (i < to && compressed[i] != 0) {
+		if (CBLT_IS_LITERAL(compressed[i])) {
+			length = CBLT_LITERAL_LENGTH(compressed[i]);
+			if (length <= CBLT_MAX_REPEAT)
+				cblt_addRepeat(repeats, (const char *)(compressed + i + 1),
+					length);
+			i += 1 + CBLT_LITERAL_ELEMENTS(length);
+		} else if (CBLT_IS_REPEAT(compressed[i])
+				&& CBLT_REPEAT_SLOT(compressed[i]) < repeats->count) {
+			cblt_useRepeat(repeats, CBLT_REPEAT_SLOT(compressed[i]));
+			++i;
+		} else if (CBLT_IS_NUMBER(compressed[i])) {
+			i += 1 + CBLT_NUMBER_ELEMENTS(compressed[i]);
+		} else if (compressed[i] == CBLT_BEGIN_STRING) {
+			/* then integer ceiling division */
+			length = strlen( (char *)(compressed + i + 1) ) + 1;
+			i += 1 + (length / 2 + (length % 2 != 0));
+		} else {
+			++i;
+		}
+	}
+}
+
+/*
+ * Writes every string literal among the COUNT elements of COMPRESSED that came
+ * up before as a CBLT_REPEAT symbol instead, for a block that was encoded
+ * without repeating them, and returns the number of elements left. The block
+ * then comes out just as if the literals had been repeated while it was being
+ * encoded. It only gets shorter, so it is rewritten in place, and its null
+ * terminator, if it has one, isn't moved.
+ */
+size_t cblt_repeatLiterals(uint16_t *compressed, size_t count) {
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	size_t i = 0;			/* index of the next element read */
+	size_t j = 0;			/* index of the next element written */
+	size_t n;				/* elements in the current symbol */
+	size_t length;			/* length of a literal */
+	uint16_t symbol;
+	/* the symbol before the current one, and the one before that */
+	uint16_t previous = 0, earlier = 0;
+	int slot;
+
+	cblt_initRepeats(&repeats, NULL, true);
+	while (i < count) {
+		symbol = compressed[i];
+		n = 1;
+		if (CBLT_IS_LITERAL(symbol))
+			n += CBLT_LITERAL_ELEMENTS(CBLT_LITERAL_LENGTH(symbol));
+		else if (CBLT_IS_NUMBER(symbol))
+			n += CBLT_NUMBER_ELEMENTS(symbol);
+		if (n > count - i)
+			n = count - i;
+		memmove(compressed + j, compressed + i, sizeof(uint16_t) * n);
+		i += n;
+
+		length = CBLT_LITERAL_LENGTH(symbol);
+		if (!CBLT_IS_LITERAL(symbol) || length > CBLT_MAX_REPEAT) {
+			j += n;
+		} else if (previous == CBLT_NO_SPACE
+				&& earlier == CBLT_LITERAL + CBLT_MAX_LITERAL) {
+			/* the last piece of a longer word, which is only kept */
+			cblt_addRepeat(&repeats, (const char *)(compressed + j + 1),
+				length);
+			j += n;
+		} else if ((slot = cblt_seeRepeat(&repeats,
+				(const char *)(compressed + j + 1), length)) >= 0) {
+			compressed[j++] = (uint16_t)(CBLT_REPEAT + slot);
+		} else {
+			j += n;
+		}
+		earlier = previous;
+		previous = symbol;
+	}
+	return j;
+}
+
+/*
+ * This function takes a single null-terminated array of 16-bit unsigned
+ * integers as an argument and returns a pointer to a null-terminated string of
+ * characters containing the original sentence. The block of memory pointed to
+ * by the return value is dynamically allocated, so it is the job of the
+ * programmer to free() the pointer after doing something meaningful with the
+ * data.
+ */
+
+char *cblt_decodeSentenceDict(const cblt_dict *dict,
+		const uint16_t *compressed) {
+	char *sentence;		/* decoded data */
+	char *grown;
+	size_t capacity;	/* number of characters allocated for sentence */
+	size_t length = 0;	/* number of characters decoded so far */
+	size_t i = 0;		/* index for compressed */
+	/* By my specification, the first word will not have a leading space unless
+	   explicitly specified by a literal ASCII space. */
+	bool noSpace = true;
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	cblt_dict builtin;
+
+	if (compressed == NULL)
+		return NULL;
+	dict = cblt_useDict(dict, &builtin);
+	cblt_initRepeats(&repeats, NULL, false);
+
+	/* Instead of decoding the whole block once just to find out how long
+	   the sentence is, we count its elements, which only takes a look for
+	   the null terminator, and guess from that. The sentence grows if the
+	   guess was short. A symbol decodes to a little over 3 characters on
+	   average in English text, including spaces. */
+	capacity = cblt_getUint16BlockSize(compressed) * CBLT_DECODE_RATIO
+		+ CBLT_MAX_WORD_ROOM;
+	sentence = malloc(sizeof(char) * capacity);
+	if (sentence == NULL)
+		return NULL;
+
+	while (1) {
+		/* keep 1 character for the null terminator */
+		length += cblt_decodeSome(dict, compressed, &i, SIZE_MAX,
+			sentence + length, capacity - length - 1, &noSpace, &repeats);
+		if (compressed[i] == 0)
+			break;
+
+		capacity *= 2;
+		grown = realloc(sentence, sizeof(char) * capacity);
+		if (grown == NULL) {
+			free(sentence);
+			return NULL;
+		}
+		sentence = grown;
+	}
+	sentence[length] = '\0';
+
+	/* give back what we didn't use */
+	grown = realloc(sentence, sizeof(char) * (length + 1));
+	return (grown != NULL) ? grown : sentence;
+}
+
+char *cblt_decodeSentence(const uint16_t *compressed) {
+	return cblt_decodeSentenceDict(NULL, compressed);
+}
+
+/*
+ * Decodes COMPRESSED into the CAPACITY characters at OUT, without allocating
+ * any memory. See cobalt.h.
+ */
+bool cblt_decodeIntoDict(const cblt_dict *dict, const uint16_t *compressed,
+		char *out, size_t capacity, size_t *pwritten) {
+	size_t length = 0;	/* number of characters decoded so far */
+	size_t rest;		/* number of characters left to decode */
+	size_t i = 0;		/* index for compressed */
+	bool noSpace = true;
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	cblt_repeats counted;	/* the same, while the rest is counted */
+	cblt_dict builtin;
+
+	if (pwritten != NULL)
+		*pwritten = 0;
+	if (compressed == NULL || pwritten == NULL || (out == NULL && capacity > 0))
+		return false;
+	dict = cblt_useDict(dict, &builtin);
+	if (capacity == 0) {
+		*pwritten = cblt_getDecodedLengthDict(dict, compressed);
+		return false;
+	}
+
+	/* keep 1 character for the null terminator */
+	cblt_initRepeats(&repeats, NULL, false);
+	length = cblt_decodeSome(dict, compressed, &i, SIZE_MAX, out, capacity - 1,
+		&noSpace, &repeats);
+	if (compressed[i] != 0) {
+		/* Decoding stops a little early, to be on the safe side, so the rest
+		   may still fit. */
+		counted = repeats;
+		rest = cblt_countDecoded(dict, compressed, i, noSpace, &counted);
+		if (rest >= capacity - length) {
+			*pwritten = length + rest + 1;
+			return false;
+		}
+		length += cblt_decodeRange(dict, compressed, i, SIZE_MAX, out + length,
+			noSpace, &repeats);
+	}
+
+	out[length] = '\0';
+	*pwritten = length + 1;
+	return true;
+}
+
+bool cblt_decodeInto(const uint16_t *compressed, char *out, size_t capacity,
+		size_t *pwritten) {
+	return cblt_decodeIntoDict(NULL, compressed, out, capacity, pwritten);
 }
@@ -6,14 +6,77 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "dict.h"
+#include "repeats.h"
+#include "splitstring.h"
 
 #ifndef SENTENCE_H
 #define SENTENCE_H
 
+/* returned by cblt_findPhrase() when it has to see more of the text */
+#define CBLT_PHRASE_NEEDS_MORE	-3
+
+/* set in a symbol returned by cblt_findPhrase() when the word was only found
+   in lowercase, so it has to be written after a CBLT_CAPITALIZE or
+   CBLT_UPPERCASE symbol */
+#define CBLT_WORD_CAPITALIZED	0x10000
+#define CBLT_WORD_UPPERCASE		0x20000
+#define CBLT_WORD_SYMBOL(word)	((uint16_t)((word) & 0xFFFF))
+
 size_t cblt_getEncodedLength(const char *sentence);
+size_t cblt_getEncodedLengthDict(const cblt_dict *dict, const char *sentence);
 uint16_t *cblt_encodeSentence(const char *sentence);
+uint16_t *cblt_encodeSentenceDict(const cblt_dict *dict, const char *sentence);
+int32_t cblt_findPhrase(const cblt_dict *dict, cblt_tokenizer *tok,
+		const char *group, size_t *plength, bool final);
+size_t cblt_cutChars(const char *chars, size_t length);
+int32_t cblt_findLiteral(cblt_repeats *repeats, const char *group,
+		size_t length);
+size_t cblt_encodeGroup(const char *group, size_t length, int32_t word,
+		int status, int nextStatus, bool first, uint16_t *out);
+uint16_t *cblt_encodeRange(const cblt_dict *dict, const char *s,
+		size_t length, size_t *pcount, cblt_index *index, size_t interval,
+		bool repeat);
+bool cblt_encodeInto(const char *sentence, size_t length, uint16_t *out,
+		size_t capacity, size_t *pwritten);
+bool cblt_encodeIntoDict(const cblt_dict *dict, const char *sentence,
+		size_t length, uint16_t *out, size_t capacity, size_t *pwritten);
+uint16_t *cblt_encodeSentenceIndexed(const char *sentence, size_t interval,
+		cblt_index *index);
+uint16_t *cblt_encodeSentenceIndexedDict(const cblt_dict *dict,
+		const char *sentence, size_t interval, cblt_index *index);
+void cblt_freeIndex(cblt_index *index);
 
 size_t cblt_getDecodedLength(const uint16_t *compressed);
+size_t cblt_getDecodedLengthDict(const cblt_dict *dict,
+		const uint16_t *compressed);
 char *cblt_decodeSentence(const uint16_t *compressed);
+char *cblt_decodeSentenceDict(const cblt_dict *dict,
+		const uint16_t *compressed);
+void cblt_applyCase(char *word, size_t length, uint16_t escape);
+const char *cblt_getRun(uint16_t symbol, size_t *plength);
+size_t cblt_formatSmallNumber(uint16_t symbol, char *dest);
+const char *cblt_getNumberPrefix(uint16_t symbol, size_t *plength);
+size_t cblt_getChunkDigits(uint16_t symbol, size_t k);
+uint32_t cblt_getChunkLimit(uint16_t symbol, size_t digits);
+void cblt_formatChunk(uint16_t symbol, uint16_t element, size_t digits,
+		char *dest);
+bool cblt_checkNumber(const uint16_t *compressed, size_t i, size_t count);
+size_t cblt_checkBeginString(const uint16_t *compressed, size_t i,
+		size_t count);
+bool cblt_checkElements(const uint16_t *compressed, size_t count);
+size_t cblt_decodeRange(const cblt_dict *dict, const uint16_t *compressed,
+		size_t from, size_t to, char *sentence, bool noSpace,
+		cblt_repeats *repeats);
+void cblt_followRepeats(const uint16_t *compressed, size_t from, size_t to,
+		cblt_repeats *repeats);
+size_t cblt_repeatLiterals(uint16_t *compressed, size_t count);
+bool cblt_decodeInto(const uint16_t *compressed, char *out, size_t capacity,
+		size_t *pwritten);
+bool cblt_decodeIntoDict(const cblt_dict *dict, const uint16_t *compressed,
+		char *out, size_t capacity, size_t *pwritten);
 
 #endif  /* SENTENCE_H */
\ No newline at end of file
@@ -5,9 +5,13 @@
  * splitting a sentence into substrings or tokens.
  */
 
-#include <ctype.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "cobalt.h"
 #include "splitstring.h"
@@ -33,23 +37,11 @@ const char *cblt_getStatusName(int status) {
 }
 
 /* This function is gonna get called a lot. For nearly every character in the
-   string, in fact. 
-   TODO: 
-   Find a way to define this function as inline to allow the compiler to
-   probably optimize the function. I've done as much as I can to optimize this
-   function myself, primarily by ordering the OR'ed conditions in the third
-   if statement in descending order of probability. */
+   string, in fact. The rules themselves live in util/construct_charstatus.c,
+   which turns them into a lookup table when the library is compiled, so all
+   that's left to do at runtime is a single load. */
 int cblt_getCharStatus(unsigned char c) {
-	if (c == ' ')
-		return Space;
-	if (c == '\0')
-		return EndOfString;
-	if ( isalnum(c)
-			|| (c > 0x7f)
-			|| (c == '\'')
-			|| (c == '-') )
-		return Word;
-	return Punctuation;
+	return CHARSTATUS[c];
 }
 
 /*
@@ -116,3 +108,143 @@ char *cblt_splitstr(char *s, int *pcurrentStatus, int *pnextStatus) {
 	*pnext = '\0';
 	return pcurrent;
 }
+
+/* Gets the status of the character at P, treating END as the end of the
+   string even if there is no null byte there. */
+static int cblt_getStatusAt(const char *p, const char *end) {
+	if (p == end)
+		return EndOfString;
+	return CHARSTATUS[(unsigned char)*p];
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+/*
+ * On x86-64, character groups are measured a whole vector at a time. Every byte
+ * in the vector is classified at once, and the classes are turned into a bit
+ * mask with one bit per byte, which is set if that byte does NOT belong to the
+ * group we are in. The position of the first set bit is where the group ends.
+ *
+ * These comparisons must always agree with the rules in
+ * util/construct_charstatus.c; tests/charstatus_table.c checks that they do.
+ */
+#if defined(__AVX2__)
+#define VECTOR_WIDTH	32
+typedef __m256i cblt_vector;
+#define vset1(c)		_mm256_set1_epi8(c)
+#define vload(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define vor(a, b)		_mm256_or_si256(a, b)
+#define vsub(a, b)		_mm256_sub_epi8(a, b)
+#define vmin(a, b)		_mm256_min_epu8(a, b)
+#define veq(a, b)		_mm256_cmpeq_epi8(a, b)
+#define vmask(a)		((uint32_t)_mm256_movemask_epi8(a))
+#else
+#define VECTOR_WIDTH	16
+typedef __m128i cblt_vector;
+#define vset1(c)		_mm_set1_epi8(c)
+#define vload(p)		_mm_loadu_si128((const __m128i *)(p))
+#define vor(a, b)		_mm_or_si128(a, b)
+#define vsub(a, b)		_mm_sub_epi8(a, b)
+#define vmin(a, b)		_mm_min_epu8(a, b)
+#define veq(a, b)		_mm_cmpeq_epi8(a, b)
+#define vmask(a)		((uint32_t)_mm_movemask_epi8(a))
+#endif
+
+/* Unsigned X <= N for every byte, as a vector of 0x00 or 0xFF bytes */
+#define vle(x, n)		veq(vmin(x, vset1(n)), x)
+
+/* Bit mask of the bytes in V that are Word characters: letters, digits, ',
+   - and everything above 0x7f. */
+static inline uint32_t cblt_wordMask(cblt_vector v) {
+	cblt_vector digit = vle(vsub(v, vset1('0')), 9);
+	cblt_vector alpha = vle(vsub(vor(v, vset1(0x20)), vset1('a')), 25);
+	cblt_vector other = vor(veq(v, vset1('\'')), veq(v, vset1('-')));
+	return vmask(vor(vor(digit, alpha), other)) | vmask(v);
+}
+
+/* Returns a pointer to the first character at or after P that doesn't have
+   the status STATUS, or END if there isn't one. */
+static const char *cblt_findGroupEnd(const char *p, const char *end,
+		int status) {
+	cblt_vector v;
+	uint32_t words, spaces, nulls, stop;
+
+	for ( ; end - p >= VECTOR_WIDTH; p += VECTOR_WIDTH) {
+		v = vload(p);
+		words = cblt_wordMask(v);
+		spaces = vmask(veq(v, vset1(' ')));
+		nulls = vmask(veq(v, vset1('\0')));
+		switch (status) {
+		case Word:
+			stop = ~words;
+			break;
+		case Space:
+			stop = ~spaces;
+			break;
+		default:
+			stop = words | spaces | nulls;
+			break;
+		}
+#if VECTOR_WIDTH < 32
+		stop &= (1u << VECTOR_WIDTH) - 1;
+#endif
+		if (stop != 0)
+			return p + __builtin_ctz(stop);
+	}
+
+	/* finish off the last few characters one at a time */
+	while (p != end && CHARSTATUS[(unsigned char)*p] == status)
+		++p;
+	return p;
+}
+#else
+/* Returns a pointer to the first character at or after P that doesn't have
+   the status STATUS, or END if there isn't one. */
+static const char *cblt_findGroupEnd(const char *p, const char *end,
+		int status) {
+	while (p != end && CHARSTATUS[(unsigned char)*p] == status)
+		++p;
+	return p;
+}
+#endif
+
+/*
+ * Prepares TOK to split the first LENGTH characters of S into character groups.
+ * The tokenizer will also stop at the first null byte, if there is one before
+ * S + LENGTH. S is never modified.
+ */
+void cblt_initTokenizer(cblt_tokenizer *tok, const char *s, size_t length) {
+	tok->next = s;
+	tok->end = s + length;
+	tok->nextStatus = cblt_getStatusAt(s, tok->end);
+}
+
+/*
+ * Finds the next character group in the string being split by TOK. A pointer
+ * to the first character of the group is stored in *PGROUP and the number of
+ * characters in the group is stored in *PLENGTH. The group is NOT null-
+ * terminated. The status of the group that follows it can be read from
+ * tok->nextStatus.
+ *
+ * Return value:
+ * This function returns the status of the group that was found. Once the end
+ * of the string is reached, EndOfString is returned with a length of 0, and
+ * will keep being returned on every call after that.
+ */
+int cblt_nextToken(cblt_tokenizer *tok, const char **pgroup, size_t *plength) {
+	const char *p = tok->next;
+	int status = tok->nextStatus;
+
+	*pgroup = p;
+	if (status == EndOfString) {
+		*plength = 0;
+		return EndOfString;
+	}
+
+	/* move p to beginning of next substring */
+	p = cblt_findGroupEnd(p + 1, tok->end, status);
+
+	*plength = p - *pgroup;
+	tok->next = p;
+	tok->nextStatus = cblt_getStatusAt(p, tok->end);
+	return status;
+}
@@ -7,6 +7,8 @@
 #ifndef SPLITSTRING_H
 #define SPLITSTRING_H
 
+#include <stddef.h>
+
 /*
  * This enum defines the possible return values of cblt_strsplit().
  * 
@@ -24,8 +26,37 @@ enum substringStatus{
 	EndOfString
 };
 
+/*
+ * A cblt_tokenizer is a cursor over a string that splits it into the same
+ * character groups as cblt_splitstr(), except that it never modifies the
+ * string and keeps all of its state in the struct itself. This means that any
+ * number of tokenizers can walk over the same string, or over different
+ * strings in different threads, at the same time.
+ *
+ * next:		the first character of the next group
+ * end:			one past the last character that will be looked at
+ * nextStatus:	the status of the group starting at next
+ */
+typedef struct cblt_tokenizer {
+	const char *next;
+	const char *end;
+	int nextStatus;
+} cblt_tokenizer;
+
+/*
+ * CHARSTATUS holds the status of every possible value of an unsigned char, so
+ * that CHARSTATUS[c] == cblt_getCharStatus(c). It is generated at compile time
+ * by util/construct_charstatus.c, which is where the rules for splitting
+ * sentences into character groups are defined.
+ */
+extern const unsigned char CHARSTATUS[];
+extern const size_t CHARSTATUS_LEN;
+
 char *cblt_splitstr(char *s, int *pcurrentStatus, int *pnextStatus);
 
+void cblt_initTokenizer(cblt_tokenizer *tok, const char *s, size_t length);
+int cblt_nextToken(cblt_tokenizer *tok, const char **pgroup, size_t *plength);
+
 int cblt_getCharStatus(unsigned char c);
 
 const char *cblt_getStatusName(int status);
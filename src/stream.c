@@ -0,0 +1,488 @@
+/*
+ * stream.c
+ * by Eliot Baez
+ *
+ * This file contains the definitions of functions used for encoding and
+ * decoding sentences that arrive a piece at a time, such as from a pipe, or
+ * that are too large to keep in memory all at once.
+ *
+ * The encoder keeps a fixed-size window of input that hasn't been encoded yet.
+ * Every character group in the window is encoded as soon as the character after
+ * it has arrived, since that is all the encoder needs to know about what comes
+ * next. Only the last group in the window is held back, because the next piece
+ * of input may still add to it.
+ *
+ * The decoder doesn't need to look ahead at all, so it only remembers what is
+ * left of the symbol it is in the middle of writing, and whether the next word
+ * gets a leading space and a change of case.
+ *
+ * Both of them also keep a copy of every string literal that can be repeated,
+ * since the input it came from is long gone by the time it is repeated.
+ */
+
+#include <stdlib.h>	/* malloc, free, size_t */
+#include <string.h>	/* memcpy, memmove, memchr */
+#include <stdint.h>	/* uint16_t */
+#include <stdbool.h>
+
+#include "cobalt.h"
+#include "repeats.h"
+#include "sentence.h"
+#include "splitstring.h"
+#include "dict.h"
+
+/* The window has to be able to hold the longest word in the table, and then
+   some, or long words would get cut in half. */
+#define CBLT_MIN_WINDOW	256
+
+struct cblt_encoder {
+	char *window;			/* input that hasn't been encoded yet */
+	size_t windowSize;		/* number of characters allocated for window */
+	size_t windowLength;	/* number of characters in window */
+
+	uint16_t *pending;		/* encoded symbols not handed out yet */
+	size_t pendingStart;	/* first element of pending not handed out */
+	size_t pendingEnd;		/* number of elements in pending */
+
+	bool first;		/* no character group has been encoded yet */
+	bool joinWord;	/* the last group was a word that didn't fit in the window */
+	bool finished;	/* the null terminator has been added to pending */
+
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	char (*store)[CBLT_MAX_REPEAT];	/* and the copies of them */
+	cblt_dict dict;	/* the dictionary to encode with */
+};
+
+struct cblt_decoder {
+	const char *copy;	/* characters of the current symbol not written yet */
+	size_t copyLength;
+	char pair[2];		/* the characters of the current literal element */
+	char digits[4];		/* the digits of the current number element */
+	char cased[UINT8_MAX];	/* the current word, if its case was changed */
+	char kept[CBLT_MAX_REPEAT];	/* the current literal, if it is short
+								   enough to be repeated */
+	size_t keptLength;	/* its length, or 0 if it isn't kept */
+	uint16_t escape;	/* the case symbol before the next word, or 0 */
+
+	bool space;			/* a leading space has yet to be written */
+	bool noSpace;		/* the next word has no leading space */
+	size_t literalLeft;	/* characters left in the current string literal */
+	uint16_t number;	/* the CBLT_NUMBER symbol of the current number */
+	size_t numberLeft;	/* elements left in the current number */
+	bool inLiteral;		/* the next symbol is part of an older literal */
+	bool finished;		/* the null terminator has been read */
+
+	cblt_repeats repeats;	/* the literals that can be repeated */
+	char (*store)[CBLT_MAX_REPEAT];	/* and the copies of them */
+	cblt_dict dict;		/* the dictionary to decode with */
+};
+
+/* Puts ENC back in the state it was in right after it was created. */
+static void cblt_resetEncoder(cblt_encoder *enc) {
+	enc->windowLength = 0;
+	enc->pendingStart = 0;
+	enc->pendingEnd = 0;
+	enc->first = true;
+	enc->joinWord = false;
+	enc->finished = false;
+	cblt_initRepeats(&enc->repeats, enc->store, true);
+}
+
+cblt_encoder *cblt_createEncoder(size_t window) {
+	return cblt_createEncoderDict(NULL, window);
+}
+
+cblt_encoder *cblt_createEncoderDict(const cblt_dict *dict, size_t window) {
+	cblt_encoder *enc;
+
+	if (window == 0)
+		window = CBLT_DEFAULT_WINDOW;
+	if (window < CBLT_MIN_WINDOW)
+		window = CBLT_MIN_WINDOW;
+
+	enc = malloc(sizeof(cblt_encoder));
+	if (enc == NULL)
+		return NULL;
+	enc->window = malloc(sizeof(char) * window);
+	/* No character takes up more than 2 elements, and a cut word and the
+	   terminator take 1 more element each. */
+	enc->pending = malloc(sizeof(uint16_t) * (2 * window + 2));
+	enc->store = malloc(sizeof(*enc->store) * CBLT_REPEATS);
+	if (enc->window == NULL || enc->pending == NULL || enc->store == NULL) {
+		cblt_freeEncoder(enc);
+		return NULL;
+	}
+
+	enc->windowSize = window;
+	if (dict != NULL)
+		enc->dict = *dict;
+	else
+		cblt_loadBuiltinDict(&enc->dict);
+	cblt_resetEncoder(enc);
+	return enc;
+}
+
+void cblt_freeEncoder(cblt_encoder *enc) {
+	if (enc == NULL)
+		return;
+	free(enc->window);
+	free(enc->pending);
+	free(enc->store);
+	free(enc);
+}
+
+/* Hands out as many pending symbols of ENC as fit in the output. */
+static void cblt_drainEncoder(cblt_encoder *enc, uint16_t **pout,
+		size_t *poutCapacity) {
+	size_t n = enc->pendingEnd - enc->pendingStart;
+
+	if (n > *poutCapacity)
+		n = *poutCapacity;
+	memcpy(*pout, enc->pending + enc->pendingStart, sizeof(uint16_t) * n);
+	*pout += n;
+	*poutCapacity -= n;
+	enc->pendingStart += n;
+}
+
+/* Moves as much input as fits into the window of ENC. Null characters can't
+   be encoded, so they are skipped. */
+static void cblt_fillWindow(cblt_encoder *enc, const char **pin,
+		size_t *pinLength) {
+	size_t n;
+	const char *nul;
+
+	while (*pinLength > 0 && enc->windowLength < enc->windowSize) {
+		n = enc->windowSize - enc->windowLength;
+		if (n > *pinLength)
+			n = *pinLength;
+		nul = memchr(*pin, '\0', n);
+		if (nul != NULL)
+			n = nul - *pin;
+
+		memcpy(enc->window + enc->windowLength, *pin, n);
+		enc->windowLength += n;
+		*pin += n;
+		*pinLength -= n;
+		if (nul != NULL) {
+			++*pin;
+			--*pinLength;
+		}
+	}
+}
+
+/*
+ * Encodes every character group in the window of ENC that is known to be
+ * complete into the pending block, which must be empty. If FINAL is true, no
+ * more input is coming, so every group is complete.
+ *
+ * If a single group takes up the whole window, it is cut at the end of the
+ * window. Spaces and punctuation are cut right before their last run or
+ * character, which may carry on in the next piece of input, so cutting them
+ * changes nothing, but a word has to be encoded as a string literal, and the
+ * rest of it is joined on with a space omission signal.
+ */
+static void cblt_encodeWindow(cblt_encoder *enc, bool final) {
+	cblt_tokenizer tok;		/* splits the window into character groups */
+	const char *group;		/* points to a group of characters */
+	size_t length;			/* length of group */
+	int currentStatus;		/* the type of characters stored in group */
+	int nextStatus;
+	int32_t word;			/* the symbol of group, if it is a word */
+	bool cut;				/* group is cut off at the end of the window */
+	size_t consumed = 0;	/* characters of the window encoded so far */
+	uint16_t *out;
+
+	enc->pendingStart = 0;
+	enc->pendingEnd = 0;
+	out = enc->pending;
+
+	cblt_initTokenizer(&tok, enc->window, enc->windowLength);
+	while ((currentStatus = cblt_nextToken(&tok, &group, &length))
+			!= EndOfString) {
+		nextStatus = tok.nextStatus;
+		cut = false;
+		if (!final && group + length == enc->window + enc->windowLength) {
+			/* this group may carry on in the next piece of input */
+			if (consumed > 0 || enc->windowLength < enc->windowSize)
+				break;
+			if (currentStatus != Word)
+				/* keep the last run or character back for when we know
+				   what comes after it */
+				length = cblt_cutChars(group, length);
+			/* as far as encoding goes, the group carries on */
+			nextStatus = currentStatus;
+			cut = true;
+		}
+
+		word = CBLT_WORD_NOT_FOUND;
+		if (currentStatus == Word) {
+			word = cblt_findPhrase(&enc->dict, &tok, group, &length, final);
+			if (word == CBLT_PHRASE_NEEDS_MORE) {
+				/* the phrase may carry on in the next piece of input. A
+				   phrase is never longer than the smallest window, so
+				   this only happens after some other group. */
+				if (consumed > 0 || enc->windowLength < enc->windowSize)
+					break;
+				word = cblt_findPhrase(&enc->dict, &tok, group, &length,
+					true);
+			}
+			if (!cut)
+				nextStatus = tok.nextStatus;
+			if (word < 0)
+				word = cblt_findLiteral(&enc->repeats, group, length);
+		}
+
+		if (enc->joinWord && currentStatus == Word)
+			*out++ = CBLT_NO_SPACE;
+		out += cblt_encodeGroup(group, length, word, currentStatus,
+			nextStatus, enc->first, out);
+		enc->joinWord = (cut && currentStatus == Word);
+		enc->first = false;
+		consumed = group + length - enc->window;
+		if (cut)
+			break;
+	}
+
+	enc->pendingEnd = out - enc->pending;
+	enc->windowLength -= consumed;
+	memmove(enc->window, enc->window + consumed, enc->windowLength);
+}
+
+void cblt_encoderUpdate(cblt_encoder *enc, const char **pin,
+		size_t *pinLength, uint16_t **pout, size_t *poutCapacity) {
+	if (enc == NULL || enc->finished)
+		return;
+
+	while (1) {
+		cblt_drainEncoder(enc, pout, poutCapacity);
+		if (enc->pendingStart != enc->pendingEnd || *pinLength == 0)
+			return;
+		cblt_fillWindow(enc, pin, pinLength);
+		cblt_encodeWindow(enc, false);
+	}
+}
+
+bool cblt_encoderFinish(cblt_encoder *enc, uint16_t **pout,
+		size_t *poutCapacity) {
+	if (enc == NULL)
+		return true;
+
+	cblt_drainEncoder(enc, pout, poutCapacity);
+	if (enc->pendingStart != enc->pendingEnd)
+		return false;
+
+	if (!enc->finished) {
+		cblt_encodeWindow(enc, true);
+		enc->pending[enc->pendingEnd++] = 0x0000;
+		enc->finished = true;
+		cblt_drainEncoder(enc, pout, poutCapacity);
+		if (enc->pendingStart != enc->pendingEnd)
+			return false;
+	}
+
+	cblt_resetEncoder(enc);
+	return true;
+}
+
+/* Puts DEC back in the state it was in right after it was created. */
+static void cblt_resetDecoder(cblt_decoder *dec) {
+	dec->copy = NULL;
+	dec->copyLength = 0;
+	dec->space = false;
+	dec->noSpace = true;
+	dec->escape = 0;
+	dec->literalLeft = 0;
+	dec->keptLength = 0;
+	dec->numberLeft = 0;
+	dec->inLiteral = false;
+	dec->finished = false;
+	cblt_initRepeats(&dec->repeats, dec->store, false);
+}
+
+cblt_decoder *cblt_createDecoder(void) {
+	return cblt_createDecoderDict(NULL);
+}
+
+cblt_decoder *cblt_createDecoderDict(const cblt_dict *dict) {
+	cblt_decoder *dec;
+
+	dec = malloc(sizeof(cblt_decoder));
+	if (dec == NULL)
+		return NULL;
+	dec->store = malloc(sizeof(*dec->store) * CBLT_REPEATS);
+	if (dec->store == NULL) {
+		free(dec);
+		return NULL;
+	}
+	if (dict != NULL)
+		dec->dict = *dict;
+	else
+		cblt_loadBuiltinDict(&dec->dict);
+	cblt_resetDecoder(dec);
+	return dec;
+}
+
+void cblt_freeDecoder(cblt_decoder *dec) {
+	if (dec == NULL)
+		return;
+	free(dec->store);
+	free(dec);
+}
+
+/* Writes as much of what is left of the current symbol of DEC as fits in the
+   output. Returns true if all of it was written. */
+static bool cblt_drainDecoder(cblt_decoder *dec, char **pout,
+		size_t *poutCapacity) {
+	size_t n;
+
+	if (dec->space) {
+		if (*poutCapacity == 0)
+			return false;
+		*(*pout)++ = ' ';
+		--*poutCapacity;
+		dec->space = false;
+	}
+
+	n = dec->copyLength;
+	if (n > *poutCapacity)
+		n = *poutCapacity;
+	if (n == 0)
+		return dec->copyLength == 0;
+	memcpy(*pout, dec->copy, n);
+	*pout += n;
+	*poutCapacity -= n;
+	dec->copy += n;
+	dec->copyLength -= n;
+	return dec->copyLength == 0;
+}
+
+bool cblt_decoderUpdate(cblt_decoder *dec, const uint16_t **pin,
+		size_t *pinLength, char **pout, size_t *poutCapacity) {
+	uint16_t symbol;
+	size_t slot;			/* the slot of a repeated literal */
+
+	if (dec == NULL)
+		return true;
+
+	while (cblt_drainDecoder(dec, pout, poutCapacity)) {
+		if (dec->finished) {
+			cblt_resetDecoder(dec);
+			return true;
+		}
+		if (*pinLength == 0)
+			return false;
+		symbol = *(*pin)++;
+		--*pinLength;
+
+		if (dec->literalLeft > 0) {
+			/* the characters of a literal are stored in the elements in
+			   memory order */
+			memcpy(dec->pair, &symbol, 2);
+			dec->copy = dec->pair;
+			dec->copyLength = (dec->literalLeft < 2) ? dec->literalLeft : 2;
+			if (dec->keptLength > 0)
+				memcpy(dec->kept + dec->keptLength - dec->literalLeft,
+					dec->pair, dec->copyLength);
+			dec->literalLeft -= dec->copyLength;
+			/* the literal can be repeated once all of it has arrived */
+			if (dec->keptLength > 0 && dec->literalLeft == 0)
+				cblt_addRepeat(&dec->repeats, dec->kept, dec->keptLength);
+		} else if (dec->numberLeft > 0) {
+			/* the digits of a number, most significant first */
+			dec->copyLength = cblt_getChunkDigits(dec->number,
+				CBLT_NUMBER_ELEMENTS(dec->number) - dec->numberLeft--);
+			cblt_formatChunk(dec->number, symbol, dec->copyLength,
+				dec->digits);
+			dec->copy = dec->digits;
+		} else if (dec->inLiteral) {
+			/* the same, up to a null terminator */
+			memcpy(dec->pair, &symbol, 2);
+			dec->copy = dec->pair;
+			dec->copyLength = (dec->pair[0] == '\0') ? 0
+				: (dec->pair[1] == '\0') ? 1 : 2;
+			dec->inLiteral = (dec->copyLength == 2);
+		} else if (symbol == 0) {
+			dec->finished = true;
+		} else if (symbol < 0x100) {
+			/* direct byte injection */
+			dec->pair[0] = (char)symbol;
+			dec->copy = dec->pair;
+			dec->copyLength = 1;
+			dec->noSpace = false;
+		} else if (symbol < dec->dict.symbols) {
+			/* valid words */
+			dec->space = !dec->noSpace;
+			dec->copy = (const char *)dec->dict.wordtable
+				+ dec->dict.wordmap[symbol];
+			dec->copyLength = dec->dict.wordlen[symbol];
+			if (dec->escape != 0) {
+				memcpy(dec->cased, dec->copy, dec->copyLength);
+				cblt_applyCase(dec->cased, dec->copyLength, dec->escape);
+				dec->copy = dec->cased;
+			}
+			dec->noSpace = false;
+		} else if (CBLT_IS_RUN(symbol)) {
+			/* a run of spaces, tabs or line breaks */
+			dec->copy = cblt_getRun(symbol, &dec->copyLength);
+			dec->noSpace = (symbol & CBLT_RUN_NO_SPACE) != 0;
+		} else if (CBLT_IS_LITERAL(symbol)) {
+			/* string literal */
+			dec->space = !dec->noSpace;
+			dec->literalLeft = CBLT_LITERAL_LENGTH(symbol);
+			dec->keptLength = (dec->literalLeft <= CBLT_MAX_REPEAT)
+				? dec->literalLeft : 0;
+			if (dec->literalLeft == 0)
+				cblt_addRepeat(&dec->repeats, dec->kept, 0);
+			dec->noSpace = false;
+		} else if (CBLT_IS_REPEAT(symbol)
+				&& CBLT_REPEAT_SLOT(symbol) < dec->repeats.count) {
+			/* a string literal that came up before */
+			slot = CBLT_REPEAT_SLOT(symbol);
+			dec->space = !dec->noSpace;
+			dec->copy = dec->repeats.text[slot];
+			dec->copyLength = dec->repeats.length[slot];
+			cblt_useRepeat(&dec->repeats, slot);
+			dec->noSpace = false;
+		} else if (CBLT_IS_SMALL_NUMBER(symbol)) {
+			/* a number of 1 to 3 digits */
+			dec->space = !dec->noSpace;
+			dec->copyLength = cblt_formatSmallNumber(symbol, dec->digits);
+			dec->copy = dec->digits;
+			dec->noSpace = false;
+		} else if (CBLT_IS_NUMBER(symbol)) {
+			/* any other number, whose digits come next */
+			dec->space = !dec->noSpace;
+			dec->copy = cblt_getNumberPrefix(symbol, &dec->copyLength);
+			dec->number = symbol;
+			dec->numberLeft = CBLT_NUMBER_ELEMENTS(symbol);
+			dec->noSpace = false;
+		} else if (symbol == CBLT_BEGIN_STRING) {
+			/* string literal from an older block */
+			dec->space = !dec->noSpace;
+			dec->inLiteral = true;
+			dec->noSpace = false;
+		} else if (symbol == CBLT_NO_SPACE) {
+			/* The next word will not have a leading space */
+			dec->noSpace = true;
+		} else if (symbol == CBLT_CAPITALIZE || symbol == CBLT_UPPERCASE) {
+			/* the case of the next word */
+			dec->escape = symbol;
+			continue;
+		}
+		/* Any other codes are invalid, so move on. A case symbol only
+		   applies to the symbol right after it. */
+		dec->escape = 0;
+	}
+
+	return false;
+}
+
+bool cblt_decoderFinish(cblt_decoder *dec, char **pout,
+		size_t *poutCapacity) {
+	if (dec == NULL)
+		return true;
+	if (!cblt_drainDecoder(dec, pout, poutCapacity))
+		return false;
+	cblt_resetDecoder(dec);
+	return true;
+}
@@ -0,0 +1,79 @@
+/*
+ * wordhash.h
+ *
+ * Contains the hash functions shared by cblt_findWord() and the program that
+ * builds the perfect hash table over the word list (map/construct_wordhash.c).
+ * Both sides MUST agree on every detail of these functions, which is why they
+ * are defined here as static inline functions instead of in a source file.
+ *
+ * The table is a "hash and displace" minimal perfect hash. Every word is
+ * hashed exactly once into a 64-bit value H. The upper bits of H select a
+ * bucket, and each bucket has a 16-bit seed stored in HASHSEEDS. Mixing H with
+ * the seed of its bucket gives the slot of the word in HASHSLOTS. The seeds are
+ * chosen at build time so that no two words in the table land in the same
+ * slot, and there are exactly as many slots as there are unique words.
+ */
+
+#ifndef WORDHASH_H
+#define WORDHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Each element of HASHSLOTS packs the length of a word into the upper 16 bits
+ * and the ordinal number of the word into the lower 16 bits.
+ */
+#define CBLT_SLOT_WORD(slot)	((uint16_t)((slot) & 0xFFFF))
+#define CBLT_SLOT_LENGTH(slot)	((size_t)((slot) >> 16))
+#define CBLT_MAKE_SLOT(word, length) \
+	((uint32_t)(word) | ((uint32_t)(length) << 16))
+
+/* Finalizer from MurmurHash3, used to spread the bits of H around. */
+static inline uint64_t cblt_hashMix(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/* Hashes LEN bytes of S, 8 bytes at a time. The loads are done through
+   memcpy() so that S does not need to be aligned, and so that we never read
+   past the end of the word. Like the rest of the tables, the result depends on
+   the endianness of the machine. */
+static inline uint64_t cblt_hashWord(const char *s, size_t len) {
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * 0xff51afd7ed558ccdULL);
+	uint64_t chunk;
+
+	while (len >= 8) {
+		memcpy(&chunk, s, 8);
+		h = (h ^ chunk) * 0x87c37b91114253d5ULL;
+		h ^= h >> 31;
+		s += 8;
+		len -= 8;
+	}
+	chunk = 0;
+	memcpy(&chunk, s, len);
+	h = (h ^ chunk) * 0x87c37b91114253d5ULL;
+
+	return cblt_hashMix(h);
+}
+
+/* Maps the 32-bit value X onto the range [0, N) without a division. */
+static inline uint32_t cblt_hashReduce(uint32_t x, size_t n) {
+	return (uint32_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline uint32_t cblt_hashBucket(uint64_t h, size_t buckets) {
+	return cblt_hashReduce((uint32_t)(h >> 32), buckets);
+}
+
+static inline uint32_t cblt_hashSlot(uint64_t h, uint16_t seed, size_t slots) {
+	return cblt_hashReduce(
+		(uint32_t)cblt_hashMix(h + seed * 0x9e3779b97f4a7c15ULL), slots);
+}
+
+#endif /* WORDHASH_H */
@@ -0,0 +1,306 @@
+/*
+ * archive.c
+ *
+ * This program checks that records written into an archive can each be
+ * decoded on their own, and that any range of their characters can be too. It
+ * takes no command line arguments.
+ *
+ * Made-up records, from empty ones to ones longer than a few hundred words,
+ * are written into an archive in memory and into a file. Every record must
+ * come back out of cblt_decodeRecord() and cblt_decodeRecordInto(), and ranges
+ * of characters that start and end anywhere must come back out of
+ * cblt_decodeArchiveRange(). The archive must be refused by a different
+ * dictionary and once it is cut short, and a damaged archive, including one
+ * with a record made up to end with a string literal of an older block that
+ * runs past its end, must never be read out of bounds.
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the number of records in the big archive, and in the one that is damaged */
+#define RECORDS			20000
+#define DAMAGED_RECORDS	100
+/* the number of ranges tried */
+#define RANGES			20000
+/* the file the archive is saved to, which is removed afterwards */
+#define ARCHIVE_PATH	"archive_test.tmp"
+
+static const char *WORDS[] = {
+	"the", "of", "and", "to", "in", "is", "was", "that", "for", "with", "as",
+	"Time", "PEOPLE", "water", "house", "zorblax", "quuxle", "1984", "3.14",
+	"0x1F", ",", ".", "  ", "\n", "\t",
+};
+#define NWORDS	(sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* Returns a newly allocated made-up record. Most are a few words long, and
+   every 100th is a few hundred words long. */
+static char *makeRecord(void) {
+	size_t words = (nextRandom() % 100 == 0) ? 300 + nextRandom() % 500
+		: nextRandom() % 12;
+	char *record;
+	char *end;
+	size_t i;
+
+	record = malloc(words * 8 + 1);
+	if (record == NULL)
+		return NULL;
+	end = record;
+	for (i = 0; i < words; ++i)
+		end += sprintf(end, "%s%s", (i > 0 && nextRandom() % 4 != 0) ? " "
+			: "", WORDS[nextRandom() % NWORDS]);
+	*end = '\0';
+	return record;
+}
+
+/* Checks that every record of A comes back the same as in RECORDS, and that
+   ranges of them come back the same as in ALL, which is LENGTH characters
+   long. Returns 1 on failure and 0 otherwise. */
+static int checkArchive(const cblt_archive *a, char **records, size_t count,
+		const char *all, size_t length) {
+	char *decoded;
+	char small[4];
+	size_t written;
+	size_t n, offset, rangeLength;
+
+	if (cblt_getRecordCount(a) != count || cblt_getArchiveLength(a) != length) {
+		printf("the archive had %zu records and %zu characters\n",
+			cblt_getRecordCount(a), cblt_getArchiveLength(a));
+		return 1;
+	}
+	for (n = 0; n < count; ++n) {
+		decoded = cblt_decodeRecord(a, n);
+		if (decoded == NULL || strcmp(decoded, records[n]) != 0) {
+			printf("record %zu decoded wrongly\n", n);
+			free(decoded);
+			return 1;
+		}
+		free(decoded);
+		if (cblt_decodeRecordInto(a, n, small, sizeof(small), &written)
+				!= (strlen(records[n]) < sizeof(small))
+				|| written != strlen(records[n]) + 1) {
+			printf("record %zu was measured as %zu characters\n", n, written);
+			return 1;
+		}
+	}
+	if (cblt_decodeRecord(a, count) != NULL) {
+		printf("a record past the last one was decoded\n");
+		return 1;
+	}
+
+	decoded = malloc(length + 1);
+	if (decoded == NULL)
+		return 1;
+	for (n = 0; n < RANGES; ++n) {
+		offset = (size_t)(((uint64_t)nextRandom() << 15 | nextRandom())
+			% (length + 1));
+		rangeLength = (n % 1000 == 0) ? length - offset
+			: nextRandom() % 3000 % (length - offset + 1);
+		if (!cblt_decodeArchiveRange(a, offset, rangeLength, decoded)
+				|| memcmp(decoded, all + offset, rangeLength) != 0
+				|| decoded[rangeLength] != '\0') {
+			printf("%zu characters at %zu decoded wrongly\n", rangeLength,
+				offset);
+			free(decoded);
+			return 1;
+		}
+	}
+	if (cblt_decodeArchiveRange(a, length, 1, decoded)) {
+		printf("a range past the end was decoded\n");
+		free(decoded);
+		return 1;
+	}
+	free(decoded);
+	return 0;
+}
+
+/* Writes COUNT records into an archive in memory, and stores it in *PBYTES
+   and its size in *PSIZE, and all of the records put together in *PALL and
+   their length in *PLENGTH. If PATH isn't NULL, also saves it there. Returns
+   the records, or NULL on failure. */
+static char **writeArchive(size_t count, const char *path,
+		unsigned char **pbytes, size_t *psize, char **pall,
+		size_t *plength) {
+	cblt_archiveWriter *w;
+	char **records;
+	char *all;
+	size_t n, length = 0;
+
+	w = cblt_createArchiveWriter();
+	records = malloc(sizeof(char *) * count);
+	if (w == NULL || records == NULL)
+		return NULL;
+	for (n = 0; n < count; ++n) {
+		records[n] = makeRecord();
+		if (records[n] == NULL || !cblt_addRecord(w, records[n]))
+			return NULL;
+		length += strlen(records[n]);
+	}
+	*pbytes = cblt_finishArchive(w, psize);
+	if (*pbytes == NULL || (path != NULL && !cblt_saveArchive(w, path)))
+		return NULL;
+	cblt_freeArchiveWriter(w);
+
+	all = malloc(length + 1);
+	if (all == NULL)
+		return NULL;
+	for (n = 0, length = 0; n < count; ++n) {
+		strcpy(all + length, records[n]);
+		length += strlen(records[n]);
+	}
+	*pall = all;
+	*plength = length;
+	return records;
+}
+
+/* Checks that the SIZE bytes at BYTES, an archive of COUNT records, are
+   refused once they are cut short, and are never read out of bounds once
+   they are damaged. Returns 1 on failure and 0 otherwise. */
+static int checkDamaged(unsigned char *bytes, size_t size, size_t count,
+		size_t length) {
+	cblt_archive *a;
+	char *decoded;
+	size_t i, n;
+
+	for (i = 0; i < size; ++i) {
+		a = cblt_openArchiveBuffer(bytes, i);
+		if (a != NULL) {
+			printf("an archive cut to %zu bytes was opened\n", i);
+			cblt_closeArchive(a);
+			return 1;
+		}
+	}
+
+	decoded = malloc(length + 1);
+	if (decoded == NULL)
+		return 1;
+	for (i = 0; i < size; i += 1 + i / 64) {
+		bytes[i] ^= 0x5A;
+		a = cblt_openArchiveBuffer(bytes, size);
+		for (n = 0; n < count; ++n)
+			free(cblt_decodeRecord(a, n));
+		if (a != NULL && cblt_getArchiveLength(a) == length)
+			cblt_decodeArchiveRange(a, 0, length, decoded);
+		cblt_closeArchive(a);
+		bytes[i] ^= 0x5A;
+	}
+	free(decoded);
+	return 0;
+}
+
+/* Checks that a record made up to end with a string literal of an older
+   block, whose null terminator never comes, is refused rather than decoded
+   past its end. Returns 1 on failure and 0 otherwise. */
+static int checkUnterminated(void) {
+	char record[128 * 22 + 1];
+	cblt_archiveWriter *w;
+	cblt_archive *a;
+	unsigned char *bytes;
+	uint16_t *encoded;
+	char *decoded;
+	char out[sizeof(record)];
+	size_t size, written;
+	size_t n;
+	int failed = 0;
+
+	/* long enough that its elements don't fit on the stack of the decoder,
+	   and stored as its elements, which end the archive */
+	for (n = 0; n < 128; ++n)
+		memcpy(record + 22 * n, "the time of the water ", 22);
+	record[sizeof(record) - 1] = '\0';
+	encoded = cblt_encodeSentence(record);
+	w = cblt_createArchiveWriter();
+	if (encoded == NULL || w == NULL || !cblt_addRecord(w, record)
+			|| cblt_getUint16BlockSize(encoded) < 3)
+		return 1;
+	bytes = cblt_finishArchive(w, &size);
+	cblt_freeArchiveWriter(w);
+	free(encoded);
+	if (bytes == NULL)
+		return 1;
+	bytes[size - 4] = 0xFF;
+	bytes[size - 3] = 0xFF;
+	bytes[size - 2] = 'a';
+	bytes[size - 1] = 'b';
+
+	a = cblt_openArchiveBuffer(bytes, size);
+	decoded = cblt_decodeRecord(a, 0);
+	if (a == NULL || decoded != NULL
+			|| cblt_decodeRecordInto(a, 0, out, sizeof(out), &written)
+			|| cblt_decodeArchiveRange(a, 0, strlen(record), out)) {
+		printf("a record with a literal that runs past its end was "
+			"decoded\n");
+		failed = 1;
+	}
+	free(decoded);
+	cblt_closeArchive(a);
+	free(bytes);
+	return failed;
+}
+
+int main(void) {
+	cblt_archive *a;
+	cblt_dict *other;
+	unsigned char *bytes;
+	char **records;
+	char *all;
+	size_t size, length;
+	size_t n;
+	int failures = 0;
+
+	records = writeArchive(RECORDS, ARCHIVE_PATH, &bytes, &size, &all,
+		&length);
+	if (records == NULL) {
+		printf("the archive couldn't be written\n");
+		return EXIT_FAILURE;
+	}
+	printf("%d records of %zu characters took %zu bytes\n", RECORDS, length,
+		size);
+
+	a = cblt_openArchiveBuffer(bytes, size);
+	failures += (a == NULL) ? 1 : checkArchive(a, records, RECORDS, all,
+		length);
+	cblt_closeArchive(a);
+	a = cblt_openArchive(ARCHIVE_PATH);
+	failures += (a == NULL) ? 1 : checkArchive(a, records, RECORDS, all,
+		length);
+	cblt_closeArchive(a);
+	remove(ARCHIVE_PATH);
+
+	other = cblt_createDict(WORDS, NWORDS);
+	a = cblt_openArchiveBufferDict(other, bytes, size);
+	if (other == NULL || a != NULL) {
+		printf("the archive was opened with the wrong dictionary\n");
+		++failures;
+	}
+	cblt_closeArchive(a);
+	cblt_closeDict(other);
+
+	for (n = 0; n < RECORDS; ++n)
+		free(records[n]);
+	free(records);
+	free(all);
+	free(bytes);
+
+	records = writeArchive(DAMAGED_RECORDS, NULL, &bytes, &size, &all,
+		&length);
+	if (records == NULL)
+		return EXIT_FAILURE;
+	failures += checkDamaged(bytes, size, DAMAGED_RECORDS, length);
+	for (n = 0; n < DAMAGED_RECORDS; ++n)
+		free(records[n]);
+	free(records);
+	free(all);
+	free(bytes);
+	failures += checkUnterminated();
+
+	if (failures == 0)
+		printf("all records decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
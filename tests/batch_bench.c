@@ -0,0 +1,188 @@
+/*
+ * batch_bench.c
+ *
+ * This is a benchmark for cblt_encodeBatch() and cblt_decodeBatch(). It takes
+ * the name of a text file as its only command line argument, and treats every
+ * line of it as a sentence of its own, so a file of short lines, such as a log
+ * or plaintext/wiki-100k.txt, shows what batching is for.
+ *
+ * Every sentence must come out of a batch the same as out of
+ * cblt_encodeSentence(), and must decode back to itself. The lines are then
+ * encoded and decoded several times over, once as a batch and once by calling
+ * cblt_encodeSentence() and cblt_decodeSentence() on each of them, and the
+ * best time per sentence of each is printed.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "cobalt.h"
+
+#ifndef REPETITIONS
+#define REPETITIONS 5
+#endif
+
+static double now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* Checks that the batch of the N lines at LINES is the same as the blocks
+   encoded one at a time, and decodes back. Returns 1 on failure and 0
+   otherwise. */
+static int check(const char *const *lines, size_t n) {
+	uint16_t *batch;
+	uint16_t *single;
+	char *decoded;
+	size_t *offsets;
+	size_t *decodedOffsets;
+	size_t count;
+	size_t i;
+	int failed = 0;
+
+	offsets = malloc(sizeof(size_t) * (n + 1));
+	decodedOffsets = malloc(sizeof(size_t) * (n + 1));
+	if (offsets == NULL || decodedOffsets == NULL)
+		return 1;
+	batch = cblt_encodeBatch(lines, n, offsets);
+	decoded = (batch != NULL) ? cblt_decodeBatch(batch, offsets, n,
+		decodedOffsets) : NULL;
+	if (decoded == NULL) {
+		printf("the batch couldn't be encoded and decoded\n");
+		failed = 1;
+	}
+
+	for (i = 0; i < n && !failed; ++i) {
+		single = cblt_encodeSentence(lines[i]);
+		count = (single != NULL) ? cblt_getUint16BlockSize(single) : 0;
+		if (single == NULL || offsets[i + 1] - offsets[i] != count
+				|| memcmp(batch + offsets[i], single,
+					sizeof(uint16_t) * count) != 0) {
+			printf("line %zu was encoded differently in the batch\n", i);
+			failed = 1;
+		} else if (strcmp(decoded + decodedOffsets[i], lines[i]) != 0
+				|| decodedOffsets[i + 1] - decodedOffsets[i]
+					!= strlen(lines[i]) + 1) {
+			printf("line %zu decoded wrongly\n", i);
+			failed = 1;
+		}
+		free(single);
+	}
+
+	free(batch);
+	free(decoded);
+	free(offsets);
+	free(decodedOffsets);
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *buf;
+	char **lines;
+	uint16_t **blocks;
+	uint16_t *batch;
+	char *decoded;
+	size_t *offsets;
+	size_t *decodedOffsets;
+	size_t n, i;
+	int r;
+	double t, encodeLoop = 0, decodeLoop = 0, encodeBatch = 0,
+		decodeBatch = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "%s requires one argument.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	buf = malloc(size + 1);
+	lines = malloc(sizeof(char *) * (size + 1));
+	blocks = malloc(sizeof(uint16_t *) * (size + 1));
+	offsets = malloc(sizeof(size_t) * (size + 2));
+	decodedOffsets = malloc(sizeof(size_t) * (size + 2));
+	if (buf == NULL || lines == NULL || blocks == NULL || offsets == NULL
+			|| decodedOffsets == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	size = fread(buf, 1, size, fp);
+	fclose(fp);
+	buf[size] = '\0';
+
+	/* split the file into lines */
+	n = 0;
+	for (i = 0; i < size; ) {
+		lines[n++] = buf + i;
+		while (i < size && buf[i] != '\n')
+			++i;
+		buf[i++] = '\0';
+	}
+
+	if (check((const char *const *)lines, n) != 0)
+		return EXIT_FAILURE;
+	if (n == 0) {
+		printf("the file has no lines\n");
+		goto done;
+	}
+
+	for (r = 0; r < REPETITIONS; ++r) {
+		t = now();
+		for (i = 0; i < n; ++i)
+			blocks[i] = cblt_encodeSentence(lines[i]);
+		t = now() - t;
+		if (r == 0 || t < encodeLoop)
+			encodeLoop = t;
+
+		t = now();
+		for (i = 0; i < n; ++i)
+			free(cblt_decodeSentence(blocks[i]));
+		t = now() - t;
+		if (r == 0 || t < decodeLoop)
+			decodeLoop = t;
+		for (i = 0; i < n; ++i)
+			free(blocks[i]);
+
+		t = now();
+		batch = cblt_encodeBatch((const char *const *)lines, n, offsets);
+		t = now() - t;
+		if (r == 0 || t < encodeBatch)
+			encodeBatch = t;
+
+		t = now();
+		decoded = cblt_decodeBatch(batch, offsets, n, decodedOffsets);
+		t = now() - t;
+		if (r == 0 || t < decodeBatch)
+			decodeBatch = t;
+		free(batch);
+		free(decoded);
+	}
+
+	printf("%zu lines, %zu characters\n", n, size);
+	printf("encoding: %.1f ns/line one at a time, %.1f ns/line in a batch\n",
+		encodeLoop / n, encodeBatch / n);
+	printf("decoding: %.1f ns/line one at a time, %.1f ns/line in a batch\n",
+		decodeLoop / n, decodeBatch / n);
+
+done:
+	free(lines);
+	free(blocks);
+	free(offsets);
+	free(decodedOffsets);
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * bytes_fallback.c
+ *
+ * This program checks that text the dictionary doesn't help with is never
+ * made much bigger by the byte format, and that it still decodes exactly. It
+ * takes no command line arguments.
+ *
+ * Made-up text of every kind is encoded at a range of lengths: English, which
+ * the dictionary should make smaller, base64, which can't be made smaller by
+ * anything, and log lines full of names and numbers that the dictionary
+ * doesn't know, which LZ77 should make much smaller. Every block must decode
+ * back to its text, and must be no more than a few bytes bigger than it.
+ * Blocks that were cut short must be refused, and damaged ones must never be
+ * read out of bounds, including one made up to hold a string literal of an
+ * older block that runs past its end.
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the longest made-up text, which is long enough that only the start of it
+   is tried with LZ77 at first */
+#define MAX_TEXT	100000
+/* the most bytes a block may take on top of its text */
+#define MAX_OVERHEAD	4
+
+/* the kinds of text that are made up */
+enum { ENGLISH, BASE64, LOG, NKINDS };
+static const char *KIND_NAMES[] = { "English", "base64", "log lines" };
+
+static const char *WORDS[] = {
+	"the", "of", "and", "to", "in", "is", "was", "that", "for", "with", "as",
+	"time", "people", "water", "house", "small", "large", "between", "after",
+};
+#define NWORDS	(sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* Writes LENGTH characters of made-up text of KIND to OUT, followed by a null
+   terminator. */
+static void makeText(char *out, int kind, size_t length) {
+	static const char base64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char line[64];
+	size_t n, i = 0;
+
+	while (i < length) {
+		if (kind == ENGLISH) {
+			n = (size_t)sprintf(line, "%s ", WORDS[nextRandom() % NWORDS]);
+		} else if (kind == BASE64) {
+			line[0] = base64[nextRandom() % 64];
+			n = 1;
+		} else {
+			n = (size_t)sprintf(line, "Mar 12 10:%02u:%02u qzhost%u "
+				"kvrd[%u]: xq_conn=%u\n", nextRandom() % 60,
+				nextRandom() % 60, nextRandom() % 4, 1000 + nextRandom() % 4,
+				nextRandom() % 8);
+		}
+		if (n > length - i)
+			n = length - i;
+		memcpy(out + i, line, n);
+		i += n;
+	}
+	out[length] = '\0';
+}
+
+/* Encodes TEXT of KIND in the byte format, and checks that it decodes back
+   exactly, isn't much bigger than the text, and is refused once it is cut or
+   damaged. Returns 1 on failure and 0 otherwise. */
+static int check(const char *text, int kind) {
+	unsigned char *bytes;
+	char *decoded;
+	size_t length = strlen(text);
+	size_t size;
+	size_t i;
+	int failed = 0;
+
+	bytes = cblt_encodeBytes(text, &size);
+	if (bytes == NULL)
+		return 1;
+	decoded = cblt_decodeBytes(bytes, size);
+	if (decoded == NULL || strcmp(decoded, text) != 0) {
+		printf("%zu characters of %s decoded wrongly\n", length,
+			KIND_NAMES[kind]);
+		failed = 1;
+	}
+	free(decoded);
+	if (size > length + MAX_OVERHEAD) {
+		printf("%zu characters of %s took %zu bytes\n", length,
+			KIND_NAMES[kind], size);
+		failed = 1;
+	}
+	/* past a few lines, only base64 should stay the same size, and the log
+	   lines should go down the most */
+	if (length >= 4000 && ((kind == ENGLISH && size > length / 2)
+			|| (kind == LOG && size > length / 3))) {
+		printf("%zu characters of %s only went down to %zu bytes\n", length,
+			KIND_NAMES[kind], size);
+		failed = 1;
+	}
+
+	for (i = 0; i < size; i += 1 + i / 8) {
+		decoded = cblt_decodeBytes(bytes, i);
+		if (decoded != NULL) {
+			printf("%s cut to %zu bytes was decoded\n", KIND_NAMES[kind], i);
+			failed = 1;
+		}
+		free(decoded);
+	}
+	for (i = 0; i < size; i += 1 + i / 8) {
+		bytes[i] ^= 0x5A;
+		free(cblt_decodeBytes(bytes, size));
+		bytes[i] ^= 0x5A;
+	}
+
+	free(bytes);
+	return failed;
+}
+
+/* Checks that a block made up to start a string literal of an older block,
+   which the byte format never holds, is refused. Its null terminator would
+   only be found in the terminator of the block, so the decoder would step
+   right past the end of the block. Returns 1 on failure and 0 otherwise. */
+static int checkLegacyLiteral(void) {
+	cblt_dict *dict;
+	char *decoded;
+	unsigned char bytes[] = {
+		0xB5,				/* the format */
+		0, 0,				/* the number of symbols, filled in below */
+		0, 0, 0,			/* no bytes, no 1-byte and no 2-byte words */
+		0x05, 0xFF, 0xFF,	/* CBLT_BEGIN_STRING */
+		0x05, 0x01, 0x01,	/* the characters "\x01\x01", or a word */
+		0x00,				/* the end of the block */
+	};
+
+	dict = cblt_createDict(WORDS, NWORDS);
+	if (dict == NULL)
+		return 1;
+	/* the number of symbols is a 2-byte varint */
+	bytes[1] = (unsigned char)(0x80 | ((0x100 + NWORDS) & 0x7F));
+	bytes[2] = (unsigned char)((0x100 + NWORDS) >> 7);
+	decoded = cblt_decodeBytesDict(dict, bytes, sizeof(bytes));
+	cblt_closeDict(dict);
+	if (decoded != NULL) {
+		printf("a block with a literal of an older block was decoded\n");
+		free(decoded);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+	char *text;
+	size_t length;
+	int kind;
+	int failures = 0;
+
+	text = malloc(MAX_TEXT + 1);
+	if (text == NULL)
+		return EXIT_FAILURE;
+	for (kind = 0; kind < NKINDS; ++kind) {
+		for (length = 0; length <= MAX_TEXT;
+				length += 1 + length / 2) {
+			makeText(text, kind, length);
+			failures += check(text, kind);
+		}
+	}
+	free(text);
+	failures += checkLegacyLiteral();
+
+	if (failures == 0)
+		printf("all fallbacks decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,186 @@
+/*
+ * bytes_roundtrip.c
+ *
+ * This program checks that cblt_decodeBytes() gives back exactly the sentence
+ * that cblt_encodeBytes() was given, and measures how small and how fast the
+ * byte format is. It takes the name of a text file as its only command line
+ * argument.
+ *
+ * A few short sentences with string literals of every length, case symbols and
+ * leading spaces are checked first, and then the file. The sizes of the text,
+ * of the same text encoded with cblt_encodeSentence() and in the byte format
+ * are printed, along with how fast it was encoded and decoded. Bytes that were
+ * cut short or damaged must be refused rather than read out of bounds, and so
+ * must bytes encoded with a different dictionary.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "cobalt.h"
+
+/* the number of times the text is encoded and decoded, for timing */
+#define RUNS	5
+
+static const char *SENTENCES[] = {
+	"",
+	" ",
+	" the",
+	"the end.",
+	"x",
+	"xq",
+	"xqz",
+	"The QUICK brown fox, xqzzy, JUMPED over the lazy dog!!",
+	"  two  spaces\tand a tab\n",
+	"\x7f\x01 odd bytes \xc3\xa9t\xc3\xa9",
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* Returns the number of seconds between START and END. */
+static double elapsed(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec)
+		+ (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Encodes and decodes SENTENCE with DICT, and checks that it comes out the
+   same. Returns 1 on failure and 0 otherwise. */
+static int check(const cblt_dict *dict, const char *sentence) {
+	unsigned char *bytes;
+	char *decoded;
+	size_t size;
+	int failed = 0;
+
+	bytes = cblt_encodeBytesDict(dict, sentence, &size);
+	decoded = cblt_decodeBytesDict(dict, bytes, size);
+	if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+		printf("\"%.40s\" decoded as \"%.40s\"\n", sentence,
+			decoded == NULL ? "(null)" : decoded);
+		failed = 1;
+	}
+	free(decoded);
+	free(bytes);
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *text;
+	uint16_t *encoded;
+	unsigned char *bytes;
+	size_t bytesSize;
+	char *decoded;
+	const char *words[] = { "the", "end", "of", "it" };
+	cblt_dict *dict;
+	struct timespec start, end;
+	double encodeTime = 1e9, decodeTime = 1e9;
+	size_t i;
+	int run;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage:\t%s TXTFILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = malloc(size + 1);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	size = fread(text, 1, size, fp);
+	fclose(fp);
+	text[size] = '\0';
+
+	dict = cblt_createDict(words, sizeof(words) / sizeof(words[0]));
+	if (dict == NULL) {
+		printf("dictionary could not be created\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < NSENTENCES; ++i) {
+		failures += check(NULL, SENTENCES[i]);
+		failures += check(dict, SENTENCES[i]);
+	}
+
+	/* bytes encoded with one dictionary can't be decoded with another, once
+	   the dictionary makes them smaller than the text */
+	bytes = cblt_encodeBytesDict(dict, "the end of it, the end of it, "
+		"the end of it, the end of it, the end of it", &bytesSize);
+	decoded = cblt_decodeBytes(bytes, bytesSize);
+	if (bytes == NULL || decoded != NULL) {
+		printf("bytes were decoded with the wrong dictionary\n");
+		++failures;
+	}
+	free(decoded);
+	free(bytes);
+	cblt_closeDict(dict);
+
+	/* time the best of a few runs of each step */
+	bytes = NULL;
+	decoded = NULL;
+	for (run = 0; run < RUNS; ++run) {
+		free(bytes);
+		free(decoded);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		bytes = cblt_encodeBytes(text, &bytesSize);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (elapsed(&start, &end) < encodeTime)
+			encodeTime = elapsed(&start, &end);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		decoded = cblt_decodeBytes(bytes, bytesSize);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (elapsed(&start, &end) < decodeTime)
+			decodeTime = elapsed(&start, &end);
+	}
+	if (decoded == NULL || strcmp(decoded, text) != 0) {
+		printf("decoded text differs\n");
+		++failures;
+	}
+
+	encoded = cblt_encodeSentence(text);
+	printf("text:    %zu bytes\n", size);
+	printf("encoded: %zu bytes (%.1f%%)\n",
+		2 * cblt_getUint16BlockSize(encoded),
+		200.0 * cblt_getUint16BlockSize(encoded) / size);
+	printf("bytes:   %zu bytes (%.1f%%)\n", bytesSize,
+		100.0 * bytesSize / size);
+	printf("encode:  %.0f MB/s of text\n", size / encodeTime / 1e6);
+	printf("decode:  %.0f MB/s of text\n", size / decodeTime / 1e6);
+
+	free(decoded);
+	/* anything cut off must be refused */
+	for (i = 0; i < bytesSize; i += 1 + i / 16) {
+		decoded = cblt_decodeBytes(bytes, i);
+		if (decoded != NULL) {
+			printf("bytes cut to %zu were decoded\n", i);
+			++failures;
+		}
+		free(decoded);
+	}
+	/* and damage must never be read out of bounds */
+	for (i = 0; i < bytesSize; i += 1 + i / 16) {
+		bytes[i] ^= 0x5A;
+		free(cblt_decodeBytes(bytes, bytesSize));
+		bytes[i] ^= 0x5A;
+	}
+
+	free(bytes);
+	free(encoded);
+	free(text);
+	if (failures == 0)
+		printf("all sentences decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,187 @@
+/*
+ * capitals.c
+ *
+ * This program checks that words that are only in the dictionary in lowercase,
+ * like "Abandoned" and "ABANDONED", are encoded as the lowercase word after a
+ * CBLT_CAPITALIZE or CBLT_UPPERCASE symbol instead of as a string literal, and
+ * that every decoder gives them back their case. It takes the name of a text
+ * file as its only command line argument.
+ *
+ * A few short sentences are encoded with the built-in dictionary and with a
+ * small one made by cblt_createDict(). Every sentence, and then the file, is
+ * decoded by cblt_decodeSentence(), by cblt_decodeInto() and by a cblt_decoder
+ * that is given 1 symbol at a time, so that a case symbol and its word always
+ * arrive separately.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+/* sentences and the number of elements each should be encoded in, not
+   counting the null terminator, with the built-in dictionary and with
+   WORDS */
+static const struct {
+	const char *sentence;
+	size_t builtin;
+	size_t small;
+} SENTENCES[] = {
+	{ "abandoned", 1, 6 },
+	{ "Abandoned", 2, 6 },
+	{ "ABANDONED", 2, 6 },
+	{ "AbanDoned", 6, 6 },
+	{ "aBANDONED", 6, 6 },
+	{ "ABANDONED.", 3, 7 },
+	{ "the X-ray", 5, 3 },
+	{ "The X-RAY", 5, 4 },
+	{ "THE x-RAY", 5, 6 },
+	{ "Cobalt", 4, 1 },
+	{ "COBALT", 4, 4 },
+	{ "cobalt", 4, 4 },
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* a dictionary with "the" and "x-ray" only in lowercase, and "Cobalt" only
+   with its first letter in uppercase, which is never made lowercase */
+static const char *WORDS[] = { "the", "x-ray", "Cobalt" };
+#define NWORDS	(sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* Decodes ENCODED with DICT, feeding a cblt_decoder 1 symbol at a time.
+   Returns NULL if a memory allocation fails. */
+static char *decodeStreamed(const cblt_dict *dict, const uint16_t *encoded,
+		size_t length) {
+	cblt_decoder *dec;
+	char *decoded;
+	char *out;
+	size_t capacity;
+	size_t inLength;
+	bool done = false;
+
+	dec = cblt_createDecoderDict(dict);
+	decoded = malloc(length);
+	if (dec == NULL || decoded == NULL) {
+		cblt_freeDecoder(dec);
+		free(decoded);
+		return NULL;
+	}
+
+	out = decoded;
+	capacity = length - 1;
+	while (!done) {
+		inLength = 1;
+		done = cblt_decoderUpdate(dec, &encoded, &inLength, &out, &capacity);
+	}
+	*out = '\0';
+	cblt_freeDecoder(dec);
+	return decoded;
+}
+
+/* Encodes SENTENCE with DICT, and checks that it takes ELEMENTS elements and
+   that every decoder gives back SENTENCE. Returns 1 on failure and 0
+   otherwise. */
+static int check(const cblt_dict *dict, const char *sentence,
+		size_t elements) {
+	uint16_t *encoded;
+	char *decoded[3];
+	size_t count, length;
+	size_t written;
+	size_t i;
+	int failed = 0;
+
+	encoded = cblt_encodeSentenceDict(dict, sentence);
+	count = cblt_getUint16BlockSize(encoded) - 1;
+	length = strlen(sentence) + 1;
+
+	decoded[0] = cblt_decodeSentenceDict(dict, encoded);
+	decoded[1] = malloc(length);
+	if (decoded[1] != NULL && !cblt_decodeIntoDict(dict, encoded, decoded[1],
+			length, &written)) {
+		free(decoded[1]);
+		decoded[1] = NULL;
+	}
+	decoded[2] = decodeStreamed(dict, encoded, length);
+
+	for (i = 0; i < 3; ++i) {
+		if (decoded[i] == NULL || strcmp(decoded[i], sentence) != 0) {
+			printf("\"%.40s\" decoded as \"%.40s\" by decoder %zu\n", sentence,
+				decoded[i] == NULL ? "(null)" : decoded[i], i);
+			failed = 1;
+		}
+		free(decoded[i]);
+	}
+	if (elements != 0 && count != elements) {
+		printf("\"%s\" took %zu elements instead of %zu\n", sentence, count,
+			elements);
+		failed = 1;
+	}
+
+	free(encoded);
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *text;
+	uint16_t *encoded;
+	size_t cased = 0;		/* number of case symbols in the file */
+	cblt_dict *dict;
+	size_t i;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage:\t%s TXTFILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	dict = cblt_createDict(WORDS, NWORDS);
+	if (dict == NULL) {
+		printf("dictionary could not be created\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < NSENTENCES; ++i) {
+		failures += check(NULL, SENTENCES[i].sentence, SENTENCES[i].builtin);
+		failures += check(dict, SENTENCES[i].sentence, SENTENCES[i].small);
+	}
+	cblt_closeDict(dict);
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = malloc(size + 1);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	size = fread(text, 1, size, fp);
+	fclose(fp);
+	text[size] = '\0';
+
+	failures += check(NULL, text, 0);
+	encoded = cblt_encodeSentence(text);
+	for (i = 0; encoded != NULL && encoded[i] != 0; ++i) {
+		if (CBLT_IS_LITERAL(encoded[i])) {
+			/* skip past the literal */
+			i += CBLT_LITERAL_ELEMENTS(CBLT_LITERAL_LENGTH(encoded[i]));
+		} else if (encoded[i] == CBLT_CAPITALIZE
+				|| encoded[i] == CBLT_UPPERCASE) {
+			++cased;
+		}
+	}
+	printf("%zu words had their case changed\n", cased);
+
+	free(encoded);
+	free(text);
+	if (failures == 0)
+		printf("all words decoded in the right case\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
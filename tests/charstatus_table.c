@@ -0,0 +1,122 @@
+/*
+ * charstatus_table.c
+ *
+ * This test program makes sure that the generated CHARSTATUS table, and the
+ * vectorized group splitting in splitstring.c, classify characters exactly the
+ * way cblt_getCharStatus() always has. The original rules are copied below
+ * verbatim. Every possible unsigned char is checked against them, and then a
+ * few thousand random strings are split with a cblt_tokenizer and compared,
+ * group by group, against a naive splitter that uses the original rules.
+ *
+ * The output of charstatus_asciimap.c should also be identical before and
+ * after any change to the character statuses.
+ *
+ * This file is intended to be compiled with ../src/splitstring.c and
+ * ../src/globals/charstatus.c, NOT linked with libcobalt at compile time.
+ * Compile it once as is and once with -mavx2 to test both vector widths.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "splitstring.h"
+
+#define STRINGS 10000
+#define MAX_LENGTH 200
+
+/* the rules as they were before CHARSTATUS existed */
+static int originalCharStatus(unsigned char c) {
+    if (c == ' ')
+        return Space;
+    if (c == '\0')
+        return EndOfString;
+    if ( isalnum(c)
+            || (c > 0x7f)
+            || (c == '\'')
+            || (c == '-') )
+        return Word;
+    return Punctuation;
+}
+
+/* compares the groups found by a cblt_tokenizer with a naive splitter */
+static int checkString(const char *s, size_t length) {
+    cblt_tokenizer tok;
+    const char *group;
+    size_t groupLength;
+    int status;
+    size_t i = 0, j;
+
+    cblt_initTokenizer(&tok, s, length);
+    do {
+        status = cblt_nextToken(&tok, &group, &groupLength);
+        if (i == length || s[i] == '\0') {
+            if (status != EndOfString)
+                return 0;
+            break;
+        }
+
+        for (j = i + 1; j < length
+                && originalCharStatus(s[j]) == originalCharStatus(s[i]); ++j) ;
+        if (status != originalCharStatus(s[i])
+                || group != s + i
+                || groupLength != j - i)
+            return 0;
+        i = j;
+    } while (status != EndOfString);
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    /* mostly letters, with a few of everything else thrown in */
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+        "     '-.,;:!?()[]{}@`/\\\n\t\"\x7f\x80\xe9\xff";
+    char buf[MAX_LENGTH + 1];
+    unsigned int c;
+    size_t length, i;
+    int n, failures = 0;
+
+    if (argc != 1) {
+        fprintf(stderr, "%s does not take any arguments.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (c = 0; c < 0x100; ++c) {
+        if (cblt_getCharStatus(c) != originalCharStatus(c)) {
+            printf("0x%02X: expected %s, got %s\n", c,
+                cblt_getStatusName(originalCharStatus(c)),
+                cblt_getStatusName(cblt_getCharStatus(c)));
+            ++failures;
+        }
+    }
+
+    srand(1);
+    for (n = 0; n < STRINGS; ++n) {
+        length = rand() % MAX_LENGTH;
+        for (i = 0; i < length; ++i) {
+            /* long runs of a single class are what the vector code is for */
+            if (i > 0 && rand() % 4 != 0)
+                buf[i] = buf[i - 1];
+            else
+                buf[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        buf[length] = '\0';
+        /* every so often, stop early at a null byte in the middle */
+        if (length > 0 && rand() % 16 == 0)
+            buf[rand() % length] = '\0';
+
+        if (!checkString(buf, length)) {
+            printf("string %d was split incorrectly\n", n);
+            ++failures;
+        }
+    }
+
+    if (failures != 0) {
+        printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All character statuses match\n");
+    return EXIT_SUCCESS;
+}
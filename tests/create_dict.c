@@ -0,0 +1,111 @@
+/*
+ * create_dict.c
+ *
+ * This program checks that cblt_createDict() builds a dictionary that finds
+ * exactly the words it was given, under the symbols it was given them in, and
+ * that text encoded with it decodes back to the original. It takes the name of
+ * a text file as its only command line argument.
+ *
+ * The dictionary is made of a few words that are in the built-in dictionary,
+ * a few that aren't, and one word given twice, which must keep its first
+ * symbol. A word that is too long to fit in a dictionary must be refused.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+static const char *WORDS[] = {
+	"the", "zzq", "isn't", "Cobalt", "x", "of", "zzq", "lookup-table"
+};
+#define NWORDS	(sizeof(WORDS) / sizeof(WORDS[0]))
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *text;
+	cblt_dict *dict;
+	uint16_t *encoded;
+	char *decoded;
+	char longWord[UINT8_MAX + 2];
+	const char *longWords[1];
+	size_t i, j;
+	int32_t expected, found;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage:\t%s TXTFILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	dict = cblt_createDict(WORDS, NWORDS);
+	if (dict == NULL) {
+		printf("dictionary could not be created\n");
+		return EXIT_FAILURE;
+	}
+
+	/* every word is found under its first symbol */
+	for (i = 0; i < NWORDS; ++i) {
+		for (j = 0; strcmp(WORDS[j], WORDS[i]) != 0; ++j) ;
+		expected = 0x100 + j;
+		found = cblt_findWordDict(dict, WORDS[i], strlen(WORDS[i]));
+		if (found != expected) {
+			printf("%s: found %d, expected %d\n", WORDS[i], found, expected);
+			++failures;
+		}
+	}
+	/* words that aren't in it aren't found, even if they are built in */
+	if (cblt_findWordDict(dict, "and", 3) != CBLT_WORD_NOT_FOUND
+			|| cblt_findWordDict(dict, "th", 2) != CBLT_WORD_NOT_FOUND) {
+		printf("found a word that isn't in the dictionary\n");
+		++failures;
+	}
+
+	/* words longer than 255 characters don't fit */
+	memset(longWord, 'a', UINT8_MAX + 1);
+	longWord[UINT8_MAX + 1] = '\0';
+	longWords[0] = longWord;
+	if (cblt_createDict(longWords, 1) != NULL) {
+		printf("a word of %d characters was accepted\n", UINT8_MAX + 1);
+		++failures;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = malloc(size + 1);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	size = fread(text, 1, size, fp);
+	fclose(fp);
+	text[size] = '\0';
+
+	encoded = cblt_encodeSentenceDict(dict, text);
+	decoded = cblt_decodeSentenceDict(dict, encoded);
+	if (decoded == NULL || strcmp(decoded, text) != 0) {
+		printf("decoded text differs\n");
+		++failures;
+	} else {
+		printf("decoded text matches: %zu characters in %zu elements\n",
+			strlen(text), cblt_getUint16BlockSize(encoded));
+	}
+
+	free(decoded);
+	free(encoded);
+	free(text);
+	cblt_closeDict(dict);
+	if (failures == 0)
+		printf("all words found\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,159 @@
+/*
+ * dict_roundtrip.c
+ *
+ * This program checks that dictionary files work just like the built-in
+ * dictionary. It takes the name of a text file as its first command line
+ * argument, and the name of a scratch file to write dictionaries to as its
+ * second.
+ *
+ * The built-in dictionary is saved to the scratch file and opened again, and
+ * the text file is encoded and decoded with both. The two encoded blocks must
+ * be identical, and both must decode back to the original text. Then the
+ * scratch file is damaged in a few different ways, and every damaged file must
+ * be rejected by cblt_openDict().
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+/* Writes LENGTH bytes of DATA to PATH, with the byte at OFFSET replaced by
+   VALUE if OFFSET is less than LENGTH. Returns false on failure. */
+static bool writeDamaged(const char *path, const unsigned char *data,
+		size_t length, size_t offset, unsigned char value) {
+	FILE *fp;
+	bool ok;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+		return false;
+	ok = fwrite(data, 1, length, fp) == length;
+	if (offset < length) {
+		fseek(fp, offset, SEEK_SET);
+		ok = ok && fputc(value, fp) != EOF;
+	}
+	return fclose(fp) == 0 && ok;
+}
+
+/* Reads the whole file at PATH into memory. Returns NULL on failure. */
+static char *readFile(const char *path, size_t *plength) {
+	FILE *fp;
+	char *data;
+	size_t length;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	rewind(fp);
+	data = malloc(length + 1);
+	if (data != NULL) {
+		length = fread(data, 1, length, fp);
+		data[length] = '\0';
+	}
+	fclose(fp);
+	*plength = length;
+	return data;
+}
+
+int main(int argc, char **argv) {
+	char *text;
+	size_t size;
+	unsigned char *file;	/* the saved dictionary file */
+	size_t fileLength;
+	cblt_dict *dict;
+	uint16_t *expected;		/* encoded with the built-in dictionary */
+	uint16_t *encoded;		/* encoded with the saved dictionary */
+	char *decoded;
+	size_t count;
+	int failures = 0;
+	/* bytes to damage, and what to damage them with */
+	const size_t offsets[] = { 0, 12, 16, 64, 72 };
+	size_t i;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage:\t%s TXTFILE DICTFILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	text = readFile(argv[1], &size);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	size = strlen(text);
+
+	if (!cblt_saveDict(NULL, argv[2])) {
+		fprintf(stderr, "%s: Error writing file %s\n", argv[0], argv[2]);
+		return EXIT_FAILURE;
+	}
+	dict = cblt_openDict(argv[2]);
+	if (dict == NULL) {
+		printf("saved dictionary could not be opened\n");
+		return EXIT_FAILURE;
+	}
+
+	expected = cblt_encodeSentence(text);
+	encoded = cblt_encodeSentenceDict(dict, text);
+	if (expected == NULL || encoded == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	count = cblt_getUint16BlockSize(expected);
+	if (cblt_getUint16BlockSize(encoded) != count
+			|| memcmp(encoded, expected, sizeof(uint16_t) * count) != 0) {
+		printf("encoded blocks differ\n");
+		++failures;
+	} else {
+		printf("encoded blocks match: %zu elements\n", count);
+	}
+
+	decoded = cblt_decodeSentenceDict(dict, encoded);
+	if (decoded == NULL || strcmp(decoded, text) != 0) {
+		printf("decoded text differs\n");
+		++failures;
+	} else {
+		printf("decoded text matches: %zu characters\n", size);
+	}
+	free(decoded);
+	free(encoded);
+	free(expected);
+	cblt_closeDict(dict);
+
+	/* every damaged copy of the file must be rejected */
+	file = (unsigned char *)readFile(argv[2], &fileLength);
+	if (file == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[2]);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+		writeDamaged(argv[2], file, fileLength, offsets[i],
+			file[offsets[i]] ^ 0x80);
+		dict = cblt_openDict(argv[2]);
+		if (dict != NULL) {
+			printf("damaged byte %zu was not noticed\n", offsets[i]);
+			cblt_closeDict(dict);
+			++failures;
+		}
+	}
+	/* cut off in the middle of the word table */
+	writeDamaged(argv[2], file, fileLength - 2, fileLength, 0);
+	dict = cblt_openDict(argv[2]);
+	if (dict != NULL) {
+		printf("truncated file was not noticed\n");
+		cblt_closeDict(dict);
+		++failures;
+	}
+	if (failures == 0)
+		printf("damaged files rejected\n");
+
+	remove(argv[2]);
+	free(file);
+	free(text);
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
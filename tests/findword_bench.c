@@ -0,0 +1,88 @@
+/*
+ * findword_bench.c
+ *
+ * This is a microbenchmark for cblt_findWord(). It takes the name of a word
+ * list as its only command line argument, such as plaintext/wiki-100k.txt.
+ * Every line of the file that isn't a #comment is looked up in the word table
+ * several times over, and the average time per lookup is printed along with
+ * the number of words that were found.
+ *
+ * Since only the first 50,000 words of wiki-100k.txt make it into the word
+ * table, running this on the full file measures a roughly even mix of hits and
+ * misses.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "cobalt.h"
+
+#ifndef REPETITIONS
+#define REPETITIONS 20
+#endif
+
+int main(int argc, char **argv) {
+    FILE *fp;
+    size_t size;
+    char *buf;
+    char **words;
+    size_t nwords;
+    size_t i;
+    int r;
+    size_t found;
+    struct timespec start, end;
+    double ns;
+
+    if (argc != 2) {
+        fprintf(stderr, "%s requires one argument.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+        return EXIT_FAILURE;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+    buf = malloc(size + 1);
+    words = malloc(sizeof(char *) * (size / 2 + 1));
+    if (buf == NULL || words == NULL) {
+        fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    fread(buf, 1, size, fp);
+    fclose(fp);
+    buf[size] = '\0';
+
+    /* split the file into lines, skipping comments and empty lines */
+    nwords = 0;
+    for (i = 0; i < size; ) {
+        char *line = buf + i;
+        while (i < size && buf[i] != '\n')
+            ++i;
+        buf[i++] = '\0';
+        if (line[0] != '#' && line[0] != '\0')
+            words[nwords++] = line;
+    }
+
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < REPETITIONS; ++r)
+        for (i = 0; i < nwords; ++i)
+            found += (cblt_findWord(words[i]) >= 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%zu words, %zu found\n", nwords, found / REPETITIONS);
+    printf("%.1f ns/lookup\n", ns / ((double)nwords * REPETITIONS));
+
+    free(words);
+    free(buf);
+    return 0;
+}
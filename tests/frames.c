@@ -0,0 +1,239 @@
+/*
+ * frames.c
+ *
+ * This program checks that text encoded into a frame decodes back exactly,
+ * and that the headers of a frame can be read on their own. It takes no
+ * command line arguments.
+ *
+ * Made-up text is encoded at a range of lengths and block sizes, with and
+ * without checksums. Every frame must decode back to its text, its header must
+ * give the length of the text and the ID of the built-in dictionary, and every
+ * block must decode back to its part of the text on its own. A frame must be
+ * refused by a different dictionary, must be refused once it is cut short, and
+ * a frame with checksums must fail to verify once any byte of a block is
+ * changed. Damaged frames must never be read out of bounds, including one
+ * made up around a block that holds a string literal of an older block.
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the longest made-up text */
+#define MAX_TEXT	300000
+
+static const char *WORDS[] = {
+	"the", "of", "and", "to", "in", "is", "was", "that", "for", "with", "as",
+	"time", "people", "water", "house", "small", "large", "between", "after",
+	"zorblax", "quuxle", "1984",
+};
+#define NWORDS	(sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* the block sizes tried, where 0 is the default */
+static const size_t BLOCK_SIZES[] = { 1, 100, 4096, 0 };
+#define NBLOCK_SIZES	(sizeof(BLOCK_SIZES) / sizeof(BLOCK_SIZES[0]))
+
+/* Writes LENGTH characters of made-up text to OUT, followed by a null
+   terminator. */
+static void makeText(char *out, size_t length) {
+	char word[32];
+	size_t n, i = 0;
+
+	while (i < length) {
+		n = (size_t)sprintf(word, "%s%c", WORDS[nextRandom() % NWORDS],
+			(nextRandom() % 16 == 0) ? '\n' : ' ');
+		if (n > length - i)
+			n = length - i;
+		memcpy(out + i, word, n);
+		i += n;
+	}
+	out[length] = '\0';
+}
+
+/* Checks that every block of the SIZE bytes at FRAME decodes on its own to
+   its part of TEXT. Returns 1 on failure and 0 otherwise. */
+static int checkBlocks(const unsigned char *frame, size_t size,
+		const cblt_frameInfo *info, const char *text) {
+	cblt_frameBlock block;
+	char *decoded;
+	size_t n;
+	size_t next = 0;
+
+	for (n = 0; n < info->blocks; ++n) {
+		if (!cblt_getFrameBlock(frame, size, n, &block)
+				|| block.decodedOffset != next) {
+			printf("block %zu of %zu couldn't be found\n", n, info->blocks);
+			return 1;
+		}
+		decoded = cblt_decodeBytes(block.bytes, block.size);
+		if (decoded == NULL || strlen(decoded) != block.decodedLength
+				|| memcmp(decoded, text + next, block.decodedLength) != 0) {
+			printf("block %zu of %zu decoded wrongly\n", n, info->blocks);
+			free(decoded);
+			return 1;
+		}
+		free(decoded);
+		next += block.decodedLength;
+	}
+	if (cblt_getFrameBlock(frame, size, info->blocks, &block)) {
+		printf("a block past the last one was found\n");
+		return 1;
+	}
+	return 0;
+}
+
+/* Encodes TEXT into a frame of blocks of BLOCKSIZE characters with FLAGS,
+   and checks it. Returns 1 on failure and 0 otherwise. */
+static int check(const char *text, size_t blockSize, unsigned int flags,
+		const cblt_dict *other) {
+	unsigned char *frame;
+	char *decoded;
+	cblt_frameInfo info;
+	size_t length = strlen(text);
+	size_t size;
+	size_t i;
+	int failed = 0;
+
+	frame = cblt_encodeFrame(text, blockSize, flags, &size);
+	if (frame == NULL) {
+		printf("%zu characters in blocks of %zu couldn't be encoded\n",
+			length, blockSize);
+		return 1;
+	}
+	decoded = cblt_decodeFrame(frame, size);
+	if (decoded == NULL || strcmp(decoded, text) != 0) {
+		printf("%zu characters in blocks of %zu decoded wrongly\n", length,
+			blockSize);
+		failed = 1;
+	}
+	free(decoded);
+
+	if (!cblt_getFrameInfo(frame, size, &info)
+			|| info.decodedLength != length
+			|| info.dictId != cblt_getDictId(NULL)
+			|| info.crc != ((flags & CBLT_FRAME_CRC) != 0)) {
+		printf("%zu characters in blocks of %zu had the wrong header\n",
+			length, blockSize);
+		free(frame);
+		return 1;
+	}
+	failed |= checkBlocks(frame, size, &info, text);
+	if (!cblt_verifyFrame(frame, size)) {
+		printf("%zu characters in blocks of %zu didn't verify\n", length,
+			blockSize);
+		failed = 1;
+	}
+
+	decoded = cblt_decodeFrameDict(other, frame, size);
+	if (decoded != NULL) {
+		printf("%zu characters were decoded with the wrong dictionary\n",
+			length);
+		failed = 1;
+	}
+	free(decoded);
+
+	for (i = 0; i < size; i += 1 + i / 8) {
+		decoded = cblt_decodeFrame(frame, i);
+		if (decoded != NULL || cblt_verifyFrame(frame, i)) {
+			printf("a frame cut to %zu bytes was accepted\n", i);
+			failed = 1;
+		}
+		free(decoded);
+	}
+	for (i = 0; i < size; i += 1 + i / 8) {
+		frame[i] ^= 0x5A;
+		free(cblt_decodeFrame(frame, size));
+		/* past the 22 bytes of the header of the frame, which only the
+		   decoder checks against the dictionary, changing a byte always
+		   shows */
+		if ((flags & CBLT_FRAME_CRC) && i >= 22
+				&& cblt_verifyFrame(frame, size)
+				&& cblt_getFrameInfo(frame, size, &info)
+				&& info.decodedLength == length) {
+			printf("a frame changed at byte %zu was verified\n", i);
+			failed = 1;
+		}
+		frame[i] ^= 0x5A;
+	}
+
+	free(frame);
+	return failed;
+}
+
+/* Checks that a frame made up around a block that starts a string literal of
+   an older block, which the byte format never holds, is refused rather than
+   decoded past the end of the block. The frame has no checksums, and DICT is
+   the dictionary that the block is made up for. Returns 1 on failure and 0
+   otherwise. */
+static int checkLegacyLiteral(const cblt_dict *dict) {
+	unsigned char frame[] = {
+		'C', 'B', 'L', 'F', 1, 0,	/* the magic, version and flags */
+		0, 0, 0, 0,					/* the dictionary, filled in below */
+		1, 0, 0, 0,					/* 1 block */
+		3, 0, 0, 0, 0, 0, 0, 0,		/* of 3 characters */
+		13, 0, 0, 0,				/* the size of the block */
+		3, 0, 0, 0,					/* and its characters */
+		0xB5,						/* the format */
+		0, 0,						/* the number of symbols, filled in below */
+		0, 0, 0,					/* no bytes, no 1-byte and no 2-byte words */
+		0x05, 0xFF, 0xFF,			/* CBLT_BEGIN_STRING */
+		0x05, 0x01, 0x01,			/* the characters "\x01\x01", or a word */
+		0x00,						/* the end of the block */
+	};
+	uint32_t id = cblt_getDictId(dict);
+	char *decoded;
+	size_t i;
+
+	for (i = 0; i < 4; ++i)
+		frame[6 + i] = (unsigned char)(id >> 8 * i);
+	/* the number of symbols is a 2-byte varint */
+	frame[31] = (unsigned char)(0x80 | ((0x100 + NWORDS) & 0x7F));
+	frame[32] = (unsigned char)((0x100 + NWORDS) >> 7);
+	decoded = cblt_decodeFrameDict(dict, frame, sizeof(frame));
+	if (decoded != NULL) {
+		printf("a frame with a literal of an older block was decoded\n");
+		free(decoded);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void) {
+	char *text;
+	cblt_dict *other;
+	size_t length;
+	size_t n;
+	int failures = 0;
+
+	other = cblt_createDict(WORDS, NWORDS);
+	text = malloc(MAX_TEXT + 1);
+	if (other == NULL || text == NULL)
+		return EXIT_FAILURE;
+	if (cblt_getDictId(other) == cblt_getDictId(NULL)) {
+		printf("2 dictionaries had the same ID\n");
+		++failures;
+	}
+
+	for (length = 0; length <= MAX_TEXT; length += 1 + length) {
+		makeText(text, length);
+		for (n = 0; n < NBLOCK_SIZES; ++n) {
+			/* blocks of 1 character make for a lot of blocks */
+			if (BLOCK_SIZES[n] == 1 && length > 5000)
+				continue;
+			failures += check(text, BLOCK_SIZES[n], 0, other);
+			failures += check(text, BLOCK_SIZES[n], CBLT_FRAME_CRC, other);
+		}
+	}
+	free(text);
+	failures += checkLegacyLiteral(other);
+	cblt_closeDict(other);
+
+	if (failures == 0)
+		printf("all frames decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,86 @@
+/*
+ * index_decode.c
+ *
+ * This test program takes the name of a text file and, optionally, an index
+ * interval in characters as command line arguments. The file is encoded with
+ * cblt_encodeSentenceIndexed(), and then decoded with
+ * cblt_decodeSentenceParallel() using 1, 2, 3 and 8 threads. Every output is
+ * compared to the original file, and to the output of cblt_decodeSentence().
+ * If they all match, the program exits successfully.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+int main(int argc, char **argv) {
+    static const unsigned int threads[] = { 1, 2, 3, 8 };
+    FILE *fp;
+    size_t size;
+    size_t interval = 0;
+    char *sentence;
+    char *decoded;
+    uint16_t *encoded;
+    cblt_index index;
+    size_t i;
+    int failures = 0;
+
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage:\t%s TXTFILE [INTERVAL]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc == 3)
+        interval = strtoul(argv[2], NULL, 10);
+
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+        return EXIT_FAILURE;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+    sentence = malloc(size + 1);
+    if (sentence == NULL) {
+        fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    fread(sentence, 1, size, fp);
+    fclose(fp);
+    sentence[size] = '\0';
+
+    encoded = cblt_encodeSentenceIndexed(sentence, interval, &index);
+    if (encoded == NULL) {
+        fprintf(stderr, "Error during encoding.\n");
+        return EXIT_FAILURE;
+    }
+    printf("%zu index entries, decoded length %zu\n",
+        index.count, index.decodedLength);
+
+    decoded = cblt_decodeSentence(encoded);
+    if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+        printf("cblt_decodeSentence() output does not match\n");
+        ++failures;
+    }
+    free(decoded);
+
+    for (i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i) {
+        decoded = cblt_decodeSentenceParallel(encoded, &index, threads[i]);
+        if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+            printf("%u threads: output does not match\n", threads[i]);
+            ++failures;
+        } else {
+            printf("%u threads: output matches\n", threads[i]);
+        }
+        free(decoded);
+    }
+
+    cblt_freeIndex(&index);
+    free(encoded);
+    free(sentence);
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+/*
+ * into_buffers.c
+ *
+ * This program checks cblt_encodeInto() and cblt_decodeInto() against
+ * cblt_encodeSentence() and cblt_decodeSentence(). It takes the name of a text
+ * file as its only command line argument, and treats every line of the file as
+ * a separate sentence.
+ *
+ * Every sentence is encoded and decoded into buffers that are exactly big
+ * enough, and into buffers that are 1 element too small, which must fail and
+ * report the size that was needed. Only the buffers allocated here are used;
+ * the two functions themselves never allocate anything.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+/* Checks a single sentence. Returns the number of failed checks. */
+static int checkSentence(const char *line, size_t length) {
+	char *sentence;
+	uint16_t *expected;		/* output of cblt_encodeSentence() */
+	size_t encodedLength;
+	size_t decodedLength;
+	uint16_t *encoded;
+	char *decoded;
+	size_t written;
+	int failures = 0;
+
+	/* the reference functions need a null-terminated sentence */
+	sentence = malloc(length + 1);
+	memcpy(sentence, line, length);
+	sentence[length] = '\0';
+	expected = cblt_encodeSentence(sentence);
+	encodedLength = cblt_getUint16BlockSize(expected);
+	decodedLength = cblt_getDecodedLength(expected);
+
+	encoded = malloc(sizeof(uint16_t) * encodedLength);
+	decoded = malloc(decodedLength);
+
+	/* straight from the line, which isn't null-terminated */
+	if (!cblt_encodeInto(line, length, encoded, encodedLength, &written)
+			|| written != encodedLength
+			|| memcmp(encoded, expected, sizeof(uint16_t) * written) != 0) {
+		printf("encodeInto failed: [%s]\n", sentence);
+		++failures;
+	}
+	if (cblt_encodeInto(line, length, encoded, encodedLength - 1, &written)
+			|| written != encodedLength) {
+		printf("encodeInto didn't report %zu elements: [%s]\n",
+			encodedLength, sentence);
+		++failures;
+	}
+
+	if (!cblt_decodeInto(expected, decoded, decodedLength, &written)
+			|| written != decodedLength || strcmp(decoded, sentence) != 0) {
+		printf("decodeInto failed: [%s]\n", sentence);
+		++failures;
+	}
+	if (cblt_decodeInto(expected, decoded, decodedLength - 1, &written)
+			|| written != decodedLength) {
+		printf("decodeInto didn't report %zu characters: [%s]\n",
+			decodedLength, sentence);
+		++failures;
+	}
+
+	free(sentence);
+	free(expected);
+	free(encoded);
+	free(decoded);
+	return failures;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *buf;
+	char *line, *end;
+	size_t lines = 0;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "%s requires one argument.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	buf = malloc(size + 1);
+	if (buf == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	fread(buf, 1, size, fp);
+	fclose(fp);
+	buf[size] = '\n';
+
+	for (line = buf; line < buf + size; line = end + 1) {
+		end = memchr(line, '\n', buf + size + 1 - line);
+		failures += checkSentence(line, end - line);
+		++lines;
+	}
+
+	printf("%zu sentences, %d failures\n", lines, failures);
+	free(buf);
+	return (failures == 0) ? 0 : EXIT_FAILURE;
+}
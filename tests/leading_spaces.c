@@ -0,0 +1,121 @@
+/*
+ * leading_spaces.c
+ *
+ * This program checks how the spaces at the start of a sentence are encoded,
+ * and that they are decoded back exactly. It takes no command line arguments.
+ *
+ * The decoder puts a space before every word that isn't at the very start of
+ * the sentence, so 1 of the spaces before the first word is left implicit, the
+ * same as anywhere else, and the rest make a run. A single leading space has
+ * nothing before it to make the decoder write it, so it is written as a run of
+ * 1 with CBLT_RUN_NO_SPACE added instead. Every sentence must be encoded into
+ * exactly the expected elements, measured by cblt_getDecodedLength() as long
+ * as it is, and decoded back the same by cblt_decodeSentence().
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+/* stand for the elements of the words "dog" and "cat" in the expected
+   elements */
+#define DOG		0x0001
+#define CAT		0x0002
+/* the most elements any of the sentences is expected to take */
+#define MAX_ELEMENTS	4
+
+/* sentences and the elements each should be encoded in, up to the null
+   terminator */
+static const struct {
+	const char *sentence;
+	uint16_t elements[MAX_ELEMENTS + 1];
+} SENTENCES[] = {
+	{ "dog", { DOG } },
+	{ " dog", { CBLT_RUN_SPACES + 1 + CBLT_RUN_NO_SPACE, DOG } },
+	{ "  dog", { CBLT_RUN_SPACES + 1, DOG } },
+	{ "   dog", { CBLT_RUN_SPACES + 2, DOG } },
+	{ " dog cat", { CBLT_RUN_SPACES + 1 + CBLT_RUN_NO_SPACE, DOG, CAT } },
+	{ "  dog cat", { CBLT_RUN_SPACES + 1, DOG, CAT } },
+	{ " ", { CBLT_RUN_SPACES + 1 } },
+	{ "  ", { CBLT_RUN_SPACES + 2 } },
+	{ " .", { CBLT_RUN_SPACES + 1, '.' } },
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* Encodes SENTENCE and checks it against the null-terminated ELEMENTS, in
+   which DOG and CAT stand for the first 2 elements of WORDS. Returns 1 on
+   failure and 0 otherwise. */
+static int check(const char *sentence, const uint16_t *elements,
+		const uint16_t *words) {
+	uint16_t *encoded;
+	uint16_t expected = 0;
+	char *decoded;
+	size_t i;
+	int failed = 0;
+
+	encoded = cblt_encodeSentence(sentence);
+	if (encoded == NULL)
+		return 1;
+
+	for (i = 0; elements[i] != 0; ++i) {
+		if (elements[i] == DOG)
+			expected = words[0];
+		else if (elements[i] == CAT)
+			expected = words[1];
+		else
+			expected = elements[i];
+		if (encoded[i] != expected)
+			break;
+	}
+	if (elements[i] != 0 || encoded[i] != 0) {
+		printf("\"%s\": element %zu is %04X instead of %04X\n", sentence, i,
+			encoded[i], (elements[i] != 0) ? expected : 0);
+		failed = 1;
+	}
+
+	if (cblt_getDecodedLength(encoded) != strlen(sentence) + 1) {
+		printf("\"%s\" was measured as %zu characters\n", sentence,
+			cblt_getDecodedLength(encoded) - 1);
+		failed = 1;
+	}
+	decoded = cblt_decodeSentence(encoded);
+	if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+		printf("\"%s\" decoded as \"%s\"\n", sentence,
+			decoded == NULL ? "(null)" : decoded);
+		failed = 1;
+	}
+
+	free(decoded);
+	free(encoded);
+	return failed;
+}
+
+int main(void) {
+	uint16_t *words;
+	size_t i;
+	int failures = 0;
+
+	/* the elements of the words, whatever the dictionary numbers them */
+	words = cblt_encodeSentence("dog cat");
+	if (words == NULL || words[0] < 0x100 || words[1] < 0x100
+			|| words[2] != 0) {
+		printf("\"dog cat\" is not 2 words\n");
+		free(words);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < NSENTENCES; ++i)
+		failures += check(SENTENCES[i].sentence, SENTENCES[i].elements, words);
+	free(words);
+
+	if (failures > 0) {
+		printf("%d sentences failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all sentences passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/*
+ * literals.c
+ *
+ * This program checks that words that aren't in the dictionary are written as
+ * string literals that carry their own length, and that every decoder reads
+ * them back. It takes no command line arguments.
+ *
+ * Words of every length from 1 to a few times CBLT_MAX_LITERAL characters are
+ * encoded on their own and between other words. Each must take exactly as many
+ * elements as its literals need, and must come back out of
+ * cblt_decodeSentence(), cblt_decodeInto(), a cblt_decoder that is given 1
+ * symbol at a time, a packed block and the byte format. A block with a literal the way older versions of the
+ * library wrote it, with CBLT_BEGIN_STRING and a null terminator, must still
+ * be decoded.
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the longest word that is checked */
+#define MAX_LENGTH	(3 * CBLT_MAX_LITERAL + 2)
+
+/* Returns the number of elements a literal of LENGTH characters should take,
+   counting the CBLT_NO_SPACE symbols between its pieces. */
+static size_t literalElements(size_t length) {
+	size_t elements = 0;
+	size_t n;
+
+	while (length > 0) {
+		n = (length < CBLT_MAX_LITERAL) ? length : CBLT_MAX_LITERAL;
+		elements += 1 + CBLT_LITERAL_ELEMENTS(n);
+		length -= n;
+		if (length > 0)
+			++elements;
+	}
+	return elements;
+}
+
+int main(void) {
+	char word[MAX_LENGTH + 1];
+	char sentence[2 * MAX_LENGTH + 16];
+	uint16_t *encoded;
+	uint16_t older[8];
+	size_t count;
+	size_t length;
+	size_t i;
+	int failures = 0;
+
+	for (length = 1; length <= MAX_LENGTH; ++length) {
+		/* letters that make no word in the dictionary */
+		for (i = 0; i < length; ++i)
+			word[i] = "qxzj"[i % 4];
+		word[length] = '\0';
+
+		encoded = cblt_encodeSentence(word);
+		count = cblt_getUint16BlockSize(encoded) - 1;
+		/* a letter on its own may well be a word */
+		if (cblt_findWord(word) < 0 && count != literalElements(length)) {
+			printf("a word of %zu characters took %zu elements instead of "
+				"%zu\n", length, count, literalElements(length));
+			++failures;
+		}
+		failures += checkDecoded(encoded, word);
+		free(encoded);
+
+		sprintf(sentence, "the %s, and %s the", word, word);
+		encoded = cblt_encodeSentence(sentence);
+		failures += checkDecoded(encoded, sentence);
+		free(encoded);
+	}
+
+	/* "abc the" and "abcd", as older blocks wrote them */
+	older[0] = CBLT_BEGIN_STRING;
+	memcpy(&older[1], "abc\0", 4);
+	older[3] = (uint16_t)cblt_findWord("the");
+	older[4] = 0;
+	failures += checkDecoded(older, "abc the");
+	older[0] = CBLT_BEGIN_STRING;
+	memcpy(&older[1], "abcd\0\xff", 6);
+	older[4] = 0;
+	failures += checkDecoded(older, "abcd");
+
+	if (failures == 0)
+		printf("all literals decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+/*
+ * numbers.c
+ *
+ * This program checks that words made of digits are written as numbers, and
+ * that every decoder reads them back exactly. It takes no command line
+ * arguments.
+ *
+ * A few short sentences must take exactly the expected number of elements.
+ * Then numbers of every length from 1 to CBLT_MAX_DIGITS and a little past it
+ * are made up, in decimal with and without leading zeros and a "-" sign, and
+ * in hexadecimal in either case with and without "0x". Each must come back
+ * out of cblt_decodeSentence(), cblt_decodeInto(), a cblt_decoder that is
+ * given 1 symbol at a time, a packed block and the byte format, and a
+ * cblt_encoder must encode it the same way as cblt_encodeSentence().
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* room for a made-up number of up to 2 digits past CBLT_MAX_DIGITS, with its
+   "0x" and null terminator */
+#define MAX_NUMBER		(CBLT_MAX_DIGITS + 5)
+/* enough for any sentence made of a few numbers and words */
+#define MAX_SENTENCE	(4 * MAX_NUMBER + 32)
+
+/* sentences and the number of elements each should be encoded in, not
+   counting the null terminator */
+static const struct {
+	const char *sentence;
+	size_t elements;
+} SENTENCES[] = {
+	{ "7", 1 },
+	{ "07", 1 },
+	{ "007", 1 },
+	{ "999", 1 },
+	{ "2021", 2 },
+	{ "in 2021", 3 },
+	{ "-12", 2 },
+	{ "0x1f", 2 },
+	{ "0xFF", 2 },
+	{ "deadbeef", 4 },
+	{ "DEADBEEF", 4 },
+	{ "DeadBeef", 5 },
+	{ "123456789", 4 },
+	{ "000000000", 4 },
+	{ "12:34:56", 7 },
+	{ "1234567890123456789012345678901", 9 },
+	{ "12345678901234567890123456789012", 17 },
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* the kinds of numbers that are made up */
+enum { DECIMAL, NEGATIVE, LOWER, UPPER, PREFIXED, NKINDS };
+
+/* Writes a made-up number of KIND with N digits to OUT. */
+static void makeNumber(char *out, int kind, size_t n) {
+	const char *digits = (kind == UPPER) ? "0123456789ABCDEF"
+		: "0123456789abcdef";
+	unsigned int base = (kind == DECIMAL || kind == NEGATIVE) ? 10 : 16;
+	size_t i;
+
+	if (kind == NEGATIVE)
+		*out++ = '-';
+	else if (kind == PREFIXED)
+		*out++ = '0', *out++ = 'x';
+	for (i = 0; i < n; ++i)
+		*out++ = digits[nextRandom() % base];
+	*out = '\0';
+}
+
+int main(void) {
+	char number[MAX_NUMBER];
+	char other[MAX_NUMBER];
+	char sentence[MAX_SENTENCE];
+	size_t n;
+	int kind;
+	int round;
+	int failures = 0;
+
+	for (n = 0; n < NSENTENCES; ++n)
+		failures += checkSentence(SENTENCES[n].sentence, SENTENCES[n].elements);
+
+	for (kind = 0; kind < NKINDS; ++kind) {
+		for (n = 1; n <= CBLT_MAX_DIGITS + 2; ++n) {
+			for (round = 0; round < 8; ++round) {
+				makeNumber(number, kind, n);
+				makeNumber(other, (kind + round) % NKINDS, n);
+				failures += checkSentence(number, 0);
+				sprintf(sentence, "%s, %s.\n%s:%s", number, other, number,
+					other);
+				failures += checkSentence(sentence, 0);
+			}
+		}
+	}
+
+	if (failures == 0)
+		printf("all numbers decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,215 @@
+/*
+ * pack_roundtrip.c
+ *
+ * This program checks that cblt_unpackBlock() gives back exactly the block
+ * that cblt_packBlock() was given, and measures how small and how fast it is.
+ * It takes the name of a text file as its only command line argument.
+ *
+ * The file is encoded, packed and unpacked, and the sizes of the text, the
+ * encoded block and the packed block are printed, along with how fast the
+ * block was packed and unpacked, and how fast the unpacked block was decoded
+ * back to text. Blocks that can't be packed with the entropy coder, like an
+ * empty one or one with a literal that isn't padded the usual way, and blocks
+ * with literals written the way older versions wrote them, must still come
+ * back out the same, and a packed block that was cut short or damaged, or
+ * with one of those literals running past its end, must be refused rather
+ * than read out of bounds.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "cobalt.h"
+
+/* the number of times the block is packed and unpacked, for timing */
+#define RUNS	5
+
+/* Returns the number of seconds between START and END. */
+static double elapsed(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec)
+		+ (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Packs and unpacks the COUNT elements of BLOCK, including the terminator, and
+   checks that they come out the same. Returns 1 on failure and 0 otherwise. */
+static int check(const char *name, const uint16_t *block, size_t count) {
+	unsigned char *packed;
+	uint16_t *unpacked;
+	size_t size;
+	int failed = 0;
+
+	packed = cblt_packBlock(block, &size);
+	unpacked = cblt_unpackBlock(packed, size);
+	if (unpacked == NULL || memcmp(unpacked, block,
+			sizeof(uint16_t) * count) != 0) {
+		printf("%s: unpacked block differs\n", name);
+		failed = 1;
+	}
+	free(unpacked);
+	free(packed);
+	return failed;
+}
+
+/* Packs a block that ends with a literal the way older blocks wrote it, but
+   with no null terminator before the end of the block, after WORDS words.
+   Unpacking it must fail rather than hand the decoder a literal that runs
+   past the end. Returns 1 on failure and 0 otherwise. */
+static int checkUnterminated(size_t words) {
+	unsigned char *packed;
+	uint16_t *block;
+	uint16_t *unpacked;
+	size_t size;
+	size_t i;
+
+	block = malloc(sizeof(uint16_t) * (words + 3));
+	if (block == NULL)
+		return 1;
+	for (i = 0; i < words; ++i)
+		block[i] = 0x100;
+	block[words] = CBLT_BEGIN_STRING;
+	memcpy(&block[words + 1], "ab", 2);
+	block[words + 2] = 0;
+
+	packed = cblt_packBlock(block, &size);
+	unpacked = cblt_unpackBlock(packed, size);
+	free(block);
+	free(packed);
+	if (unpacked != NULL) {
+		printf("a literal after %zu words that runs past the end was "
+			"unpacked\n", words);
+		free(unpacked);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *text;
+	uint16_t *encoded;
+	size_t count;			/* elements in encoded, with the terminator */
+	unsigned char *packed;
+	size_t packedSize;
+	uint16_t *unpacked;
+	char *decoded;
+	/* a literal padded with something other than a null byte */
+	uint16_t odd[] = { CBLT_LITERAL + 1, 0, 0x100, 0 };
+	/* a literal the way older blocks wrote it */
+	uint16_t older[] = { 0x100, CBLT_BEGIN_STRING, 0, 0, 0x100, 0 };
+	uint16_t empty[] = { 0 };
+	struct timespec start, end;
+	double packTime = 1e9, unpackTime = 1e9, decodeTime = 1e9;
+	size_t i;
+	int run;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage:\t%s TXTFILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = malloc(size + 1);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	size = fread(text, 1, size, fp);
+	fclose(fp);
+	text[size] = '\0';
+
+	memcpy(&odd[1], "xq", 2);
+	failures += check("odd literal", odd, 4);
+	memcpy(&older[2], "abc\0", 4);
+	failures += check("older literal", older, 6);
+	failures += check("empty block", empty, 1);
+	/* short enough to be stored, and long enough to be entropy coded */
+	failures += checkUnterminated(0);
+	failures += checkUnterminated(1000);
+
+	encoded = cblt_encodeSentence(text);
+	if (encoded == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	count = cblt_getUint16BlockSize(encoded);
+	failures += check(argv[1], encoded, count);
+
+	/* time the best of a few runs of each step */
+	packed = NULL;
+	unpacked = NULL;
+	decoded = NULL;
+	for (run = 0; run < RUNS; ++run) {
+		free(packed);
+		free(unpacked);
+		free(decoded);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		packed = cblt_packBlock(encoded, &packedSize);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (elapsed(&start, &end) < packTime)
+			packTime = elapsed(&start, &end);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		unpacked = cblt_unpackBlock(packed, packedSize);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (elapsed(&start, &end) < unpackTime)
+			unpackTime = elapsed(&start, &end);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		decoded = cblt_decodeSentence(unpacked);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (elapsed(&start, &end) < decodeTime)
+			decodeTime = elapsed(&start, &end);
+	}
+	if (decoded == NULL || strcmp(decoded, text) != 0) {
+		printf("decoded text differs\n");
+		++failures;
+	}
+
+	printf("text:    %zu bytes\n", size);
+	printf("encoded: %zu bytes (%.1f%%)\n", 2 * count,
+		200.0 * count / size);
+	printf("packed:  %zu bytes (%.1f%%)\n", packedSize,
+		100.0 * packedSize / size);
+	printf("pack:    %.0f MB/s of text\n", size / packTime / 1e6);
+	printf("unpack:  %.0f MB/s of text\n", size / unpackTime / 1e6);
+	printf("decode:  %.0f MB/s of text after unpacking\n",
+		size / decodeTime / 1e6);
+
+	free(unpacked);
+	/* anything cut off must be refused */
+	for (i = 0; i < packedSize; i += 1 + i / 16) {
+		unpacked = cblt_unpackBlock(packed, i);
+		if (unpacked != NULL) {
+			printf("a block cut to %zu bytes was unpacked\n", i);
+			++failures;
+		}
+		free(unpacked);
+	}
+	/* and damage must never be read out of bounds */
+	for (i = 0; i < packedSize; i += 1 + i / 16) {
+		packed[i] ^= 0x5A;
+		free(cblt_unpackBlock(packed, packedSize));
+		packed[i] ^= 0x5A;
+	}
+
+	free(decoded);
+	free(packed);
+	free(encoded);
+	free(text);
+	if (failures == 0)
+		printf("all blocks unpacked\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,149 @@
+/*
+ * phrases.c
+ *
+ * This program checks that frequent phrases like "one of the" are encoded as a
+ * single symbol, and that text with phrases in it always decodes back to the
+ * original. It takes the name of a text file as its only command line
+ * argument, preferably one in plain English, so that it has plenty of phrases
+ * in it.
+ *
+ * A few short sentences check the edges of a phrase: the words of a phrase
+ * must be separated by exactly 1 space, and a phrase must end where a word
+ * ends. The file is then encoded by cblt_encodeSentence() and by
+ * cblt_encodeSentenceParallel(), which must never cut the file in the middle
+ * of a phrase, so both must give the same output. Finally, a dictionary with
+ * phrases of its own is created with cblt_createDict().
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+/* sentences and the number of elements each should be encoded in, not
+   counting the null terminator */
+static const struct {
+	const char *sentence;
+	size_t elements;
+} SENTENCES[] = {
+	{ "one of the", 1 },
+	{ "one of the best", 2 },
+	{ "of the", 1 },
+	{ "of  the", 3 },
+	{ "of the.", 2 },
+	{ "of thee", 2 },
+	{ " of the", 2 },
+	{ "In the end", 2 },
+	{ "of the the the of", 4 },
+	{ "of-the", 4 },
+	{ "of\nthe", 3 },
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* a dictionary where "a b c d" has too many words, "x  y" has 2 spaces in a
+   row, and "b c d" has no phrase "b c" to lead up to it */
+static const char *WORDS[] = {
+	"a", "b", "c", "d", "x", "y",
+	"a b", "a b c", "a b c d", "x  y", "b c d"
+};
+#define NWORDS	(sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* Encodes SENTENCE with DICT, and checks that it takes ELEMENTS elements and
+   decodes back to SENTENCE. Returns 1 on failure and 0 otherwise. */
+static int check(const cblt_dict *dict, const char *sentence,
+		size_t elements) {
+	uint16_t *encoded;
+	char *decoded;
+	size_t count;
+	int failed = 0;
+
+	encoded = cblt_encodeSentenceDict(dict, sentence);
+	decoded = cblt_decodeSentenceDict(dict, encoded);
+	count = cblt_getUint16BlockSize(encoded) - 1;
+	if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+		printf("\"%s\" decoded as \"%s\"\n", sentence,
+			decoded == NULL ? "(null)" : decoded);
+		failed = 1;
+	} else if (count != elements) {
+		printf("\"%s\" took %zu elements instead of %zu\n", sentence, count,
+			elements);
+		failed = 1;
+	}
+
+	free(encoded);
+	free(decoded);
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *text;
+	uint16_t *expected;		/* output of cblt_encodeSentence() */
+	uint16_t *parallel;		/* output of cblt_encodeSentenceParallel() */
+	size_t count;
+	cblt_dict *dict;
+	size_t i;
+	int failures = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage:\t%s TXTFILE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < NSENTENCES; ++i)
+		failures += check(NULL, SENTENCES[i].sentence,
+			SENTENCES[i].elements);
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = malloc(size + 1);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	size = fread(text, 1, size, fp);
+	fclose(fp);
+	text[size] = '\0';
+
+	expected = cblt_encodeSentence(text);
+	count = cblt_getUint16BlockSize(expected);
+	failures += check(NULL, text, count - 1);
+	for (i = 2; i <= 64; i *= 2) {
+		parallel = cblt_encodeSentenceParallel(text, i);
+		if (parallel == NULL || cblt_getUint16BlockSize(parallel) != count
+				|| memcmp(parallel, expected, sizeof(uint16_t) * count) != 0) {
+			printf("%zu threads: encoded blocks differ\n", i);
+			++failures;
+		}
+		free(parallel);
+	}
+	printf("%zu characters in %zu elements\n", strlen(text), count);
+
+	dict = cblt_createDict(WORDS, NWORDS);
+	if (dict == NULL) {
+		printf("dictionary could not be created\n");
+		++failures;
+	} else {
+		failures += check(dict, "a b c", 1);
+		failures += check(dict, "a b c d", 2);
+		failures += check(dict, "x  y", 3);
+		failures += check(dict, "b c d", 3);
+		cblt_closeDict(dict);
+	}
+
+	free(expected);
+	free(text);
+	if (failures == 0)
+		printf("all phrases found\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,185 @@
+/*
+ * repeats.c
+ *
+ * This program checks that string literals that come up more than once in a
+ * block are repeated with a CBLT_REPEAT symbol, and that every decoder reads
+ * them back exactly. It takes no command line arguments.
+ *
+ * A few short sentences must take exactly the expected number of elements.
+ * Then long sentences are made up out of pools of made-up words, some smaller
+ * and some larger than the CBLT_REPEATS literals that can be remembered at
+ * once, so that literals are both repeated and forgotten. Each must come back
+ * out of cblt_decodeSentence(), cblt_decodeInto(), a cblt_decoder that is
+ * given 1 symbol at a time, a packed block, the byte format, and
+ * cblt_decodeSentenceParallel() with a small index interval. A cblt_encoder
+ * and cblt_encodeSentenceParallel() must encode it the same way as
+ * cblt_encodeSentence().
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the longest made-up word, which is longer than any literal */
+#define MAX_WORD		300
+/* the number of words in each made-up sentence */
+#define SENTENCE_WORDS	40000
+
+/* sentences and the number of elements each should be encoded in, not
+   counting the null terminator */
+static const struct {
+	const char *sentence;
+	size_t elements;
+} SENTENCES[] = {
+	{ "zorblax", 5 },
+	{ "zorblax zorblax", 6 },
+	{ "zorblax zorblax zorblax", 7 },
+	{ "zorblax, zorblax.", 8 },
+	{ "zorblax quuxle zorblax quuxle", 11 },
+	{ "zorblax Zorblax", 10 },
+	{ "zorblax zorblaxes", 11 },
+	{ "the zorblax of the zorblax", 8 },
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* the sizes of the pools of made-up words */
+static const size_t POOLS[] = { 1, 10, CBLT_REPEATS, CBLT_REPEATS + 1, 1000 };
+#define NPOOLS	(sizeof(POOLS) / sizeof(POOLS[0]))
+
+/* Writes made-up word number N to OUT, which must have room for MAX_WORD + 1
+   characters. Every 64th word is longer than any literal. */
+static void makeWord(char *out, size_t n) {
+	size_t length = (n % 64 == 63) ? MAX_WORD : 4 + n % 20;
+	size_t i;
+
+	for (i = 0; i < length; ++i)
+		out[i] = "qxzjvkw"[(n + i * i) % 7];
+	/* the number in base 26 keeps the words apart */
+	for (i = 0; n > 0 && i < length; ++i, n /= 26)
+		out[i] = (char)('a' + n % 26);
+	out[length] = '\0';
+}
+
+/* Decodes ENCODED with cblt_decodeSentenceParallel(), using an index made by
+   encoding SENTENCE with a small interval. */
+static char *decodeParallel(const uint16_t *encoded, size_t count,
+		const char *sentence) {
+	cblt_index index = { 0 };
+	uint16_t *indexed;
+	char *decoded = NULL;
+
+	indexed = cblt_encodeSentenceIndexed(sentence, 256, &index);
+	if (indexed != NULL && cblt_getUint16BlockSize(indexed) == count
+			&& memcmp(indexed, encoded, sizeof(uint16_t) * count) == 0)
+		decoded = cblt_decodeSentenceParallel(encoded, &index, 4);
+	free(indexed);
+	cblt_freeIndex(&index);
+	return decoded;
+}
+
+/* Encodes SENTENCE with a cblt_encoder whose window holds any made-up word and
+   with cblt_encodeSentenceParallel(), and checks that both come out the same
+   as ENCODED, which has COUNT elements, including the terminator. A
+   cblt_encoder of the smallest window, which cuts the longest words into
+   pieces, must still be decoded back to SENTENCE. Returns 1 on failure and 0
+   otherwise. */
+static int checkEncoded(const char *sentence, const uint16_t *encoded,
+		size_t count) {
+	uint16_t *streamed;
+	uint16_t *parallel;
+	char *decoded;
+	int failed = 0;
+
+	streamed = encodeStreamed(sentence, 2 * MAX_WORD);
+	if (streamed == NULL || cblt_getUint16BlockSize(streamed) != count
+			|| memcmp(streamed, encoded, sizeof(uint16_t) * count) != 0) {
+		printf("\"%.40s\" was streamed differently\n", sentence);
+		failed = 1;
+	}
+	free(streamed);
+
+	streamed = encodeStreamed(sentence, 1);
+	decoded = (streamed != NULL) ? decodeStreamed(streamed, strlen(sentence))
+		: NULL;
+	if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+		printf("\"%.40s\" was streamed in pieces wrongly\n", sentence);
+		failed = 1;
+	}
+	free(decoded);
+	free(streamed);
+
+	parallel = cblt_encodeSentenceParallel(sentence, 4);
+	if (parallel == NULL || cblt_getUint16BlockSize(parallel) != count
+			|| memcmp(parallel, encoded, sizeof(uint16_t) * count) != 0) {
+		printf("\"%.40s\" was encoded differently in parallel\n", sentence);
+		failed = 1;
+	}
+	free(parallel);
+	return failed;
+}
+
+/* Encodes SENTENCE, and checks that it takes ELEMENTS elements, if ELEMENTS
+   isn't 0, and that it is decoded and encoded back the same, by the parallel
+   decoder and encoder too. Returns 1 on failure and 0 otherwise. */
+static int checkRepeats(const char *sentence, size_t elements) {
+	uint16_t *encoded;
+	char *decoded;
+	size_t count;
+	int failed;
+
+	encoded = cblt_encodeSentence(sentence);
+	if (encoded == NULL)
+		return 1;
+	count = cblt_getUint16BlockSize(encoded);
+	failed = checkDecoded(encoded, sentence);
+	decoded = decodeParallel(encoded, count, sentence);
+	if (decoded == NULL || strcmp(decoded, sentence) != 0) {
+		printf("\"%.40s\" was decoded wrongly in parallel\n", sentence);
+		failed = 1;
+	}
+	free(decoded);
+	if (elements != 0 && count - 1 != elements) {
+		printf("\"%.40s\" took %zu elements instead of %zu\n", sentence,
+			count - 1, elements);
+		failed = 1;
+	}
+	failed |= checkEncoded(sentence, encoded, count);
+	free(encoded);
+	return failed;
+}
+
+int main(void) {
+	char word[MAX_WORD + 1];
+	char *sentence;
+	char *end;
+	size_t n, i;
+	int failures = 0;
+
+	for (n = 0; n < NSENTENCES; ++n)
+		failures += checkRepeats(SENTENCES[n].sentence,
+			SENTENCES[n].elements);
+
+	sentence = malloc((size_t)SENTENCE_WORDS * (MAX_WORD + 2));
+	if (sentence == NULL)
+		return EXIT_FAILURE;
+	for (n = 0; n < NPOOLS; ++n) {
+		end = sentence;
+		for (i = 0; i < SENTENCE_WORDS; ++i) {
+			makeWord(word, nextRandom() % POOLS[n]);
+			if (i > 0)
+				*end++ = (nextRandom() % 8 == 0) ? '\n' : ' ';
+			end += sprintf(end, "%s", word);
+		}
+		failures += checkRepeats(sentence, 0);
+	}
+	free(sentence);
+
+	if (failures == 0)
+		printf("all repeats decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+/*
+ * runs.c
+ *
+ * This program checks that spaces, tabs and line breaks are written as runs,
+ * and that every decoder reads them back. It takes no command line arguments.
+ *
+ * A few short sentences must take exactly the expected number of elements.
+ * Then runs of every length from 1 to a few times CBLT_MAX_RUN of each kind
+ * are encoded on their own and between words and punctuation. Each must take
+ * as many run symbols as it needs, and must come back out of
+ * cblt_decodeSentence(), cblt_decodeInto(), a cblt_decoder that is given 1
+ * symbol at a time, a packed block and the byte format. A cblt_encoder with
+ * the smallest window must cut the long runs without changing how they are
+ * encoded.
+ *
+ * This program is to be linked with support.c and libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the longest run that is checked */
+#define MAX_RUN		(3 * CBLT_MAX_RUN + 2)
+/* enough for any sentence made of 3 runs and a few words */
+#define MAX_SENTENCE	(3 * 2 * MAX_RUN + 32)
+
+/* sentences and the number of elements each should be encoded in, not
+   counting the null terminator */
+static const struct {
+	const char *sentence;
+	size_t elements;
+} SENTENCES[] = {
+	{ "dog\ncat", 3 },
+	{ "dog\n\ncat", 3 },
+	{ "dog\r\ncat", 3 },
+	{ "dog\r\n\r\ncat", 3 },
+	{ "dog\n\tcat", 4 },
+	{ "dog  cat", 3 },
+	{ "dog\t\t\tcat", 3 },
+	{ " dog", 2 },
+	{ "  dog", 2 },
+	{ "dog cat.\n", 4 },
+	{ "dog\rcat", 4 },
+	{ "\n", 1 },
+};
+#define NSENTENCES	(sizeof(SENTENCES) / sizeof(SENTENCES[0]))
+
+/* the characters that make up each kind of run */
+static const char *UNITS[] = { " ", "\t", "\n", "\r\n" };
+#define NUNITS	(sizeof(UNITS) / sizeof(UNITS[0]))
+
+/* Returns the number of run symbols needed for a run of N. */
+static size_t runElements(size_t n) {
+	return (n + CBLT_MAX_RUN - 1) / CBLT_MAX_RUN;
+}
+
+int main(void) {
+	char run[2 * MAX_RUN + 1];
+	char sentence[MAX_SENTENCE];
+	size_t n;
+	size_t i, k;
+	int failures = 0;
+
+	for (i = 0; i < NSENTENCES; ++i)
+		failures += checkSentence(SENTENCES[i].sentence, SENTENCES[i].elements);
+
+	for (k = 0; k < NUNITS; ++k) {
+		run[0] = '\0';
+		for (n = 1; n <= MAX_RUN; ++n) {
+			strcat(run, UNITS[k]);
+
+			failures += checkSentence(run, runElements(n));
+			/* one space before a word is left implicit */
+			sprintf(sentence, "dog%scat", run);
+			failures += checkSentence(sentence, 2 + runElements(n - (k == 0)));
+			sprintf(sentence, "dog.%s", run);
+			failures += checkSentence(sentence, 2 + runElements(n));
+			sprintf(sentence, "%sdog, %s%scat", run, run, run);
+			failures += checkSentence(sentence, 0);
+		}
+	}
+
+	if (failures == 0)
+		printf("all runs decoded\n");
+	return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+/*
+ * stream_roundtrip.c
+ *
+ * This program checks the streaming encoder and decoder against
+ * cblt_encodeSentence(). It takes the name of a text file as its first command
+ * line argument, and optionally the size of the encoder window as its second.
+ *
+ * The file is fed to a cblt_encoder in pieces of awkward, changing sizes, with
+ * just as awkward amounts of room for the output, and the result is compared
+ * with what cblt_encodeSentence() makes of the whole file. The encoded block is
+ * then fed to a cblt_decoder in the same way, and the result is compared with
+ * the original file.
+ *
+ * The two encoded blocks may only differ if the file has a word longer than the
+ * window in it, in which case only the decoded text is checked.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+
+/* sizes of the pieces of input and output, used round-robin */
+static const size_t SIZES[] = { 1, 7, 3, 4096, 2, 13, 65536, 5 };
+#define NSIZES	(sizeof(SIZES) / sizeof(SIZES[0]))
+
+int main(int argc, char **argv) {
+	FILE *fp;
+	size_t size;
+	char *text;
+	uint16_t *expected;		/* output of cblt_encodeSentence() */
+	size_t expectedCount;
+	uint16_t *streamed;		/* output of the streaming encoder */
+	char *decoded;			/* output of the streaming decoder */
+	size_t window = 0;
+	cblt_encoder *enc;
+	cblt_decoder *dec;
+	const char *in;
+	const uint16_t *sin;
+	size_t inLength, capacity, piece;
+	uint16_t *out;
+	char *sout;
+	size_t k = 0;
+	bool done;
+
+	if (argc != 2 && argc != 3) {
+		fprintf(stderr, "Usage:\t%s TXTFILE [WINDOW]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 3)
+		window = strtoul(argv[2], NULL, 10);
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	text = malloc(size + 1);
+	if (text == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	fread(text, 1, size, fp);
+	fclose(fp);
+	text[size] = '\0';
+	size = strlen(text);
+
+	expected = cblt_encodeSentence(text);
+	enc = cblt_createEncoder(window);
+	dec = cblt_createDecoder();
+	/* the streamed block is never more than twice the size of the text */
+	streamed = malloc(sizeof(uint16_t) * (2 * size + 2));
+	decoded = malloc(size + 1);
+	if (expected == NULL || enc == NULL || dec == NULL
+			|| streamed == NULL || decoded == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	expectedCount = cblt_getUint16BlockSize(expected);
+
+	/* encode */
+	in = text;
+	out = streamed;
+	while (in < text + size) {
+		piece = SIZES[k++ % NSIZES];
+		inLength = (size_t)(text + size - in);
+		if (inLength > piece)
+			inLength = piece;
+		capacity = SIZES[k++ % NSIZES];
+		cblt_encoderUpdate(enc, &in, &inLength, &out, &capacity);
+	}
+	do {
+		capacity = SIZES[k++ % NSIZES];
+		done = cblt_encoderFinish(enc, &out, &capacity);
+	} while (!done);
+
+	if ((size_t)(out - streamed) != expectedCount
+			|| memcmp(streamed, expected, sizeof(uint16_t) * expectedCount)) {
+		printf("encoded blocks differ: %zu elements streamed, %zu expected\n",
+			(size_t)(out - streamed), expectedCount);
+	} else {
+		printf("encoded blocks match: %zu elements\n", expectedCount);
+	}
+
+	/* decode */
+	sin = streamed;
+	sout = decoded;
+	done = false;
+	while (!done && sin < out) {
+		inLength = SIZES[k++ % NSIZES];
+		if (inLength > (size_t)(out - sin))
+			inLength = (size_t)(out - sin);
+		capacity = SIZES[k++ % NSIZES];
+		if (capacity > (size_t)(decoded + size - sout))
+			capacity = (size_t)(decoded + size - sout);
+		done = cblt_decoderUpdate(dec, &sin, &inLength, &sout, &capacity);
+	}
+	*sout = '\0';
+
+	if (!done || (size_t)(sout - decoded) != size
+			|| strcmp(decoded, text) != 0) {
+		printf("decoded text differs: %zu characters, %zu expected\n",
+			(size_t)(sout - decoded), size);
+		return EXIT_FAILURE;
+	}
+	printf("decoded text matches: %zu characters\n", size);
+
+	cblt_freeEncoder(enc);
+	cblt_freeDecoder(dec);
+	free(expected);
+	free(streamed);
+	free(decoded);
+	free(text);
+	return 0;
+}
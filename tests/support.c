@@ -0,0 +1,163 @@
+/*
+ * support.c
+ *
+ * This file contains what the tests share: a fixed sequence of pseudorandom
+ * numbers for making up text, and the round trips that the tests of the
+ * encoding of each kind of element go through. It is to be linked with each
+ * of those programs, and with libcobalt, at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "cobalt.h"
+#include "support.h"
+
+/* the state of nextRandom(), which starts the same on every run */
+static uint32_t seed = 12345;
+
+/* Returns the next of a fixed sequence of pseudorandom numbers from 0 to
+   0x7FFF, so that every run makes up the same text. */
+unsigned int nextRandom(void) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7FFF;
+}
+
+/* Decodes ENCODED with a cblt_decoder that is given 1 symbol at a time, into
+   a newly allocated string of at most LENGTH characters. */
+char *decodeStreamed(const uint16_t *encoded, size_t length) {
+	cblt_decoder *dec;
+	char *decoded;
+	char *out;
+	size_t capacity;
+	size_t inLength;
+	bool done = false;
+
+	dec = cblt_createDecoder();
+	decoded = malloc(length + 1);
+	if (dec == NULL || decoded == NULL) {
+		cblt_freeDecoder(dec);
+		free(decoded);
+		return NULL;
+	}
+
+	out = decoded;
+	capacity = length;
+	while (!done) {
+		inLength = 1;
+		done = cblt_decoderUpdate(dec, &encoded, &inLength, &out, &capacity);
+	}
+	*out = '\0';
+	cblt_freeDecoder(dec);
+	return decoded;
+}
+
+/* Encodes SENTENCE with a cblt_encoder whose window holds WINDOW characters,
+   and returns the newly allocated output, or NULL on failure. */
+uint16_t *encodeStreamed(const char *sentence, size_t window) {
+	cblt_encoder *enc;
+	uint16_t *streamed;
+	uint16_t *out;
+	size_t inLength = strlen(sentence);
+	size_t capacity = 2 * inLength + 2;
+
+	enc = cblt_createEncoder(window);
+	streamed = malloc(sizeof(uint16_t) * capacity);
+	if (enc == NULL || streamed == NULL) {
+		cblt_freeEncoder(enc);
+		free(streamed);
+		return NULL;
+	}
+
+	out = streamed;
+	cblt_encoderUpdate(enc, &sentence, &inLength, &out, &capacity);
+	if (!cblt_encoderFinish(enc, &out, &capacity)) {
+		free(streamed);
+		streamed = NULL;
+	}
+	cblt_freeEncoder(enc);
+	return streamed;
+}
+
+/* Checks that every decoder turns ENCODED back into SENTENCE, that SENTENCE
+   comes back out of the byte format, and that ENCODED comes back out of a
+   packed block the same. Returns 1 on failure and 0 otherwise. */
+int checkDecoded(const uint16_t *encoded, const char *sentence) {
+	char *decoded[4];
+	unsigned char *packed, *bytes;
+	uint16_t *unpacked;
+	size_t count = cblt_getUint16BlockSize(encoded);
+	size_t length = strlen(sentence);
+	size_t size, written;
+	size_t i;
+	int failed = 0;
+
+	if (cblt_getDecodedLength(encoded) != length + 1) {
+		printf("\"%.40s\" was measured as %zu characters\n", sentence,
+			cblt_getDecodedLength(encoded) - 1);
+		failed = 1;
+	}
+	decoded[0] = cblt_decodeSentence(encoded);
+	decoded[1] = malloc(length + 1);
+	if (decoded[1] != NULL && !cblt_decodeInto(encoded, decoded[1],
+			length + 1, &written)) {
+		free(decoded[1]);
+		decoded[1] = NULL;
+	}
+	decoded[2] = decodeStreamed(encoded, length);
+	bytes = cblt_encodeBytes(sentence, &size);
+	decoded[3] = (bytes != NULL) ? cblt_decodeBytes(bytes, size) : NULL;
+	free(bytes);
+
+	for (i = 0; i < 4; ++i) {
+		if (decoded[i] == NULL || strcmp(decoded[i], sentence) != 0) {
+			printf("\"%.40s\" decoded as \"%.40s\" by decoder %zu\n", sentence,
+				decoded[i] == NULL ? "(null)" : decoded[i], i);
+			failed = 1;
+		}
+		free(decoded[i]);
+	}
+
+	packed = cblt_packBlock(encoded, &size);
+	unpacked = (packed != NULL) ? cblt_unpackBlock(packed, size) : NULL;
+	if (unpacked == NULL
+			|| memcmp(unpacked, encoded, sizeof(uint16_t) * count) != 0) {
+		printf("\"%.40s\" was unpacked differently\n", sentence);
+		failed = 1;
+	}
+	free(unpacked);
+	free(packed);
+	return failed;
+}
+
+/* Encodes SENTENCE, and checks that it takes ELEMENTS elements, if ELEMENTS
+   isn't 0, that it is decoded back the same, and that a cblt_encoder of the
+   smallest window encodes it the same. Returns 1 on failure and 0
+   otherwise. */
+int checkSentence(const char *sentence, size_t elements) {
+	uint16_t *encoded;
+	uint16_t *streamed;
+	size_t count;
+	int failed;
+
+	encoded = cblt_encodeSentence(sentence);
+	if (encoded == NULL)
+		return 1;
+	count = cblt_getUint16BlockSize(encoded);
+	failed = checkDecoded(encoded, sentence);
+	if (elements != 0 && count - 1 != elements) {
+		printf("\"%.40s\" took %zu elements instead of %zu\n", sentence,
+			count - 1, elements);
+		failed = 1;
+	}
+	streamed = encodeStreamed(sentence, 1);
+	if (streamed == NULL || cblt_getUint16BlockSize(streamed) != count
+			|| memcmp(streamed, encoded, sizeof(uint16_t) * count) != 0) {
+		printf("\"%.40s\" was streamed differently\n", sentence);
+		failed = 1;
+	}
+	free(streamed);
+	free(encoded);
+	return failed;
+}
@@ -0,0 +1,19 @@
+/*
+ * support.h
+ *
+ * contains the declarations of functions defined in support.c
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef SUPPORT_H
+#define SUPPORT_H
+
+unsigned int nextRandom(void);
+char *decodeStreamed(const uint16_t *encoded, size_t length);
+uint16_t *encodeStreamed(const char *sentence, size_t window);
+int checkDecoded(const uint16_t *encoded, const char *sentence);
+int checkSentence(const char *sentence, size_t elements);
+
+#endif  /* SUPPORT_H */
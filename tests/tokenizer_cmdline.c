@@ -0,0 +1,41 @@
+/* tokenizer_cmdline.c
+ * 
+ * This is a test program that reads the 1st (not 0th) argument from the command
+ * line and splits it with a cblt_tokenizer. The program prints the same
+ * information as splitstr_cmdline.c, so the output of the two programs can be
+ * compared directly to make sure that both split strings the same way.
+ * 
+ * This file is intended to be compiled with ../src/splitstring.c, NOT linked
+ * with libcobalt at compile time.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "splitstring.h"
+
+int main(int argc, char **argv) {
+	cblt_tokenizer tok;
+	const char *group;
+	size_t length;
+	int currentStatus;
+	int i = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "%s requires one argument.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	printf("%s\n", argv[1]);
+	
+	cblt_initTokenizer(&tok, argv[1], strlen(argv[1]));
+	do {
+		currentStatus = cblt_nextToken(&tok, &group, &length);
+		printf("group %2d at index %2zd is \"%.*s\"\n",
+			i++, group - argv[0], (int)length, group);
+		printf("  current type is %s\n", cblt_getStatusName(currentStatus));
+		printf("  next type is    %s\n", cblt_getStatusName(tok.nextStatus));
+	} while (currentStatus != EndOfString);
+
+	return 0;
+}
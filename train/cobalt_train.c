@@ -0,0 +1,550 @@
+/*
+ * cobalt_train.c
+ * by Eliot Baez
+ *
+ * This program builds a dictionary that suits a particular corpus of text,
+ * instead of the general-purpose word list compiled into libcobalt. Every word
+ * that isn't in the dictionary has to be encoded as a string literal, so a
+ * corpus full of log messages or product names can shrink a great deal more
+ * with a dictionary of its own.
+ *
+ * Usage:	./cobalt-train [-n WORDS] [-j THREADS] [-w WORDLIST] CORPUS DICTFILE
+ * 	-n WORDS        Keep at most WORDS words; 50000 by default
+ * 	-j THREADS      Count words on THREADS threads at once; 0, the default,
+ * 	                means one thread per processor
+ * 	-w WORDLIST     Also write the words that were kept to WORDLIST, one per
+ * 	                line, most frequent first
+ * 	CORPUS          A file of plain text like the text that will be encoded.
+ * 	                It is read a piece at a time, so it may also be a pipe,
+ * 	                like /dev/stdin
+ * 	DICTFILE        The file where the dictionary will be written, to be
+ * 	                loaded with cblt_openDict()
+ *
+ * The corpus is split into words by the same rules as the encoder uses, and
+ * every word is counted. Encoding a word that is in the dictionary takes 1
+ * element, and encoding one that isn't takes 1 element for the CBLT_LITERAL
+ * symbol plus the characters of the literal, so every occurrence of a
+ * word saves as many elements as its literal would have taken. A word of
+ * decimal digits is written as a number instead, which saves little or
+ * nothing when it is short. The words that save the most in total are kept,
+ * and are numbered from most to least frequent.
+ *
+ * The corpus is read in chunks, which are cut right before the last word in
+ * them, so that no word is ever split between two chunks. Each thread counts
+ * the words of its own chunks into a hash table of its own, and the tables are
+ * merged once the whole corpus has been read, so the threads never wait on
+ * each other while counting. The result is the same for any number of
+ * threads.
+ *
+ * This program is to be linked with libcobalt at compile time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef CBLT_HAVE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>	/* sysconf */
+#endif
+
+#include "cobalt.h"
+#include "splitstring.h"
+#include "wordhash.h"
+
+/* characters of the corpus given to each thread at a time */
+#define CHUNK_SIZE		(16 * 1024 * 1024)
+#define DEFAULT_WORDS	50000
+/* initial number of entries in each hash table; must be a power of 2 */
+#define INITIAL_ENTRIES	(64 * 1024)
+
+/* A single unique word. Entries with a count of 0 are empty. */
+struct entry {
+	uint64_t hash;
+	uint64_t count;
+	size_t offset;		/* offset of the word in the text of the counter */
+	uint32_t length;
+};
+
+/* An open addressing hash table of word counts. The words themselves are kept
+   back to back in TEXT, each followed by a null character. */
+struct counter {
+	struct entry *entries;
+	size_t mask;		/* number of entries - 1 */
+	size_t used;		/* number of entries that aren't empty */
+	char *text;
+	size_t textLength;
+	size_t textSize;
+	uint64_t words;		/* number of words counted, not just unique ones */
+};
+
+/* A chunk of the corpus, and the counter its words go into. */
+struct job {
+	char *data;
+	size_t length;
+	struct counter *counter;
+	int status;			/* 0 on success, -1 if an allocation failed */
+	bool threaded;		/* whether the job runs on a thread of its own */
+};
+
+/* A word that may be kept in the dictionary. */
+struct candidate {
+	const char *word;
+	uint32_t length;
+	uint64_t count;
+	uint64_t saving;	/* bytes saved by having the word in the dictionary */
+};
+
+static int initCounter(struct counter *c) {
+	c->entries = calloc(INITIAL_ENTRIES, sizeof(struct entry));
+	c->mask = INITIAL_ENTRIES - 1;
+	c->used = 0;
+	c->textSize = INITIAL_ENTRIES * 8;
+	c->text = malloc(c->textSize);
+	c->textLength = 0;
+	c->words = 0;
+	return (c->entries == NULL || c->text == NULL) ? -1 : 0;
+}
+
+static void freeCounter(struct counter *c) {
+	free(c->entries);
+	free(c->text);
+	c->entries = NULL;
+	c->text = NULL;
+}
+
+/* Doubles the number of entries in C. Returns -1 if an allocation fails. */
+static int growCounter(struct counter *c) {
+	struct entry *entries;
+	size_t mask = c->mask * 2 + 1;
+	size_t i, j;
+
+	entries = calloc(mask + 1, sizeof(struct entry));
+	if (entries == NULL)
+		return -1;
+	for (i = 0; i <= c->mask; ++i) {
+		if (c->entries[i].count == 0)
+			continue;
+		for (j = c->entries[i].hash & mask; entries[j].count != 0;
+				j = (j + 1) & mask) ;
+		entries[j] = c->entries[i];
+	}
+	free(c->entries);
+	c->entries = entries;
+	c->mask = mask;
+	return 0;
+}
+
+/* Adds COUNT occurrences of the LENGTH characters at WORD, whose hash is HASH,
+   to C. Returns -1 if an allocation fails. */
+static int addWord(struct counter *c, const char *word, size_t length,
+		uint64_t hash, uint64_t count) {
+	struct entry *e;
+	size_t i;
+	char *text;
+
+	for (i = hash & c->mask; c->entries[i].count != 0; i = (i + 1) & c->mask) {
+		e = &c->entries[i];
+		if (e->hash == hash && e->length == length
+				&& memcmp(c->text + e->offset, word, length) == 0) {
+			e->count += count;
+			return 0;
+		}
+	}
+
+	/* a new word */
+	if (c->textLength + length + 1 > c->textSize) {
+		text = realloc(c->text, c->textSize * 2 + length + 1);
+		if (text == NULL)
+			return -1;
+		c->text = text;
+		c->textSize = c->textSize * 2 + length + 1;
+	}
+	e = &c->entries[i];
+	e->hash = hash;
+	e->count = count;
+	e->offset = c->textLength;
+	e->length = length;
+	memcpy(c->text + c->textLength, word, length);
+	c->text[c->textLength + length] = '\0';
+	c->textLength += length + 1;
+
+	/* keep the table at most half full */
+	if (++c->used * 2 > c->mask)
+		return growCounter(c);
+	return 0;
+}
+
+/* Counts every word in the LENGTH characters at S into C. Words too long to be
+   in a dictionary aren't counted. Returns -1 if an allocation fails. */
+static int countWords(struct counter *c, const char *s, size_t length) {
+	cblt_tokenizer tok;
+	const char *group;
+	size_t groupLength;
+	int status;
+	const char *end = s + length;
+
+	cblt_initTokenizer(&tok, s, length);
+	while (1) {
+		status = cblt_nextToken(&tok, &group, &groupLength);
+		if (status == EndOfString) {
+			/* a null character ends the tokenizer early; the encoder skips
+			   them, so we do too */
+			if (tok.next >= end)
+				break;
+			cblt_initTokenizer(&tok, tok.next + 1, end - tok.next - 1);
+			continue;
+		}
+		if (status != Word || groupLength > UINT8_MAX)
+			continue;
+		++c->words;
+		if (addWord(c, group, groupLength, cblt_hashWord(group, groupLength),
+				1) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static void *countJob(void *arg) {
+	struct job *job = arg;
+
+	job->status = countWords(job->counter, job->data, job->length);
+	return NULL;
+}
+
+/*
+ * Fills BUF with the CARRY characters left over from the last chunk, followed
+ * by as much of IN as fits in CHUNK_SIZE characters. The chunk is then cut
+ * right before its last word, unless the file has ended, and whatever comes
+ * after the cut is moved back into CARRY for the next chunk. Returns the
+ * length of the chunk, which is 0 once the whole file has been read.
+ */
+static size_t fillChunk(FILE *in, char *buf, char *carry, size_t *pcarry,
+		uint64_t *ptotal) {
+	size_t length = *pcarry;
+	size_t n;
+	size_t cut;
+
+	memcpy(buf, carry, length);
+	n = fread(buf + length, 1, CHUNK_SIZE - length, in);
+	*ptotal += n;
+	length += n;
+	*pcarry = 0;
+	if (length < CHUNK_SIZE)
+		/* that's the end of the file */
+		return length;
+
+	for (cut = length; cut > 0
+			&& cblt_getCharStatus((unsigned char)buf[cut - 1]) == Word;
+			--cut) ;
+	/* a chunk that is all one word is much too long to be in a dictionary,
+	   so it might as well be cut anywhere */
+	if (cut == 0)
+		return length;
+	*pcarry = length - cut;
+	memcpy(carry, buf + cut, *pcarry);
+	return cut;
+}
+
+/* Returns the number of elements the LENGTH characters at WORD take when they
+   aren't in the dictionary. A word of decimal digits is written as a number
+   when that is shorter, and anything else as a string literal. */
+static size_t countElements(const char *word, size_t length) {
+	size_t literal = 1 + CBLT_LITERAL_ELEMENTS(length);
+	size_t number;
+	size_t i;
+
+	for (i = 0; i < length; ++i)
+		if (word[i] < '0' || word[i] > '9')
+			return literal;
+	if (length > CBLT_MAX_DIGITS)
+		return literal;
+	/* a small number, or a CBLT_NUMBER symbol and 4 digits to an element */
+	number = (length <= 3) ? 1 : 1 + (length + 3) / 4;
+	return (number < literal) ? number : literal;
+}
+
+/* sort candidates by descending saving, so the best ones come first */
+static int cmpSaving(const void *p1, const void *p2) {
+	const struct candidate *c1 = p1, *c2 = p2;
+	if (c1->saving != c2->saving)
+		return (c1->saving < c2->saving) - (c1->saving > c2->saving);
+	if (c1->count != c2->count)
+		return (c1->count < c2->count) - (c1->count > c2->count);
+	return strcmp(c1->word, c2->word);
+}
+
+/* sort candidates by descending count, so the most frequent words get the
+   first symbols */
+static int cmpCount(const void *p1, const void *p2) {
+	const struct candidate *c1 = p1, *c2 = p2;
+	if (c1->count != c2->count)
+		return (c1->count < c2->count) - (c1->count > c2->count);
+	return strcmp(c1->word, c2->word);
+}
+
+/* Returns the number of threads to actually use when asked for THREADS. */
+static unsigned int countThreads(unsigned int threads) {
+#ifdef CBLT_HAVE_PTHREADS
+	long online;
+
+	if (threads == 0) {
+		online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (online > 0) ? (unsigned int)online : 1;
+	}
+	return threads;
+#else
+	return 1;
+#endif
+}
+
+static double getSeconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void printUsage(const char *name) {
+	fprintf(stderr, "Usage:\t%s [-n WORDS] [-j THREADS] [-w WORDLIST] "
+		"CORPUS DICTFILE\n", name);
+}
+
+int main(int argc, char **argv) {
+	size_t limit = DEFAULT_WORDS;	/* most words to keep */
+	unsigned int threads = 0;
+	const char *wordlistName = NULL;
+	FILE *infile, *outfile;
+	struct counter *counters;
+	struct job *jobs;
+	char *carry;
+	size_t carryLength = 0;
+	uint64_t total = 0;			/* characters read */
+	struct candidate *candidates;
+	const char **words;
+	size_t ncandidates, kept;
+	uint64_t saving = 0, builtinSaving = 0;
+	cblt_dict *dict;
+	double start, seconds;
+	unsigned int t, n;
+	size_t i;
+	int argi = 1;
+	bool failed = false;
+#ifdef CBLT_HAVE_PTHREADS
+	pthread_t *workers;
+#endif
+
+	while (argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0') {
+		if (argi + 1 >= argc) {
+			printUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		if (strcmp(argv[argi], "-n") == 0) {
+			limit = strtoul(argv[argi + 1], NULL, 10);
+		} else if (strcmp(argv[argi], "-j") == 0) {
+			threads = strtoul(argv[argi + 1], NULL, 10);
+		} else if (strcmp(argv[argi], "-w") == 0) {
+			wordlistName = argv[argi + 1];
+		} else {
+			printUsage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		argi += 2;
+	}
+	if (argc - argi != 2 || limit == 0) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (limit > CBLT_MAX_SYMBOLS - 0x100)
+		limit = CBLT_MAX_SYMBOLS - 0x100;
+	threads = countThreads(threads);
+
+	infile = fopen(argv[argi], "rb");
+	if (infile == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], argv[argi]);
+		return EXIT_FAILURE;
+	}
+
+	counters = malloc(sizeof(struct counter) * threads);
+	jobs = malloc(sizeof(struct job) * threads);
+	carry = malloc(CHUNK_SIZE);
+#ifdef CBLT_HAVE_PTHREADS
+	workers = malloc(sizeof(pthread_t) * threads);
+	if (workers == NULL)
+		failed = true;
+#endif
+	if (counters == NULL || jobs == NULL || carry == NULL)
+		failed = true;
+	for (t = 0; !failed && t < threads; ++t) {
+		jobs[t].counter = &counters[t];
+		jobs[t].data = malloc(CHUNK_SIZE);
+		if (initCounter(&counters[t]) != 0 || jobs[t].data == NULL)
+			failed = true;
+	}
+	if (failed) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* count every word, one chunk per thread at a time */
+	fprintf(stderr, "%s: Counting words on %u threads...\n", argv[0],
+		threads);
+	start = getSeconds();
+	while (!failed) {
+		for (n = 0; n < threads; ++n) {
+			jobs[n].length = fillChunk(infile, jobs[n].data, carry,
+				&carryLength, &total);
+			if (jobs[n].length == 0)
+				break;
+		}
+		if (n == 0)
+			break;
+
+#ifdef CBLT_HAVE_PTHREADS
+		for (t = 1; t < n; ++t) {
+			jobs[t].threaded = (pthread_create(&workers[t], NULL, countJob,
+				&jobs[t]) == 0);
+			if (!jobs[t].threaded)
+				/* count it on this thread instead */
+				countJob(&jobs[t]);
+		}
+		countJob(&jobs[0]);
+		for (t = 1; t < n; ++t)
+			if (jobs[t].threaded)
+				pthread_join(workers[t], NULL);
+#else
+		for (t = 0; t < n; ++t)
+			countJob(&jobs[t]);
+#endif
+		for (t = 0; t < n; ++t)
+			if (jobs[t].status != 0)
+				failed = true;
+	}
+	fclose(infile);
+
+	/* merge every table into the first one */
+	for (t = 1; !failed && t < threads; ++t) {
+		counters[0].words += counters[t].words;
+		for (i = 0; i <= counters[t].mask && !failed; ++i) {
+			if (counters[t].entries[i].count != 0
+					&& addWord(&counters[0],
+						counters[t].text + counters[t].entries[i].offset,
+						counters[t].entries[i].length,
+						counters[t].entries[i].hash,
+						counters[t].entries[i].count) != 0)
+				failed = true;
+		}
+		freeCounter(&counters[t]);
+	}
+	if (failed) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	seconds = getSeconds() - start;
+	fprintf(stderr, "%s: Read %llu bytes in %.2f seconds (%.2f GB/min)\n",
+		argv[0], (unsigned long long)total, seconds,
+		(seconds > 0) ? total / 1e9 / (seconds / 60) : 0.0);
+	fprintf(stderr, "%s: Found %llu words, %zu of them unique\n", argv[0],
+		(unsigned long long)counters[0].words, counters[0].used);
+	if (counters[0].used == 0) {
+		fprintf(stderr, "%s: No words found in %s\n", argv[0], argv[argi]);
+		return EXIT_FAILURE;
+	}
+
+	/* keep the words that save the most */
+	ncandidates = 0;
+	candidates = malloc(sizeof(struct candidate) * counters[0].used);
+	if (candidates == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i <= counters[0].mask; ++i) {
+		if (counters[0].entries[i].count == 0)
+			continue;
+		candidates[ncandidates].word =
+			counters[0].text + counters[0].entries[i].offset;
+		candidates[ncandidates].length = counters[0].entries[i].length;
+		candidates[ncandidates].count = counters[0].entries[i].count;
+		/* the word symbol takes the place of all but 1 of the elements the
+		   word would take otherwise */
+		candidates[ncandidates].saving = candidates[ncandidates].count
+			* sizeof(uint16_t)
+			* (countElements(candidates[ncandidates].word,
+				candidates[ncandidates].length) - 1);
+		if (cblt_findWordN(candidates[ncandidates].word,
+				candidates[ncandidates].length) >= 0)
+			builtinSaving += candidates[ncandidates].saving;
+		++ncandidates;
+	}
+	qsort(candidates, ncandidates, sizeof(struct candidate), cmpSaving);
+	kept = (ncandidates < limit) ? ncandidates : limit;
+	/* a word that saves nothing, like a small number, isn't worth a symbol */
+	while (kept > 0 && candidates[kept - 1].saving == 0)
+		--kept;
+	for (i = 0; i < kept; ++i)
+		saving += candidates[i].saving;
+	qsort(candidates, kept, sizeof(struct candidate), cmpCount);
+
+	fprintf(stderr, "%s: Kept %zu words\n", argv[0], kept);
+	fprintf(stderr, "%s: Estimated savings over encoding every word as a "
+		"string literal:\n", argv[0]);
+	fprintf(stderr, "%s: \ttrained dictionary:  %llu bytes\n", argv[0],
+		(unsigned long long)saving);
+	fprintf(stderr, "%s: \tbuilt-in dictionary: %llu bytes\n", argv[0],
+		(unsigned long long)builtinSaving);
+
+	words = malloc(sizeof(const char *) * kept);
+	if (words == NULL) {
+		fprintf(stderr, "%s: Error allocating memory.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < kept; ++i)
+		words[i] = candidates[i].word;
+
+	fprintf(stderr, "%s: Building the dictionary...\n", argv[0]);
+	dict = cblt_createDict(words, kept);
+	if (dict == NULL) {
+		fprintf(stderr, "%s: Could not build a dictionary.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	fprintf(stderr, "%s: Writing dictionary to %s\n", argv[0],
+		argv[argi + 1]);
+	if (!cblt_saveDict(dict, argv[argi + 1])) {
+		fprintf(stderr, "%s: Error writing file %s\n", argv[0],
+			argv[argi + 1]);
+		return EXIT_FAILURE;
+	}
+	cblt_closeDict(dict);
+
+	if (wordlistName != NULL) {
+		outfile = fopen(wordlistName, "w");
+		if (outfile == NULL) {
+			fprintf(stderr, "%s: Error opening file %s\n", argv[0],
+				wordlistName);
+			return EXIT_FAILURE;
+		}
+		fprintf(stderr, "%s: Writing word list to %s\n", argv[0],
+			wordlistName);
+		for (i = 0; i < kept; ++i)
+			fprintf(outfile, "%s\n", words[i]);
+		fclose(outfile);
+	}
+
+	free(words);
+	free(candidates);
+	freeCounter(&counters[0]);
+	for (t = 0; t < threads; ++t)
+		free(jobs[t].data);
+	free(jobs);
+	free(counters);
+	free(carry);
+#ifdef CBLT_HAVE_PTHREADS
+	free(workers);
+#endif
+
+	fprintf(stderr, "%s: Done.\n", argv[0]);
+	return 0;
+}
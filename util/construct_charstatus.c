@@ -0,0 +1,62 @@
+/*
+ * construct_charstatus.c
+ * by Eliot Baez
+ *
+ * This program writes the character status of every possible value of an
+ * unsigned char to charstatus.bin, one byte per character. The file is then
+ * turned into the CHARSTATUS lookup table with c_hexdump, so that the library
+ * can classify a character with a single load instead of calling isalnum().
+ *
+ * This is the one place where the rules for splitting a sentence into character
+ * groups are defined. If you want to change which characters belong to a word,
+ * change them here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "splitstring.h"
+
+#define CHARSTATUS_NAME	"charstatus.bin"
+
+/* These are the rules that cblt_getCharStatus() used to apply to every single
+   character at runtime. This program never calls setlocale(), so isalnum()
+   behaves as it does in the "C" locale. */
+static unsigned char charStatus(unsigned char c) {
+	if (c == ' ')
+		return Space;
+	if (c == '\0')
+		return EndOfString;
+	if ( isalnum(c)
+			|| (c > 0x7f)
+			|| (c == '\'')
+			|| (c == '-') )
+		return Word;
+	return Punctuation;
+}
+
+int main(int argc, char **argv) {
+	unsigned char table[0x100];
+	unsigned int c;
+	FILE *out;
+
+	(void)argc;	/* only argv[0] is used, in messages */
+
+	for (c = 0; c < 0x100; ++c)
+		table[c] = charStatus(c);
+
+	out = fopen(CHARSTATUS_NAME, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: Error opening file %s\n", argv[0], CHARSTATUS_NAME);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "%s: Writing character statuses to %s\n",
+		argv[0], CHARSTATUS_NAME);
+	fwrite(table, 1, sizeof(table), out);
+	fclose(out);
+
+	fprintf(stderr, "%s: Done.\n", argv[0]);
+	return 0;
+}